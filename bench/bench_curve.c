@@ -0,0 +1,72 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wsf_config.h"
+#include "wsf_curve.h"
+
+#define BENCH_VELOCITIES 4096
+#define BENCH_ROUNDS 20000
+
+static double bench_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec * 1e9) + (double) ts.tv_nsec;
+}
+
+/*
+ * Batch curve lookups per kernel over the default curve, as `wsf analyze`
+ * runs them. Every kernel must match the scalar one bit for bit.
+ */
+int main(void) {
+	static double velocities[BENCH_VELOCITIES];
+	static double expected[BENCH_VELOCITIES];
+	static double out[BENCH_VELOCITIES];
+	struct wsf_scroll_curve_params params;
+	struct wsf_curve_table table;
+	int kernel = 0;
+	int round = 0;
+	int i = 0;
+	int status = EXIT_SUCCESS;
+
+	wsf_scroll_curve_params_init(&params);
+	wsf_curve_compile(&table, &params);
+	for (i = 0; i < BENCH_VELOCITIES; i++) {
+		velocities[i] = table.velocity_max * 1.25 * (double) ((i * 2654435761u) % 10007) / 10007.0;
+	}
+	wsf_curve_lookup_batch(
+		&table,
+		WSF_CURVE_KERNEL_SCALAR,
+		1.35,
+		velocities,
+		expected,
+		BENCH_VELOCITIES
+	);
+
+	for (kernel = WSF_CURVE_KERNEL_SCALAR; kernel <= (int) wsf_curve_kernel_widest(); kernel++) {
+		double start = bench_now_ns();
+		double elapsed = 0.0;
+
+		for (round = 0; round < BENCH_ROUNDS; round++) {
+			wsf_curve_lookup_batch(&table, kernel, 1.35, velocities, out, BENCH_VELOCITIES);
+		}
+		elapsed = bench_now_ns() - start;
+
+		printf(
+			"%-6s %6.2f ns/lookup  %7.0f M lookups/s\n",
+			wsf_curve_kernel_name(kernel),
+			elapsed / ((double) BENCH_ROUNDS * BENCH_VELOCITIES),
+			((double) BENCH_ROUNDS * BENCH_VELOCITIES) / elapsed * 1e3
+		);
+		if (memcmp(out, expected, sizeof(out)) != 0) {
+			printf("%s kernel differs from the scalar lookup\n", wsf_curve_kernel_name(kernel));
+			status = EXIT_FAILURE;
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,192 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stub_libinput.h"
+
+/*
+ * Drives the wrapped getters the way a compositor would and reports
+ * ns/event percentiles over batches. Built as `niri` (the preload only
+ * activates in its target) and as `wsf-bench-inactive`; the factors come
+ * from the WSF_* environment overrides set by bench/meson.build. Events go
+ * through libinput_get_event() first so WSF_FETCH=1 runs can be compared.
+ */
+
+#define BENCH_BATCHES 2000
+#define BENCH_WARMUP_BATCHES 50
+#define BENCH_BATCH_EVENTS 256
+#define BENCH_EVENT_RING 64
+#define BENCH_EVENT_INTERVAL_US 8000
+
+struct libinput_event *libinput_get_event(struct libinput *libinput);
+double libinput_event_pointer_get_scroll_value(struct libinput_event *event, int axis);
+double libinput_event_pointer_get_scroll_value_v120(struct libinput_event *event, int axis);
+double libinput_event_pointer_get_axis_value_discrete(struct libinput_event *event, int axis);
+double libinput_event_gesture_get_scale(struct libinput_event *event);
+double libinput_event_gesture_get_angle_delta(struct libinput_event *event);
+void libinput_event_destroy(struct libinput_event *event);
+
+typedef double (*bench_path_fn)(struct libinput_event *event, unsigned int i);
+
+struct bench_path {
+	const char *name;
+	int type;
+	int source;
+	bench_path_fn run;
+};
+
+static struct libinput_event bench_events[BENCH_EVENT_RING];
+static uint64_t bench_time_usec = 1000000;
+static char bench_device;
+static struct libinput bench_libinput;
+
+static double bench_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec * 1e9) + (double) ts.tv_nsec;
+}
+
+/* Events are dequeued after they are filled, as libinput hands them out. */
+static struct libinput_event *bench_fetch(struct libinput_event *event) {
+	bench_libinput.pending = event;
+	return libinput_get_event(&bench_libinput);
+}
+
+/* Finger scroll: both axes, as niri reads them, then the event is freed. */
+static double bench_scroll(struct libinput_event *event, unsigned int i) {
+	double sum = 0.0;
+
+	event->value[0] = 2.0 + (double) (i & 7);
+	event->value[1] = 0.5 * (double) (i & 3);
+	event = bench_fetch(event);
+	sum += libinput_event_pointer_get_scroll_value(event, 0);
+	sum += libinput_event_pointer_get_scroll_value(event, 1);
+	libinput_event_destroy(event);
+	return sum;
+}
+
+static double bench_v120(struct libinput_event *event, unsigned int i) {
+	double sum = 0.0;
+
+	event->value[0] = (i & 1) != 0 ? 1.0 : -1.0;
+	event->value[1] = 0.0;
+	event = bench_fetch(event);
+	sum += libinput_event_pointer_get_scroll_value_v120(event, 0);
+	sum += libinput_event_pointer_get_scroll_value_v120(event, 1);
+	libinput_event_destroy(event);
+	return sum;
+}
+
+static double bench_discrete(struct libinput_event *event, unsigned int i) {
+	double sum = 0.0;
+
+	event->discrete[0] = (i & 1) != 0 ? 1.0 : -1.0;
+	event->discrete[1] = 0.0;
+	event = bench_fetch(event);
+	sum += libinput_event_pointer_get_axis_value_discrete(event, 0);
+	sum += libinput_event_pointer_get_axis_value_discrete(event, 1);
+	libinput_event_destroy(event);
+	return sum;
+}
+
+static double bench_pinch(struct libinput_event *event, unsigned int i) {
+	double sum = 0.0;
+
+	event->scale = 0.75 + ((double) (i & 63) / 64.0);
+	event = bench_fetch(event);
+	sum += libinput_event_gesture_get_scale(event);
+	libinput_event_destroy(event);
+	return sum;
+}
+
+static double bench_rotate(struct libinput_event *event, unsigned int i) {
+	double sum = 0.0;
+
+	event->angle_delta = ((double) (i & 15) - 7.5) * 0.1;
+	event = bench_fetch(event);
+	sum += libinput_event_gesture_get_angle_delta(event);
+	libinput_event_destroy(event);
+	return sum;
+}
+
+static const struct bench_path bench_paths[] = {
+	{ "scroll", STUB_EVENT_POINTER_SCROLL_FINGER, STUB_AXIS_SOURCE_FINGER, bench_scroll },
+	{ "v120", STUB_EVENT_POINTER_SCROLL_WHEEL, STUB_AXIS_SOURCE_WHEEL, bench_v120 },
+	{ "discrete", STUB_EVENT_POINTER_AXIS, STUB_AXIS_SOURCE_WHEEL, bench_discrete },
+	{ "pinch", STUB_EVENT_GESTURE_PINCH_UPDATE, 0, bench_pinch },
+	{ "rotate", STUB_EVENT_GESTURE_PINCH_UPDATE, 0, bench_rotate },
+};
+
+static int bench_compare(const void *a, const void *b) {
+	double lhs = *(const double *) a;
+	double rhs = *(const double *) b;
+
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+static double bench_batch(const struct bench_path *path) {
+	double sum = 0.0;
+	unsigned int i = 0;
+
+	for (i = 0; i < BENCH_BATCH_EVENTS; i++) {
+		struct libinput_event *event = &bench_events[i % BENCH_EVENT_RING];
+
+		event->type = path->type;
+		event->source = path->source;
+		event->device = (struct libinput_device *) &bench_device;
+		event->time_usec = bench_time_usec;
+		bench_time_usec += BENCH_EVENT_INTERVAL_US;
+		sum += path->run(event, i);
+	}
+
+	return sum;
+}
+
+static void bench_run(const char *label, const struct bench_path *path, double *samples) {
+	volatile double sink = 0.0;
+	unsigned int batch = 0;
+
+	for (batch = 0; batch < BENCH_WARMUP_BATCHES; batch++) {
+		sink += bench_batch(path);
+	}
+
+	for (batch = 0; batch < BENCH_BATCHES; batch++) {
+		double start = bench_now_ns();
+
+		sink += bench_batch(path);
+		samples[batch] = (bench_now_ns() - start) / BENCH_BATCH_EVENTS;
+	}
+
+	qsort(samples, BENCH_BATCHES, sizeof(samples[0]), bench_compare);
+	printf(
+		"%-9s %-9s min %7.1f  p50 %7.1f  p90 %7.1f  p99 %7.1f  max %8.1f ns/event\n",
+		label,
+		path->name,
+		samples[0],
+		samples[BENCH_BATCHES / 2],
+		samples[(BENCH_BATCHES * 90) / 100],
+		samples[(BENCH_BATCHES * 99) / 100],
+		samples[BENCH_BATCHES - 1]
+	);
+	(void) sink;
+}
+
+int main(int argc, char **argv) {
+	static double samples[BENCH_BATCHES];
+	const char *label = argc > 1 ? argv[1] : "default";
+	const char *only = argc > 2 ? argv[2] : NULL;
+	size_t i = 0;
+
+	for (i = 0; i < sizeof(bench_paths) / sizeof(bench_paths[0]); i++) {
+		if (only != NULL && strcmp(only, bench_paths[i].name) != 0) {
+			continue;
+		}
+		bench_run(label, &bench_paths[i], samples);
+	}
+
+	return 0;
+}
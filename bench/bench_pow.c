@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "wsf_config.h"
+#include "wsf_fastmath.h"
+
+#define BENCH_CALLS 20000000
+#define BENCH_SCALES 1024
+#define BENCH_MAX_REL_ERROR 1e-10
+
+static double bench_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec * 1e9) + (double) ts.tv_nsec;
+}
+
+/* Worst relative error over the pinch domain the preload can see. */
+static double bench_max_error(void) {
+	double worst = 0.0;
+	double y = 0.0;
+
+	for (y = WSF_FACTOR_MIN; y <= WSF_FACTOR_MAX; y += 0.0125) {
+		double x = 0.0;
+
+		for (x = 1.0 / 64.0; x <= 64.0; x *= 1.0009765625) {
+			double exact = pow(x, y);
+			double fast = 0.0;
+			double error = 0.0;
+
+			if (!wsf_fast_pow(x, y, &fast)) {
+				return INFINITY;
+			}
+			error = fabs(fast - exact) / exact;
+			if (error > worst) {
+				worst = error;
+			}
+		}
+	}
+
+	return worst;
+}
+
+int main(void) {
+	double scales[BENCH_SCALES];
+	volatile double factor = 1.35;
+	double sink = 0.0;
+	double start = 0.0;
+	double libm_ns = 0.0;
+	double fast_ns = 0.0;
+	double worst = 0.0;
+	int i = 0;
+
+	wsf_fastmath_init();
+	for (i = 0; i < BENCH_SCALES; i++) {
+		scales[i] = 0.5 + ((double) i / BENCH_SCALES) * 1.5;
+	}
+
+	start = bench_now_ns();
+	for (i = 0; i < BENCH_CALLS; i++) {
+		sink += pow(scales[i & (BENCH_SCALES - 1)], factor);
+	}
+	libm_ns = (bench_now_ns() - start) / BENCH_CALLS;
+
+	start = bench_now_ns();
+	for (i = 0; i < BENCH_CALLS; i++) {
+		double value = 0.0;
+
+		wsf_fast_pow(scales[i & (BENCH_SCALES - 1)], factor, &value);
+		sink += value;
+	}
+	fast_ns = (bench_now_ns() - start) / BENCH_CALLS;
+
+	worst = bench_max_error();
+	printf("glibc pow:    %.2f ns/call\n", libm_ns);
+	printf("wsf_fast_pow: %.2f ns/call\n", fast_ns);
+	printf("max relative error: %.3g (limit %.3g)\n", worst, BENCH_MAX_REL_ERROR);
+	printf("(checksum %g)\n", sink);
+
+	return worst <= BENCH_MAX_REL_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
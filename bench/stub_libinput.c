@@ -0,0 +1,79 @@
+#include "stub_libinput.h"
+
+#include <stddef.h>
+
+/* Pointer, gesture and base events are all the same struct here. */
+
+struct libinput_event *libinput_get_event(struct libinput *libinput) {
+	struct libinput_event *event = libinput->pending;
+
+	libinput->pending = NULL;
+	return event;
+}
+
+struct libinput_event *libinput_event_get_pointer_event(struct libinput_event *event) {
+	return event;
+}
+
+struct libinput_event *libinput_event_get_gesture_event(struct libinput_event *event) {
+	return event;
+}
+
+struct libinput_event *libinput_event_pointer_get_base_event(struct libinput_event *event) {
+	return event;
+}
+
+int libinput_event_get_type(struct libinput_event *event) {
+	return event->type;
+}
+
+struct libinput_device *libinput_event_get_device(struct libinput_event *event) {
+	return event->device;
+}
+
+/* Every stub scroll event carries both axes. */
+int libinput_event_pointer_has_axis(struct libinput_event *event, int axis) {
+	(void) event;
+	(void) axis;
+	return 1;
+}
+
+int libinput_event_pointer_get_axis_source(struct libinput_event *event) {
+	return event->source;
+}
+
+uint64_t libinput_event_pointer_get_time_usec(struct libinput_event *event) {
+	return event->time_usec;
+}
+
+uint32_t libinput_event_pointer_get_time(struct libinput_event *event) {
+	return (uint32_t) (event->time_usec / 1000);
+}
+
+double libinput_event_pointer_get_scroll_value(struct libinput_event *event, int axis) {
+	return event->value[axis != 0];
+}
+
+double libinput_event_pointer_get_scroll_value_v120(struct libinput_event *event, int axis) {
+	return event->value[axis != 0] * 120.0;
+}
+
+double libinput_event_pointer_get_axis_value(struct libinput_event *event, int axis) {
+	return event->value[axis != 0];
+}
+
+double libinput_event_pointer_get_axis_value_discrete(struct libinput_event *event, int axis) {
+	return event->discrete[axis != 0];
+}
+
+double libinput_event_gesture_get_scale(struct libinput_event *event) {
+	return event->scale;
+}
+
+double libinput_event_gesture_get_angle_delta(struct libinput_event *event) {
+	return event->angle_delta;
+}
+
+void libinput_event_destroy(struct libinput_event *event) {
+	(void) event;
+}
@@ -0,0 +1,41 @@
+#ifndef WSF_STUB_LIBINPUT_H
+#define WSF_STUB_LIBINPUT_H
+
+#include <stdint.h>
+
+/*
+ * Just enough of libinput for the preload to classify and scale events:
+ * every getter the preload wraps or calls reads a field of this struct.
+ * The bench driver fills these directly; there is no real device. Event
+ * type numbers match libinput's.
+ */
+
+#define STUB_EVENT_DEVICE_REMOVED 2
+#define STUB_EVENT_POINTER_AXIS 403
+#define STUB_EVENT_POINTER_SCROLL_WHEEL 404
+#define STUB_EVENT_POINTER_SCROLL_FINGER 405
+#define STUB_EVENT_GESTURE_PINCH_UPDATE 804
+
+#define STUB_AXIS_SOURCE_WHEEL 1
+#define STUB_AXIS_SOURCE_FINGER 2
+
+struct libinput_device;
+struct libinput_event;
+
+/* A one-slot queue: the driver posts an event and fetches it straight back. */
+struct libinput {
+	struct libinput_event *pending;
+};
+
+struct libinput_event {
+	int type;
+	int source;
+	uint64_t time_usec;
+	double value[2];
+	double discrete[2];
+	double scale;
+	double angle_delta;
+	struct libinput_device *device;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 
+import ctypes
 import json
 import os
 import shutil
@@ -10,13 +11,16 @@ import gi
 gi.require_version("Gtk", "4.0")
 gi.require_version("Adw", "1")
 
-from gi.repository import Adw, Gdk, GLib, Gtk
+from gi.repository import Adw, Gdk, Gio, GLib, Gtk
 
 APP_ID = "io.github.danielgrasso.WaylandScrollFactor"
 FACTOR_MIN = 0.05
 FACTOR_MAX = 5.0
 DEFAULT_FACTOR = 1.0
-DEBOUNCE_MS = 350
+PREVIEW_DEBOUNCE_MS = 30
+COMMIT_DEBOUNCE_MS = 750
+PREVIEW_SAMPLES = 96
+PREVIEW_HEIGHT = 120
 
 CLI_MAP = {
     "scroll_vertical": "--scroll-vertical",
@@ -26,6 +30,207 @@ CLI_MAP = {
 }
 
 
+class WsfBackend:
+    """One long-running `wsf serve` process shared by every action.
+
+    Requests are JSON lines written to its stdin; replies come back in
+    order and are read asynchronously, so the main loop never waits on the
+    CLI. Callbacks get a subprocess.CompletedProcess, or None when wsf
+    could not be run. A CLI without `serve` falls back to one process per
+    call.
+    """
+
+    def __init__(self, cli_path):
+        self._cli_path = cli_path
+        self._process = None
+        self._stdin = None
+        self._stdout = None
+        self._pending = {}
+        self._next_id = 1
+        self._answered = False
+        self._serve_supported = True
+
+    def call(self, args, callback):
+        if not self._serve_supported:
+            callback(self._run_once(args))
+            return
+        if self._process is None and not self._start():
+            callback(None)
+            return
+
+        request_id = self._next_id
+        self._next_id += 1
+        line = json.dumps({"id": request_id, "args": args}) + "\n"
+        try:
+            self._stdin.write_all(line.encode("utf-8"), None)
+        except GLib.Error:
+            self._stop()
+            callback(None)
+            return
+        self._pending[request_id] = (args, callback)
+
+    def close(self):
+        if self._stdin is not None:
+            try:
+                self._stdin.close(None)
+            except GLib.Error:
+                pass
+        self._process = None
+        self._stdin = None
+        self._stdout = None
+
+    def _start(self):
+        try:
+            self._process = Gio.Subprocess.new(
+                [self._cli_path, "serve"],
+                Gio.SubprocessFlags.STDIN_PIPE | Gio.SubprocessFlags.STDOUT_PIPE,
+            )
+        except GLib.Error:
+            self._process = None
+            return False
+        self._stdin = self._process.get_stdin_pipe()
+        self._stdout = Gio.DataInputStream.new(self._process.get_stdout_pipe())
+        self._answered = False
+        self._read_next()
+        return True
+
+    def _read_next(self):
+        self._stdout.read_line_async(
+            GLib.PRIORITY_DEFAULT, None, self._on_line, self._process
+        )
+
+    def _on_line(self, stream, result, process):
+        if process is not self._process:
+            return
+        try:
+            line, _length = stream.read_line_finish_utf8(result)
+        except GLib.Error:
+            line = None
+        if line is None:
+            if not self._answered:
+                self._serve_supported = False
+            self._stop()
+            return
+
+        self._answered = True
+        try:
+            reply = json.loads(line)
+        except json.JSONDecodeError:
+            reply = {}
+        pending = self._pending.pop(reply.get("id"), None)
+        if pending is not None:
+            args, callback = pending
+            callback(
+                subprocess.CompletedProcess(
+                    [self._cli_path] + args,
+                    reply.get("status", 1),
+                    reply.get("stdout", ""),
+                    reply.get("stderr", ""),
+                )
+            )
+        self._read_next()
+
+    def _stop(self):
+        """Drops the backend. Pending requests fail, or run one process each
+        when the CLI turned out to have no `serve`."""
+        pending = list(self._pending.values())
+        self._pending = {}
+        if self._process is not None:
+            self._process.force_exit()
+        self.close()
+        for args, callback in pending:
+            if self._serve_supported:
+                callback(None)
+            else:
+                callback(self._run_once(args))
+
+    def _run_once(self, args):
+        try:
+            return subprocess.run(
+                [self._cli_path] + args,
+                text=True,
+                capture_output=True,
+                check=False,
+            )
+        except OSError:
+            return None
+
+
+class WsfCore:
+    """The scaling engine from libwsf_core.so, for the curve preview.
+
+    The multipliers come from the same code the preload runs, so the
+    preview is exact and needs no round trip to the CLI.
+    """
+
+    AXES = {"scroll_vertical": 0, "scroll_horizontal": 1}
+
+    def __init__(self, path):
+        lib = ctypes.CDLL(path)
+        lib.wsf_core_new.argtypes = [ctypes.c_char_p]
+        lib.wsf_core_new.restype = ctypes.c_void_p
+        lib.wsf_core_free.argtypes = [ctypes.c_void_p]
+        lib.wsf_core_free.restype = None
+        lib.wsf_core_set_factors.argtypes = [ctypes.c_void_p] + [ctypes.c_double] * 4
+        lib.wsf_core_set_factors.restype = None
+        lib.wsf_core_curve_range.argtypes = [
+            ctypes.c_void_p,
+            ctypes.POINTER(ctypes.c_double),
+            ctypes.POINTER(ctypes.c_double),
+        ]
+        lib.wsf_core_curve_range.restype = None
+        lib.wsf_core_curve_sample.argtypes = [
+            ctypes.c_void_p,
+            ctypes.c_uint,
+            ctypes.POINTER(ctypes.c_double),
+            ctypes.POINTER(ctypes.c_double),
+            ctypes.c_size_t,
+        ]
+        lib.wsf_core_curve_sample.restype = None
+
+        self._lib = lib
+        self._core = lib.wsf_core_new(None)
+        if not self._core:
+            raise OSError(f"{path}: cannot load the wsf config")
+
+    @classmethod
+    def load(cls, library_dir):
+        path = os.path.join(library_dir, "libwsf_core.so")
+        if not os.path.exists(path):
+            return None
+        try:
+            return cls(path)
+        except OSError:
+            return None
+
+    def set_factors(self, factors):
+        self._lib.wsf_core_set_factors(
+            self._core,
+            factors.get("scroll_vertical", DEFAULT_FACTOR),
+            factors.get("scroll_horizontal", DEFAULT_FACTOR),
+            factors.get("pinch_zoom", DEFAULT_FACTOR),
+            factors.get("pinch_rotate", DEFAULT_FACTOR),
+        )
+
+    def curve_range(self):
+        low = ctypes.c_double()
+        high = ctypes.c_double()
+        self._lib.wsf_core_curve_range(self._core, ctypes.byref(low), ctypes.byref(high))
+        return low.value, high.value
+
+    def sample(self, key, velocities):
+        count = len(velocities)
+        inputs = (ctypes.c_double * count)(*velocities)
+        outputs = (ctypes.c_double * count)()
+        self._lib.wsf_core_curve_sample(self._core, self.AXES[key], inputs, outputs, count)
+        return list(outputs)
+
+    def close(self):
+        if self._core:
+            self._lib.wsf_core_free(self._core)
+            self._core = None
+
+
 class WsfWindow(Adw.ApplicationWindow):
     def __init__(self, app):
         super().__init__(application=app)
@@ -33,7 +238,11 @@ class WsfWindow(Adw.ApplicationWindow):
         self.set_default_size(560, 640)
 
         self._cli_path = self._find_wsf()
-        self._debounce_ids = {}
+        self._backend = WsfBackend(self._cli_path) if self._cli_path else None
+        self._pending_factors = {}
+        self._preview_id = None
+        self._commit_id = None
+        self._core = None
         self._loading = True
         self._last_doctor_output = ""
 
@@ -99,6 +308,16 @@ class WsfWindow(Adw.ApplicationWindow):
             "↻",
         )
 
+        self._preview = Gtk.DrawingArea()
+        self._preview.set_content_height(PREVIEW_HEIGHT)
+        self._preview.set_hexpand(True)
+        self._preview.set_draw_func(self._draw_preview)
+        self._preview.set_tooltip_text(
+            "Scroll multiplier against finger speed: vertical solid, horizontal dashed"
+        )
+        self._preview.set_visible(False)
+        self._scroll_group.add(self._preview)
+
         self._system_group = Adw.PreferencesGroup(title="System integration")
         content.append(self._system_group)
 
@@ -144,6 +363,8 @@ class WsfWindow(Adw.ApplicationWindow):
         diagnostics_scroller.set_child(diagnostics_view)
         self._diagnostics_group.add(diagnostics_scroller)
 
+        self.connect("close-request", self._on_close_request)
+
         self._loading = False
         self._refresh_all()
 
@@ -257,32 +478,60 @@ class WsfWindow(Adw.ApplicationWindow):
         self._set_slider_value(key, DEFAULT_FACTOR)
 
     def _on_adjustment_changed(self, adjustment, key):
+        self._update_preview()
         if self._loading:
             return
         value = adjustment.get_value()
         self._schedule_apply(key, value)
 
     def _schedule_apply(self, key, value):
-        if key in self._debounce_ids:
-            GLib.source_remove(self._debounce_ids[key])
-
-        def _apply():
-            self._debounce_ids.pop(key, None)
-            self._apply_factor(key, value)
-            return False
-
-        self._debounce_ids[key] = GLib.timeout_add(DEBOUNCE_MS, _apply)
-
-    def _apply_factor(self, key, value):
-        flag = CLI_MAP.get(key)
-        if flag is None:
-            return
-        result = self._run_wsf(["set", flag, f"{value:.4f}"])
+        """While a slider moves, only the running compositor is retuned
+        (`set --preview`, no file write); the config is written once the
+        values have settled."""
+        self._pending_factors[key] = value
+        if self._preview_id is not None:
+            GLib.source_remove(self._preview_id)
+        if self._commit_id is not None:
+            GLib.source_remove(self._commit_id)
+        self._preview_id = GLib.timeout_add(PREVIEW_DEBOUNCE_MS, self._preview_factors)
+        self._commit_id = GLib.timeout_add(COMMIT_DEBOUNCE_MS, self._commit_factors)
+
+    def _factor_args(self):
+        args = []
+        for key, value in self._pending_factors.items():
+            flag = CLI_MAP.get(key)
+            if flag is not None:
+                args += [flag, f"{value:.4f}"]
+        return args
+
+    def _preview_factors(self):
+        self._preview_id = None
+        args = self._factor_args()
+        if args:
+            # Failures surface once, from the commit.
+            self._call_wsf(["set", "--preview"] + args, lambda _result: None)
+        return False
+
+    def _commit_factors(self):
+        self._commit_id = None
+        if self._preview_id is not None:
+            GLib.source_remove(self._preview_id)
+            self._preview_id = None
+        args = self._factor_args()
+        self._pending_factors = {}
+        if args:
+            self._call_wsf(["set", "--live"] + args, self._on_factor_applied)
+        return False
+
+    def _on_factor_applied(self, result):
         if not result:
             self._show_toast("wsf not found. Install the CLI first.")
             return
         if result.returncode == 0:
-            self._show_toast("Applied. Log out and back in to take effect.")
+            # The config was written; a warning says it did not reach niri.
+            warning = result.stderr.strip()
+            if warning:
+                self._show_toast(warning)
             return
         self._show_toast(result.stderr.strip() or "Failed to apply settings.")
 
@@ -290,7 +539,9 @@ class WsfWindow(Adw.ApplicationWindow):
         if self._loading:
             return
         cmd = "enable" if switch.get_active() else "disable"
-        result = self._run_wsf([cmd])
+        self._call_wsf([cmd], self._on_enabled_applied)
+
+    def _on_enabled_applied(self, result):
         if not result:
             self._show_toast("wsf not found. Install the CLI first.")
             return
@@ -300,7 +551,9 @@ class WsfWindow(Adw.ApplicationWindow):
         self._show_toast(result.stderr.strip() or "Failed to change status.")
 
     def _on_run_doctor(self, _button):
-        result = self._run_wsf(["doctor"])
+        self._call_wsf(["doctor"], self._on_doctor_done)
+
+    def _on_doctor_done(self, result):
         if not result:
             self._show_toast("wsf not found. Install the CLI first.")
             return
@@ -324,18 +577,21 @@ class WsfWindow(Adw.ApplicationWindow):
         clipboard.set_text(self._last_doctor_output)
         self._show_toast("Diagnostics copied to clipboard.")
 
-    def _run_wsf(self, args):
-        if not self._cli_path:
-            return None
-        try:
-            return subprocess.run(
-                [self._cli_path] + args,
-                text=True,
-                capture_output=True,
-                check=False,
-            )
-        except OSError:
-            return None
+    def _call_wsf(self, args, callback):
+        if not self._backend:
+            callback(None)
+            return
+        self._backend.call(args, callback)
+
+    def _on_close_request(self, _window):
+        if self._commit_id is not None:
+            GLib.source_remove(self._commit_id)
+            self._commit_factors()
+        if self._backend:
+            self._backend.close()
+        if self._core:
+            self._core.close()
+        return False
 
     def _find_wsf(self):
         path = shutil.which("wsf")
@@ -352,7 +608,9 @@ class WsfWindow(Adw.ApplicationWindow):
         self._refresh_status()
 
     def _refresh_factors(self):
-        result = self._run_wsf(["get", "--json"])
+        self._call_wsf(["get", "--json"], self._on_factors_loaded)
+
+    def _on_factors_loaded(self, result):
         if not result or result.returncode != 0:
             return
         try:
@@ -368,7 +626,9 @@ class WsfWindow(Adw.ApplicationWindow):
         self._loading = False
 
     def _refresh_status(self):
-        result = self._run_wsf(["status", "--json"])
+        self._call_wsf(["status", "--json"], self._on_status_loaded)
+
+    def _on_status_loaded(self, result):
         if not result or result.returncode != 0:
             return
         try:
@@ -379,6 +639,52 @@ class WsfWindow(Adw.ApplicationWindow):
         self._enable_switch.set_active(bool(data.get("enabled", False)))
         self._loading = False
 
+        library = data.get("library")
+        if self._core is None and library:
+            self._core = WsfCore.load(os.path.dirname(library))
+            self._update_preview()
+
+    def _update_preview(self):
+        if not self._core:
+            return
+        self._core.set_factors(
+            {key: slider["adjustment"].get_value() for key, slider in self._sliders.items()}
+        )
+        self._preview.set_visible(True)
+        self._preview.queue_draw()
+
+    def _draw_preview(self, area, cr, width, height):
+        if not self._core or width <= 0 or height <= 0:
+            return
+        _low, high = self._core.curve_range()
+        top_speed = max(high, 1.0) * 1.25
+        velocities = [
+            top_speed * i / (PREVIEW_SAMPLES - 1) for i in range(PREVIEW_SAMPLES)
+        ]
+        curves = [
+            (self._core.sample("scroll_vertical", velocities), []),
+            (self._core.sample("scroll_horizontal", velocities), [6.0, 4.0]),
+        ]
+        top_multiplier = max(max(values) for values, _dash in curves) * 1.1
+        if top_multiplier <= 0.0:
+            return
+
+        color = area.get_color() if hasattr(area, "get_color") else None
+        if color:
+            cr.set_source_rgba(color.red, color.green, color.blue, color.alpha)
+        cr.set_line_width(2.0)
+        pad = 2.0
+        for values, dash in curves:
+            cr.set_dash(dash)
+            for i, value in enumerate(values):
+                x = pad + (width - 2 * pad) * i / (PREVIEW_SAMPLES - 1)
+                y = height - pad - (height - 2 * pad) * value / top_multiplier
+                if i == 0:
+                    cr.move_to(x, y)
+                else:
+                    cr.line_to(x, y)
+            cr.stroke()
+
     def _show_toast(self, message):
         self._toast_overlay.add_toast(Adw.Toast.new(message))
 
@@ -6,6 +6,7 @@ PREFIX="${PREFIX:-$HOME/.local}"
 rm -f "$PREFIX/bin/wsf"
 rm -f "$PREFIX/bin/wsf-gui"
 rm -f "$PREFIX/lib/wayland-scroll-factor/libwsf_preload.so"
+rm -f "$PREFIX/lib/wayland-scroll-factor/libwsf_core.so"
 rm -rf "$PREFIX/lib/wayland-scroll-factor"
 rm -f "$PREFIX/share/applications/io.github.danielgrasso.WaylandScrollFactor.desktop"
 rm -f "$PREFIX/share/metainfo/io.github.danielgrasso.WaylandScrollFactor.metainfo.xml"
@@ -4,14 +4,42 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#define WSF_CONFIG_CACHE_MAGIC 0x43465357u
+#define WSF_CONFIG_CACHE_VERSION 4u
+
+/*
+ * config.cache, written by the CLI next to the text config: the parse
+ * result of one exact version of that file, keyed by its identity and
+ * mtime. The layout is the in-memory struct of this build; version, size
+ * and checksum reject caches from any other build, and a key mismatch
+ * (hand edit, editor rename) sends readers back to the text parser.
+ */
+struct wsf_config_cache {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	int32_t status;
+	uint64_t source_dev;
+	uint64_t source_ino;
+	uint64_t source_size;
+	int64_t source_mtime_sec;
+	int64_t source_mtime_nsec;
+	struct wsf_config_values values;
+	uint64_t checksum;
+};
+
 static void wsf_debug_log(bool debug, const char *fmt, ...) {
 	if (!debug) {
 		return;
@@ -32,6 +60,37 @@ bool wsf_debug_enabled(void) {
 	return env != NULL && env[0] == '1';
 }
 
+bool wsf_trace_enabled(void) {
+	const char *env = getenv("WSF_TRACE");
+
+	return env != NULL && env[0] == '1';
+}
+
+bool wsf_stats_enabled(void) {
+	const char *env = getenv("WSF_STATS");
+
+	return env != NULL && env[0] == '1';
+}
+
+bool wsf_fetch_enabled(void) {
+	const char *env = getenv("WSF_FETCH");
+
+	return env != NULL && env[0] == '1';
+}
+
+bool wsf_coalesce_enabled(void) {
+	const char *env = getenv("WSF_COALESCE");
+
+	return env != NULL && env[0] == '1';
+}
+
+/* WSF_NO_SHM=1 keeps test and benchmark runs off the session's control block. */
+bool wsf_shm_enabled(void) {
+	const char *env = getenv("WSF_NO_SHM");
+
+	return env == NULL || env[0] != '1';
+}
+
 static const char *wsf_home(void) {
 	const char *home = getenv("HOME");
 
@@ -109,6 +168,20 @@ void wsf_config_values_init(struct wsf_config_values *values) {
 	values->has_scroll_horizontal = false;
 	values->has_pinch_zoom = false;
 	values->has_pinch_rotate = false;
+	wsf_scroll_curve_params_init(&values->curve);
+	values->has_curve_kind = false;
+	values->has_curve_points = false;
+	values->has_curve_min_multiplier = false;
+	values->has_curve_max_multiplier = false;
+	values->has_curve_velocity_low = false;
+	values->has_curve_velocity_high = false;
+	values->has_curve_smoothing = false;
+	values->has_curve_reset_gap = false;
+	values->device_profile_count = 0;
+	memset(values->device_profiles, 0, sizeof(values->device_profiles));
+	values->focus_profile_count = 0;
+	memset(values->focus_profiles, 0, sizeof(values->focus_profiles));
+	values->generation = 0;
 }
 
 static char *wsf_trim(char *str) {
@@ -130,13 +203,588 @@ static char *wsf_trim(char *str) {
 	return str;
 }
 
+static bool wsf_parse_curve_kind(const char *input, uint32_t *out_kind) {
+	if (strcmp(input, "smoothstep") == 0) {
+		*out_kind = WSF_SCROLL_CURVE_SMOOTHSTEP;
+		return true;
+	}
+	if (strcmp(input, "linear") == 0) {
+		*out_kind = WSF_SCROLL_CURVE_LINEAR;
+		return true;
+	}
+	if (strcmp(input, "cubic") == 0) {
+		*out_kind = WSF_SCROLL_CURVE_CUBIC;
+		return true;
+	}
+
+	return false;
+}
+
+const char *wsf_scroll_curve_kind_name(uint32_t kind) {
+	switch (kind) {
+	case WSF_SCROLL_CURVE_LINEAR:
+		return "linear";
+	case WSF_SCROLL_CURVE_CUBIC:
+		return "cubic";
+	default:
+		return "smoothstep";
+	}
+}
+
+/* "velocity:multiplier" pairs separated by commas, e.g. "80:0.7, 2000:1.65". */
+static bool wsf_parse_curve_points(
+	const char *input,
+	struct wsf_scroll_curve_params *params
+) {
+	const char *cursor = input;
+	unsigned int count = 0;
+
+	while (*cursor != '\0' && *cursor != '#') {
+		char *end = NULL;
+		double velocity = 0.0;
+		double multiplier = 0.0;
+
+		while (isspace((unsigned char) *cursor) || *cursor == ',') {
+			cursor++;
+		}
+		if (*cursor == '\0' || *cursor == '#') {
+			break;
+		}
+		if (count == WSF_SCROLL_CURVE_MAX_POINTS) {
+			return false;
+		}
+
+		errno = 0;
+		velocity = strtod(cursor, &end);
+		if (end == cursor || errno == ERANGE || *end != ':') {
+			return false;
+		}
+		cursor = end + 1;
+		multiplier = strtod(cursor, &end);
+		if (end == cursor || errno == ERANGE) {
+			return false;
+		}
+		cursor = end;
+
+		params->point_velocity[count] = velocity;
+		params->point_multiplier[count] = multiplier;
+		count++;
+	}
+
+	params->point_count = count;
+	return count >= 2;
+}
+
+/*
+ * Curve keys share one parser. Returns false when key is not a curve key;
+ * *invalid is set when it is one but the value does not parse.
+ */
+static bool wsf_parse_curve_key(
+	const char *key,
+	const char *value,
+	struct wsf_config_values *values,
+	bool *invalid
+) {
+	struct wsf_scroll_curve_params *curve = &values->curve;
+	double number = 0.0;
+
+	if (strcmp(key, "scroll_curve") == 0) {
+		if (!wsf_parse_curve_kind(value, &curve->kind)) {
+			*invalid = true;
+			return true;
+		}
+		values->has_curve_kind = true;
+		return true;
+	}
+	if (strcmp(key, "scroll_curve_points") == 0) {
+		if (!wsf_parse_curve_points(value, curve)) {
+			curve->point_count = 0;
+			*invalid = true;
+			return true;
+		}
+		values->has_curve_points = true;
+		return true;
+	}
+
+	if (strncmp(key, "scroll_curve_", 13) != 0) {
+		return false;
+	}
+	if (!wsf_parse_factor_str(value, &number) || !isfinite(number)) {
+		*invalid = true;
+		return true;
+	}
+
+	if (strcmp(key, "scroll_curve_min_multiplier") == 0) {
+		curve->min_multiplier = number;
+		values->has_curve_min_multiplier = true;
+	} else if (strcmp(key, "scroll_curve_max_multiplier") == 0) {
+		curve->max_multiplier = number;
+		values->has_curve_max_multiplier = true;
+	} else if (strcmp(key, "scroll_curve_velocity_low") == 0) {
+		curve->velocity_low = number;
+		values->has_curve_velocity_low = true;
+	} else if (strcmp(key, "scroll_curve_velocity_high") == 0) {
+		curve->velocity_high = number;
+		values->has_curve_velocity_high = true;
+	} else if (strcmp(key, "scroll_curve_smoothing") == 0) {
+		curve->smoothing = number;
+		values->has_curve_smoothing = true;
+	} else if (strcmp(key, "scroll_curve_reset_gap_ms") == 0) {
+		curve->reset_gap_us = number * 1000.0;
+		values->has_curve_reset_gap = true;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool wsf_parse_device_id(const char *input, uint32_t *out_id) {
+	char *end = NULL;
+	unsigned long value = 0;
+
+	errno = 0;
+	value = strtoul(input, &end, 16);
+	if (end == input || errno == ERANGE || value > 0xffff) {
+		return false;
+	}
+	while (isspace((unsigned char) *end)) {
+		end++;
+	}
+	if (*end != '\0' && *end != '#') {
+		return false;
+	}
+
+	*out_id = (uint32_t) value;
+	return true;
+}
+
+/*
+ * Factor keys shared by [device], [app] and [output] sections. factors
+ * points at the profile's four factors, which both profile structs keep
+ * in this order. Returns false for other keys.
+ */
+static bool wsf_parse_profile_factor(
+	const char *key,
+	const char *value,
+	double *factors,
+	uint32_t *keys,
+	bool *invalid
+) {
+	static const struct {
+		const char *key;
+		uint32_t bit;
+	} factor_keys[] = {
+		{ "scroll_vertical_factor", WSF_DEVICE_KEY_SCROLL_VERTICAL },
+		{ "scroll_horizontal_factor", WSF_DEVICE_KEY_SCROLL_HORIZONTAL },
+		{ "pinch_zoom_factor", WSF_DEVICE_KEY_PINCH_ZOOM },
+		{ "pinch_rotate_factor", WSF_DEVICE_KEY_PINCH_ROTATE },
+	};
+	double factor = 0.0;
+	size_t i = 0;
+
+	for (i = 0; i < sizeof(factor_keys) / sizeof(factor_keys[0]); i++) {
+		if (strcmp(key, factor_keys[i].key) != 0) {
+			continue;
+		}
+		if (!wsf_parse_factor_str(value, &factor) || !wsf_factor_in_range(factor)) {
+			*invalid = true;
+			return true;
+		}
+		factors[i] = factor;
+		*keys |= factor_keys[i].bit;
+		return true;
+	}
+
+	return false;
+}
+
+_Static_assert(
+	offsetof(struct wsf_device_profile, pinch_rotate) ==
+		offsetof(struct wsf_device_profile, scroll_vertical) + 3 * sizeof(double) &&
+	offsetof(struct wsf_focus_profile, pinch_rotate) ==
+		offsetof(struct wsf_focus_profile, scroll_vertical) + 3 * sizeof(double),
+	"profile factors must be laid out in factor key order"
+);
+
+/*
+ * Keys inside a [device] section. Returns false for keys a profile does
+ * not know; *invalid is set when a known key has a bad value.
+ */
+static bool wsf_parse_device_key(
+	const char *key,
+	const char *value,
+	struct wsf_device_profile *profile,
+	bool *invalid
+) {
+	if (strcmp(key, "name") == 0) {
+		size_t len = strlen(value);
+
+		if (len == 0 || len >= sizeof(profile->name)) {
+			*invalid = true;
+			return true;
+		}
+		memcpy(profile->name, value, len + 1);
+		profile->match |= WSF_DEVICE_MATCH_NAME;
+		return true;
+	}
+	if (strcmp(key, "vendor") == 0 || strcmp(key, "product") == 0) {
+		bool vendor = key[0] == 'v';
+
+		if (!wsf_parse_device_id(value, vendor ? &profile->vendor : &profile->product)) {
+			*invalid = true;
+			return true;
+		}
+		profile->match |= vendor ? WSF_DEVICE_MATCH_VENDOR : WSF_DEVICE_MATCH_PRODUCT;
+		return true;
+	}
+
+	return wsf_parse_profile_factor(
+		key,
+		value,
+		&profile->scroll_vertical,
+		&profile->keys,
+		invalid
+	);
+}
+
+/* Keys inside an [app] (app_id=) or [output] (name=) section. */
+static bool wsf_parse_focus_key(
+	const char *key,
+	const char *value,
+	struct wsf_focus_profile *profile,
+	uint32_t kind,
+	bool *invalid
+) {
+	const char *name_key = kind == WSF_FOCUS_MATCH_APP ? "app_id" : "name";
+
+	if (strcmp(key, name_key) == 0) {
+		size_t len = strlen(value);
+
+		if (len == 0 || len >= sizeof(profile->name)) {
+			*invalid = true;
+			return true;
+		}
+		memcpy(profile->name, value, len + 1);
+		profile->match = kind;
+		return true;
+	}
+
+	return wsf_parse_profile_factor(
+		key,
+		value,
+		&profile->scroll_vertical,
+		&profile->keys,
+		invalid
+	);
+}
+
+bool wsf_device_profile_valid(const struct wsf_device_profile *profile) {
+	return profile->match != 0 &&
+		(profile->match & ~(uint32_t) (WSF_DEVICE_MATCH_NAME |
+			WSF_DEVICE_MATCH_VENDOR | WSF_DEVICE_MATCH_PRODUCT)) == 0 &&
+		memchr(profile->name, '\0', sizeof(profile->name)) != NULL &&
+		((profile->match & WSF_DEVICE_MATCH_NAME) == 0 || profile->name[0] != '\0') &&
+		wsf_factor_in_range(profile->scroll_vertical) &&
+		wsf_factor_in_range(profile->scroll_horizontal) &&
+		wsf_factor_in_range(profile->pinch_zoom) &&
+		wsf_factor_in_range(profile->pinch_rotate);
+}
+
+/* First profile in file order that matches, or -1. */
+int wsf_device_profile_match(
+	const struct wsf_device_profile *profiles,
+	uint32_t count,
+	const char *name,
+	uint32_t vendor,
+	uint32_t product
+) {
+	uint32_t i = 0;
+
+	for (i = 0; i < count; i++) {
+		const struct wsf_device_profile *profile = &profiles[i];
+
+		if ((profile->match & WSF_DEVICE_MATCH_NAME) != 0 &&
+			(name == NULL || strstr(name, profile->name) == NULL)) {
+			continue;
+		}
+		if ((profile->match & WSF_DEVICE_MATCH_VENDOR) != 0 && profile->vendor != vendor) {
+			continue;
+		}
+		if ((profile->match & WSF_DEVICE_MATCH_PRODUCT) != 0 && profile->product != product) {
+			continue;
+		}
+		return (int) i;
+	}
+
+	return -1;
+}
+
+bool wsf_focus_profile_valid(const struct wsf_focus_profile *profile) {
+	return (profile->match == WSF_FOCUS_MATCH_APP ||
+			profile->match == WSF_FOCUS_MATCH_OUTPUT) &&
+		memchr(profile->name, '\0', sizeof(profile->name)) != NULL &&
+		profile->name[0] != '\0' &&
+		((profile->keys & WSF_DEVICE_KEY_SCROLL_VERTICAL) == 0 ||
+			wsf_factor_in_range(profile->scroll_vertical)) &&
+		((profile->keys & WSF_DEVICE_KEY_SCROLL_HORIZONTAL) == 0 ||
+			wsf_factor_in_range(profile->scroll_horizontal)) &&
+		((profile->keys & WSF_DEVICE_KEY_PINCH_ZOOM) == 0 ||
+			wsf_factor_in_range(profile->pinch_zoom)) &&
+		((profile->keys & WSF_DEVICE_KEY_PINCH_ROTATE) == 0 ||
+			wsf_factor_in_range(profile->pinch_rotate));
+}
+
+/* First profile of the given kind whose name equals name, or -1. */
+int wsf_focus_profile_match(
+	const struct wsf_focus_profile *profiles,
+	uint32_t count,
+	uint32_t match,
+	const char *name
+) {
+	uint32_t i = 0;
+
+	if (name == NULL || name[0] == '\0') {
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (profiles[i].match == match && strcmp(profiles[i].name, name) == 0) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+static bool wsf_config_has_curve(const struct wsf_config_values *values) {
+	return values->has_curve_kind ||
+		values->has_curve_points ||
+		values->has_curve_min_multiplier ||
+		values->has_curve_max_multiplier ||
+		values->has_curve_velocity_low ||
+		values->has_curve_velocity_high ||
+		values->has_curve_smoothing ||
+		values->has_curve_reset_gap;
+}
+
+static void wsf_config_clear_curve(struct wsf_config_values *values) {
+	wsf_scroll_curve_params_init(&values->curve);
+	values->has_curve_kind = false;
+	values->has_curve_points = false;
+	values->has_curve_min_multiplier = false;
+	values->has_curve_max_multiplier = false;
+	values->has_curve_velocity_low = false;
+	values->has_curve_velocity_high = false;
+	values->has_curve_smoothing = false;
+	values->has_curve_reset_gap = false;
+}
+
+static bool wsf_config_cache_path(const char *path, char *buf, size_t len) {
+	int written = 0;
+
+	if (path == NULL) {
+		return false;
+	}
+
+	written = snprintf(buf, len, "%s.cache", path);
+	return written > 0 && (size_t) written < len;
+}
+
+/* FNV-1a over everything before the checksum field. */
+static uint64_t wsf_config_cache_checksum(const struct wsf_config_cache *cache) {
+	const unsigned char *bytes = (const unsigned char *) cache;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i = 0;
+
+	for (i = 0; i < offsetof(struct wsf_config_cache, checksum); i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static void wsf_config_cache_key(struct wsf_config_cache *cache, const struct stat *st) {
+	cache->source_dev = (uint64_t) st->st_dev;
+	cache->source_ino = (uint64_t) st->st_ino;
+	cache->source_size = (uint64_t) st->st_size;
+	cache->source_mtime_sec = (int64_t) st->st_mtim.tv_sec;
+	cache->source_mtime_nsec = (int64_t) st->st_mtim.tv_nsec;
+}
+
+static bool wsf_config_cache_matches(const struct wsf_config_cache *cache, const struct stat *st) {
+	struct wsf_config_cache key;
+
+	wsf_config_cache_key(&key, st);
+	return cache->source_dev == key.source_dev &&
+		cache->source_ino == key.source_ino &&
+		cache->source_size == key.source_size &&
+		cache->source_mtime_sec == key.source_mtime_sec &&
+		cache->source_mtime_nsec == key.source_mtime_nsec;
+}
+
+static bool wsf_config_cache_valid(const struct wsf_config_cache *cache) {
+	return cache->magic == WSF_CONFIG_CACHE_MAGIC &&
+		cache->version == WSF_CONFIG_CACHE_VERSION &&
+		cache->size == sizeof(*cache) &&
+		cache->checksum == wsf_config_cache_checksum(cache);
+}
+
+/*
+ * Returns WSF_CONFIG_CACHE_FRESH with the cached parse in *out_values and
+ * *out_status, or why the text parser has to run instead. One read() of
+ * the fixed-size record: for a few hundred bytes, mmap plus munmap cost
+ * more than the copy they save.
+ */
+static int wsf_config_cache_load(
+	const char *path,
+	struct wsf_config_values *out_values,
+	int *out_status
+) {
+	struct wsf_config_cache cache;
+	char cache_path[PATH_MAX];
+	struct stat st;
+	ssize_t got = 0;
+	int fd = -1;
+
+	if (!wsf_config_cache_path(path, cache_path, sizeof(cache_path))) {
+		return WSF_CONFIG_CACHE_MISSING;
+	}
+
+	fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return WSF_CONFIG_CACHE_MISSING;
+	}
+	got = read(fd, &cache, sizeof(cache));
+	close(fd);
+
+	if (got != (ssize_t) sizeof(cache) || !wsf_config_cache_valid(&cache) ||
+		stat(path, &st) != 0 || !wsf_config_cache_matches(&cache, &st)) {
+		return WSF_CONFIG_CACHE_STALE;
+	}
+
+	*out_values = cache.values;
+	*out_status = cache.status;
+	return WSF_CONFIG_CACHE_FRESH;
+}
+
+int wsf_config_cache_state(void) {
+	struct wsf_config_values values;
+	int status = WSF_CONFIG_OK;
+
+	return wsf_config_cache_load(wsf_config_path(), &values, &status);
+}
+
+/*
+ * Parses `source` (the not yet renamed text config) and stores the result
+ * keyed to it. The key survives the rename, so the cache is fresh the
+ * moment the new config appears. Failure only costs readers a text parse.
+ */
+static void wsf_config_cache_write(const char *path, const char *source, bool debug) {
+	struct wsf_config_cache cache;
+	char cache_path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+	struct stat st;
+	ssize_t written = 0;
+	int fd = -1;
+
+	if (!wsf_config_cache_path(path, cache_path, sizeof(cache_path)) ||
+		snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", cache_path) >=
+			(int) sizeof(tmp_path)) {
+		return;
+	}
+
+	memset(&cache, 0, sizeof(cache));
+	cache.status = wsf_config_read_path(source, &cache.values, debug);
+	if (cache.status == WSF_CONFIG_ERROR || stat(source, &st) != 0) {
+		unlink(cache_path);
+		return;
+	}
+
+	cache.magic = WSF_CONFIG_CACHE_MAGIC;
+	cache.version = WSF_CONFIG_CACHE_VERSION;
+	cache.size = sizeof(cache);
+	wsf_config_cache_key(&cache, &st);
+	cache.checksum = wsf_config_cache_checksum(&cache);
+
+	fd = mkostemp(tmp_path, O_CLOEXEC);
+	if (fd < 0) {
+		wsf_debug_log(debug, "failed to create config cache: %s", strerror(errno));
+		unlink(cache_path);
+		return;
+	}
+	written = write(fd, &cache, sizeof(cache));
+	if (written == (ssize_t) sizeof(cache) && fsync(fd) != 0) {
+		written = -1;
+	}
+	if (close(fd) != 0 || written != (ssize_t) sizeof(cache) ||
+		rename(tmp_path, cache_path) != 0) {
+		wsf_debug_log(debug, "failed to write config cache: %s", strerror(errno));
+		unlink(tmp_path);
+		unlink(cache_path);
+	}
+}
+
 int wsf_config_read(struct wsf_config_values *out_values, bool debug) {
+	const char *path = wsf_config_path();
+	int status = WSF_CONFIG_OK;
+
+	if (out_values != NULL &&
+		wsf_config_cache_load(path, out_values, &status) == WSF_CONFIG_CACHE_FRESH) {
+		return status;
+	}
+
+	/*
+	 * Without a fresh cache the file was edited since `wsf set` wrote it,
+	 * so the generation in its header no longer names its contents.
+	 */
+	status = wsf_config_read_path(path, out_values, debug);
+	if (out_values != NULL) {
+		out_values->generation = 0;
+	}
+	return status;
+}
+
+/* "# generation N", the header `wsf set` writes. */
+static bool wsf_parse_generation(const char *comment, uint64_t *out_generation) {
+	char *end = NULL;
+	unsigned long long value = 0;
+
+	comment++;
+	while (*comment == ' ' || *comment == '\t') {
+		comment++;
+	}
+	if (strncmp(comment, "generation", 10) != 0 ||
+		!isspace((unsigned char) comment[10])) {
+		return false;
+	}
+
+	errno = 0;
+	value = strtoull(comment + 10, &end, 10);
+	if (end == comment + 10 || errno == ERANGE) {
+		return false;
+	}
+
+	*out_generation = (uint64_t) value;
+	return true;
+}
+
+int wsf_config_read_path(
+	const char *path,
+	struct wsf_config_values *out_values,
+	bool debug
+) {
+	struct wsf_device_profile *section = NULL;
+	struct wsf_focus_profile *focus_section = NULL;
+	uint32_t focus_kind = 0;
 	FILE *file = NULL;
 	char *line = NULL;
 	size_t size = 0;
+	bool in_section = false;
 	bool found = false;
 	bool invalid = false;
-	const char *path = wsf_config_path();
+	uint32_t kept = 0;
+	uint32_t i = 0;
 
 	if (out_values == NULL) {
 		return WSF_CONFIG_ERROR;
@@ -169,7 +817,40 @@ int wsf_config_read(struct wsf_config_values *out_values, bool debug) {
 			cursor++;
 		}
 
-		if (*cursor == '#' || *cursor == '\0' || *cursor == '\n') {
+		if (*cursor == '#') {
+			wsf_parse_generation(cursor, &out_values->generation);
+			continue;
+		}
+		if (*cursor == '\0' || *cursor == '\n') {
+			continue;
+		}
+
+		/* A section runs to the next header; globals must come first. */
+		if (*cursor == '[') {
+			char *header = wsf_trim(cursor);
+
+			in_section = true;
+			section = NULL;
+			focus_section = NULL;
+			focus_kind = strcmp(header, "[app]") == 0 ? WSF_FOCUS_MATCH_APP :
+				strcmp(header, "[output]") == 0 ? WSF_FOCUS_MATCH_OUTPUT : 0;
+			if (focus_kind != 0) {
+				if (out_values->focus_profile_count == WSF_FOCUS_PROFILE_MAX) {
+					invalid = true;
+					continue;
+				}
+				focus_section =
+					&out_values->focus_profiles[out_values->focus_profile_count++];
+				found = true;
+				continue;
+			}
+			if (strcmp(header, "[device]") != 0 ||
+				out_values->device_profile_count == WSF_DEVICE_PROFILE_MAX) {
+				invalid = true;
+				continue;
+			}
+			section = &out_values->device_profiles[out_values->device_profile_count++];
+			found = true;
 			continue;
 		}
 
@@ -182,6 +863,15 @@ int wsf_config_read(struct wsf_config_values *out_values, bool debug) {
 		key = wsf_trim(cursor);
 		value = wsf_trim(eq + 1);
 
+		if (in_section) {
+			if (section != NULL) {
+				wsf_parse_device_key(key, value, section, &invalid);
+			} else if (focus_section != NULL) {
+				wsf_parse_focus_key(key, value, focus_section, focus_kind, &invalid);
+			}
+			continue;
+		}
+
 		if (strcmp(key, "factor") == 0) {
 			if (!wsf_parse_factor_str(value, &factor) ||
 				!wsf_factor_in_range(factor)) {
@@ -237,11 +927,53 @@ int wsf_config_read(struct wsf_config_values *out_values, bool debug) {
 			found = true;
 			continue;
 		}
+		if (wsf_parse_curve_key(key, value, out_values, &invalid)) {
+			found = true;
+			continue;
+		}
 	}
 
 	free(line);
 	fclose(file);
 
+	/* A section without a name, vendor or product would match every device. */
+	for (i = 0; i < out_values->device_profile_count; i++) {
+		if (out_values->device_profiles[i].match == 0) {
+			wsf_debug_log(debug, "[device] section %u matches nothing; ignoring it", i + 1);
+			invalid = true;
+			continue;
+		}
+		out_values->device_profiles[kept++] = out_values->device_profiles[i];
+	}
+	out_values->device_profile_count = kept;
+	kept = 0;
+	for (i = 0; i < out_values->focus_profile_count; i++) {
+		if (out_values->focus_profiles[i].match == 0) {
+			wsf_debug_log(
+				debug,
+				"[app]/[output] section %u names no app_id or output; ignoring it",
+				i + 1
+			);
+			invalid = true;
+			continue;
+		}
+		out_values->focus_profiles[kept++] = out_values->focus_profiles[i];
+	}
+	out_values->focus_profile_count = kept;
+
+	if (wsf_config_has_curve(out_values)) {
+		struct wsf_scroll_curve_params *curve = &out_values->curve;
+
+		if (out_values->has_curve_points && !out_values->has_curve_kind) {
+			curve->kind = WSF_SCROLL_CURVE_CUBIC;
+		}
+		if (!wsf_scroll_curve_params_valid(curve)) {
+			wsf_debug_log(debug, "invalid scroll curve; using the default curve");
+			wsf_config_clear_curve(out_values);
+			invalid = true;
+		}
+	}
+
 	if (invalid) {
 		wsf_debug_log(debug, "invalid config value; using defaults for that key");
 		return WSF_CONFIG_INVALID;
@@ -269,9 +1001,133 @@ static bool wsf_env_factor(const char *name, double *out_factor, bool debug) {
 	return false;
 }
 
+void wsf_scroll_curve_params_init(struct wsf_scroll_curve_params *params) {
+	params->min_multiplier = WSF_SCROLL_CURVE_MIN_MULTIPLIER;
+	params->max_multiplier = WSF_SCROLL_CURVE_MAX_MULTIPLIER;
+	params->velocity_low = WSF_SCROLL_CURVE_VELOCITY_LOW;
+	params->velocity_high = WSF_SCROLL_CURVE_VELOCITY_HIGH;
+	params->smoothing = WSF_SCROLL_CURVE_SMOOTHING;
+	params->reset_gap_us = WSF_SCROLL_CURVE_RESET_GAP_US;
+	params->kind = WSF_SCROLL_CURVE_SMOOTHSTEP;
+	params->point_count = 0;
+	memset(params->point_velocity, 0, sizeof(params->point_velocity));
+	memset(params->point_multiplier, 0, sizeof(params->point_multiplier));
+}
+
+static bool wsf_curve_points_valid(const struct wsf_scroll_curve_params *params) {
+	unsigned int i = 0;
+
+	if (params->point_count < 2 || params->point_count > WSF_SCROLL_CURVE_MAX_POINTS) {
+		return false;
+	}
+
+	for (i = 0; i < params->point_count; i++) {
+		double velocity = params->point_velocity[i];
+		double multiplier = params->point_multiplier[i];
+
+		if (!isfinite(velocity) || velocity < 0.0 || velocity > 1e9) {
+			return false;
+		}
+		if (!isfinite(multiplier) || multiplier <= 0.0 || multiplier > 100.0) {
+			return false;
+		}
+		if (i > 0 && velocity <= params->point_velocity[i - 1]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool wsf_scroll_curve_params_valid(const struct wsf_scroll_curve_params *params) {
+	if (params == NULL) {
+		return false;
+	}
+
+	if (params->kind != WSF_SCROLL_CURVE_SMOOTHSTEP) {
+		if (params->kind != WSF_SCROLL_CURVE_LINEAR &&
+			params->kind != WSF_SCROLL_CURVE_CUBIC) {
+			return false;
+		}
+		if (!wsf_curve_points_valid(params)) {
+			return false;
+		}
+	}
+
+	return params->min_multiplier > 0.0 &&
+		params->max_multiplier >= params->min_multiplier &&
+		params->max_multiplier <= 100.0 &&
+		params->velocity_low >= 0.0 &&
+		params->velocity_high > params->velocity_low &&
+		params->velocity_high <= 1e9 &&
+		params->smoothing > 0.0 &&
+		params->smoothing <= 1.0 &&
+		params->reset_gap_us > 0.0 &&
+		params->reset_gap_us <= 10000000.0;
+}
+
+/* Profile keys a [device] section leaves out follow the global factors. */
+static void wsf_device_profiles_inherit(struct wsf_effective_factors *factors) {
+	uint32_t i = 0;
+
+	for (i = 0; i < factors->device_profile_count; i++) {
+		struct wsf_device_profile *profile = &factors->device_profiles[i];
+
+		if ((profile->keys & WSF_DEVICE_KEY_SCROLL_VERTICAL) == 0) {
+			profile->scroll_vertical = factors->scroll_vertical;
+		}
+		if ((profile->keys & WSF_DEVICE_KEY_SCROLL_HORIZONTAL) == 0) {
+			profile->scroll_horizontal = factors->scroll_horizontal;
+		}
+		if ((profile->keys & WSF_DEVICE_KEY_PINCH_ZOOM) == 0) {
+			profile->pinch_zoom = factors->pinch_zoom;
+		}
+		if ((profile->keys & WSF_DEVICE_KEY_PINCH_ROTATE) == 0) {
+			profile->pinch_rotate = factors->pinch_rotate;
+		}
+	}
+}
+
+/* Applies the key precedence rules of the config file; env is not consulted. */
+void wsf_config_resolve(
+	const struct wsf_config_values *values,
+	struct wsf_effective_factors *out_factors
+) {
+	double base_factor = WSF_FACTOR_DEFAULT;
+
+	out_factors->used_legacy_factor = false;
+	if (values->has_factor) {
+		base_factor = values->factor;
+		out_factors->used_legacy_factor = true;
+	}
+
+	out_factors->scroll_vertical = values->has_scroll_vertical ?
+		values->scroll_vertical_factor : base_factor;
+	out_factors->scroll_horizontal = values->has_scroll_horizontal ?
+		values->scroll_horizontal_factor : base_factor;
+	out_factors->pinch_zoom = values->has_pinch_zoom ?
+		values->pinch_zoom_factor : WSF_FACTOR_DEFAULT;
+	out_factors->pinch_rotate = values->has_pinch_rotate ?
+		values->pinch_rotate_factor : WSF_FACTOR_DEFAULT;
+	out_factors->curve = values->curve;
+	out_factors->device_profile_count = values->device_profile_count;
+	memcpy(
+		out_factors->device_profiles,
+		values->device_profiles,
+		sizeof(out_factors->device_profiles)
+	);
+	wsf_device_profiles_inherit(out_factors);
+	out_factors->focus_profile_count = values->focus_profile_count;
+	memcpy(
+		out_factors->focus_profiles,
+		values->focus_profiles,
+		sizeof(out_factors->focus_profiles)
+	);
+	out_factors->generation = values->generation;
+}
+
 int wsf_effective_factors(struct wsf_effective_factors *out_factors, bool debug) {
 	struct wsf_config_values cfg;
-	double base_factor = WSF_FACTOR_DEFAULT;
 	double env_factor = WSF_FACTOR_DEFAULT;
 	int status = WSF_CONFIG_OK;
 
@@ -279,30 +1135,15 @@ int wsf_effective_factors(struct wsf_effective_factors *out_factors, bool debug)
 		return WSF_CONFIG_ERROR;
 	}
 
-	out_factors->scroll_vertical = WSF_FACTOR_DEFAULT;
-	out_factors->scroll_horizontal = WSF_FACTOR_DEFAULT;
-	out_factors->pinch_zoom = WSF_FACTOR_DEFAULT;
-	out_factors->pinch_rotate = WSF_FACTOR_DEFAULT;
-	out_factors->used_legacy_factor = false;
+	wsf_config_values_init(&cfg);
+	wsf_config_resolve(&cfg, out_factors);
 
 	status = wsf_config_read(&cfg, debug);
 	if (status == WSF_CONFIG_ERROR) {
 		return status;
 	}
 
-	if (cfg.has_factor) {
-		base_factor = cfg.factor;
-		out_factors->used_legacy_factor = true;
-	}
-
-	out_factors->scroll_vertical = cfg.has_scroll_vertical ?
-		cfg.scroll_vertical_factor : base_factor;
-	out_factors->scroll_horizontal = cfg.has_scroll_horizontal ?
-		cfg.scroll_horizontal_factor : base_factor;
-	out_factors->pinch_zoom = cfg.has_pinch_zoom ?
-		cfg.pinch_zoom_factor : WSF_FACTOR_DEFAULT;
-	out_factors->pinch_rotate = cfg.has_pinch_rotate ?
-		cfg.pinch_rotate_factor : WSF_FACTOR_DEFAULT;
+	wsf_config_resolve(&cfg, out_factors);
 
 	if (wsf_env_factor("WSF_FACTOR", &env_factor, debug)) {
 		out_factors->scroll_vertical = env_factor;
@@ -321,10 +1162,30 @@ int wsf_effective_factors(struct wsf_effective_factors *out_factors, bool debug)
 	if (wsf_env_factor("WSF_PINCH_ROTATE_FACTOR", &env_factor, debug)) {
 		out_factors->pinch_rotate = env_factor;
 	}
+	wsf_device_profiles_inherit(out_factors);
 
 	return status;
 }
 
+bool wsf_env_overrides_present(void) {
+	static const char *const names[] = {
+		"WSF_FACTOR",
+		"WSF_SCROLL_VERTICAL_FACTOR",
+		"WSF_SCROLL_HORIZONTAL_FACTOR",
+		"WSF_PINCH_ZOOM_FACTOR",
+		"WSF_PINCH_ROTATE_FACTOR",
+	};
+	double factor = WSF_FACTOR_DEFAULT;
+	unsigned int i = 0;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (wsf_env_factor(names[i], &factor, false)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static int wsf_mkdir(const char *path, bool debug) {
 	if (mkdir(path, 0700) == 0) {
 		return 0;
@@ -351,50 +1212,149 @@ int wsf_config_write(double factor, bool debug) {
 	return wsf_config_write_updates(&updates, debug);
 }
 
-static int wsf_config_write_all(
-	const struct wsf_config_values *values,
-	bool debug
+static void wsf_config_write_profile_factors(
+	FILE *file,
+	uint32_t keys,
+	const double *factors
 ) {
+	if ((keys & WSF_DEVICE_KEY_SCROLL_VERTICAL) != 0) {
+		fprintf(file, "scroll_vertical_factor=%.4f\n", factors[0]);
+	}
+	if ((keys & WSF_DEVICE_KEY_SCROLL_HORIZONTAL) != 0) {
+		fprintf(file, "scroll_horizontal_factor=%.4f\n", factors[1]);
+	}
+	if ((keys & WSF_DEVICE_KEY_PINCH_ZOOM) != 0) {
+		fprintf(file, "pinch_zoom_factor=%.4f\n", factors[2]);
+	}
+	if ((keys & WSF_DEVICE_KEY_PINCH_ROTATE) != 0) {
+		fprintf(file, "pinch_rotate_factor=%.4f\n", factors[3]);
+	}
+}
+
+static void wsf_config_write_device(FILE *file, const struct wsf_device_profile *profile) {
+	fprintf(file, "\n[device]\n");
+	if ((profile->match & WSF_DEVICE_MATCH_NAME) != 0) {
+		fprintf(file, "name=%s\n", profile->name);
+	}
+	if ((profile->match & WSF_DEVICE_MATCH_VENDOR) != 0) {
+		fprintf(file, "vendor=%04x\n", profile->vendor);
+	}
+	if ((profile->match & WSF_DEVICE_MATCH_PRODUCT) != 0) {
+		fprintf(file, "product=%04x\n", profile->product);
+	}
+	wsf_config_write_profile_factors(file, profile->keys, &profile->scroll_vertical);
+}
+
+static void wsf_config_write_focus(FILE *file, const struct wsf_focus_profile *profile) {
+	if (profile->match == WSF_FOCUS_MATCH_APP) {
+		fprintf(file, "\n[app]\napp_id=%s\n", profile->name);
+	} else {
+		fprintf(file, "\n[output]\nname=%s\n", profile->name);
+	}
+	wsf_config_write_profile_factors(file, profile->keys, &profile->scroll_vertical);
+}
+
+/* Creates ~/.config/wayland-scroll-factor as needed and returns its path. */
+static bool wsf_config_dir(char *out, size_t len, bool debug) {
 	const char *home = wsf_home();
-	const char *path = wsf_config_path();
-	char config_dir[PATH_MAX];
 	char base_dir[PATH_MAX];
-	FILE *file = NULL;
 	int written = 0;
 
-	if (home == NULL || path == NULL) {
+	if (home == NULL) {
 		wsf_debug_log(debug, "cannot resolve HOME for config write");
-		return -1;
+		return false;
 	}
 
 	written = snprintf(base_dir, sizeof(base_dir), "%s/.config", home);
 	if (written <= 0 || (size_t) written >= sizeof(base_dir)) {
-		return -1;
+		return false;
+	}
+	written = snprintf(out, len, "%s/wayland-scroll-factor", base_dir);
+	if (written <= 0 || (size_t) written >= len) {
+		return false;
 	}
 
-	written = snprintf(
-		config_dir,
-		sizeof(config_dir),
-		"%s/.config/wayland-scroll-factor",
-		home
-	);
-	if (written <= 0 || (size_t) written >= sizeof(config_dir)) {
-		return -1;
+	return wsf_mkdir(base_dir, debug) == 0 && wsf_mkdir(out, debug) == 0;
+}
+
+/*
+ * The process umask, read from /proc/self/status (Linux 4.7+) because
+ * umask() can only be read by setting it, which would race other threads
+ * in the compositor. 022 when the field is unavailable.
+ */
+static mode_t wsf_config_umask(void) {
+	FILE *file = fopen("/proc/self/status", "re");
+	char line[256];
+	unsigned int mask = 022;
+
+	if (file == NULL) {
+		return (mode_t) mask;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "Umask: %o", &mask) == 1) {
+			break;
+		}
+	}
+	fclose(file);
+	return (mode_t) (mask & 0777);
+}
+
+/* Makes the renames in dir durable; best effort. */
+static void wsf_config_sync_dir(const char *dir) {
+	int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
 	}
+}
+
+/*
+ * Writes a temp file next to the config, fsyncs it, keys the cache to it
+ * and renames it into place, so readers see either the old file or the
+ * new one. Callers hold the config lock.
+ */
+static int wsf_config_write_all(
+	const struct wsf_config_values *values,
+	bool debug
+) {
+	const char *path = wsf_config_path();
+	char config_dir[PATH_MAX];
+	char tmp_path[PATH_MAX];
+	struct stat st;
+	FILE *file = NULL;
+	uint32_t i = 0;
+	int written = 0;
+	int fd = -1;
 
-	if (wsf_mkdir(base_dir, debug) != 0) {
+	if (path == NULL || !wsf_config_dir(config_dir, sizeof(config_dir), debug)) {
 		return -1;
 	}
-	if (wsf_mkdir(config_dir, debug) != 0) {
+
+	written = snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+	if (written <= 0 || (size_t) written >= sizeof(tmp_path)) {
 		return -1;
 	}
 
-	file = fopen(path, "w");
+	/* Written aside and renamed in, so the cache can be keyed first. */
+	fd = mkostemp(tmp_path, O_CLOEXEC);
+	file = fd >= 0 ? fdopen(fd, "w") : NULL;
 	if (file == NULL) {
 		wsf_debug_log(debug, "failed to write config: %s", strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp_path);
+		}
 		return -1;
 	}
+	/* mkostemp creates 0600; a new config gets the mode open() would give it. */
+	if (stat(path, &st) == 0) {
+		fchmod(fd, st.st_mode & 0777);
+	} else {
+		fchmod(fd, 0666 & ~wsf_config_umask());
+	}
 
+	fprintf(file, "# generation %llu\n", (unsigned long long) values->generation);
 	if (values->has_factor) {
 		fprintf(file, "factor=%.4f\n", values->factor);
 	}
@@ -410,63 +1370,239 @@ static int wsf_config_write_all(
 	if (values->has_pinch_rotate) {
 		fprintf(file, "pinch_rotate_factor=%.4f\n", values->pinch_rotate_factor);
 	}
+	if (values->has_curve_kind) {
+		fprintf(file, "scroll_curve=%s\n", wsf_scroll_curve_kind_name(values->curve.kind));
+	}
+	if (values->has_curve_points) {
+		unsigned int i = 0;
+
+		fprintf(file, "scroll_curve_points=");
+		for (i = 0; i < values->curve.point_count; i++) {
+			fprintf(
+				file,
+				"%s%.4f:%.4f",
+				i > 0 ? "," : "",
+				values->curve.point_velocity[i],
+				values->curve.point_multiplier[i]
+			);
+		}
+		fprintf(file, "\n");
+	}
+	if (values->has_curve_min_multiplier) {
+		fprintf(file, "scroll_curve_min_multiplier=%.4f\n", values->curve.min_multiplier);
+	}
+	if (values->has_curve_max_multiplier) {
+		fprintf(file, "scroll_curve_max_multiplier=%.4f\n", values->curve.max_multiplier);
+	}
+	if (values->has_curve_velocity_low) {
+		fprintf(file, "scroll_curve_velocity_low=%.4f\n", values->curve.velocity_low);
+	}
+	if (values->has_curve_velocity_high) {
+		fprintf(file, "scroll_curve_velocity_high=%.4f\n", values->curve.velocity_high);
+	}
+	if (values->has_curve_smoothing) {
+		fprintf(file, "scroll_curve_smoothing=%.4f\n", values->curve.smoothing);
+	}
+	if (values->has_curve_reset_gap) {
+		fprintf(file, "scroll_curve_reset_gap_ms=%.4f\n", values->curve.reset_gap_us / 1000.0);
+	}
+	for (i = 0; i < values->device_profile_count; i++) {
+		wsf_config_write_device(file, &values->device_profiles[i]);
+	}
+	for (i = 0; i < values->focus_profile_count; i++) {
+		wsf_config_write_focus(file, &values->focus_profiles[i]);
+	}
+
+	if (fflush(file) != 0 || fsync(fd) != 0) {
+		wsf_debug_log(debug, "failed to write config: %s", strerror(errno));
+		fclose(file);
+		unlink(tmp_path);
+		return -1;
+	}
+	if (fclose(file) != 0) {
+		wsf_debug_log(debug, "failed to write config: %s", strerror(errno));
+		unlink(tmp_path);
+		return -1;
+	}
+
+	wsf_config_cache_write(path, tmp_path, debug);
+	if (rename(tmp_path, path) != 0) {
+		wsf_debug_log(debug, "failed to replace config: %s", strerror(errno));
+		unlink(tmp_path);
+		return -1;
+	}
+	wsf_config_sync_dir(config_dir);
 
-	fclose(file);
 	return 0;
 }
 
-int wsf_config_write_updates(
-	const struct wsf_config_values *updates,
-	bool debug
+int wsf_config_merge_updates(
+	struct wsf_config_values *values,
+	const struct wsf_config_values *updates
 ) {
-	struct wsf_config_values values;
-	int status = WSF_CONFIG_OK;
-
-	if (updates == NULL) {
+	if (values == NULL || updates == NULL) {
 		return -1;
 	}
 
-	wsf_config_values_init(&values);
-	status = wsf_config_read(&values, debug);
-	if (status == WSF_CONFIG_ERROR) {
-		wsf_config_values_init(&values);
-	}
-
 	if (updates->has_factor) {
 		if (!wsf_factor_in_range(updates->factor)) {
 			return -1;
 		}
-		values.factor = updates->factor;
-		values.has_factor = true;
+		values->factor = updates->factor;
+		values->has_factor = true;
 	}
 	if (updates->has_scroll_vertical) {
 		if (!wsf_factor_in_range(updates->scroll_vertical_factor)) {
 			return -1;
 		}
-		values.scroll_vertical_factor = updates->scroll_vertical_factor;
-		values.has_scroll_vertical = true;
+		values->scroll_vertical_factor = updates->scroll_vertical_factor;
+		values->has_scroll_vertical = true;
 	}
 	if (updates->has_scroll_horizontal) {
 		if (!wsf_factor_in_range(updates->scroll_horizontal_factor)) {
 			return -1;
 		}
-		values.scroll_horizontal_factor = updates->scroll_horizontal_factor;
-		values.has_scroll_horizontal = true;
+		values->scroll_horizontal_factor = updates->scroll_horizontal_factor;
+		values->has_scroll_horizontal = true;
 	}
 	if (updates->has_pinch_zoom) {
 		if (!wsf_factor_in_range(updates->pinch_zoom_factor)) {
 			return -1;
 		}
-		values.pinch_zoom_factor = updates->pinch_zoom_factor;
-		values.has_pinch_zoom = true;
+		values->pinch_zoom_factor = updates->pinch_zoom_factor;
+		values->has_pinch_zoom = true;
 	}
 	if (updates->has_pinch_rotate) {
 		if (!wsf_factor_in_range(updates->pinch_rotate_factor)) {
 			return -1;
 		}
-		values.pinch_rotate_factor = updates->pinch_rotate_factor;
-		values.has_pinch_rotate = true;
+		values->pinch_rotate_factor = updates->pinch_rotate_factor;
+		values->has_pinch_rotate = true;
+	}
+	if (wsf_config_has_curve(updates)) {
+		struct wsf_config_values merged = *values;
+
+		if (updates->has_curve_kind) {
+			merged.curve.kind = updates->curve.kind;
+			merged.has_curve_kind = true;
+		}
+		if (updates->has_curve_points) {
+			memcpy(
+				merged.curve.point_velocity,
+				updates->curve.point_velocity,
+				sizeof(merged.curve.point_velocity)
+			);
+			memcpy(
+				merged.curve.point_multiplier,
+				updates->curve.point_multiplier,
+				sizeof(merged.curve.point_multiplier)
+			);
+			merged.curve.point_count = updates->curve.point_count;
+			merged.has_curve_points = true;
+		}
+		if (updates->has_curve_min_multiplier) {
+			merged.curve.min_multiplier = updates->curve.min_multiplier;
+			merged.has_curve_min_multiplier = true;
+		}
+		if (updates->has_curve_max_multiplier) {
+			merged.curve.max_multiplier = updates->curve.max_multiplier;
+			merged.has_curve_max_multiplier = true;
+		}
+		if (updates->has_curve_velocity_low) {
+			merged.curve.velocity_low = updates->curve.velocity_low;
+			merged.has_curve_velocity_low = true;
+		}
+		if (updates->has_curve_velocity_high) {
+			merged.curve.velocity_high = updates->curve.velocity_high;
+			merged.has_curve_velocity_high = true;
+		}
+		if (updates->has_curve_smoothing) {
+			merged.curve.smoothing = updates->curve.smoothing;
+			merged.has_curve_smoothing = true;
+		}
+		if (updates->has_curve_reset_gap) {
+			merged.curve.reset_gap_us = updates->curve.reset_gap_us;
+			merged.has_curve_reset_gap = true;
+		}
+		if (!wsf_scroll_curve_params_valid(&merged.curve)) {
+			return -1;
+		}
+		*values = merged;
+	}
+
+	return 0;
+}
+
+/*
+ * The lock is a separate file: the config itself is replaced on every
+ * write, so a lock on it would not exclude a writer that opened the new
+ * one. Writers block each other; readers never take it.
+ */
+int wsf_config_txn_begin(struct wsf_config_txn *txn, bool debug) {
+	char config_dir[PATH_MAX];
+	char lock_path[PATH_MAX];
+	const char *path = wsf_config_path();
+	int written = 0;
+
+	txn->lock_fd = -1;
+	if (path == NULL || !wsf_config_dir(config_dir, sizeof(config_dir), debug)) {
+		return -1;
+	}
+	written = snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+	if (written <= 0 || (size_t) written >= sizeof(lock_path)) {
+		return -1;
+	}
+
+	txn->lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (txn->lock_fd < 0) {
+		wsf_debug_log(debug, "failed to open %s: %s", lock_path, strerror(errno));
+		return -1;
+	}
+	while (flock(txn->lock_fd, LOCK_EX) != 0) {
+		if (errno != EINTR) {
+			wsf_debug_log(debug, "failed to lock %s: %s", lock_path, strerror(errno));
+			wsf_config_txn_end(txn);
+			return -1;
+		}
+	}
+
+	/* Under the lock the text is current; the cache may lag a hand edit. */
+	txn->status = wsf_config_read_path(path, &txn->values, debug);
+	if (txn->status == WSF_CONFIG_ERROR) {
+		wsf_config_values_init(&txn->values);
+	}
+	txn->values.generation++;
+	return 0;
+}
+
+int wsf_config_txn_commit(struct wsf_config_txn *txn, bool debug) {
+	int rc = wsf_config_write_all(&txn->values, debug);
+
+	wsf_config_txn_end(txn);
+	return rc;
+}
+
+void wsf_config_txn_end(struct wsf_config_txn *txn) {
+	if (txn->lock_fd >= 0) {
+		close(txn->lock_fd);
+		txn->lock_fd = -1;
+	}
+}
+
+int wsf_config_write_updates(
+	const struct wsf_config_values *updates,
+	bool debug
+) {
+	struct wsf_config_txn txn;
+
+	if (updates == NULL || wsf_config_txn_begin(&txn, debug) != 0) {
+		return -1;
+	}
+
+	if (wsf_config_merge_updates(&txn.values, updates) != 0) {
+		wsf_config_txn_end(&txn);
+		return -1;
 	}
 
-	return wsf_config_write_all(&values, debug);
+	return wsf_config_txn_commit(&txn, debug);
 }
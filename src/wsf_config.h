@@ -2,11 +2,103 @@
 #define WSF_CONFIG_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define WSF_FACTOR_DEFAULT 1.0
 #define WSF_FACTOR_MIN 0.05
 #define WSF_FACTOR_MAX 5.0
 
+#define WSF_SCROLL_CURVE_MIN_MULTIPLIER 0.70
+#define WSF_SCROLL_CURVE_MAX_MULTIPLIER 1.65
+#define WSF_SCROLL_CURVE_VELOCITY_LOW 80.0
+#define WSF_SCROLL_CURVE_VELOCITY_HIGH 2000.0
+#define WSF_SCROLL_CURVE_SMOOTHING 0.35
+#define WSF_SCROLL_CURVE_RESET_GAP_US 120000.0
+#define WSF_SCROLL_CURVE_MAX_POINTS 16
+
+#define WSF_DEVICE_PROFILE_MAX 8
+#define WSF_DEVICE_NAME_MAX 64
+#define WSF_FOCUS_PROFILE_MAX 8
+#define WSF_FOCUS_NAME_MAX 64
+
+enum wsf_scroll_curve_kind {
+	WSF_SCROLL_CURVE_SMOOTHSTEP = 0,
+	WSF_SCROLL_CURVE_LINEAR = 1,
+	WSF_SCROLL_CURVE_CUBIC = 2
+};
+
+/*
+ * smoothstep ramps from min_multiplier to max_multiplier between
+ * velocity_low and velocity_high (units/s). linear and cubic (monotone)
+ * interpolate the control points instead.
+ */
+struct wsf_scroll_curve_params {
+	double min_multiplier;
+	double max_multiplier;
+	double velocity_low;
+	double velocity_high;
+	double smoothing;
+	double reset_gap_us;
+	uint32_t kind;
+	uint32_t point_count;
+	double point_velocity[WSF_SCROLL_CURVE_MAX_POINTS];
+	double point_multiplier[WSF_SCROLL_CURVE_MAX_POINTS];
+};
+
+enum wsf_device_match {
+	WSF_DEVICE_MATCH_NAME = 1u << 0,
+	WSF_DEVICE_MATCH_VENDOR = 1u << 1,
+	WSF_DEVICE_MATCH_PRODUCT = 1u << 2
+};
+
+enum wsf_device_profile_key {
+	WSF_DEVICE_KEY_SCROLL_VERTICAL = 1u << 0,
+	WSF_DEVICE_KEY_SCROLL_HORIZONTAL = 1u << 1,
+	WSF_DEVICE_KEY_PINCH_ZOOM = 1u << 2,
+	WSF_DEVICE_KEY_PINCH_ROTATE = 1u << 3
+};
+
+/*
+ * One [device] section. A device matches when every key in `match` does:
+ * name as a substring of libinput's device name, vendor and product as
+ * the USB/bluetooth IDs. Factor keys missing from `keys` fall back to the
+ * global ones when the config is resolved. Fixed layout: it is also
+ * carried in the control block.
+ */
+struct wsf_device_profile {
+	char name[WSF_DEVICE_NAME_MAX];
+	uint32_t vendor;
+	uint32_t product;
+	uint32_t match;
+	uint32_t keys;
+	double scroll_vertical;
+	double scroll_horizontal;
+	double pinch_zoom;
+	double pinch_rotate;
+};
+
+enum wsf_focus_match {
+	WSF_FOCUS_MATCH_APP = 1u << 0,
+	WSF_FOCUS_MATCH_OUTPUT = 1u << 1
+};
+
+/*
+ * One [app] or [output] section: factors for while a window with that
+ * app_id has focus, or while that output (connector name) does. Both match
+ * exactly; match holds the one kind a section has. Factor keys use the
+ * WSF_DEVICE_KEY_* bits, and only the keys given replace the global
+ * factors. Fixed layout, carried in the control block like device profiles.
+ */
+struct wsf_focus_profile {
+	char name[WSF_FOCUS_NAME_MAX];
+	uint32_t match;
+	uint32_t keys;
+	double scroll_vertical;
+	double scroll_horizontal;
+	double pinch_zoom;
+	double pinch_rotate;
+};
+
 struct wsf_config_values {
 	double factor;
 	double scroll_vertical_factor;
@@ -18,6 +110,20 @@ struct wsf_config_values {
 	bool has_scroll_horizontal;
 	bool has_pinch_zoom;
 	bool has_pinch_rotate;
+	struct wsf_scroll_curve_params curve;
+	bool has_curve_kind;
+	bool has_curve_points;
+	bool has_curve_min_multiplier;
+	bool has_curve_max_multiplier;
+	bool has_curve_velocity_low;
+	bool has_curve_velocity_high;
+	bool has_curve_smoothing;
+	bool has_curve_reset_gap;
+	uint32_t device_profile_count;
+	struct wsf_device_profile device_profiles[WSF_DEVICE_PROFILE_MAX];
+	uint32_t focus_profile_count;
+	struct wsf_focus_profile focus_profiles[WSF_FOCUS_PROFILE_MAX];
+	uint64_t generation;
 };
 
 struct wsf_effective_factors {
@@ -25,7 +131,25 @@ struct wsf_effective_factors {
 	double scroll_horizontal;
 	double pinch_zoom;
 	double pinch_rotate;
+	struct wsf_scroll_curve_params curve;
 	bool used_legacy_factor;
+	uint32_t device_profile_count;
+	struct wsf_device_profile device_profiles[WSF_DEVICE_PROFILE_MAX];
+	uint32_t focus_profile_count;
+	struct wsf_focus_profile focus_profiles[WSF_FOCUS_PROFILE_MAX];
+	uint64_t generation;
+};
+
+/*
+ * A read-modify-write of the config under the config lock. begin takes
+ * the lock and reads the text file itself into values, with generation
+ * already advanced to the one commit will write; commit writes values
+ * and releases the lock, end releases it without writing.
+ */
+struct wsf_config_txn {
+	int lock_fd;
+	int status;
+	struct wsf_config_values values;
 };
 
 enum wsf_config_status {
@@ -35,11 +159,59 @@ enum wsf_config_status {
 	WSF_CONFIG_ERROR = 3
 };
 
+enum wsf_config_cache_state {
+	WSF_CONFIG_CACHE_FRESH = 0,
+	WSF_CONFIG_CACHE_MISSING = 1,
+	WSF_CONFIG_CACHE_STALE = 2
+};
+
 bool wsf_debug_enabled(void);
+bool wsf_trace_enabled(void);
+bool wsf_stats_enabled(void);
+bool wsf_fetch_enabled(void);
+bool wsf_coalesce_enabled(void);
+bool wsf_shm_enabled(void);
 const char *wsf_config_path(void);
 void wsf_config_values_init(struct wsf_config_values *values);
 int wsf_config_read(struct wsf_config_values *out_values, bool debug);
+int wsf_config_cache_state(void);
+int wsf_config_read_path(
+	const char *path,
+	struct wsf_config_values *out_values,
+	bool debug
+);
+void wsf_scroll_curve_params_init(struct wsf_scroll_curve_params *params);
+bool wsf_scroll_curve_params_valid(const struct wsf_scroll_curve_params *params);
+const char *wsf_scroll_curve_kind_name(uint32_t kind);
+bool wsf_device_profile_valid(const struct wsf_device_profile *profile);
+int wsf_device_profile_match(
+	const struct wsf_device_profile *profiles,
+	uint32_t count,
+	const char *name,
+	uint32_t vendor,
+	uint32_t product
+);
+bool wsf_focus_profile_valid(const struct wsf_focus_profile *profile);
+int wsf_focus_profile_match(
+	const struct wsf_focus_profile *profiles,
+	uint32_t count,
+	uint32_t match,
+	const char *name
+);
+void wsf_config_resolve(
+	const struct wsf_config_values *values,
+	struct wsf_effective_factors *out_factors
+);
+int wsf_config_merge_updates(
+	struct wsf_config_values *values,
+	const struct wsf_config_values *updates
+);
 int wsf_effective_factors(struct wsf_effective_factors *out_factors, bool debug);
+/* Whether any usable WSF_* factor override is set in this process. */
+bool wsf_env_overrides_present(void);
+int wsf_config_txn_begin(struct wsf_config_txn *txn, bool debug);
+int wsf_config_txn_commit(struct wsf_config_txn *txn, bool debug);
+void wsf_config_txn_end(struct wsf_config_txn *txn);
 int wsf_config_write(double factor, bool debug);
 int wsf_config_write_updates(const struct wsf_config_values *updates, bool debug);
 
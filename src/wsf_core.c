@@ -0,0 +1,245 @@
+#include "wsf_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void wsf_core_init(struct wsf_core *core, const struct wsf_effective_factors *factors) {
+	memset(core, 0, sizeof(*core));
+	core->curve = factors->curve;
+	wsf_curve_compile(&core->curve_table, &core->curve);
+	core->kernel = wsf_curve_kernel_best();
+	wsf_core_set_factors(
+		core,
+		factors->scroll_vertical,
+		factors->scroll_horizontal,
+		factors->pinch_zoom,
+		factors->pinch_rotate
+	);
+}
+
+void wsf_core_set_factors(
+	struct wsf_core *core,
+	double scroll_vertical,
+	double scroll_horizontal,
+	double pinch_zoom,
+	double pinch_rotate
+) {
+	core->scroll_factor[WSF_CORE_SCROLL_VERTICAL] = scroll_vertical;
+	core->scroll_factor[WSF_CORE_SCROLL_HORIZONTAL] = scroll_horizontal;
+	core->pinch_zoom_factor = pinch_zoom;
+	core->pinch_rotate_factor = pinch_rotate;
+	if (pinch_zoom != 1.0) {
+		wsf_fastmath_init();
+	}
+}
+
+void wsf_core_reset(struct wsf_core *core) {
+	memset(core->axis, 0, sizeof(core->axis));
+}
+
+/*
+ * Mirrors the preload: classify and pass trivial values, or advance the
+ * velocity state. Returns true with out_velocity set when the curve
+ * applies, false with out_scaled set when it does not.
+ */
+static bool wsf_core_scroll_velocity(
+	struct wsf_core *core,
+	const struct wsf_core_event *event,
+	double *out_scaled,
+	double *out_velocity
+) {
+	*out_scaled = event->value;
+	if (!wsf_engine_scroll_source_scaled(event->source) || event->device >= WSF_CORE_DEVICES ||
+		wsf_engine_scroll_trivial(event->value, core->scroll_factor[event->kind], out_scaled)) {
+		return false;
+	}
+
+	*out_velocity = wsf_engine_scroll_velocity(
+		&core->curve,
+		&core->axis[event->device][event->kind],
+		event->has_time != 0,
+		event->time_us,
+		event->value
+	);
+	return true;
+}
+
+static double wsf_core_scroll(
+	struct wsf_core *core,
+	const struct wsf_core_event *event,
+	struct wsf_core_result *result
+) {
+	double scaled = event->value;
+
+	if (!wsf_core_scroll_velocity(core, event, &scaled, &result->velocity)) {
+		return scaled;
+	}
+
+	result->multiplier = wsf_engine_scroll_multiplier(
+		&core->curve_table,
+		core->scroll_factor[event->kind],
+		result->velocity
+	);
+	result->curve = true;
+	return event->value * result->multiplier;
+}
+
+double wsf_core_scale(
+	struct wsf_core *core,
+	const struct wsf_core_event *event,
+	struct wsf_core_result *out_result
+) {
+	struct wsf_core_result result = { event->value, 0.0, 1.0, false };
+
+	switch (event->kind) {
+	case WSF_CORE_SCROLL_VERTICAL:
+	case WSF_CORE_SCROLL_HORIZONTAL:
+		result.value = wsf_core_scroll(core, event, &result);
+		break;
+	case WSF_CORE_PINCH_ZOOM:
+		result.value = wsf_engine_pinch_zoom(event->value, core->pinch_zoom_factor);
+		break;
+	case WSF_CORE_PINCH_ROTATE:
+		result.value = wsf_engine_pinch_rotate(event->value, core->pinch_rotate_factor);
+		break;
+	default:
+		break;
+	}
+
+	if (out_result != NULL) {
+		*out_result = result;
+	}
+	return result.value;
+}
+
+/*
+ * Split as `wsf analyze` does it: the velocity state advances event by
+ * event, then each scroll axis gets its multipliers from one vector curve
+ * lookup over the velocities collected for it. Chunks keep the scratch
+ * arrays on the stack.
+ */
+#define WSF_CORE_BATCH_CHUNK 256
+
+void wsf_core_scale_batch(
+	struct wsf_core *core,
+	const struct wsf_core_event *events,
+	double *out_values,
+	size_t count
+) {
+	double velocities[2][WSF_CORE_BATCH_CHUNK];
+	double multipliers[WSF_CORE_BATCH_CHUNK];
+	size_t slots[2][WSF_CORE_BATCH_CHUNK];
+	size_t curved[2] = { 0, 0 };
+	size_t start = 0;
+	size_t end = 0;
+	size_t i = 0;
+	unsigned int axis = 0;
+
+	for (start = 0; start < count; start = end) {
+		end = count - start > WSF_CORE_BATCH_CHUNK ? start + WSF_CORE_BATCH_CHUNK : count;
+		curved[0] = 0;
+		curved[1] = 0;
+		for (i = start; i < end; i++) {
+			const struct wsf_core_event *event = &events[i];
+
+			if (event->kind > WSF_CORE_SCROLL_HORIZONTAL) {
+				out_values[i] = wsf_core_scale(core, event, NULL);
+				continue;
+			}
+			if (wsf_core_scroll_velocity(
+				core,
+				event,
+				&out_values[i],
+				&velocities[event->kind][curved[event->kind]]
+			)) {
+				slots[event->kind][curved[event->kind]++] = i;
+			}
+		}
+
+		for (axis = 0; axis < 2; axis++) {
+			wsf_curve_lookup_batch(
+				&core->curve_table,
+				core->kernel,
+				core->scroll_factor[axis],
+				velocities[axis],
+				multipliers,
+				curved[axis]
+			);
+			for (i = 0; i < curved[axis]; i++) {
+				out_values[slots[axis][i]] = events[slots[axis][i]].value * multipliers[i];
+			}
+		}
+	}
+}
+
+double wsf_core_curve_multiplier(const struct wsf_core *core, unsigned int axis, double velocity) {
+	if (axis > WSF_CORE_SCROLL_HORIZONTAL || core->scroll_factor[axis] == 1.0) {
+		return 1.0;
+	}
+
+	return wsf_engine_scroll_multiplier(&core->curve_table, core->scroll_factor[axis], velocity);
+}
+
+void wsf_core_curve_sample(
+	const struct wsf_core *core,
+	unsigned int axis,
+	const double *velocities,
+	double *out_multipliers,
+	size_t count
+) {
+	size_t i = 0;
+
+	if (axis > WSF_CORE_SCROLL_HORIZONTAL || core->scroll_factor[axis] == 1.0) {
+		for (i = 0; i < count; i++) {
+			out_multipliers[i] = 1.0;
+		}
+		return;
+	}
+
+	wsf_curve_lookup_batch(
+		&core->curve_table,
+		core->kernel,
+		core->scroll_factor[axis],
+		velocities,
+		out_multipliers,
+		count
+	);
+}
+
+void wsf_core_curve_range(const struct wsf_core *core, double *out_min, double *out_max) {
+	*out_min = core->curve_table.velocity_min;
+	*out_max = core->curve_table.velocity_max;
+}
+
+struct wsf_core *wsf_core_new(const char *config_path) {
+	struct wsf_effective_factors factors;
+	struct wsf_core *core = NULL;
+	bool debug = wsf_debug_enabled();
+	int status = WSF_CONFIG_OK;
+
+	if (config_path == NULL) {
+		status = wsf_effective_factors(&factors, debug);
+		if (status == WSF_CONFIG_ERROR || status == WSF_CONFIG_INVALID) {
+			return NULL;
+		}
+	} else {
+		struct wsf_config_values values;
+
+		wsf_config_values_init(&values);
+		if (wsf_config_read_path(config_path, &values, debug) != WSF_CONFIG_OK) {
+			return NULL;
+		}
+		wsf_config_resolve(&values, &factors);
+	}
+
+	core = malloc(sizeof(*core));
+	if (core == NULL) {
+		return NULL;
+	}
+	wsf_core_init(core, &factors);
+	return core;
+}
+
+void wsf_core_free(struct wsf_core *core) {
+	free(core);
+}
@@ -0,0 +1,111 @@
+#ifndef WSF_CORE_H
+#define WSF_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wsf_config.h"
+#include "wsf_curve.h"
+#include "wsf_engine.h"
+
+/*
+ * The scaling engine behind one state object, for code that is not the
+ * preload: `wsf replay`, the tests and, through libwsf_core.so, the GUI.
+ * Each call is the wsf_engine.h arithmetic the preload inlines into its
+ * hooks, so results match a running compositor bit for bit. The struct is
+ * public so C callers can keep it on the stack; wsf_core_new()/free() are
+ * for callers that only hold a pointer (ctypes).
+ */
+
+#define WSF_CORE_DEVICES 64
+
+/* Event kinds; the scroll axes match the preload's axis numbering. */
+enum wsf_core_kind {
+	WSF_CORE_SCROLL_VERTICAL = 0,
+	WSF_CORE_SCROLL_HORIZONTAL = 1,
+	WSF_CORE_PINCH_ZOOM = 2,
+	WSF_CORE_PINCH_ROTATE = 3,
+};
+
+struct wsf_core_event {
+	uint64_t time_us;
+	uint32_t kind;
+	/* enum wsf_scroll_source; scroll only. */
+	uint32_t source;
+	/* Velocity state slot, below WSF_CORE_DEVICES; scroll only. */
+	uint32_t device;
+	uint32_t has_time;
+	double value;
+};
+
+/* What the engine did with one event; velocity/multiplier need curve. */
+struct wsf_core_result {
+	double value;
+	double velocity;
+	double multiplier;
+	bool curve;
+};
+
+struct wsf_core {
+	double scroll_factor[2];
+	double pinch_zoom_factor;
+	double pinch_rotate_factor;
+	struct wsf_scroll_curve_params curve;
+	struct wsf_curve_table curve_table;
+	/* Curve kernel for wsf_core_scale_batch() and wsf_core_curve_sample(). */
+	enum wsf_curve_kernel kernel;
+	struct wsf_scroll_axis_state axis[WSF_CORE_DEVICES][2];
+};
+
+void wsf_core_init(struct wsf_core *core, const struct wsf_effective_factors *factors);
+void wsf_core_set_factors(
+	struct wsf_core *core,
+	double scroll_vertical,
+	double scroll_horizontal,
+	double pinch_zoom,
+	double pinch_rotate
+);
+/* Forgets every device's velocity; factors and curve stay. */
+void wsf_core_reset(struct wsf_core *core);
+
+/* Returns the scaled value; out_result may be NULL. */
+double wsf_core_scale(
+	struct wsf_core *core,
+	const struct wsf_core_event *event,
+	struct wsf_core_result *out_result
+);
+/*
+ * Same bits as calling wsf_core_scale() on each event in order, with the
+ * curve lookups run through the vector kernel.
+ */
+void wsf_core_scale_batch(
+	struct wsf_core *core,
+	const struct wsf_core_event *events,
+	double *out_values,
+	size_t count
+);
+
+/*
+ * factor * curve(velocity) for a scroll axis, without touching state; 1.0
+ * on an axis at factor 1.0, which the compositor leaves alone.
+ */
+double wsf_core_curve_multiplier(const struct wsf_core *core, unsigned int axis, double velocity);
+void wsf_core_curve_sample(
+	const struct wsf_core *core,
+	unsigned int axis,
+	const double *velocities,
+	double *out_multipliers,
+	size_t count
+);
+/* Velocity range over which the curve changes (units/s). */
+void wsf_core_curve_range(const struct wsf_core *core, double *out_min, double *out_max);
+
+/*
+ * Heap state from a config file, or from the user's config with WSF_*
+ * overrides when config_path is NULL. NULL when the file cannot be used.
+ */
+struct wsf_core *wsf_core_new(const char *config_path);
+void wsf_core_free(struct wsf_core *core);
+
+#endif
@@ -0,0 +1,246 @@
+#include "wsf_curve.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+static double wsf_curve_smoothstep(
+	const struct wsf_scroll_curve_params *params,
+	double velocity
+) {
+	double normalized = 0.0;
+
+	if (!isfinite(velocity) || velocity <= params->velocity_low) {
+		return params->min_multiplier;
+	}
+	if (velocity >= params->velocity_high) {
+		return params->max_multiplier;
+	}
+
+	normalized =
+		(velocity - params->velocity_low) /
+		(params->velocity_high - params->velocity_low);
+	normalized = normalized * normalized * (3.0 - (2.0 * normalized));
+
+	return params->min_multiplier +
+		(normalized * (params->max_multiplier - params->min_multiplier));
+}
+
+/* Fritsch-Carlson tangents: the interpolant never overshoots the points. */
+static void wsf_curve_tangents(
+	const struct wsf_scroll_curve_params *params,
+	double *tangents
+) {
+	const double *x = params->point_velocity;
+	const double *y = params->point_multiplier;
+	unsigned int n = params->point_count;
+	double slopes[WSF_SCROLL_CURVE_MAX_POINTS] = { 0.0 };
+	unsigned int i = 0;
+
+	for (i = 0; i + 1 < n; i++) {
+		slopes[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]);
+	}
+
+	tangents[0] = slopes[0];
+	tangents[n - 1] = slopes[n - 2];
+	for (i = 1; i + 1 < n; i++) {
+		if (slopes[i - 1] * slopes[i] <= 0.0) {
+			tangents[i] = 0.0;
+		} else {
+			tangents[i] = (slopes[i - 1] + slopes[i]) * 0.5;
+		}
+	}
+
+	for (i = 0; i + 1 < n; i++) {
+		double alpha = 0.0;
+		double beta = 0.0;
+		double norm = 0.0;
+
+		if (slopes[i] == 0.0) {
+			tangents[i] = 0.0;
+			tangents[i + 1] = 0.0;
+			continue;
+		}
+
+		alpha = tangents[i] / slopes[i];
+		beta = tangents[i + 1] / slopes[i];
+		norm = (alpha * alpha) + (beta * beta);
+		if (norm > 9.0) {
+			double tau = 3.0 / sqrt(norm);
+
+			tangents[i] = tau * alpha * slopes[i];
+			tangents[i + 1] = tau * beta * slopes[i];
+		}
+	}
+}
+
+static double wsf_curve_points_eval(
+	const struct wsf_scroll_curve_params *params,
+	const double *tangents,
+	double velocity
+) {
+	const double *x = params->point_velocity;
+	const double *y = params->point_multiplier;
+	unsigned int n = params->point_count;
+	unsigned int i = 0;
+	double h = 0.0;
+	double t = 0.0;
+	double t2 = 0.0;
+	double t3 = 0.0;
+
+	if (!isfinite(velocity) || velocity <= x[0]) {
+		return y[0];
+	}
+	if (velocity >= x[n - 1]) {
+		return y[n - 1];
+	}
+
+	while (i + 2 < n && velocity >= x[i + 1]) {
+		i++;
+	}
+
+	h = x[i + 1] - x[i];
+	t = (velocity - x[i]) / h;
+	if (params->kind == WSF_SCROLL_CURVE_LINEAR || tangents == NULL) {
+		return y[i] + ((y[i + 1] - y[i]) * t);
+	}
+
+	t2 = t * t;
+	t3 = t2 * t;
+	return (((2.0 * t3) - (3.0 * t2) + 1.0) * y[i]) +
+		((t3 - (2.0 * t2) + t) * h * tangents[i]) +
+		(((-2.0 * t3) + (3.0 * t2)) * y[i + 1]) +
+		((t3 - t2) * h * tangents[i + 1]);
+}
+
+double wsf_curve_eval(const struct wsf_scroll_curve_params *params, double velocity) {
+	double tangents[WSF_SCROLL_CURVE_MAX_POINTS];
+
+	if (params->kind == WSF_SCROLL_CURVE_SMOOTHSTEP || params->point_count < 2) {
+		return wsf_curve_smoothstep(params, velocity);
+	}
+	if (params->kind == WSF_SCROLL_CURVE_LINEAR) {
+		return wsf_curve_points_eval(params, NULL, velocity);
+	}
+
+	wsf_curve_tangents(params, tangents);
+	return wsf_curve_points_eval(params, tangents, velocity);
+}
+
+/*
+ * Gives every point segment its own grid: WSF_CURVE_MIN_SEGMENT_STEPS steps
+ * plus a share of the rest by width, the rounding left over going to the
+ * widest, so the segments use exactly WSF_CURVE_TABLE_SIZE steps.
+ */
+static void wsf_curve_compile_segments(
+	struct wsf_curve_table *table,
+	const struct wsf_scroll_curve_params *params,
+	const double *tangents
+) {
+	const double *x = params->point_velocity;
+	unsigned int count = params->point_count - 1;
+	unsigned int spare = WSF_CURVE_TABLE_SIZE - (count * WSF_CURVE_MIN_SEGMENT_STEPS);
+	unsigned int used = 0;
+	unsigned int widest = 0;
+	unsigned int offset = 0;
+	unsigned int segment = 0;
+	unsigned int i = 0;
+	double range = table->velocity_max - table->velocity_min;
+
+	table->segment_count = count;
+	for (segment = 0; segment < count; segment++) {
+		double width = x[segment + 1] - x[segment];
+		unsigned int steps = WSF_CURVE_MIN_SEGMENT_STEPS +
+			(unsigned int) ((double) spare * (width / range));
+
+		if (width > x[widest + 1] - x[widest]) {
+			widest = segment;
+		}
+		table->segment_steps[segment] = (uint16_t) steps;
+		used += steps;
+	}
+	table->segment_steps[widest] =
+		(uint16_t) (table->segment_steps[widest] + (WSF_CURVE_TABLE_SIZE - used));
+
+	for (segment = 0; segment < count; segment++) {
+		unsigned int steps = table->segment_steps[segment];
+		double step = (x[segment + 1] - x[segment]) / (double) steps;
+
+		table->segment_offset[segment] = (uint16_t) offset;
+		table->segment_start[segment] = x[segment];
+		table->segment_inv_step[segment] = 1.0 / step;
+		for (i = 0; i < steps; i++) {
+			table->values[offset + i] = wsf_curve_points_eval(
+				params,
+				tangents,
+				x[segment] + (step * (double) i)
+			);
+		}
+		offset += steps;
+	}
+	table->values[WSF_CURVE_TABLE_SIZE] = params->point_multiplier[count];
+
+	table->index_inv_step = WSF_CURVE_INDEX_SIZE / range;
+	segment = 0;
+	for (i = 0; i < WSF_CURVE_INDEX_SIZE; i++) {
+		double velocity = table->velocity_min + ((range * (double) i) / WSF_CURVE_INDEX_SIZE);
+
+		while (segment + 1 < count && velocity >= x[segment + 1]) {
+			segment++;
+		}
+		table->segment_index[i] = (uint8_t) segment;
+	}
+}
+
+void wsf_curve_compile(
+	struct wsf_curve_table *table,
+	const struct wsf_scroll_curve_params *params
+) {
+	double tangents[WSF_SCROLL_CURVE_MAX_POINTS];
+	const double *curve_tangents = NULL;
+	bool points = params->kind != WSF_SCROLL_CURVE_SMOOTHSTEP &&
+		params->point_count >= 2;
+	bool uneven = false;
+	double step = 0.0;
+	unsigned int i = 0;
+
+	memset(table, 0, sizeof(*table));
+	if (points) {
+		table->velocity_min = params->point_velocity[0];
+		table->velocity_max = params->point_velocity[params->point_count - 1];
+		if (params->kind == WSF_SCROLL_CURVE_CUBIC) {
+			wsf_curve_tangents(params, tangents);
+			curve_tangents = tangents;
+		}
+	} else {
+		table->velocity_min = params->velocity_low;
+		table->velocity_max = params->velocity_high;
+	}
+
+	step = (table->velocity_max - table->velocity_min) / WSF_CURVE_TABLE_SIZE;
+	table->inv_step = 1.0 / step;
+	if (points) {
+		for (i = 0; i + 1 < params->point_count; i++) {
+			double width = params->point_velocity[i + 1] - params->point_velocity[i];
+
+			if (width < step * WSF_CURVE_MIN_SEGMENT_STEPS) {
+				uneven = true;
+			}
+		}
+	}
+	if (uneven) {
+		wsf_curve_compile_segments(table, params, curve_tangents);
+		return;
+	}
+
+	for (i = 0; i <= WSF_CURVE_TABLE_SIZE; i++) {
+		double velocity = table->velocity_min + (step * (double) i);
+
+		if (i == WSF_CURVE_TABLE_SIZE) {
+			velocity = table->velocity_max;
+		}
+		table->values[i] = points ?
+			wsf_curve_points_eval(params, curve_tangents, velocity) :
+			wsf_curve_smoothstep(params, velocity);
+	}
+}
@@ -0,0 +1,143 @@
+#ifndef WSF_CURVE_H
+#define WSF_CURVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wsf_config.h"
+
+#define WSF_CURVE_TABLE_SIZE 256
+
+/* A point segment narrower than this many grid steps is not sampled. */
+#define WSF_CURVE_MIN_SEGMENT_STEPS 8
+/* Buckets of the velocity-to-segment index of a segmented table. */
+#define WSF_CURVE_INDEX_SIZE 64
+
+/*
+ * Velocity -> multiplier curve sampled on a uniform grid over the curve's
+ * active velocity range. Below/above the range the end values hold, so a
+ * lookup is one range check and one linear interpolation regardless of how
+ * the curve was defined.
+ *
+ * A point curve whose segments are too uneven for one grid (0:1,100:3,
+ * 200000:3 would lose its first segment) is segmented instead: each point
+ * segment gets its own grid of at least WSF_CURVE_MIN_SEGMENT_STEPS steps
+ * in values, with nodes on the points, and a uniform index over the range
+ * names the segment of each bucket's start. A lookup then adds an index
+ * load and a boundary check or two (one per point inside the bucket).
+ */
+struct wsf_curve_table {
+	double velocity_min;
+	double velocity_max;
+	double inv_step;
+	double values[WSF_CURVE_TABLE_SIZE + 1];
+	/* 0 for the uniform grid; otherwise the point segments. */
+	unsigned int segment_count;
+	double index_inv_step;
+	uint8_t segment_index[WSF_CURVE_INDEX_SIZE];
+	uint16_t segment_offset[WSF_SCROLL_CURVE_MAX_POINTS - 1];
+	uint16_t segment_steps[WSF_SCROLL_CURVE_MAX_POINTS - 1];
+	double segment_start[WSF_SCROLL_CURVE_MAX_POINTS - 1];
+	double segment_inv_step[WSF_SCROLL_CURVE_MAX_POINTS - 1];
+};
+
+double wsf_curve_eval(const struct wsf_scroll_curve_params *params, double velocity);
+void wsf_curve_compile(
+	struct wsf_curve_table *table,
+	const struct wsf_scroll_curve_params *params
+);
+
+static inline double wsf_curve_interpolate(
+	const struct wsf_curve_table *table,
+	double position,
+	unsigned int offset,
+	unsigned int steps
+) {
+	unsigned int index = (unsigned int) position;
+	double fraction = 0.0;
+
+	if (index >= steps) {
+		index = steps - 1;
+	}
+	fraction = position - (double) index;
+	index += offset;
+
+	return table->values[index] +
+		((table->values[index + 1] - table->values[index]) * fraction);
+}
+
+/* In-range lookup in a segmented table. */
+static inline double wsf_curve_segment_lookup(const struct wsf_curve_table *table, double velocity) {
+	unsigned int bucket =
+		(unsigned int) ((velocity - table->velocity_min) * table->index_inv_step);
+	unsigned int segment = 0;
+
+	if (bucket >= WSF_CURVE_INDEX_SIZE) {
+		bucket = WSF_CURVE_INDEX_SIZE - 1;
+	}
+	segment = table->segment_index[bucket];
+	/* The index is exact up to rounding at a bucket's start. */
+	if (segment > 0 && velocity < table->segment_start[segment]) {
+		segment--;
+	}
+	while (segment + 1 < table->segment_count &&
+		velocity >= table->segment_start[segment + 1]) {
+		segment++;
+	}
+
+	return wsf_curve_interpolate(
+		table,
+		(velocity - table->segment_start[segment]) * table->segment_inv_step[segment],
+		table->segment_offset[segment],
+		table->segment_steps[segment]
+	);
+}
+
+static inline double wsf_curve_lookup(const struct wsf_curve_table *table, double velocity) {
+	if (!(velocity > table->velocity_min)) {
+		return table->values[0];
+	}
+	if (velocity >= table->velocity_max) {
+		return table->values[WSF_CURVE_TABLE_SIZE];
+	}
+	if (table->segment_count != 0) {
+		return wsf_curve_segment_lookup(table, velocity);
+	}
+
+	return wsf_curve_interpolate(
+		table,
+		(velocity - table->velocity_min) * table->inv_step,
+		0,
+		WSF_CURVE_TABLE_SIZE
+	);
+}
+
+/*
+ * Array form of factor * wsf_curve_lookup() for offline tools, with a
+ * vector kernel per instruction set. Every kernel returns the same bits
+ * as the scalar lookup; wsf_curve_kernel_widest() is the widest one this
+ * CPU runs, and a kernel above it must not be passed.
+ * wsf_curve_kernel_best() is the one to use: SSE2 has no gather, so its
+ * two lanes load the table one by one, and it is not reliably faster than
+ * scalar (slower on some CPUs), so only AVX2 replaces the scalar kernel.
+ */
+enum wsf_curve_kernel {
+	WSF_CURVE_KERNEL_SCALAR = 0,
+	WSF_CURVE_KERNEL_SSE2 = 1,
+	WSF_CURVE_KERNEL_AVX2 = 2
+};
+
+enum wsf_curve_kernel wsf_curve_kernel_widest(void);
+enum wsf_curve_kernel wsf_curve_kernel_best(void);
+const char *wsf_curve_kernel_name(enum wsf_curve_kernel kernel);
+void wsf_curve_lookup_batch(
+	const struct wsf_curve_table *table,
+	enum wsf_curve_kernel kernel,
+	double factor,
+	const double *velocities,
+	double *out,
+	size_t count
+);
+
+#endif
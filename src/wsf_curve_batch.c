@@ -0,0 +1,165 @@
+#include "wsf_curve.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define WSF_CURVE_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * The vector kernels follow wsf_curve_lookup() operation for operation:
+ * the in-range interpolation is computed for every lane on a velocity
+ * clamped into the table, and lanes at or outside the ends are replaced
+ * by the end values afterwards. None of the target sets include FMA, so
+ * a + (b - a) * f rounds exactly as the scalar code does.
+ */
+
+static void wsf_curve_batch_scalar(
+	const struct wsf_curve_table *table,
+	double factor,
+	const double *velocities,
+	double *out,
+	size_t count
+) {
+	size_t i = 0;
+
+	for (i = 0; i < count; i++) {
+		out[i] = factor * wsf_curve_lookup(table, velocities[i]);
+	}
+}
+
+#ifdef WSF_CURVE_X86
+
+static size_t wsf_curve_batch_sse2(
+	const struct wsf_curve_table *table,
+	double factor,
+	const double *velocities,
+	double *out,
+	size_t count
+) {
+	const __m128d min = _mm_set1_pd(table->velocity_min);
+	const __m128d max = _mm_set1_pd(table->velocity_max);
+	const __m128d inv_step = _mm_set1_pd(table->inv_step);
+	const __m128d last_index = _mm_set1_pd((double) (WSF_CURVE_TABLE_SIZE - 1));
+	const __m128d first_value = _mm_set1_pd(table->values[0]);
+	const __m128d last_value = _mm_set1_pd(table->values[WSF_CURVE_TABLE_SIZE]);
+	const __m128d scale = _mm_set1_pd(factor);
+	size_t i = 0;
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		__m128d velocity = _mm_loadu_pd(velocities + i);
+		__m128d inside = _mm_cmpgt_pd(velocity, min);
+		__m128d above = _mm_cmpge_pd(velocity, max);
+		/* maxpd returns its second operand for NaN, which lands on values[0]. */
+		__m128d clamped = _mm_min_pd(_mm_max_pd(velocity, min), max);
+		__m128d position = _mm_mul_pd(_mm_sub_pd(clamped, min), inv_step);
+		__m128i index = _mm_cvttpd_epi32(_mm_min_pd(position, last_index));
+		int index0 = _mm_cvtsi128_si32(index);
+		int index1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(index, 1));
+		__m128d fraction = _mm_sub_pd(position, _mm_cvtepi32_pd(index));
+		__m128d low = _mm_set_pd(table->values[index1], table->values[index0]);
+		__m128d high = _mm_set_pd(table->values[index1 + 1], table->values[index0 + 1]);
+		__m128d value = _mm_add_pd(low, _mm_mul_pd(_mm_sub_pd(high, low), fraction));
+
+		value = _mm_or_pd(_mm_and_pd(inside, value), _mm_andnot_pd(inside, first_value));
+		value = _mm_or_pd(_mm_andnot_pd(above, value), _mm_and_pd(above, last_value));
+		_mm_storeu_pd(out + i, _mm_mul_pd(scale, value));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t wsf_curve_batch_avx2(
+	const struct wsf_curve_table *table,
+	double factor,
+	const double *velocities,
+	double *out,
+	size_t count
+) {
+	const __m256d min = _mm256_set1_pd(table->velocity_min);
+	const __m256d max = _mm256_set1_pd(table->velocity_max);
+	const __m256d inv_step = _mm256_set1_pd(table->inv_step);
+	const __m256d last_index = _mm256_set1_pd((double) (WSF_CURVE_TABLE_SIZE - 1));
+	const __m256d first_value = _mm256_set1_pd(table->values[0]);
+	const __m256d last_value = _mm256_set1_pd(table->values[WSF_CURVE_TABLE_SIZE]);
+	const __m256d scale = _mm256_set1_pd(factor);
+	size_t i = 0;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m256d velocity = _mm256_loadu_pd(velocities + i);
+		__m256d inside = _mm256_cmp_pd(velocity, min, _CMP_GT_OQ);
+		__m256d above = _mm256_cmp_pd(velocity, max, _CMP_GE_OQ);
+		__m256d clamped = _mm256_min_pd(_mm256_max_pd(velocity, min), max);
+		__m256d position = _mm256_mul_pd(_mm256_sub_pd(clamped, min), inv_step);
+		__m128i index = _mm256_cvttpd_epi32(_mm256_min_pd(position, last_index));
+		__m256d fraction = _mm256_sub_pd(position, _mm256_cvtepi32_pd(index));
+		__m256d low = _mm256_i32gather_pd(table->values, index, 8);
+		__m256d high = _mm256_i32gather_pd(table->values + 1, index, 8);
+		__m256d value = _mm256_add_pd(low, _mm256_mul_pd(_mm256_sub_pd(high, low), fraction));
+
+		value = _mm256_blendv_pd(first_value, value, inside);
+		value = _mm256_blendv_pd(value, last_value, above);
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(scale, value));
+	}
+
+	return i;
+}
+
+#endif
+
+enum wsf_curve_kernel wsf_curve_kernel_widest(void) {
+#ifdef WSF_CURVE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return WSF_CURVE_KERNEL_AVX2;
+	}
+	return WSF_CURVE_KERNEL_SSE2;
+#else
+	return WSF_CURVE_KERNEL_SCALAR;
+#endif
+}
+
+enum wsf_curve_kernel wsf_curve_kernel_best(void) {
+	enum wsf_curve_kernel widest = wsf_curve_kernel_widest();
+
+	return widest == WSF_CURVE_KERNEL_SSE2 ? WSF_CURVE_KERNEL_SCALAR : widest;
+}
+
+const char *wsf_curve_kernel_name(enum wsf_curve_kernel kernel) {
+	switch (kernel) {
+	case WSF_CURVE_KERNEL_SSE2:
+		return "sse2";
+	case WSF_CURVE_KERNEL_AVX2:
+		return "avx2";
+	case WSF_CURVE_KERNEL_SCALAR:
+	default:
+		return "scalar";
+	}
+}
+
+void wsf_curve_lookup_batch(
+	const struct wsf_curve_table *table,
+	enum wsf_curve_kernel kernel,
+	double factor,
+	const double *velocities,
+	double *out,
+	size_t count
+) {
+	size_t done = 0;
+
+#ifdef WSF_CURVE_X86
+	/* Segmented tables have no single grid to gather from. */
+	if (table->segment_count != 0) {
+		kernel = WSF_CURVE_KERNEL_SCALAR;
+	}
+	if (kernel == WSF_CURVE_KERNEL_AVX2) {
+		done = wsf_curve_batch_avx2(table, factor, velocities, out, count);
+	} else if (kernel == WSF_CURVE_KERNEL_SSE2) {
+		done = wsf_curve_batch_sse2(table, factor, velocities, out, count);
+	}
+#else
+	(void) kernel;
+#endif
+
+	wsf_curve_batch_scalar(table, factor, velocities + done, out + done, count - done);
+}
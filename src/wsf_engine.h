@@ -0,0 +1,183 @@
+#ifndef WSF_ENGINE_H
+#define WSF_ENGINE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wsf_config.h"
+#include "wsf_curve.h"
+#include "wsf_fastmath.h"
+
+/*
+ * The scaling arithmetic proper, shared by the preload hooks and the
+ * offline tools (`wsf replay`), so a recorded stream goes through exactly
+ * the code a running compositor applies. Nothing here touches libinput or
+ * globals: velocity state belongs to the caller, and the fast pow tables
+ * must have been filled with wsf_fastmath_init() before a pinch factor
+ * other than 1.0 is applied.
+ */
+
+/* Assumed event spacing when there is no usable previous timestamp. */
+#define WSF_SCROLL_CURVE_FALLBACK_DT_US 8000.0
+
+/* Same numbering as libinput's enum libinput_pointer_axis_source. */
+enum wsf_scroll_source {
+	WSF_SCROLL_SOURCE_WHEEL = 1,
+	WSF_SCROLL_SOURCE_FINGER = 2,
+	WSF_SCROLL_SOURCE_CONTINUOUS = 3,
+	WSF_SCROLL_SOURCE_WHEEL_TILT = 4,
+};
+
+struct wsf_scroll_axis_state {
+	double velocity;
+	uint64_t last_time_us;
+	bool has_velocity;
+	bool has_last_time;
+};
+
+/* Wheel clicks keep their detents; only touchpad-style scrolling scales. */
+static inline bool wsf_engine_scroll_source_scaled(unsigned int source) {
+	return source == WSF_SCROLL_SOURCE_FINGER ||
+		source == WSF_SCROLL_SOURCE_CONTINUOUS;
+}
+
+/*
+ * Values that never reach the curve: an axis at factor 1.0 (passed through
+ * untouched, velocity state included), non-finite input, a disabled axis
+ * and zero deltas. Returns true with the result in *out for those.
+ */
+static inline bool wsf_engine_scroll_trivial(double value, double base_factor, double *out) {
+	if (base_factor == 1.0 || !isfinite(value)) {
+		*out = value;
+		return true;
+	}
+	if (!isfinite(base_factor) || base_factor <= 0.0) {
+		*out = value * base_factor;
+		return true;
+	}
+	if (value == 0.0) {
+		*out = 0.0;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Whether wsf_engine_scroll_velocity() restarts the EMA at this event (the
+ * axis' first event, or one after a gap above the reset gap), and the
+ * spacing it assumes. Lets offline tools split the stream into gestures.
+ */
+static inline bool wsf_engine_scroll_restarts(
+	const struct wsf_scroll_curve_params *curve,
+	const struct wsf_scroll_axis_state *state,
+	bool has_time,
+	uint64_t time_us,
+	double *out_dt_us
+) {
+	bool restarts = !state->has_velocity;
+
+	*out_dt_us = WSF_SCROLL_CURVE_FALLBACK_DT_US;
+	if (has_time && state->has_last_time && time_us > state->last_time_us) {
+		uint64_t delta_us = time_us - state->last_time_us;
+
+		if ((double) delta_us > curve->reset_gap_us) {
+			restarts = true;
+		} else {
+			*out_dt_us = (double) delta_us;
+		}
+	}
+	return restarts;
+}
+
+/*
+ * Feeds one event into the axis EMA and returns the smoothed velocity in
+ * units per second. has_time is false for events without a timestamp; they
+ * assume the fallback spacing and leave the last timestamp alone.
+ */
+static inline double wsf_engine_scroll_velocity(
+	const struct wsf_scroll_curve_params *curve,
+	struct wsf_scroll_axis_state *state,
+	bool has_time,
+	uint64_t time_us,
+	double value
+) {
+	double instantaneous_velocity =
+		fabs(value) * (1000000.0 / WSF_SCROLL_CURVE_FALLBACK_DT_US);
+
+	if (has_time) {
+		if (state->has_last_time && time_us > state->last_time_us) {
+			uint64_t delta_us = time_us - state->last_time_us;
+
+			if ((double) delta_us > curve->reset_gap_us) {
+				state->has_velocity = false;
+			} else if (delta_us > 0) {
+				instantaneous_velocity =
+					fabs(value) * (1000000.0 / (double) delta_us);
+			}
+		}
+
+		state->last_time_us = time_us;
+		state->has_last_time = true;
+	}
+
+	if (!isfinite(instantaneous_velocity)) {
+		instantaneous_velocity = 0.0;
+	}
+
+	if (!state->has_velocity) {
+		state->velocity = instantaneous_velocity;
+		state->has_velocity = true;
+	} else {
+		state->velocity =
+			state->velocity +
+			((instantaneous_velocity - state->velocity) * curve->smoothing);
+	}
+
+	return state->velocity;
+}
+
+static inline double wsf_engine_scroll_multiplier(
+	const struct wsf_curve_table *table,
+	double base_factor,
+	double velocity
+) {
+	return base_factor * wsf_curve_lookup(table, velocity);
+}
+
+/*
+ * The fast kernel rejects non-finite, non-positive and subnormal scales and
+ * out-of-range results itself, so the common case needs no further checks.
+ */
+static inline double wsf_engine_pinch_zoom(double scale, double factor) {
+	double scaled = 1.0;
+
+	if (factor == 1.0) {
+		return scale;
+	}
+	if (__builtin_expect(wsf_fast_pow(scale, factor, &scaled), 1)) {
+		return scaled;
+	}
+
+	if (!isfinite(scale) || scale <= 0.0) {
+		return scale;
+	}
+
+	scaled = pow(scale, factor);
+	if (!isfinite(scaled) || scaled <= 0.0) {
+		return scale;
+	}
+
+	return scaled;
+}
+
+static inline double wsf_engine_pinch_rotate(double delta, double factor) {
+	if (factor == 1.0) {
+		return delta;
+	}
+
+	return delta * factor;
+}
+
+#endif
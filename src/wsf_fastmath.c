@@ -0,0 +1,23 @@
+#include "wsf_fastmath.h"
+
+#include <math.h>
+
+struct wsf_fastmath_tables wsf_fastmath;
+
+/* Runs once at init; the hot path never calls into libm. */
+void wsf_fastmath_init(void) {
+	int i = 0;
+
+	for (i = 0; i < WSF_FAST_LOG2_SIZE; i++) {
+		double centre = 1.0 + (((double) i + 0.5) / WSF_FAST_LOG2_SIZE);
+		double inv_centre = 1.0 / centre;
+
+		wsf_fastmath.log2_inv_centre[i] = inv_centre;
+		/* log2 of the centre actually used, so rounding of 1/c cancels. */
+		wsf_fastmath.log2_centre[i] = -log2(inv_centre);
+	}
+
+	for (i = 0; i < WSF_FAST_EXP2_SIZE; i++) {
+		wsf_fastmath.exp2_fraction[i] = exp2((double) i / WSF_FAST_EXP2_SIZE);
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef WSF_FASTMATH_H
+#define WSF_FASTMATH_H
+
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * libm-free pow() for the pinch path: x^y = 2^(y * log2(x)).
+ *
+ * log2 looks up the top 7 mantissa bits (log2 and reciprocal of the
+ * interval centre) and runs a degree-4 log1p polynomial on the remainder;
+ * exp2 looks up 2^(j/64) and runs a degree-3 polynomial on the last 1/128.
+ * For x in [1/64, 64] and y in [WSF_FACTOR_MIN, WSF_FACTOR_MAX] the
+ * measured maximum relative error against glibc pow() is below 1e-10
+ * (bench/bench_pow.c checks it).
+ *
+ * Only normal, positive x and results inside the normal double range are
+ * handled; wsf_fast_pow() reports anything else so the caller can fall
+ * back. The tables are filled by wsf_fastmath_init().
+ */
+
+#define WSF_FAST_LOG2_BITS 7
+#define WSF_FAST_LOG2_SIZE (1 << WSF_FAST_LOG2_BITS)
+#define WSF_FAST_EXP2_BITS 6
+#define WSF_FAST_EXP2_SIZE (1 << WSF_FAST_EXP2_BITS)
+
+#define WSF_FAST_LN2 0.69314718055994530942
+#define WSF_FAST_LOG2E 1.44269504088896340736
+
+struct wsf_fastmath_tables {
+	double log2_inv_centre[WSF_FAST_LOG2_SIZE];
+	double log2_centre[WSF_FAST_LOG2_SIZE];
+	double exp2_fraction[WSF_FAST_EXP2_SIZE];
+};
+
+extern struct wsf_fastmath_tables wsf_fastmath;
+
+void wsf_fastmath_init(void);
+
+static inline double wsf_fast_from_bits(uint64_t bits) {
+	double value = 0.0;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static inline uint64_t wsf_fast_to_bits(double value) {
+	uint64_t bits = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/* x must be positive, finite and normal. */
+static inline double wsf_fast_log2(double x) {
+	uint64_t bits = wsf_fast_to_bits(x);
+	int exponent = (int) ((bits >> 52) & 0x7ffu) - 1023;
+	unsigned int index = (unsigned int) (bits >> (52 - WSF_FAST_LOG2_BITS)) &
+		(WSF_FAST_LOG2_SIZE - 1);
+	double mantissa = wsf_fast_from_bits(
+		(bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull
+	);
+	double r = (mantissa * wsf_fastmath.log2_inv_centre[index]) - 1.0;
+	double log1p = r * (1.0 + r * (-1.0 / 2.0 + r * (1.0 / 3.0 + r * (-1.0 / 4.0))));
+
+	return (double) exponent + wsf_fastmath.log2_centre[index] + (log1p * WSF_FAST_LOG2E);
+}
+
+/* t must lie in (-1022, 1023). */
+static inline double wsf_fast_exp2(double t) {
+	double scaled = t * WSF_FAST_EXP2_SIZE;
+	int whole = (int) (scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+	double r = (scaled - (double) whole) * (WSF_FAST_LN2 / WSF_FAST_EXP2_SIZE);
+	double poly = 1.0 + r * (1.0 + r * (1.0 / 2.0 + r * (1.0 / 6.0)));
+	int exponent = whole >> WSF_FAST_EXP2_BITS;
+	double power = wsf_fast_from_bits((uint64_t) (exponent + 1023) << 52);
+
+	return poly * power * wsf_fastmath.exp2_fraction[whole & (WSF_FAST_EXP2_SIZE - 1)];
+}
+
+/* Returns false when x or the result is outside the kernel's domain. */
+static inline bool wsf_fast_pow(double x, double y, double *out) {
+	double t = 0.0;
+
+	if (!(x >= DBL_MIN && x <= DBL_MAX)) {
+		return false;
+	}
+
+	t = y * wsf_fast_log2(x);
+	if (!(t > -1021.0 && t < 1022.0)) {
+		return false;
+	}
+
+	*out = wsf_fast_exp2(t);
+	return true;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+
+#include "wsf_ldcache.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Layouts from glibc's sysdeps/generic/dl-cache.h. The old format is a
+ * 16-byte header and 12-byte entries whose string offsets count from the
+ * end of the entries; the new one a 48-byte header and 24-byte entries
+ * whose offsets count from the start of that header. Compat caches put
+ * the new table right after the old one, aligned to 8 bytes.
+ */
+#define WSF_LDCACHE_OLD_MAGIC "ld.so-1.7.0"
+#define WSF_LDCACHE_OLD_HEADER 16u
+#define WSF_LDCACHE_OLD_ENTRY 12u
+#define WSF_LDCACHE_NEW_MAGIC "glibc-ld.so.cache1.1"
+#define WSF_LDCACHE_NEW_HEADER 48u
+#define WSF_LDCACHE_NEW_ENTRY 24u
+#define WSF_LDCACHE_NEW_ALIGN 8u
+
+#define WSF_LDCACHE_FLAG_TYPE_MASK 0x00ffu
+#define WSF_LDCACHE_FLAG_ELF_LIBC6 0x0003u
+
+struct wsf_ldcache_table {
+	const unsigned char *entries;
+	size_t count;
+	size_t entry_size;
+	const char *strings;
+	size_t strings_len;
+};
+
+static uint32_t wsf_ldcache_u32(const unsigned char *at) {
+	uint32_t value = 0;
+
+	memcpy(&value, at, sizeof(value));
+	return value;
+}
+
+/* Offsets come from the file, so each string must end inside it. */
+static const char *wsf_ldcache_string(const struct wsf_ldcache_table *table, uint32_t offset) {
+	if (offset >= table->strings_len) {
+		return NULL;
+	}
+	if (memchr(table->strings + offset, '\0', table->strings_len - offset) == NULL) {
+		return NULL;
+	}
+
+	return table->strings + offset;
+}
+
+static bool wsf_ldcache_table(
+	const unsigned char *data,
+	size_t size,
+	struct wsf_ldcache_table *out_table
+) {
+	size_t old_magic_len = strlen(WSF_LDCACHE_OLD_MAGIC);
+	size_t new_magic_len = strlen(WSF_LDCACHE_NEW_MAGIC);
+	size_t offset = 0;
+	size_t count = 0;
+
+	if (size >= WSF_LDCACHE_OLD_HEADER &&
+		memcmp(data, WSF_LDCACHE_OLD_MAGIC, old_magic_len) == 0) {
+		count = wsf_ldcache_u32(data + 12);
+		if (count > (size - WSF_LDCACHE_OLD_HEADER) / WSF_LDCACHE_OLD_ENTRY) {
+			return false;
+		}
+		offset = WSF_LDCACHE_OLD_HEADER + count * WSF_LDCACHE_OLD_ENTRY;
+		out_table->entries = data + WSF_LDCACHE_OLD_HEADER;
+		out_table->count = count;
+		out_table->entry_size = WSF_LDCACHE_OLD_ENTRY;
+		out_table->strings = (const char *) data + offset;
+		out_table->strings_len = size - offset;
+
+		offset = (offset + WSF_LDCACHE_NEW_ALIGN - 1) & ~(size_t) (WSF_LDCACHE_NEW_ALIGN - 1);
+		if (offset > size || size - offset < WSF_LDCACHE_NEW_HEADER ||
+			memcmp(data + offset, WSF_LDCACHE_NEW_MAGIC, new_magic_len) != 0) {
+			return true;
+		}
+	} else if (size < WSF_LDCACHE_NEW_HEADER ||
+		memcmp(data, WSF_LDCACHE_NEW_MAGIC, new_magic_len) != 0) {
+		return false;
+	}
+
+	count = wsf_ldcache_u32(data + offset + 20);
+	if (count > (size - offset - WSF_LDCACHE_NEW_HEADER) / WSF_LDCACHE_NEW_ENTRY) {
+		return false;
+	}
+	out_table->entries = data + offset + WSF_LDCACHE_NEW_HEADER;
+	out_table->count = count;
+	out_table->entry_size = WSF_LDCACHE_NEW_ENTRY;
+	out_table->strings = (const char *) data + offset;
+	out_table->strings_len = size - offset;
+	return true;
+}
+
+bool wsf_ldcache_find(
+	const char *cache_path,
+	const char *prefix,
+	wsf_ldcache_fn fn,
+	void *data
+) {
+	struct wsf_ldcache_table table;
+	struct stat st;
+	unsigned char *map = NULL;
+	size_t prefix_len = 0;
+	size_t i = 0;
+	bool found = false;
+	int fd = -1;
+
+	if (cache_path == NULL || prefix == NULL || fn == NULL) {
+		return false;
+	}
+
+	fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	prefix_len = strlen(prefix);
+	if (wsf_ldcache_table(map, (size_t) st.st_size, &table)) {
+		for (i = 0; i < table.count && !found; i++) {
+			const unsigned char *entry = table.entries + i * table.entry_size;
+			uint32_t flags = wsf_ldcache_u32(entry);
+			const char *name = wsf_ldcache_string(&table, wsf_ldcache_u32(entry + 4));
+			const char *path = wsf_ldcache_string(&table, wsf_ldcache_u32(entry + 8));
+
+			if ((flags & WSF_LDCACHE_FLAG_TYPE_MASK) != WSF_LDCACHE_FLAG_ELF_LIBC6 ||
+				name == NULL || path == NULL ||
+				strncmp(name, prefix, prefix_len) != 0) {
+				continue;
+			}
+			found = fn(name, path, data);
+		}
+	}
+
+	munmap(map, (size_t) st.st_size);
+	return found;
+}
@@ -0,0 +1,26 @@
+#ifndef WSF_LDCACHE_H
+#define WSF_LDCACHE_H
+
+#include <stdbool.h>
+
+#define WSF_LDCACHE_PATH "/etc/ld.so.cache"
+
+/* Return true to stop the lookup at this entry. */
+typedef bool (*wsf_ldcache_fn)(const char *name, const char *path, void *data);
+
+/*
+ * Reads the dynamic linker's cache (as written by ldconfig, in either the
+ * glibc 2.32+ format or the older one with or without the new table
+ * appended) and calls fn for each ELF entry whose name starts with prefix,
+ * in cache order, which is the order the linker prefers them in. Entries
+ * are not filtered by architecture; the caller finds out by loading one.
+ * Returns true when fn accepted an entry.
+ */
+bool wsf_ldcache_find(
+	const char *cache_path,
+	const char *prefix,
+	wsf_ldcache_fn fn,
+	void *data
+);
+
+#endif
@@ -0,0 +1,984 @@
+#define _GNU_SOURCE
+
+#include "wsf_niri.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* niri creates its socket during startup; poll for it for about a minute. */
+#define WSF_NIRI_CONNECT_INTERVAL_MS 250
+#define WSF_NIRI_CONNECT_ATTEMPTS 240
+
+#define WSF_NIRI_LINE_INITIAL 4096
+#define WSF_NIRI_LINE_MAX (1u << 20)
+#define WSF_NIRI_WINDOWS_MAX 128
+#define WSF_NIRI_WORKSPACES_MAX 32
+#define WSF_JSON_MAX_DEPTH 16
+
+#define WSF_NIRI_REQUEST "\"EventStream\"\n"
+
+struct wsf_niri_window {
+	uint64_t id;
+	char app_id[WSF_FOCUS_NAME_MAX];
+};
+
+struct wsf_niri_workspace {
+	uint64_t id;
+	char output[WSF_FOCUS_NAME_MAX];
+};
+
+/*
+ * The slice of niri's state the focus needs, rebuilt from the event
+ * stream: the full window and workspace lists arrive once after
+ * subscribing and incremental events follow. Windows beyond the table
+ * are not tracked; focusing one reads as an unknown app.
+ */
+struct wsf_niri_state {
+	struct wsf_niri_window windows[WSF_NIRI_WINDOWS_MAX];
+	struct wsf_niri_workspace workspaces[WSF_NIRI_WORKSPACES_MAX];
+	unsigned int window_count;
+	unsigned int workspace_count;
+	uint64_t focused_window;
+	uint64_t focused_workspace;
+	bool has_focused_window;
+	bool has_focused_workspace;
+};
+
+struct wsf_niri_watch {
+	char runtime_dir[PATH_MAX];
+	char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+	wsf_niri_focus_fn on_focus;
+	void *data;
+	bool debug;
+	bool logged_overflow;
+	char *line;
+	size_t line_size;
+	struct wsf_niri_focus focus;
+	struct wsf_niri_state state;
+};
+
+struct wsf_json {
+	const char *cur;
+	const char *end;
+};
+
+static void wsf_debug_log(bool debug, const char *fmt, ...) {
+	if (!debug) {
+		return;
+	}
+
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "wsf: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static void wsf_json_space(struct wsf_json *json) {
+	while (json->cur < json->end &&
+		(*json->cur == ' ' || *json->cur == '\t' ||
+			*json->cur == '\n' || *json->cur == '\r')) {
+		json->cur++;
+	}
+}
+
+static bool wsf_json_peek(struct wsf_json *json, char c) {
+	wsf_json_space(json);
+	return json->cur < json->end && *json->cur == c;
+}
+
+static bool wsf_json_take(struct wsf_json *json, char c) {
+	if (!wsf_json_peek(json, c)) {
+		return false;
+	}
+
+	json->cur++;
+	return true;
+}
+
+static bool wsf_json_literal(struct wsf_json *json, const char *literal) {
+	size_t len = strlen(literal);
+
+	wsf_json_space(json);
+	if ((size_t) (json->end - json->cur) < len ||
+		memcmp(json->cur, literal, len) != 0) {
+		return false;
+	}
+
+	json->cur += len;
+	return true;
+}
+
+static bool wsf_json_hex4(struct wsf_json *json, uint32_t *out) {
+	uint32_t value = 0;
+	int i = 0;
+
+	if (json->end - json->cur < 4) {
+		return false;
+	}
+	for (i = 0; i < 4; i++) {
+		char c = *json->cur++;
+
+		value <<= 4;
+		if (c >= '0' && c <= '9') {
+			value |= (uint32_t) (c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			value |= (uint32_t) (c - 'a' + 10);
+		} else if (c >= 'A' && c <= 'F') {
+			value |= (uint32_t) (c - 'A' + 10);
+		} else {
+			return false;
+		}
+	}
+
+	*out = value;
+	return true;
+}
+
+static size_t wsf_utf8_encode(uint32_t code, char *out) {
+	if (code < 0x80) {
+		out[0] = (char) code;
+		return 1;
+	}
+	if (code < 0x800) {
+		out[0] = (char) (0xc0 | (code >> 6));
+		out[1] = (char) (0x80 | (code & 0x3f));
+		return 2;
+	}
+	if (code < 0x10000) {
+		out[0] = (char) (0xe0 | (code >> 12));
+		out[1] = (char) (0x80 | ((code >> 6) & 0x3f));
+		out[2] = (char) (0x80 | (code & 0x3f));
+		return 3;
+	}
+	out[0] = (char) (0xf0 | (code >> 18));
+	out[1] = (char) (0x80 | ((code >> 12) & 0x3f));
+	out[2] = (char) (0x80 | ((code >> 6) & 0x3f));
+	out[3] = (char) (0x80 | (code & 0x3f));
+	return 4;
+}
+
+/*
+ * Decodes a string into out (len bytes, NUL-terminated). A string that
+ * does not fit comes back empty, so it can never match a profile name by
+ * its prefix. out may be NULL to skip the string.
+ */
+static bool wsf_json_string(struct wsf_json *json, char *out, size_t len) {
+	size_t used = 0;
+	bool fits = true;
+
+	if (!wsf_json_take(json, '"')) {
+		return false;
+	}
+
+	while (json->cur < json->end) {
+		char bytes[4];
+		size_t count = 1;
+		char c = *json->cur++;
+
+		if (c == '"') {
+			if (out != NULL) {
+				out[fits ? used : 0] = '\0';
+			}
+			return true;
+		}
+		bytes[0] = c;
+		if (c == '\\') {
+			uint32_t code = 0;
+
+			if (json->cur >= json->end) {
+				return false;
+			}
+			c = *json->cur++;
+			switch (c) {
+			case '"':
+			case '\\':
+			case '/':
+				bytes[0] = c;
+				break;
+			case 'b':
+				bytes[0] = '\b';
+				break;
+			case 'f':
+				bytes[0] = '\f';
+				break;
+			case 'n':
+				bytes[0] = '\n';
+				break;
+			case 'r':
+				bytes[0] = '\r';
+				break;
+			case 't':
+				bytes[0] = '\t';
+				break;
+			case 'u':
+				if (!wsf_json_hex4(json, &code)) {
+					return false;
+				}
+				if (code >= 0xd800 && code < 0xdc00) {
+					uint32_t low = 0;
+
+					if (json->end - json->cur < 6 || json->cur[0] != '\\' ||
+						json->cur[1] != 'u') {
+						return false;
+					}
+					json->cur += 2;
+					if (!wsf_json_hex4(json, &low) || low < 0xdc00 || low >= 0xe000) {
+						return false;
+					}
+					code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+				}
+				count = wsf_utf8_encode(code, bytes);
+				break;
+			default:
+				return false;
+			}
+		}
+
+		if (out != NULL && fits) {
+			if (used + count >= len) {
+				fits = false;
+			} else {
+				memcpy(out + used, bytes, count);
+				used += count;
+			}
+		}
+	}
+
+	return false;
+}
+
+static bool wsf_json_skip(struct wsf_json *json, int depth) {
+	const char *start = NULL;
+
+	wsf_json_space(json);
+	if (json->cur >= json->end) {
+		return false;
+	}
+
+	if (*json->cur == '"') {
+		return wsf_json_string(json, NULL, 0);
+	}
+	if (*json->cur == '{' || *json->cur == '[') {
+		bool object = *json->cur == '{';
+		char close = object ? '}' : ']';
+
+		if (depth >= WSF_JSON_MAX_DEPTH) {
+			return false;
+		}
+		json->cur++;
+		if (wsf_json_take(json, close)) {
+			return true;
+		}
+		do {
+			if (object &&
+				(!wsf_json_string(json, NULL, 0) || !wsf_json_take(json, ':'))) {
+				return false;
+			}
+			if (!wsf_json_skip(json, depth + 1)) {
+				return false;
+			}
+		} while (wsf_json_take(json, ','));
+
+		return wsf_json_take(json, close);
+	}
+
+	/* Numbers, true, false and null. */
+	start = json->cur;
+	while (json->cur < json->end &&
+		(*json->cur == '-' || *json->cur == '+' || *json->cur == '.' ||
+			(*json->cur >= '0' && *json->cur <= '9') ||
+			(*json->cur >= 'a' && *json->cur <= 'z') ||
+			(*json->cur >= 'A' && *json->cur <= 'Z'))) {
+		json->cur++;
+	}
+
+	return json->cur > start;
+}
+
+/*
+ * Steps to the next member of an object whose '{' was consumed. Returns 1
+ * with the member name in key and the cursor on its value, 0 at the
+ * closing brace, -1 on malformed input.
+ */
+static int wsf_json_member(struct wsf_json *json, bool *first, char *key, size_t key_len) {
+	if (wsf_json_take(json, '}')) {
+		return 0;
+	}
+	if (!*first && !wsf_json_take(json, ',')) {
+		return -1;
+	}
+	*first = false;
+	if (!wsf_json_string(json, key, key_len) || !wsf_json_take(json, ':')) {
+		return -1;
+	}
+
+	return 1;
+}
+
+/* An id, or null (*present false). */
+static bool wsf_json_id(struct wsf_json *json, uint64_t *out, bool *present) {
+	uint64_t value = 0;
+	const char *start = NULL;
+
+	if (wsf_json_literal(json, "null")) {
+		*present = false;
+		return true;
+	}
+
+	start = json->cur;
+	while (json->cur < json->end && *json->cur >= '0' && *json->cur <= '9') {
+		if (value > (UINT64_MAX - 9) / 10) {
+			return false;
+		}
+		value = value * 10 + (uint64_t) (*json->cur - '0');
+		json->cur++;
+	}
+	if (json->cur == start) {
+		return false;
+	}
+
+	*out = value;
+	*present = true;
+	return true;
+}
+
+static bool wsf_json_bool(struct wsf_json *json, bool *out) {
+	if (wsf_json_literal(json, "true")) {
+		*out = true;
+		return true;
+	}
+	if (wsf_json_literal(json, "false")) {
+		*out = false;
+		return true;
+	}
+
+	return false;
+}
+
+/* A string, or null as the empty string. */
+static bool wsf_json_name(struct wsf_json *json, char *out, size_t len) {
+	if (wsf_json_literal(json, "null")) {
+		out[0] = '\0';
+		return true;
+	}
+
+	return wsf_json_string(json, out, len);
+}
+
+/*
+ * Reads a Window or Workspace object: its id, its name field (app_id or
+ * output) and is_focused. Everything else is skipped.
+ */
+static bool wsf_niri_object(
+	struct wsf_json *json,
+	const char *name_key,
+	uint64_t *id,
+	char *name,
+	size_t name_len,
+	bool *focused
+) {
+	char key[32];
+	bool first = true;
+	bool has_id = false;
+	int rc = 0;
+
+	name[0] = '\0';
+	*focused = false;
+	if (!wsf_json_take(json, '{')) {
+		return false;
+	}
+	while ((rc = wsf_json_member(json, &first, key, sizeof(key))) > 0) {
+		bool ok = true;
+
+		if (strcmp(key, "id") == 0) {
+			ok = wsf_json_id(json, id, &has_id);
+		} else if (strcmp(key, name_key) == 0) {
+			ok = wsf_json_name(json, name, name_len);
+		} else if (strcmp(key, "is_focused") == 0) {
+			ok = wsf_json_bool(json, focused);
+		} else {
+			ok = wsf_json_skip(json, 1);
+		}
+		if (!ok) {
+			return false;
+		}
+	}
+
+	return rc == 0 && has_id;
+}
+
+static struct wsf_niri_window *wsf_niri_window_find(
+	const struct wsf_niri_state *state,
+	uint64_t id
+) {
+	unsigned int i = 0;
+
+	for (i = 0; i < state->window_count; i++) {
+		if (state->windows[i].id == id) {
+			return (struct wsf_niri_window *) &state->windows[i];
+		}
+	}
+
+	return NULL;
+}
+
+static const struct wsf_niri_workspace *wsf_niri_workspace_find(
+	const struct wsf_niri_state *state,
+	uint64_t id
+) {
+	unsigned int i = 0;
+
+	for (i = 0; i < state->workspace_count; i++) {
+		if (state->workspaces[i].id == id) {
+			return &state->workspaces[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Adds or updates a window; false when the table is full. */
+static bool wsf_niri_window_store(
+	struct wsf_niri_state *state,
+	uint64_t id,
+	const char *app_id
+) {
+	struct wsf_niri_window *window = wsf_niri_window_find(state, id);
+
+	if (window == NULL) {
+		if (state->window_count == WSF_NIRI_WINDOWS_MAX) {
+			return false;
+		}
+		window = &state->windows[state->window_count++];
+		window->id = id;
+	}
+	snprintf(window->app_id, sizeof(window->app_id), "%s", app_id);
+	return true;
+}
+
+static void wsf_niri_window_remove(struct wsf_niri_state *state, uint64_t id) {
+	struct wsf_niri_window *window = wsf_niri_window_find(state, id);
+
+	if (window != NULL) {
+		*window = state->windows[--state->window_count];
+	}
+	if (state->has_focused_window && state->focused_window == id) {
+		state->has_focused_window = false;
+	}
+}
+
+/* {"windows": [...]} or {"window": {...}}: replace the list or upsert one. */
+static bool wsf_niri_windows(
+	struct wsf_niri_watch *watch,
+	struct wsf_json *json,
+	bool replace
+) {
+	struct wsf_niri_state *state = &watch->state;
+	char key[32];
+	char app_id[WSF_FOCUS_NAME_MAX];
+	bool first = true;
+	int rc = 0;
+
+	if (!wsf_json_take(json, '{')) {
+		return false;
+	}
+	while ((rc = wsf_json_member(json, &first, key, sizeof(key))) > 0) {
+		uint64_t id = 0;
+		bool focused = false;
+		bool stored = true;
+
+		if (strcmp(key, replace ? "windows" : "window") != 0) {
+			if (!wsf_json_skip(json, 1)) {
+				return false;
+			}
+			continue;
+		}
+
+		if (!replace) {
+			if (!wsf_niri_object(json, "app_id", &id, app_id, sizeof(app_id), &focused)) {
+				return false;
+			}
+			stored = wsf_niri_window_store(state, id, app_id);
+			if (focused) {
+				state->focused_window = id;
+				state->has_focused_window = true;
+			}
+		} else {
+			state->window_count = 0;
+			state->has_focused_window = false;
+			if (!wsf_json_take(json, '[')) {
+				return false;
+			}
+			if (!wsf_json_take(json, ']')) {
+				do {
+					if (!wsf_niri_object(
+						json,
+						"app_id",
+						&id,
+						app_id,
+						sizeof(app_id),
+						&focused
+					)) {
+						return false;
+					}
+					stored = wsf_niri_window_store(state, id, app_id) && stored;
+					if (focused) {
+						state->focused_window = id;
+						state->has_focused_window = true;
+					}
+				} while (wsf_json_take(json, ','));
+				if (!wsf_json_take(json, ']')) {
+					return false;
+				}
+			}
+		}
+
+		if (!stored && !watch->logged_overflow) {
+			wsf_debug_log(
+				watch->debug,
+				"niri: more than %d windows; ignoring the rest",
+				WSF_NIRI_WINDOWS_MAX
+			);
+			watch->logged_overflow = true;
+		}
+	}
+
+	return rc == 0;
+}
+
+static bool wsf_niri_workspaces(struct wsf_niri_watch *watch, struct wsf_json *json) {
+	struct wsf_niri_state *state = &watch->state;
+	char key[32];
+	bool first = true;
+	int rc = 0;
+
+	if (!wsf_json_take(json, '{')) {
+		return false;
+	}
+	while ((rc = wsf_json_member(json, &first, key, sizeof(key))) > 0) {
+		if (strcmp(key, "workspaces") != 0) {
+			if (!wsf_json_skip(json, 1)) {
+				return false;
+			}
+			continue;
+		}
+
+		state->workspace_count = 0;
+		state->has_focused_workspace = false;
+		if (!wsf_json_take(json, '[')) {
+			return false;
+		}
+		if (wsf_json_take(json, ']')) {
+			continue;
+		}
+		do {
+			struct wsf_niri_workspace workspace;
+			bool focused = false;
+
+			if (!wsf_niri_object(
+				json,
+				"output",
+				&workspace.id,
+				workspace.output,
+				sizeof(workspace.output),
+				&focused
+			)) {
+				return false;
+			}
+			if (state->workspace_count < WSF_NIRI_WORKSPACES_MAX) {
+				state->workspaces[state->workspace_count++] = workspace;
+			}
+			if (focused) {
+				state->focused_workspace = workspace.id;
+				state->has_focused_workspace = true;
+			}
+		} while (wsf_json_take(json, ','));
+		if (!wsf_json_take(json, ']')) {
+			return false;
+		}
+	}
+
+	return rc == 0;
+}
+
+/*
+ * {"id": N} for WindowClosed and WindowFocusChanged (where null means no
+ * window has focus), {"id": N, "focused": bool} for WorkspaceActivated.
+ */
+static bool wsf_niri_id_event(
+	struct wsf_json *json,
+	uint64_t *id,
+	bool *present,
+	bool *focused
+) {
+	char key[32];
+	bool first = true;
+	int rc = 0;
+
+	*present = false;
+	*focused = false;
+	if (!wsf_json_take(json, '{')) {
+		return false;
+	}
+	while ((rc = wsf_json_member(json, &first, key, sizeof(key))) > 0) {
+		bool ok = true;
+
+		if (strcmp(key, "id") == 0) {
+			ok = wsf_json_id(json, id, present);
+		} else if (strcmp(key, "focused") == 0) {
+			ok = wsf_json_bool(json, focused);
+		} else {
+			ok = wsf_json_skip(json, 1);
+		}
+		if (!ok) {
+			return false;
+		}
+	}
+
+	return rc == 0;
+}
+
+/* Applies one event line; lines that do not parse leave the state alone. */
+static void wsf_niri_event(struct wsf_niri_watch *watch, const char *line, size_t len) {
+	struct wsf_niri_state *state = &watch->state;
+	struct wsf_niri_state saved;
+	struct wsf_json json = { line, line + len };
+	char name[48];
+	uint64_t id = 0;
+	bool present = false;
+	bool focused = false;
+	bool first = true;
+	bool ok = true;
+
+	if (!wsf_json_take(&json, '{') ||
+		wsf_json_member(&json, &first, name, sizeof(name)) <= 0) {
+		return;
+	}
+
+	/* The list events rewrite the tables; keep them until the line parses. */
+	if (strcmp(name, "WindowsChanged") == 0 || strcmp(name, "WorkspacesChanged") == 0) {
+		saved = *state;
+		if (strcmp(name, "WindowsChanged") == 0) {
+			ok = wsf_niri_windows(watch, &json, true);
+		} else {
+			ok = wsf_niri_workspaces(watch, &json);
+		}
+		if (!ok) {
+			*state = saved;
+		}
+		return;
+	}
+
+	if (strcmp(name, "WindowOpenedOrChanged") == 0) {
+		wsf_niri_windows(watch, &json, false);
+	} else if (strcmp(name, "WindowClosed") == 0) {
+		if (wsf_niri_id_event(&json, &id, &present, &focused) && present) {
+			wsf_niri_window_remove(state, id);
+		}
+	} else if (strcmp(name, "WindowFocusChanged") == 0) {
+		if (wsf_niri_id_event(&json, &id, &present, &focused)) {
+			state->focused_window = id;
+			state->has_focused_window = present;
+		}
+	} else if (strcmp(name, "WorkspaceActivated") == 0) {
+		if (wsf_niri_id_event(&json, &id, &present, &focused) && present && focused) {
+			state->focused_workspace = id;
+			state->has_focused_workspace = true;
+		}
+	}
+}
+
+static void wsf_niri_focus_current(
+	const struct wsf_niri_state *state,
+	struct wsf_niri_focus *out_focus
+) {
+	memset(out_focus, 0, sizeof(*out_focus));
+
+	if (state->has_focused_window) {
+		const struct wsf_niri_window *window =
+			wsf_niri_window_find(state, state->focused_window);
+
+		if (window != NULL) {
+			memcpy(out_focus->app_id, window->app_id, sizeof(out_focus->app_id));
+		}
+	}
+	if (state->has_focused_workspace) {
+		const struct wsf_niri_workspace *workspace =
+			wsf_niri_workspace_find(state, state->focused_workspace);
+
+		if (workspace != NULL) {
+			memcpy(out_focus->output, workspace->output, sizeof(out_focus->output));
+		}
+	}
+}
+
+static void wsf_niri_report(struct wsf_niri_watch *watch, const struct wsf_niri_focus *focus) {
+	if (strcmp(focus->app_id, watch->focus.app_id) == 0 &&
+		strcmp(focus->output, watch->focus.output) == 0) {
+		return;
+	}
+
+	watch->focus = *focus;
+	wsf_debug_log(
+		watch->debug,
+		"niri: focus app_id=%s output=%s",
+		focus->app_id[0] != '\0' ? focus->app_id : "-",
+		focus->output[0] != '\0' ? focus->output : "-"
+	);
+	watch->on_focus(focus, watch->data);
+}
+
+/* The socket niri created for this process: niri.<display>.<pid>.sock. */
+static bool wsf_niri_find_socket(struct wsf_niri_watch *watch) {
+	char suffix[32];
+	struct dirent *entry = NULL;
+	size_t suffix_len = 0;
+	bool found = false;
+	DIR *dir = NULL;
+
+	if (watch->runtime_dir[0] == '\0') {
+		return false;
+	}
+	snprintf(suffix, sizeof(suffix), ".%ld.sock", (long) getpid());
+	suffix_len = strlen(suffix);
+
+	dir = opendir(watch->runtime_dir);
+	if (dir == NULL) {
+		return false;
+	}
+	while (!found && (entry = readdir(dir)) != NULL) {
+		size_t len = strlen(entry->d_name);
+		int written = 0;
+
+		if (len <= suffix_len + 5 || strncmp(entry->d_name, "niri.", 5) != 0 ||
+			strcmp(entry->d_name + len - suffix_len, suffix) != 0) {
+			continue;
+		}
+		written = snprintf(
+			watch->socket_path,
+			sizeof(watch->socket_path),
+			"%s/%s",
+			watch->runtime_dir,
+			entry->d_name
+		);
+		found = written > 0 && (size_t) written < sizeof(watch->socket_path);
+	}
+	closedir(dir);
+
+	return found;
+}
+
+static int wsf_niri_connect(struct wsf_niri_watch *watch) {
+	struct sockaddr_un addr;
+	int fd = -1;
+
+	if (!wsf_niri_find_socket(watch)) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, watch->socket_path, sizeof(addr.sun_path));
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (const struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+		send(fd, WSF_NIRI_REQUEST, strlen(WSF_NIRI_REQUEST), MSG_NOSIGNAL) !=
+			(ssize_t) strlen(WSF_NIRI_REQUEST)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static bool wsf_niri_line_grow(struct wsf_niri_watch *watch) {
+	size_t size = watch->line_size * 2;
+	char *line = NULL;
+
+	if (size > WSF_NIRI_LINE_MAX) {
+		return false;
+	}
+	line = realloc(watch->line, size);
+	if (line == NULL) {
+		return false;
+	}
+
+	watch->line = line;
+	watch->line_size = size;
+	return true;
+}
+
+/*
+ * Reads the reply to the EventStream request, then one event per line
+ * until niri closes the connection. Returns false when niri refused the
+ * request, which retrying will not change.
+ */
+static bool wsf_niri_stream(struct wsf_niri_watch *watch, int fd) {
+	struct wsf_niri_focus focus;
+	bool replied = false;
+	bool skipping = false;
+	size_t used = 0;
+
+	memset(&watch->state, 0, sizeof(watch->state));
+
+	for (;;) {
+		char *start = watch->line;
+		char *newline = NULL;
+		ssize_t len = 0;
+
+		if (used + 1 >= watch->line_size && !wsf_niri_line_grow(watch)) {
+			/* Longer than any event worth reading: drop it up to its newline. */
+			skipping = true;
+			used = 0;
+		}
+
+		len = read(fd, watch->line + used, watch->line_size - used - 1);
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			if (len < 0) {
+				wsf_debug_log(watch->debug, "niri: read failed: %s", strerror(errno));
+			}
+			return true;
+		}
+		used += (size_t) len;
+
+		while ((newline = memchr(start, '\n', used - (size_t) (start - watch->line))) != NULL) {
+			size_t line_len = (size_t) (newline - start);
+
+			*newline = '\0';
+			if (skipping) {
+				skipping = false;
+			} else if (!replied) {
+				if (strncmp(start, "{\"Ok\"", 5) != 0) {
+					wsf_debug_log(watch->debug, "niri: event stream refused: %s", start);
+					return false;
+				}
+				replied = true;
+			} else {
+				wsf_niri_event(watch, start, line_len);
+				wsf_niri_focus_current(&watch->state, &focus);
+				wsf_niri_report(watch, &focus);
+			}
+			start = newline + 1;
+		}
+
+		used -= (size_t) (start - watch->line);
+		memmove(watch->line, start, used);
+	}
+}
+
+static void *wsf_niri_thread(void *arg) {
+	struct wsf_niri_watch *watch = arg;
+	struct timespec interval = {
+		.tv_sec = WSF_NIRI_CONNECT_INTERVAL_MS / 1000,
+		.tv_nsec = (WSF_NIRI_CONNECT_INTERVAL_MS % 1000) * 1000000L,
+	};
+	int attempts = 0;
+
+	while (attempts < WSF_NIRI_CONNECT_ATTEMPTS) {
+		struct wsf_niri_focus none;
+		bool retry = true;
+		int fd = wsf_niri_connect(watch);
+
+		if (fd < 0) {
+			attempts++;
+			nanosleep(&interval, NULL);
+			continue;
+		}
+
+		attempts = 0;
+		wsf_debug_log(watch->debug, "niri: subscribed to %s", watch->socket_path);
+		retry = wsf_niri_stream(watch, fd);
+		close(fd);
+
+		/* Without the stream nothing says what has focus any more. */
+		memset(&none, 0, sizeof(none));
+		wsf_niri_report(watch, &none);
+		if (!retry) {
+			break;
+		}
+		wsf_debug_log(watch->debug, "niri: event stream closed");
+	}
+
+	if (attempts == WSF_NIRI_CONNECT_ATTEMPTS) {
+		wsf_debug_log(watch->debug, "niri: no IPC socket appeared; giving up");
+	}
+	free(watch->line);
+	free(watch);
+	return NULL;
+}
+
+bool wsf_niri_watch_start(wsf_niri_focus_fn on_focus, void *data, bool debug) {
+	struct wsf_niri_watch *watch = NULL;
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t all_signals;
+	sigset_t old_signals;
+	int written = 0;
+	int rc = 0;
+
+	if (on_focus == NULL) {
+		return false;
+	}
+	if (runtime_dir == NULL || runtime_dir[0] == '\0') {
+		wsf_debug_log(debug, "niri: XDG_RUNTIME_DIR not set; focus profiles stay off");
+		return false;
+	}
+
+	watch = calloc(1, sizeof(*watch));
+	if (watch == NULL) {
+		return false;
+	}
+	written = snprintf(watch->runtime_dir, sizeof(watch->runtime_dir), "%s", runtime_dir);
+	if (written <= 0 || (size_t) written >= sizeof(watch->runtime_dir)) {
+		free(watch);
+		return false;
+	}
+	watch->line_size = WSF_NIRI_LINE_INITIAL;
+	watch->line = malloc(watch->line_size);
+	if (watch->line == NULL) {
+		free(watch);
+		return false;
+	}
+	watch->on_focus = on_focus;
+	watch->data = data;
+	watch->debug = debug;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+	rc = pthread_create(&thread, &attr, wsf_niri_thread, watch);
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0) {
+		wsf_debug_log(debug, "niri: pthread_create failed: %s", strerror(rc));
+		free(watch->line);
+		free(watch);
+		return false;
+	}
+
+	return true;
+}
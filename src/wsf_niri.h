@@ -0,0 +1,27 @@
+#ifndef WSF_NIRI_H
+#define WSF_NIRI_H
+
+#include <stdbool.h>
+
+#include "wsf_config.h"
+
+/* What has keyboard focus in niri; empty strings for nothing/unknown. */
+struct wsf_niri_focus {
+	char app_id[WSF_FOCUS_NAME_MAX];
+	char output[WSF_FOCUS_NAME_MAX];
+};
+
+typedef void (*wsf_niri_focus_fn)(const struct wsf_niri_focus *focus, void *data);
+
+/*
+ * Starts a detached background thread that subscribes to the IPC event
+ * stream of the niri instance running in this process, i.e. the socket it
+ * announces as $NIRI_SOCKET ($XDG_RUNTIME_DIR/niri.<display>.<pid>.sock).
+ * The socket does not exist yet while niri starts up; the thread waits for
+ * it. on_focus runs on that thread whenever the focused window's app_id or
+ * the focused output changes, and with both empty once the stream ends.
+ * The thread blocks all signals, like the config watcher.
+ */
+bool wsf_niri_watch_start(wsf_niri_focus_fn on_focus, void *data, bool debug);
+
+#endif
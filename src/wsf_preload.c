@@ -1,8 +1,12 @@
 #define _GNU_SOURCE
 
 #include <dlfcn.h>
+#include <errno.h>
 #include <math.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -16,8 +20,18 @@
 #endif
 
 #include "wsf_config.h"
+#include "wsf_curve.h"
+#include "wsf_engine.h"
+#include "wsf_fastmath.h"
 #include "wsf_proc.h"
-
+#include "wsf_shm.h"
+#include "wsf_stats.h"
+#include "wsf_trace.h"
+#include "wsf_niri.h"
+#include "wsf_watch.h"
+
+struct libinput;
+struct libinput_device;
 struct libinput_event;
 struct libinput_event_pointer;
 struct libinput_event_gesture;
@@ -39,22 +53,220 @@ typedef struct libinput_event *(*wsf_base_event_fn)(struct libinput_event_pointe
 typedef wsf_event_type_t (*wsf_event_type_fn)(struct libinput_event *);
 typedef uint64_t (*wsf_pointer_time_usec_fn)(struct libinput_event_pointer *);
 typedef uint32_t (*wsf_pointer_time_fn)(struct libinput_event_pointer *);
+typedef void (*wsf_event_destroy_fn)(struct libinput_event *);
+typedef struct libinput_device *(*wsf_event_device_fn)(struct libinput_event *);
+typedef struct libinput_event *(*wsf_get_event_fn)(struct libinput *);
+typedef struct libinput_event_pointer *(*wsf_pointer_event_fn)(struct libinput_event *);
+typedef int (*wsf_has_axis_fn)(struct libinput_event_pointer *, wsf_axis_t);
+typedef wsf_event_type_t (*wsf_next_event_type_fn)(struct libinput *);
+typedef const char *(*wsf_device_name_fn)(struct libinput_device *);
+typedef unsigned int (*wsf_device_id_fn)(struct libinput_device *);
+typedef struct libinput_event *(*wsf_gesture_base_event_fn)(struct libinput_event_gesture *);
+
+#define WSF_LIKELY(x) __builtin_expect(!!(x), 1)
+#define WSF_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define WSF_CACHE_LINE 64
+
+/*
+ * A snapshot is filled in a free slot of wsf_factor_snapshots and
+ * wsf_state.factors is swapped to it; hooks take a single acquire load
+ * and never lock. Snapshots are built, and the trace and stats mappings
+ * opened, by the threads that change factors (the config watcher, the
+ * control block watcher and the niri IPC thread), serialized on
+ * snapshot_lock. libinput is not thread-safe, so niri calls every hook
+ * from its input thread; when that thread finds a new pointer it records
+ * it in factors_seen, and publishers never refill that slot or the
+ * published one. No hook keeps a snapshot pointer past its return.
+ *
+ * With the shared control block available, the block is the source of
+ * truth: the config watcher and `wsf set --live` write it, and the control
+ * block watcher, woken by the write, turns the new generation into a
+ * snapshot. Without it the config watcher publishes directly.
+ *
+ * trace and stats point at the trace ring and the overhead counters while
+ * they are switched on and are NULL otherwise, so each costs a hook a
+ * single branch when it is off.
+ *
+ * Devices matching a [device] profile use its factors instead of the
+ * global ones. scroll_identity says an axis is 1.0 for every device, which
+ * lets the getters skip the event cache as they do without profiles.
+ */
+#define WSF_FACTOR_SNAPSHOT_SLOTS 4
+
+struct wsf_factor_snapshot {
+	double scroll_factor[2];
+	double pinch_zoom_factor;
+	double pinch_rotate_factor;
+	struct wsf_scroll_curve_params curve;
+	struct wsf_trace_ring *trace;
+	struct wsf_stats_block *stats;
+	uint32_t generation;
+	uint32_t device_profile_count;
+	bool scroll_identity[2];
+	struct wsf_curve_table curve_table;
+	struct wsf_device_profile device_profiles[WSF_DEVICE_PROFILE_MAX];
+};
+
+/*
+ * Velocity state per libinput_device, so a touchpad and a trackpad used
+ * together do not feed one EMA. Open addressing with linear probing over a
+ * fixed table; an entry is dropped when its device's DEVICE_REMOVED event
+ * is destroyed. Events without a device, or arriving while every slot is
+ * taken, share wsf_device_overflow.
+ *
+ * profile is the matching [device] profile plus one (0: global factors),
+ * resolved on the device's first event under each factor snapshot
+ * generation, so string matching never runs per event.
+ */
+#define WSF_DEVICE_TABLE_BITS 4
+#define WSF_DEVICE_TABLE_SIZE (1u << WSF_DEVICE_TABLE_BITS)
+
+struct wsf_device_state {
+	struct libinput_device *device;
+	uint32_t profile_generation;
+	uint32_t profile;
+	struct wsf_scroll_axis_state axis[2];
+};
+
+/*
+ * The compositor may query several getters (and the same getter several
+ * times) for one scroll event. Each event is classified and advances the
+ * velocity state once; later queries are served from this cache until
+ * libinput_event_destroy() drops the entry. One entry fills one cache line.
+ */
+#define WSF_EVENT_CACHE_SIZE 8
+
+enum wsf_scroll_getter {
+	WSF_SCROLL_GETTER_SCROLL_VALUE = 0,
+	WSF_SCROLL_GETTER_SCROLL_VALUE_V120,
+	WSF_SCROLL_GETTER_AXIS_VALUE,
+	WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE,
+	WSF_SCROLL_GETTER_COUNT
+};
+
+struct wsf_event_cache_entry {
+	_Alignas(WSF_CACHE_LINE) struct libinput_event_pointer *event;
+	struct libinput_event *base;
+	double multiplier;
+	double values[WSF_SCROLL_GETTER_COUNT];
+	wsf_axis_t axis;
+	bool should_scale;
+	bool has_multiplier;
+	uint8_t value_mask;
+	uint8_t source;
+};
 
-#define WSF_SCROLL_CURVE_MIN_MULTIPLIER 0.70
-#define WSF_SCROLL_CURVE_MAX_MULTIPLIER 1.65
-#define WSF_SCROLL_CURVE_VELOCITY_LOW 80.0
-#define WSF_SCROLL_CURVE_VELOCITY_HIGH 2000.0
-#define WSF_SCROLL_CURVE_SMOOTHING 0.35
-#define WSF_SCROLL_CURVE_RESET_GAP_US 120000ULL
-#define WSF_SCROLL_CURVE_FALLBACK_DT_US 8000.0
-
-struct wsf_scroll_axis_state {
-	double velocity;
-	uint64_t last_time_us;
-	bool has_velocity;
-	bool has_last_time;
+_Static_assert(
+	sizeof(struct wsf_event_cache_entry) == WSF_CACHE_LINE,
+	"event cache entry must fill exactly one cache line"
+);
+
+/*
+ * Fetch mode (WSF_FETCH=1) also interposes libinput_get_event(): scroll
+ * events are classified and scaled into the event cache as they are
+ * dequeued, so velocity follows queue order and the getters only look the
+ * result up. Gestures carry no state that depends on order, so their
+ * getters scale them as in the default mode.
+ */
+
+/*
+ * Coalescing (WSF_COALESCE=1, implies fetch mode) folds a scroll backlog
+ * into one event. When the event just dequeued is a finger or continuous
+ * scroll and more of the same are already queued, those are dequeued too;
+ * each still advances the velocity state with its own timestamp, and the
+ * newest one is handed out carrying the summed scaled deltas. Only the
+ * stream niri reads (scroll_* or legacy axis events, learned from its
+ * getter calls) is merged; the other stream's copies inside a run are
+ * dropped. A scroll stop (an axis reporting 0) or a change of device,
+ * source or axis set ends a run; that event is held back for the next
+ * libinput_get_event(), and libinput_next_event_type() reports it.
+ */
+#define WSF_COALESCE_MAX_EVENTS 64
+
+struct wsf_coalesce_run {
+	struct libinput_device *device;
+	wsf_event_type_t type;
+	uint8_t source;
+	uint8_t axis_mask;
+	double sum[2];
 };
 
+/* One bit per resolved symbol, used to log a missing symbol only once. */
+enum wsf_missing_symbol {
+	WSF_MISSING_SCROLL_VALUE = 1u << WSF_SCROLL_GETTER_SCROLL_VALUE,
+	WSF_MISSING_SCROLL_VALUE_V120 = 1u << WSF_SCROLL_GETTER_SCROLL_VALUE_V120,
+	WSF_MISSING_AXIS_VALUE = 1u << WSF_SCROLL_GETTER_AXIS_VALUE,
+	WSF_MISSING_AXIS_VALUE_DISCRETE = 1u << WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE,
+	WSF_MISSING_AXIS_SOURCE = 1u << 4,
+	WSF_MISSING_GESTURE_SCALE = 1u << 5,
+	WSF_MISSING_GESTURE_ANGLE = 1u << 6,
+	WSF_MISSING_POINTER_TIME = 1u << 7,
+	WSF_MISSING_POINTER_TIME_USEC = 1u << 8,
+	WSF_MISSING_EVENT_DESTROY = 1u << 9,
+	WSF_MISSING_SHM_VALUES = 1u << 10,
+	WSF_MISSING_EVENT_DEVICE = 1u << 11,
+	WSF_MISSING_GET_EVENT = 1u << 12,
+	WSF_MISSING_NEXT_EVENT_TYPE = 1u << 13
+};
+
+/* Which getter families niri has called; see wsf_fetch_scroll_getter(). */
+#define WSF_SCROLL_API_MODERN \
+	((1u << WSF_SCROLL_GETTER_SCROLL_VALUE) | (1u << WSF_SCROLL_GETTER_SCROLL_VALUE_V120))
+#define WSF_SCROLL_API_LEGACY \
+	((1u << WSF_SCROLL_GETTER_AXIS_VALUE) | (1u << WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE))
+
+/*
+ * Everything the hooks read, resolved once by wsf_init_internal() and never
+ * written afterwards except for the device count, scroll_api and the two
+ * snapshot pointers. The first line holds what every scroll query needs,
+ * including its only check for new factors: one acquire load of factors
+ * compared with factors_seen, which only the input thread writes. The
+ * control block and the publishers' lock live outside this struct, so the
+ * hooks never load a line another process or thread writes per update. The
+ * second line holds the velocity state lookup and the remaining scroll
+ * getters; gesture and teardown hooks come last.
+ */
+struct wsf_hot_state {
+	_Alignas(WSF_CACHE_LINE) bool active;
+	bool debug;
+	bool init_done;
+	bool fetch;
+	_Atomic(const struct wsf_factor_snapshot *) factors;
+	_Atomic(const struct wsf_factor_snapshot *) factors_seen;
+	wsf_scroll_value_fn scroll_value;
+	wsf_base_event_fn base_event;
+	wsf_event_type_fn event_type;
+	wsf_axis_source_fn axis_source;
+	wsf_pointer_time_usec_fn pointer_time_usec;
+
+	_Alignas(WSF_CACHE_LINE) wsf_event_device_fn event_device;
+	unsigned int device_count;
+	uint8_t scroll_api;
+	bool coalesce;
+	wsf_scroll_value_fn scroll_value_v120;
+	wsf_scroll_value_fn axis_value;
+
+	_Alignas(WSF_CACHE_LINE) wsf_scroll_value_fn axis_value_discrete;
+	unsigned int logged_missing;
+	wsf_pointer_time_fn pointer_time;
+	wsf_event_destroy_fn event_destroy;
+	wsf_gesture_value_fn gesture_scale;
+	wsf_gesture_value_fn gesture_angle_delta;
+	wsf_get_event_fn get_event;
+	wsf_pointer_event_fn pointer_event;
+	wsf_has_axis_fn has_axis;
+	wsf_next_event_type_fn next_event_type;
+	wsf_device_name_fn device_name;
+	wsf_device_id_fn device_vendor;
+	wsf_device_id_fn device_product;
+	wsf_gesture_base_event_fn gesture_base_event;
+};
+
+_Static_assert(
+	offsetof(struct wsf_hot_state, event_device) == WSF_CACHE_LINE,
+	"scroll query fields must fit the first cache line"
+);
+
 #if defined(WSF_HAVE_LIBINPUT_HEADERS) && defined(LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)
 #define WSF_AXIS_SCROLL_VERTICAL LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL
 #define WSF_AXIS_SCROLL_HORIZONTAL LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL
@@ -87,40 +299,83 @@ struct wsf_scroll_axis_state {
 #define WSF_EVENT_POINTER_SCROLL_CONTINUOUS 406
 #endif
 
-static wsf_scroll_value_fn wsf_real_scroll_value = NULL;
-static wsf_scroll_value_fn wsf_real_scroll_value_v120 = NULL;
-static wsf_scroll_value_fn wsf_real_axis_value = NULL;
-static wsf_scroll_value_fn wsf_real_axis_value_discrete = NULL;
-static wsf_axis_source_fn wsf_real_axis_source = NULL;
-static wsf_gesture_value_fn wsf_real_gesture_scale = NULL;
-static wsf_gesture_value_fn wsf_real_gesture_angle_delta = NULL;
-static wsf_base_event_fn wsf_real_base_event = NULL;
-static wsf_event_type_fn wsf_real_event_type = NULL;
-static wsf_pointer_time_usec_fn wsf_real_pointer_time_usec = NULL;
-static wsf_pointer_time_fn wsf_real_pointer_time = NULL;
-
-static bool wsf_debug = false;
-static bool wsf_active = false;
-static double wsf_scroll_vertical_factor = WSF_FACTOR_DEFAULT;
-static double wsf_scroll_horizontal_factor = WSF_FACTOR_DEFAULT;
-static double wsf_pinch_zoom_factor = WSF_FACTOR_DEFAULT;
-static double wsf_pinch_rotate_factor = WSF_FACTOR_DEFAULT;
-static bool wsf_init_done = false;
-static bool wsf_logged_missing_scroll = false;
-static bool wsf_logged_missing_scroll_v120 = false;
-static bool wsf_logged_missing_axis_value = false;
-static bool wsf_logged_missing_axis_value_discrete = false;
-static bool wsf_logged_missing_axis_source = false;
-static bool wsf_logged_missing_gesture_scale = false;
-static bool wsf_logged_missing_gesture_angle = false;
-static bool wsf_logged_missing_pointer_time = false;
-static bool wsf_logged_missing_pointer_time_usec = false;
-
-static struct wsf_scroll_axis_state wsf_vertical_scroll_state = {0};
-static struct wsf_scroll_axis_state wsf_horizontal_scroll_state = {0};
+#if defined(WSF_HAVE_LIBINPUT_HEADERS)
+#define WSF_EVENT_DEVICE_REMOVED LIBINPUT_EVENT_DEVICE_REMOVED
+#else
+#define WSF_EVENT_DEVICE_REMOVED 2
+#endif
+
+static const char *const wsf_scroll_getter_missing[WSF_SCROLL_GETTER_COUNT] = {
+	[WSF_SCROLL_GETTER_SCROLL_VALUE] =
+		"scroll_value symbol missing; returning 0",
+	[WSF_SCROLL_GETTER_SCROLL_VALUE_V120] =
+		"scroll_value_v120 symbol missing; returning 0",
+	[WSF_SCROLL_GETTER_AXIS_VALUE] =
+		"axis_value symbol missing; returning 0",
+	[WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE] =
+		"axis_value_discrete symbol missing; returning 0",
+};
+
+/* curve_table is compiled in wsf_init_internal before any hook can read it. */
+static struct wsf_factor_snapshot wsf_default_factors = {
+	.scroll_factor = { WSF_FACTOR_DEFAULT, WSF_FACTOR_DEFAULT },
+	.scroll_identity = { true, true },
+	.pinch_zoom_factor = WSF_FACTOR_DEFAULT,
+	.pinch_rotate_factor = WSF_FACTOR_DEFAULT,
+	.curve = {
+		.min_multiplier = WSF_SCROLL_CURVE_MIN_MULTIPLIER,
+		.max_multiplier = WSF_SCROLL_CURVE_MAX_MULTIPLIER,
+		.velocity_low = WSF_SCROLL_CURVE_VELOCITY_LOW,
+		.velocity_high = WSF_SCROLL_CURVE_VELOCITY_HIGH,
+		.smoothing = WSF_SCROLL_CURVE_SMOOTHING,
+		.reset_gap_us = WSF_SCROLL_CURVE_RESET_GAP_US,
+	},
+};
+
+static struct wsf_hot_state wsf_state = {
+	.factors = &wsf_default_factors,
+	.factors_seen = &wsf_default_factors,
+};
+
+/* Publisher-side state; hooks never touch it. */
+static atomic_flag wsf_snapshot_lock = ATOMIC_FLAG_INIT;
+static struct wsf_shm_block *wsf_control_block = NULL;
+static struct wsf_factor_snapshot wsf_factor_snapshots[WSF_FACTOR_SNAPSHOT_SLOTS];
+static unsigned int wsf_factor_snapshot_next = 0;
+static uint32_t wsf_factor_generation = 0;
+static bool wsf_fastmath_ready = false;
+static struct wsf_trace_ring *wsf_trace_ring = NULL;
+static struct wsf_stats_block *wsf_stats_block = NULL;
+
+static struct wsf_device_state wsf_device_table[WSF_DEVICE_TABLE_SIZE];
+static struct wsf_device_state wsf_device_overflow;
+
+static struct wsf_event_cache_entry wsf_event_cache[WSF_EVENT_CACHE_SIZE];
+static unsigned int wsf_event_cache_next = 0;
+static unsigned int wsf_event_cache_used = 0;
+static struct libinput *wsf_held_libinput = NULL;
+static struct libinput_event *wsf_held_event = NULL;
+
+/*
+ * [app] and [output] profiles switch with niri's keyboard focus. The IPC
+ * thread (wsf_niri.c) reports focus changes; wsf_published_values keeps
+ * the last values published before focus profiles were applied, so a
+ * focus change republishes them with the new profile. All of it is only
+ * touched with snapshot_lock held. wsf_focus_applied caches the matched
+ * [app] and [output] profile (-1: none) to skip focus changes between
+ * windows that resolve to the same factors.
+ */
+static struct wsf_shm_values wsf_published_values;
+static bool wsf_published_valid = false;
+static struct wsf_niri_focus wsf_focus;
+static int wsf_focus_applied[2] = { -1, -1 };
+static atomic_flag wsf_focus_started = ATOMIC_FLAG_INIT;
+
+/* Config generation last applied without a control block; see wsf_reload_factors. */
+static uint64_t wsf_applied_generation = 0;
 
 static void wsf_debug_log(const char *fmt, ...) {
-	if (!wsf_debug) {
+	if (!wsf_state.debug) {
 		return;
 	}
 
@@ -133,6 +388,18 @@ static void wsf_debug_log(const char *fmt, ...) {
 	va_end(args);
 }
 
+__attribute__((cold, noinline)) static void wsf_log_missing(
+	unsigned int bit,
+	const char *message
+) {
+	if (!wsf_state.debug || (wsf_state.logged_missing & bit) != 0) {
+		return;
+	}
+
+	wsf_debug_log("%s", message);
+	wsf_state.logged_missing |= bit;
+}
+
 static void *wsf_load_symbol(const char *name) {
 	const char *error = NULL;
 	void *symbol = NULL;
@@ -149,179 +416,576 @@ static void *wsf_load_symbol(const char *name) {
 	return symbol;
 }
 
-static void wsf_init_internal(void) {
+/* A focus profile's factor keys replace the global ones they set. */
+static void wsf_focus_override(
+	struct wsf_shm_values *values,
+	const struct wsf_focus_profile *profile
+) {
+	static const uint32_t bits[] = {
+		WSF_DEVICE_KEY_SCROLL_VERTICAL,
+		WSF_DEVICE_KEY_SCROLL_HORIZONTAL,
+		WSF_DEVICE_KEY_PINCH_ZOOM,
+		WSF_DEVICE_KEY_PINCH_ROTATE,
+	};
+	double *globals[] = {
+		&values->scroll_vertical,
+		&values->scroll_horizontal,
+		&values->pinch_zoom,
+		&values->pinch_rotate,
+	};
+	const double *factors = &profile->scroll_vertical;
+	uint32_t i = 0;
+	uint32_t d = 0;
+
+	for (i = 0; i < 4; i++) {
+		if ((profile->keys & bits[i]) == 0) {
+			continue;
+		}
+		*globals[i] = factors[i];
+		/* Device profile keys that follow the globals follow them here too. */
+		for (d = 0; d < values->device_profile_count; d++) {
+			struct wsf_device_profile *device = &values->device_profiles[d];
+
+			if ((device->keys & bits[i]) == 0) {
+				(&device->scroll_vertical)[i] = factors[i];
+			}
+		}
+	}
+}
+
+static void wsf_focus_match(const struct wsf_shm_values *values, int *out_app, int *out_output) {
+	*out_app = wsf_focus_profile_match(
+		values->focus_profiles,
+		values->focus_profile_count,
+		WSF_FOCUS_MATCH_APP,
+		wsf_focus.app_id
+	);
+	*out_output = wsf_focus_profile_match(
+		values->focus_profiles,
+		values->focus_profile_count,
+		WSF_FOCUS_MATCH_OUTPUT,
+		wsf_focus.output
+	);
+}
+
+/*
+ * Returns values with the profiles of the focused output and then the
+ * focused app applied (the app wins), using out as scratch space.
+ */
+static const struct wsf_shm_values *wsf_focus_apply(
+	struct wsf_shm_values *out,
+	const struct wsf_shm_values *values
+) {
+	int app = -1;
+	int output = -1;
+
+	wsf_focus_match(values, &app, &output);
+	wsf_focus_applied[0] = app;
+	wsf_focus_applied[1] = output;
+	if (app < 0 && output < 0) {
+		return values;
+	}
+
+	*out = *values;
+	if (output >= 0) {
+		wsf_focus_override(out, &values->focus_profiles[output]);
+	}
+	if (app >= 0) {
+		wsf_focus_override(out, &values->focus_profiles[app]);
+	}
+	return out;
+}
+
+/* Builds and swaps in a snapshot; the caller holds snapshot_lock. */
+static void wsf_publish_locked(const struct wsf_shm_values *source) {
+	const struct wsf_factor_snapshot *published = NULL;
+	const struct wsf_factor_snapshot *seen = NULL;
+	struct wsf_factor_snapshot *snapshot = NULL;
+	struct wsf_shm_values focused;
+	const struct wsf_shm_values *values = NULL;
+	bool pinch_zoom = false;
+	uint32_t i = 0;
+
+	if (source != &wsf_published_values) {
+		wsf_published_values = *source;
+		wsf_published_valid = true;
+	}
+	values = wsf_focus_apply(&focused, source);
+	pinch_zoom = values->pinch_zoom != 1.0;
+
+	/*
+	 * The pow tables are only needed once a non-unity pinch factor is
+	 * published; the release store below orders them before any reader.
+	 */
+	for (i = 0; i < values->device_profile_count; i++) {
+		pinch_zoom = pinch_zoom || values->device_profiles[i].pinch_zoom != 1.0;
+	}
+	if (pinch_zoom && !wsf_fastmath_ready) {
+		wsf_fastmath_init();
+		wsf_fastmath_ready = true;
+	}
+
+	/* Both mappings outlive being switched off; they are never unmapped. */
+	if (values->trace != 0 && wsf_trace_ring == NULL) {
+		wsf_trace_ring = wsf_trace_open(true, wsf_state.debug);
+	}
+	if (values->stats != 0 && wsf_stats_block == NULL) {
+		wsf_stats_block = wsf_stats_open(true, wsf_state.debug);
+	}
+
+	/* Pairs with wsf_factors_adopt(); see the comment on the snapshots. */
+	published = atomic_load_explicit(&wsf_state.factors, memory_order_seq_cst);
+	seen = atomic_load_explicit(&wsf_state.factors_seen, memory_order_seq_cst);
+	do {
+		snapshot = &wsf_factor_snapshots[wsf_factor_snapshot_next];
+		wsf_factor_snapshot_next =
+			(wsf_factor_snapshot_next + 1) % WSF_FACTOR_SNAPSHOT_SLOTS;
+	} while (snapshot == published || snapshot == seen);
+	snapshot->scroll_factor[0] = values->scroll_vertical;
+	snapshot->scroll_factor[1] = values->scroll_horizontal;
+	snapshot->pinch_zoom_factor = values->pinch_zoom;
+	snapshot->pinch_rotate_factor = values->pinch_rotate;
+	snapshot->curve = values->curve;
+	snapshot->trace = values->trace != 0 ? wsf_trace_ring : NULL;
+	snapshot->stats = values->stats != 0 ? wsf_stats_block : NULL;
+	/* A focus change keeps the device profile list, so devices keep theirs. */
+	if (source != &wsf_published_values) {
+		wsf_factor_generation++;
+	}
+	snapshot->generation = wsf_factor_generation;
+	snapshot->device_profile_count = values->device_profile_count;
+	memcpy(
+		snapshot->device_profiles,
+		values->device_profiles,
+		sizeof(snapshot->device_profiles)
+	);
+	snapshot->scroll_identity[0] = values->scroll_vertical == 1.0;
+	snapshot->scroll_identity[1] = values->scroll_horizontal == 1.0;
+	for (i = 0; i < values->device_profile_count; i++) {
+		snapshot->scroll_identity[0] = snapshot->scroll_identity[0] &&
+			values->device_profiles[i].scroll_vertical == 1.0;
+		snapshot->scroll_identity[1] = snapshot->scroll_identity[1] &&
+			values->device_profiles[i].scroll_horizontal == 1.0;
+	}
+	wsf_curve_compile(&snapshot->curve_table, &values->curve);
+	atomic_store_explicit(&wsf_state.factors, snapshot, memory_order_seq_cst);
+}
+
+/* Waits for snapshot_lock; only the threads that publish take it. */
+static void wsf_snapshot_lock_wait(void) {
+	while (atomic_flag_test_and_set_explicit(&wsf_snapshot_lock, memory_order_acquire)) {
+		sched_yield();
+	}
+}
+
+static void wsf_publish_factors(const struct wsf_shm_values *values) {
+	wsf_snapshot_lock_wait();
+	wsf_publish_locked(values);
+	atomic_flag_clear_explicit(&wsf_snapshot_lock, memory_order_release);
+}
+
+/*
+ * Runs on the niri IPC thread. It waits for the lock, as a lost focus
+ * change would leave the wrong profile in place until the next one.
+ */
+static void wsf_focus_changed(const struct wsf_niri_focus *focus, void *data) {
+	int app = -1;
+	int output = -1;
+
+	(void) data;
+	wsf_snapshot_lock_wait();
+
+	wsf_focus = *focus;
+	if (wsf_published_valid) {
+		wsf_focus_match(&wsf_published_values, &app, &output);
+		if (app != wsf_focus_applied[0] || output != wsf_focus_applied[1]) {
+			wsf_publish_locked(&wsf_published_values);
+			wsf_debug_log(
+				"focus: app_id=%s output=%s app_profile=%d output_profile=%d",
+				focus->app_id[0] != '\0' ? focus->app_id : "-",
+				focus->output[0] != '\0' ? focus->output : "-",
+				app + 1,
+				output + 1
+			);
+		}
+	}
+
+	atomic_flag_clear_explicit(&wsf_snapshot_lock, memory_order_release);
+}
+
+/* The IPC thread starts with the first config that has a focus profile. */
+static void wsf_focus_start(uint32_t focus_profile_count) {
+	if (focus_profile_count == 0 ||
+		atomic_flag_test_and_set_explicit(&wsf_focus_started, memory_order_relaxed)) {
+		return;
+	}
+
+	if (!wsf_niri_watch_start(wsf_focus_changed, NULL, wsf_state.debug)) {
+		atomic_flag_clear_explicit(&wsf_focus_started, memory_order_relaxed);
+	}
+}
+
+/*
+ * Runs on the control block watcher after each completed write (and once
+ * at init). Values that fail validation keep the previous snapshot.
+ */
+static void wsf_shm_changed(void *data) {
+	struct wsf_shm_values values;
+
+	(void) data;
+	if (!wsf_shm_read(wsf_control_block, &values)) {
+		return;
+	}
+	if (!wsf_shm_values_valid(&values)) {
+		wsf_log_missing(
+			WSF_MISSING_SHM_VALUES,
+			"shm: control block holds out-of-range values; ignoring"
+		);
+		return;
+	}
+	wsf_publish_factors(&values);
+}
+
+/*
+ * Runs on the input thread when the published pointer has moved: it
+ * records the new snapshot as in use, which keeps publishers off its
+ * slot, then checks that it was not replaced before the record landed.
+ */
+__attribute__((noinline)) static const struct wsf_factor_snapshot *wsf_factors_adopt(
+	const struct wsf_factor_snapshot *snapshot
+) {
+	const struct wsf_factor_snapshot *current = NULL;
+
+	for (;;) {
+		atomic_store_explicit(&wsf_state.factors_seen, snapshot, memory_order_seq_cst);
+		current = atomic_load_explicit(&wsf_state.factors, memory_order_seq_cst);
+		if (current == snapshot) {
+			return snapshot;
+		}
+		snapshot = current;
+	}
+}
+
+static inline const struct wsf_factor_snapshot *wsf_factors(void) {
+	const struct wsf_factor_snapshot *snapshot =
+		atomic_load_explicit(&wsf_state.factors, memory_order_acquire);
+
+	if (WSF_UNLIKELY(
+		snapshot != atomic_load_explicit(&wsf_state.factors_seen, memory_order_relaxed)
+	)) {
+		return wsf_factors_adopt(snapshot);
+	}
+
+	return snapshot;
+}
+
+/*
+ * Tracing and stats are toggled through the control block; reloads keep
+ * them. Runs on the config watcher thread, so it reads the published
+ * values under snapshot_lock rather than a snapshot that may be refilled.
+ */
+static void wsf_current_switches(struct wsf_shm_values *out_values) {
+	if (wsf_control_block != NULL && wsf_shm_read(wsf_control_block, out_values)) {
+		return;
+	}
+
+	wsf_snapshot_lock_wait();
+	if (wsf_published_valid) {
+		out_values->trace = wsf_published_values.trace;
+		out_values->stats = wsf_published_values.stats;
+	}
+	atomic_flag_clear_explicit(&wsf_snapshot_lock, memory_order_release);
+	out_values->config_generation = wsf_applied_generation;
+}
+
+static void wsf_apply_factors(
+	const struct wsf_effective_factors *factors,
+	bool trace,
+	bool stats
+) {
+	struct wsf_shm_values values;
+
+	wsf_shm_values_from_factors(&values, factors);
+	values.trace = trace ? 1u : 0u;
+	values.stats = stats ? 1u : 0u;
+	wsf_applied_generation = factors->generation;
+	/* The control block watcher publishes what lands in the block. */
+	if (wsf_control_block != NULL && wsf_shm_write(wsf_control_block, &values)) {
+		return;
+	}
+	wsf_publish_factors(&values);
+}
+
+/*
+ * A config that fails to parse keeps the previous factors. A removed
+ * config is a legitimate reset to defaults. A generation already in
+ * effect (`wsf set --live` pushed it right after writing the file) is not
+ * published again.
+ */
+static void wsf_reload_factors(void *data) {
 	struct wsf_effective_factors factors;
-	char proc_name[128] = "unknown";
+	struct wsf_shm_values current;
+	int status = wsf_effective_factors(&factors, wsf_state.debug);
 
-	if (wsf_init_done) {
+	(void) data;
+	if (status == WSF_CONFIG_INVALID || status == WSF_CONFIG_ERROR) {
+		wsf_debug_log("reload: config unusable; keeping previous factors");
 		return;
 	}
 
-	wsf_debug = wsf_debug_enabled();
-	if (wsf_effective_factors(&factors, wsf_debug) == WSF_CONFIG_ERROR) {
-		factors.scroll_vertical = WSF_FACTOR_DEFAULT;
-		factors.scroll_horizontal = WSF_FACTOR_DEFAULT;
-		factors.pinch_zoom = WSF_FACTOR_DEFAULT;
-		factors.pinch_rotate = WSF_FACTOR_DEFAULT;
+	memset(&current, 0, sizeof(current));
+	wsf_current_switches(&current);
+	if (factors.generation != 0 && factors.generation == current.config_generation) {
+		wsf_debug_log(
+			"reload: config generation %llu already applied",
+			(unsigned long long) factors.generation
+		);
+		wsf_focus_start(factors.focus_profile_count);
+		return;
 	}
-	wsf_scroll_vertical_factor = factors.scroll_vertical;
-	wsf_scroll_horizontal_factor = factors.scroll_horizontal;
-	wsf_pinch_zoom_factor = factors.pinch_zoom;
-	wsf_pinch_rotate_factor = factors.pinch_rotate;
-	wsf_active = wsf_proc_is_target("niri");
-	wsf_real_scroll_value =
+	wsf_apply_factors(&factors, current.trace != 0, current.stats != 0);
+	wsf_focus_start(factors.focus_profile_count);
+	wsf_debug_log(
+		"reload: generation=%llu scroll_vertical=%.4f scroll_horizontal=%.4f pinch_zoom=%.4f pinch_rotate=%.4f",
+		(unsigned long long) factors.generation,
+		factors.scroll_vertical,
+		factors.scroll_horizontal,
+		factors.pinch_zoom,
+		factors.pinch_rotate
+	);
+}
+
+static void wsf_load_symbols(void) {
+	wsf_state.scroll_value =
 		(wsf_scroll_value_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_scroll_value"
 		);
-	wsf_real_scroll_value_v120 =
+	wsf_state.scroll_value_v120 =
 		(wsf_scroll_value_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_scroll_value_v120"
 		);
-	wsf_real_axis_value =
+	wsf_state.axis_value =
 		(wsf_scroll_value_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_axis_value"
 		);
-	wsf_real_axis_value_discrete =
+	wsf_state.axis_value_discrete =
 		(wsf_scroll_value_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_axis_value_discrete"
 		);
-	wsf_real_axis_source =
+	wsf_state.axis_source =
 		(wsf_axis_source_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_axis_source"
 		);
-	wsf_real_base_event =
+	wsf_state.base_event =
 		(wsf_base_event_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_base_event"
 		);
-	wsf_real_event_type =
+	wsf_state.event_type =
 		(wsf_event_type_fn) wsf_load_symbol(
 			"libinput_event_get_type"
 		);
-	wsf_real_pointer_time_usec =
+	wsf_state.pointer_time_usec =
 		(wsf_pointer_time_usec_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_time_usec"
 		);
-	wsf_real_pointer_time =
+	wsf_state.pointer_time =
 		(wsf_pointer_time_fn) wsf_load_symbol(
 			"libinput_event_pointer_get_time"
 		);
-	wsf_real_gesture_scale =
+	wsf_state.gesture_scale =
 		(wsf_gesture_value_fn) wsf_load_symbol(
 			"libinput_event_gesture_get_scale"
 		);
-	wsf_real_gesture_angle_delta =
+	wsf_state.gesture_angle_delta =
 		(wsf_gesture_value_fn) wsf_load_symbol(
 			"libinput_event_gesture_get_angle_delta"
 		);
-
-	wsf_init_done = true;
-
-	if (wsf_proc_name(proc_name, sizeof(proc_name))) {
-		wsf_debug_log(
-			"init: process=%s active=%s scroll_vertical=%.4f scroll=%s v120=%s",
-			proc_name,
-			wsf_active ? "yes" : "no",
-			wsf_scroll_vertical_factor,
-			wsf_real_scroll_value ? "yes" : "no",
-			wsf_real_scroll_value_v120 ? "yes" : "no"
+	wsf_state.event_destroy =
+		(wsf_event_destroy_fn) wsf_load_symbol(
+			"libinput_event_destroy"
 		);
-		wsf_debug_log(
-			"init: scroll_vertical=%.4f scroll_horizontal=%.4f",
-			wsf_scroll_vertical_factor,
-			wsf_scroll_horizontal_factor
+	wsf_state.event_device =
+		(wsf_event_device_fn) wsf_load_symbol(
+			"libinput_event_get_device"
 		);
-		wsf_debug_log(
-			"init: axis_value=%s axis_discrete=%s",
-			wsf_real_axis_value ? "yes" : "no",
-			wsf_real_axis_value_discrete ? "yes" : "no"
+	wsf_state.get_event =
+		(wsf_get_event_fn) wsf_load_symbol(
+			"libinput_get_event"
 		);
-		wsf_debug_log(
-			"init: event_type=%s base_event=%s",
-			wsf_real_event_type ? "yes" : "no",
-			wsf_real_base_event ? "yes" : "no"
+	wsf_state.pointer_event =
+		(wsf_pointer_event_fn) wsf_load_symbol(
+			"libinput_event_get_pointer_event"
 		);
-		wsf_debug_log(
-			"init: axis_source=%s",
-			wsf_real_axis_source ? "yes" : "no"
+	wsf_state.has_axis =
+		(wsf_has_axis_fn) wsf_load_symbol(
+			"libinput_event_pointer_has_axis"
 		);
-		wsf_debug_log(
-			"init: gesture_scale=%s gesture_angle=%s pinch_zoom=%.4f pinch_rotate=%.4f",
-			wsf_real_gesture_scale ? "yes" : "no",
-			wsf_real_gesture_angle_delta ? "yes" : "no",
-			wsf_pinch_zoom_factor,
-			wsf_pinch_rotate_factor
-		);
-	} else {
-		wsf_debug_log(
-			"init: process=unknown active=%s scroll_vertical=%.4f scroll=%s v120=%s",
-			wsf_active ? "yes" : "no",
-			wsf_scroll_vertical_factor,
-			wsf_real_scroll_value ? "yes" : "no",
-			wsf_real_scroll_value_v120 ? "yes" : "no"
+	wsf_state.next_event_type =
+		(wsf_next_event_type_fn) wsf_load_symbol(
+			"libinput_next_event_type"
 		);
-		wsf_debug_log(
-			"init: scroll_vertical=%.4f scroll_horizontal=%.4f",
-			wsf_scroll_vertical_factor,
-			wsf_scroll_horizontal_factor
+	wsf_state.device_name =
+		(wsf_device_name_fn) wsf_load_symbol(
+			"libinput_device_get_name"
 		);
-		wsf_debug_log(
-			"init: axis_value=%s axis_discrete=%s",
-			wsf_real_axis_value ? "yes" : "no",
-			wsf_real_axis_value_discrete ? "yes" : "no"
+	wsf_state.device_vendor =
+		(wsf_device_id_fn) wsf_load_symbol(
+			"libinput_device_get_id_vendor"
 		);
-		wsf_debug_log(
-			"init: event_type=%s base_event=%s",
-			wsf_real_event_type ? "yes" : "no",
-			wsf_real_base_event ? "yes" : "no"
+	wsf_state.device_product =
+		(wsf_device_id_fn) wsf_load_symbol(
+			"libinput_device_get_id_product"
 		);
-		wsf_debug_log(
-			"init: axis_source=%s",
-			wsf_real_axis_source ? "yes" : "no"
+	wsf_state.gesture_base_event =
+		(wsf_gesture_base_event_fn) wsf_load_symbol(
+			"libinput_event_gesture_get_base_event"
 		);
+}
+
+static void wsf_init_internal(void) {
+	struct wsf_effective_factors factors;
+	const struct wsf_factor_snapshot *snapshot = NULL;
+	char proc_name[128] = "unknown";
+
+	if (wsf_state.init_done) {
+		return;
+	}
+
+	wsf_state.debug = wsf_debug_enabled();
+	wsf_state.active = wsf_proc_is_target("niri");
+	wsf_load_symbols();
+	if (!wsf_state.active) {
+		/* Pass-through only: no config, control block, curve or watcher. */
+		wsf_state.init_done = true;
 		wsf_debug_log(
-			"init: gesture_scale=%s gesture_angle=%s pinch_zoom=%.4f pinch_rotate=%.4f",
-			wsf_real_gesture_scale ? "yes" : "no",
-			wsf_real_gesture_angle_delta ? "yes" : "no",
-			wsf_pinch_zoom_factor,
-			wsf_pinch_rotate_factor
+			"init: process=%s active=no",
+			program_invocation_short_name
 		);
+		return;
 	}
-}
 
-__attribute__((constructor)) static void wsf_init(void) {
-	wsf_init_internal();
-}
+	wsf_curve_compile(&wsf_default_factors.curve_table, &wsf_default_factors.curve);
+	if (wsf_effective_factors(&factors, wsf_state.debug) == WSF_CONFIG_ERROR) {
+		factors.scroll_vertical = WSF_FACTOR_DEFAULT;
+		factors.scroll_horizontal = WSF_FACTOR_DEFAULT;
+		factors.pinch_zoom = WSF_FACTOR_DEFAULT;
+		factors.pinch_rotate = WSF_FACTOR_DEFAULT;
+		wsf_scroll_curve_params_init(&factors.curve);
+	}
+	if (wsf_shm_enabled()) {
+		wsf_control_block = wsf_shm_open(true, wsf_state.debug);
+		/* `wsf set --live` cannot see our environment; tell it to leave the reload to us. */
+		if (wsf_control_block != NULL) {
+			wsf_control_block->flags = wsf_env_overrides_present() ? WSF_SHM_FLAG_ENV_OVERRIDES : 0;
+		}
+	}
+	wsf_apply_factors(&factors, wsf_trace_enabled(), wsf_stats_enabled());
+	if (wsf_control_block != NULL) {
+		/* Publish the block as it stands; the watcher takes later writes. */
+		uint32_t seq = atomic_load_explicit(&wsf_control_block->seq, memory_order_acquire);
+
+		wsf_shm_changed(NULL);
+		if (!wsf_shm_watch_start(wsf_control_block, seq, wsf_shm_changed, NULL, wsf_state.debug)) {
+			/* Reloads then publish directly; `wsf set --live` still rewrites the file. */
+			wsf_control_block = NULL;
+		}
+	}
+	snapshot = wsf_factors();
+	wsf_state.coalesce = wsf_coalesce_enabled();
+	wsf_state.fetch = (wsf_fetch_enabled() || wsf_state.coalesce) &&
+		wsf_state.get_event != NULL && wsf_state.event_type != NULL &&
+		wsf_state.pointer_event != NULL && wsf_state.has_axis != NULL;
+	wsf_state.coalesce = wsf_state.fetch && wsf_state.coalesce &&
+		wsf_state.next_event_type != NULL && wsf_state.event_destroy != NULL;
 
-static void wsf_ensure_init(void) {
-	if (!wsf_init_done) {
-		wsf_init_internal();
+	wsf_state.init_done = true;
+
+	wsf_watch_start(wsf_config_path(), wsf_reload_factors, NULL, wsf_state.debug);
+	wsf_focus_start(factors.focus_profile_count);
+
+	if (!wsf_proc_name(proc_name, sizeof(proc_name))) {
+		snprintf(proc_name, sizeof(proc_name), "unknown");
 	}
+	wsf_debug_log(
+		"init: process=%s active=yes scroll_vertical=%.4f scroll=%s v120=%s",
+		proc_name,
+		snapshot->scroll_factor[0],
+		wsf_state.scroll_value ? "yes" : "no",
+		wsf_state.scroll_value_v120 ? "yes" : "no"
+	);
+	wsf_debug_log(
+		"init: scroll_vertical=%.4f scroll_horizontal=%.4f",
+		snapshot->scroll_factor[0],
+		snapshot->scroll_factor[1]
+	);
+	wsf_debug_log(
+		"init: axis_value=%s axis_discrete=%s",
+		wsf_state.axis_value ? "yes" : "no",
+		wsf_state.axis_value_discrete ? "yes" : "no"
+	);
+	wsf_debug_log(
+		"init: event_type=%s base_event=%s",
+		wsf_state.event_type ? "yes" : "no",
+		wsf_state.base_event ? "yes" : "no"
+	);
+	wsf_debug_log(
+		"init: axis_source=%s fetch=%s coalesce=%s",
+		wsf_state.axis_source ? "yes" : "no",
+		wsf_state.fetch ? "yes" : "no",
+		wsf_state.coalesce ? "yes" : "no"
+	);
+	wsf_debug_log(
+		"init: gesture_scale=%s gesture_angle=%s pinch_zoom=%.4f pinch_rotate=%.4f",
+		wsf_state.gesture_scale ? "yes" : "no",
+		wsf_state.gesture_angle_delta ? "yes" : "no",
+		snapshot->pinch_zoom_factor,
+		snapshot->pinch_rotate_factor
+	);
+	wsf_debug_log(
+		"init: device_profiles=%u focus_profiles=%u device_name=%s gesture_base=%s",
+		snapshot->device_profile_count,
+		factors.focus_profile_count,
+		wsf_state.device_name ? "yes" : "no",
+		wsf_state.gesture_base_event ? "yes" : "no"
+	);
 }
 
-static double wsf_clamp(double value, double min, double max) {
-	if (value < min) {
-		return min;
-	}
-	if (value > max) {
-		return max;
+/*
+ * The preload is inherited by everything the session spawns, so only the
+ * target pays for init at load time. Other processes resolve the real
+ * symbols on their first hook call, which most of them never make.
+ */
+__attribute__((constructor)) static void wsf_init(void) {
+	if (wsf_proc_is_target("niri")) {
+		wsf_init_internal();
 	}
-	return value;
 }
 
-static double wsf_scroll_factor_for_axis(wsf_axis_t axis) {
-	if (axis == WSF_AXIS_SCROLL_HORIZONTAL) {
-		return wsf_scroll_horizontal_factor;
+static inline void wsf_ensure_init(void) {
+	if (WSF_UNLIKELY(!wsf_state.init_done)) {
+		wsf_init_internal();
 	}
+}
 
-	return wsf_scroll_vertical_factor;
+static inline unsigned int wsf_axis_index(wsf_axis_t axis) {
+	return axis == WSF_AXIS_SCROLL_HORIZONTAL ? 1u : 0u;
 }
 
-static struct wsf_scroll_axis_state *wsf_scroll_state_for_axis(wsf_axis_t axis) {
-	if (axis == WSF_AXIS_SCROLL_HORIZONTAL) {
-		return &wsf_horizontal_scroll_state;
+static inline wsf_scroll_value_fn wsf_scroll_getter_fn(
+	enum wsf_scroll_getter getter
+) {
+	switch (getter) {
+	case WSF_SCROLL_GETTER_SCROLL_VALUE:
+		return wsf_state.scroll_value;
+	case WSF_SCROLL_GETTER_SCROLL_VALUE_V120:
+		return wsf_state.scroll_value_v120;
+	case WSF_SCROLL_GETTER_AXIS_VALUE:
+		return wsf_state.axis_value;
+	case WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE:
+		return wsf_state.axis_value_discrete;
+	default:
+		return NULL;
 	}
-
-	return &wsf_vertical_scroll_state;
 }
 
 static bool wsf_event_pointer_time_usec(
@@ -334,172 +998,341 @@ static bool wsf_event_pointer_time_usec(
 		return false;
 	}
 
-	if (wsf_real_pointer_time_usec == NULL) {
-		wsf_real_pointer_time_usec =
-			(wsf_pointer_time_usec_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_time_usec"
-			);
-	}
-	if (wsf_real_pointer_time_usec != NULL) {
-		time_us = wsf_real_pointer_time_usec(event);
-		if (time_us > 0) {
+	if (WSF_LIKELY(wsf_state.pointer_time_usec != NULL)) {
+		time_us = wsf_state.pointer_time_usec(event);
+		if (WSF_LIKELY(time_us > 0)) {
 			*out_time_us = time_us;
 			return true;
 		}
-		if (wsf_debug && !wsf_logged_missing_pointer_time_usec) {
-			wsf_debug_log(
-				"pointer_time_usec returned zero; falling back to ms timer"
-			);
-			wsf_logged_missing_pointer_time_usec = true;
-		}
+		wsf_log_missing(
+			WSF_MISSING_POINTER_TIME_USEC,
+			"pointer_time_usec returned zero; falling back to ms timer"
+		);
 	}
 
-	if (wsf_real_pointer_time == NULL) {
-		wsf_real_pointer_time =
-			(wsf_pointer_time_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_time"
-			);
-	}
-	if (wsf_real_pointer_time != NULL) {
-		uint32_t time_ms = wsf_real_pointer_time(event);
+	if (wsf_state.pointer_time != NULL) {
+		uint32_t time_ms = wsf_state.pointer_time(event);
 		if (time_ms > 0) {
 			*out_time_us = (uint64_t) time_ms * 1000ULL;
 			return true;
 		}
-		if (wsf_debug && !wsf_logged_missing_pointer_time) {
-			wsf_debug_log("pointer_time returned zero");
-			wsf_logged_missing_pointer_time = true;
-		}
+		wsf_log_missing(WSF_MISSING_POINTER_TIME, "pointer_time returned zero");
 	}
 
 	return false;
 }
 
-static double wsf_scroll_curve_multiplier(double velocity) {
-	double normalized = 0.0;
+static inline unsigned int wsf_device_slot(const struct libinput_device *device) {
+	uint64_t key = (uint64_t) (uintptr_t) device;
+
+	return (unsigned int) (((key >> 4) * 0x9e3779b97f4a7c15ull) >>
+		(64 - WSF_DEVICE_TABLE_BITS));
+}
+
+static struct wsf_device_state *wsf_device_state_for(struct libinput_event *base) {
+	struct libinput_device *device = NULL;
+	unsigned int slot = 0;
+	unsigned int probe = 0;
 
-	if (!isfinite(velocity) || velocity <= WSF_SCROLL_CURVE_VELOCITY_LOW) {
-		return WSF_SCROLL_CURVE_MIN_MULTIPLIER;
+	if (WSF_UNLIKELY(wsf_state.event_device == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_EVENT_DEVICE,
+			"event_get_device symbol missing; devices share scroll state"
+		);
+		return &wsf_device_overflow;
+	}
+	if (WSF_UNLIKELY(base == NULL)) {
+		return &wsf_device_overflow;
 	}
-	if (velocity >= WSF_SCROLL_CURVE_VELOCITY_HIGH) {
-		return WSF_SCROLL_CURVE_MAX_MULTIPLIER;
+
+	device = wsf_state.event_device(base);
+	if (WSF_UNLIKELY(device == NULL)) {
+		return &wsf_device_overflow;
 	}
 
-	normalized =
-		(velocity - WSF_SCROLL_CURVE_VELOCITY_LOW) /
-		(WSF_SCROLL_CURVE_VELOCITY_HIGH - WSF_SCROLL_CURVE_VELOCITY_LOW);
-	normalized = wsf_clamp(normalized, 0.0, 1.0);
-	normalized = normalized * normalized * (3.0 - (2.0 * normalized));
+	slot = wsf_device_slot(device);
+	for (probe = 0; probe < WSF_DEVICE_TABLE_SIZE; probe++) {
+		struct wsf_device_state *entry = &wsf_device_table[slot];
+
+		if (WSF_LIKELY(entry->device == device)) {
+			return entry;
+		}
+		if (entry->device == NULL) {
+			memset(entry, 0, sizeof(*entry));
+			entry->device = device;
+			wsf_state.device_count++;
+			return entry;
+		}
+		slot = (slot + 1) & (WSF_DEVICE_TABLE_SIZE - 1);
+	}
 
-	return WSF_SCROLL_CURVE_MIN_MULTIPLIER +
-		(normalized * (WSF_SCROLL_CURVE_MAX_MULTIPLIER -
-			WSF_SCROLL_CURVE_MIN_MULTIPLIER));
+	return &wsf_device_overflow;
 }
 
-static double wsf_scale_scroll_value(
-	struct libinput_event_pointer *event,
-	wsf_axis_t axis,
-	double value,
-	double base_factor
-) {
-	struct wsf_scroll_axis_state *state = wsf_scroll_state_for_axis(axis);
-	double instantaneous_velocity = 0.0;
-	double effective_factor = 1.0;
-	uint64_t time_us = 0;
+/* Backward-shift deletion keeps every remaining probe chain unbroken. */
+static void wsf_device_evict(struct libinput_device *device) {
+	unsigned int hole = wsf_device_slot(device);
+	unsigned int probe = 0;
+	unsigned int next = 0;
 
-	if (!isfinite(value)) {
-		return value;
-	}
-	if (!isfinite(base_factor) || base_factor <= 0.0) {
-		return value * base_factor;
+	for (probe = 0; probe < WSF_DEVICE_TABLE_SIZE; probe++) {
+		if (wsf_device_table[hole].device == device) {
+			break;
+		}
+		if (wsf_device_table[hole].device == NULL) {
+			return;
+		}
+		hole = (hole + 1) & (WSF_DEVICE_TABLE_SIZE - 1);
 	}
-	if (value == 0.0) {
-		return 0.0;
+	if (probe == WSF_DEVICE_TABLE_SIZE) {
+		return;
 	}
 
-	instantaneous_velocity = fabs(value) * (1000000.0 / WSF_SCROLL_CURVE_FALLBACK_DT_US);
-	if (wsf_event_pointer_time_usec(event, &time_us)) {
-		if (state->has_last_time && time_us > state->last_time_us) {
-			uint64_t delta_us = time_us - state->last_time_us;
+	next = hole;
+	for (;;) {
+		unsigned int home = 0;
+		bool stays = false;
 
-			if (delta_us > WSF_SCROLL_CURVE_RESET_GAP_US) {
-				state->has_velocity = false;
-			} else if (delta_us > 0) {
-				instantaneous_velocity =
-					fabs(value) * (1000000.0 / (double) delta_us);
-			}
+		next = (next + 1) & (WSF_DEVICE_TABLE_SIZE - 1);
+		if (wsf_device_table[next].device == NULL) {
+			break;
+		}
+
+		home = wsf_device_slot(wsf_device_table[next].device);
+		if (hole <= next) {
+			stays = hole < home && home <= next;
+		} else {
+			stays = hole < home || home <= next;
+		}
+		if (stays) {
+			continue;
 		}
 
-		state->last_time_us = time_us;
-		state->has_last_time = true;
+		wsf_device_table[hole] = wsf_device_table[next];
+		hole = next;
+	}
+
+	memset(&wsf_device_table[hole], 0, sizeof(wsf_device_table[hole]));
+	wsf_state.device_count--;
+}
+
+__attribute__((noinline)) static void wsf_device_profile_resolve(
+	const struct wsf_factor_snapshot *factors,
+	struct wsf_device_state *device
+) {
+	const char *name = NULL;
+	uint32_t vendor = 0;
+	uint32_t product = 0;
+	int index = -1;
+
+	device->profile_generation = factors->generation;
+	device->profile = 0;
+	if (device->device == NULL) {
+		return;
 	}
 
-	if (!isfinite(instantaneous_velocity)) {
-		instantaneous_velocity = 0.0;
+	if (wsf_state.device_name != NULL) {
+		name = wsf_state.device_name(device->device);
+	}
+	if (wsf_state.device_vendor != NULL) {
+		vendor = wsf_state.device_vendor(device->device);
+	}
+	if (wsf_state.device_product != NULL) {
+		product = wsf_state.device_product(device->device);
 	}
 
-	if (!state->has_velocity) {
-		state->velocity = instantaneous_velocity;
-		state->has_velocity = true;
+	index = wsf_device_profile_match(
+		factors->device_profiles,
+		factors->device_profile_count,
+		name,
+		vendor,
+		product
+	);
+	device->profile = index < 0 ? 0 : (uint32_t) index + 1;
+	if (index < 0) {
+		wsf_debug_log(
+			"profile: %s (%04x:%04x) uses the global factors",
+			name != NULL ? name : "unnamed device",
+			vendor,
+			product
+		);
 	} else {
-		state->velocity =
-			state->velocity +
-			((instantaneous_velocity - state->velocity) * WSF_SCROLL_CURVE_SMOOTHING);
+		wsf_debug_log(
+			"profile: %s (%04x:%04x) uses profile %d",
+			name != NULL ? name : "unnamed device",
+			vendor,
+			product,
+			index + 1
+		);
+	}
+}
+
+/* NULL when the event's device uses the global factors. */
+static inline const struct wsf_device_profile *wsf_device_profile_for(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event *base
+) {
+	struct wsf_device_state *device = NULL;
+
+	if (WSF_LIKELY(factors->device_profile_count == 0)) {
+		return NULL;
+	}
+
+	device = wsf_device_state_for(base);
+	if (WSF_UNLIKELY(device->profile_generation != factors->generation)) {
+		wsf_device_profile_resolve(factors, device);
+	}
+	if (device->profile == 0) {
+		return NULL;
 	}
 
-	effective_factor = base_factor * wsf_scroll_curve_multiplier(state->velocity);
-	return value * effective_factor;
+	return &factors->device_profiles[device->profile - 1];
 }
 
-static double wsf_scale_pinch_zoom(double scale) {
-	double scaled = 1.0;
+static inline double wsf_scroll_factor_for(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event *base,
+	unsigned int index
+) {
+	const struct wsf_device_profile *profile = wsf_device_profile_for(factors, base);
 
-	if (!isfinite(scale) || scale <= 0.0) {
-		return scale;
+	if (WSF_LIKELY(profile == NULL)) {
+		return factors->scroll_factor[index];
 	}
 
-	scaled = pow(scale, wsf_pinch_zoom_factor);
-	if (!isfinite(scaled) || scaled <= 0.0) {
-		return scale;
+	return index == 0 ? profile->scroll_vertical : profile->scroll_horizontal;
+}
+
+__attribute__((noinline)) static void wsf_trace_scroll(
+	struct wsf_trace_ring *ring,
+	const struct wsf_device_state *device,
+	const struct wsf_event_cache_entry *entry,
+	enum wsf_scroll_getter getter,
+	uint64_t time_us,
+	double value,
+	double velocity,
+	double multiplier
+) {
+	struct wsf_trace_entry record = {
+		.time_us = time_us,
+		.raw = value,
+		.scaled = value * multiplier,
+		.velocity = velocity,
+		.multiplier = multiplier,
+		.axis = wsf_axis_index(entry->axis),
+		.source = entry->source,
+		.getter = (uint32_t) getter,
+		.device = WSF_DEVICE_TABLE_SIZE,
+	};
+
+	if (device != &wsf_device_overflow) {
+		record.device = (uint32_t) (device - wsf_device_table);
 	}
 
-	return scaled;
+	wsf_trace_push(ring, &record);
 }
 
-static bool wsf_should_scale_scroll(
+static double wsf_scroll_event_multiplier(
+	const struct wsf_factor_snapshot *factors,
+	struct wsf_event_cache_entry *entry,
+	enum wsf_scroll_getter getter,
 	struct libinput_event_pointer *event,
-	double factor
+	wsf_axis_t axis,
+	double value,
+	double base_factor
 ) {
-	wsf_axis_source_t source = 0;
-	int type = 0;
-	struct libinput_event *base = NULL;
-
-	if (!wsf_active || factor == 1.0) {
-		return false;
+	struct wsf_device_state *device = wsf_device_state_for(entry->base);
+	struct wsf_scroll_axis_state *state = &device->axis[wsf_axis_index(axis)];
+	uint64_t time_us = 0;
+	bool has_time = wsf_event_pointer_time_usec(event, &time_us);
+	double velocity = wsf_engine_scroll_velocity(
+		&factors->curve,
+		state,
+		has_time,
+		time_us,
+		value
+	);
+	double multiplier = wsf_engine_scroll_multiplier(
+		&factors->curve_table,
+		base_factor,
+		velocity
+	);
+
+	if (WSF_UNLIKELY(factors->trace != NULL)) {
+		wsf_trace_scroll(
+			factors->trace,
+			device,
+			entry,
+			getter,
+			time_us,
+			value,
+			velocity,
+			multiplier
+		);
 	}
 
-	if (wsf_real_base_event == NULL) {
-		wsf_real_base_event =
-			(wsf_base_event_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_base_event"
-			);
+	return multiplier;
+}
+
+static double wsf_scale_scroll_value(
+	const struct wsf_factor_snapshot *factors,
+	struct wsf_event_cache_entry *entry,
+	enum wsf_scroll_getter getter,
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis,
+	double value
+) {
+	double base_factor = wsf_scroll_factor_for(factors, entry->base, wsf_axis_index(axis));
+	double trivial = 0.0;
+
+	/* Only reachable through a profile: this device's axis is left alone. */
+	if (base_factor == 1.0) {
+		entry->should_scale = false;
+		return value;
 	}
-	if (wsf_real_event_type == NULL) {
-		wsf_real_event_type =
-			(wsf_event_type_fn) wsf_load_symbol(
-				"libinput_event_get_type"
-			);
+	if (wsf_engine_scroll_trivial(value, base_factor, &trivial)) {
+		return trivial;
+	}
+
+	if (!entry->has_multiplier) {
+		entry->multiplier = wsf_scroll_event_multiplier(
+			factors,
+			entry,
+			getter,
+			event,
+			axis,
+			value,
+			base_factor
+		);
+		entry->has_multiplier = true;
 	}
 
-	if (wsf_real_base_event != NULL && wsf_real_event_type != NULL) {
-		base = wsf_real_base_event(event);
+	return value * entry->multiplier;
+}
+
+static bool wsf_should_scale_scroll(
+	struct libinput_event_pointer *event,
+	struct libinput_event **out_base,
+	uint8_t *out_source
+) {
+	wsf_axis_source_t source = 0;
+	int type = 0;
+	struct libinput_event *base = NULL;
+
+	if (WSF_LIKELY(wsf_state.base_event != NULL && wsf_state.event_type != NULL)) {
+		base = wsf_state.base_event(event);
+		*out_base = base;
 		if (base != NULL) {
-			type = wsf_real_event_type(base);
+			type = wsf_state.event_type(base);
 			if (type == WSF_EVENT_POINTER_SCROLL_WHEEL) {
 				return false;
 			}
-			if (type == WSF_EVENT_POINTER_SCROLL_FINGER ||
-				type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS) {
+			if (type == WSF_EVENT_POINTER_SCROLL_FINGER) {
+				*out_source = WSF_AXIS_SOURCE_FINGER;
+				return true;
+			}
+			if (type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS) {
+				*out_source = WSF_AXIS_SOURCE_CONTINUOUS;
 				return true;
 			}
 			if (type != WSF_EVENT_POINTER_AXIS) {
@@ -508,214 +1341,768 @@ static bool wsf_should_scale_scroll(
 		}
 	}
 
-	if (wsf_real_axis_source == NULL) {
-		wsf_real_axis_source =
-			(wsf_axis_source_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_axis_source"
-			);
+	if (WSF_UNLIKELY(wsf_state.axis_source == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_AXIS_SOURCE,
+			"axis_source symbol missing; scroll scaling disabled"
+		);
+		return false;
 	}
 
-	if (wsf_real_axis_source == NULL) {
-		if (wsf_debug && !wsf_logged_missing_axis_source) {
-			wsf_debug_log("axis_source symbol missing; scroll scaling disabled");
-			wsf_logged_missing_axis_source = true;
+	source = wsf_state.axis_source(event);
+	*out_source = (uint8_t) source;
+	return wsf_engine_scroll_source_scaled((unsigned int) source);
+}
+
+/* Newest entries first: queries for one event arrive back to back. */
+static struct wsf_event_cache_entry *wsf_event_cache_lookup(
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	unsigned int index = wsf_event_cache_next;
+	unsigned int i = 0;
+
+	for (i = 0; i < wsf_event_cache_used; i++) {
+		struct wsf_event_cache_entry *entry = NULL;
+
+		index = (index + WSF_EVENT_CACHE_SIZE - 1) % WSF_EVENT_CACHE_SIZE;
+		entry = &wsf_event_cache[index];
+		if (entry->event == event && entry->axis == axis) {
+			return entry;
 		}
-		return false;
 	}
 
-	source = wsf_real_axis_source(event);
-	if (source == WSF_AXIS_SOURCE_FINGER ||
-		source == WSF_AXIS_SOURCE_CONTINUOUS) {
-		return true;
+	return NULL;
+}
+
+/* An empty entry; the caller classifies the event. */
+static struct wsf_event_cache_entry *wsf_event_cache_claim(
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	struct wsf_event_cache_entry *entry =
+		&wsf_event_cache[wsf_event_cache_next];
+
+	wsf_event_cache_next = (wsf_event_cache_next + 1) % WSF_EVENT_CACHE_SIZE;
+	if (wsf_event_cache_used < WSF_EVENT_CACHE_SIZE) {
+		wsf_event_cache_used++;
 	}
 
-	return false;
+	memset(entry, 0, sizeof(*entry));
+	entry->event = event;
+	entry->axis = axis;
+	return entry;
 }
 
-double libinput_event_pointer_get_axis_value(
+static struct wsf_event_cache_entry *wsf_event_cache_insert(
 	struct libinput_event_pointer *event,
 	wsf_axis_t axis
 ) {
-	double value = 0.0;
-	double factor = 0.0;
+	struct wsf_event_cache_entry *entry = wsf_event_cache_claim(event, axis);
 
-	wsf_ensure_init();
+	entry->should_scale = wsf_should_scale_scroll(event, &entry->base, &entry->source);
+	return entry;
+}
 
-	if (wsf_real_axis_value == NULL) {
-		wsf_real_axis_value =
-			(wsf_scroll_value_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_axis_value"
-			);
+/*
+ * Live entries always sit in the wsf_event_cache_used slots before
+ * wsf_event_cache_next. Destroyed entries are tombstoned in place; the
+ * window only shrinks from its old end so lookups never skip a live entry.
+ */
+static void wsf_event_cache_invalidate(struct libinput_event *event) {
+	unsigned int index = wsf_event_cache_next;
+	unsigned int i = 0;
+
+	if (wsf_event_cache_used == 0 || event == NULL) {
+		return;
 	}
 
-	if (wsf_real_axis_value == NULL) {
-		if (wsf_debug && !wsf_logged_missing_axis_value) {
-			wsf_debug_log("axis_value symbol missing; returning 0");
-			wsf_logged_missing_axis_value = true;
+	for (i = 0; i < wsf_event_cache_used; i++) {
+		struct wsf_event_cache_entry *entry = NULL;
+
+		index = (index + WSF_EVENT_CACHE_SIZE - 1) % WSF_EVENT_CACHE_SIZE;
+		entry = &wsf_event_cache[index];
+		if (entry->base == event || (void *) entry->event == (void *) event) {
+			entry->event = NULL;
+			entry->base = NULL;
 		}
-		return 0.0;
 	}
 
-	value = wsf_real_axis_value(event, axis);
-	factor = wsf_scroll_factor_for_axis(axis);
-	if (!wsf_should_scale_scroll(event, factor)) {
-		return value;
-	}
+	while (wsf_event_cache_used > 0) {
+		unsigned int oldest =
+			(wsf_event_cache_next + WSF_EVENT_CACHE_SIZE - wsf_event_cache_used) %
+			WSF_EVENT_CACHE_SIZE;
 
-	return wsf_scale_scroll_value(event, axis, value, factor);
+		if (wsf_event_cache[oldest].event != NULL) {
+			break;
+		}
+		wsf_event_cache_used--;
+	}
 }
 
-double libinput_event_pointer_get_axis_value_discrete(
+_Static_assert(
+	(int) WSF_STATS_HOOK_SCROLL_VALUE == (int) WSF_SCROLL_GETTER_SCROLL_VALUE &&
+		(int) WSF_STATS_HOOK_SCROLL_VALUE_V120 == (int) WSF_SCROLL_GETTER_SCROLL_VALUE_V120 &&
+		(int) WSF_STATS_HOOK_AXIS_VALUE == (int) WSF_SCROLL_GETTER_AXIS_VALUE &&
+		(int) WSF_STATS_HOOK_AXIS_VALUE_DISCRETE == (int) WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE,
+	"stats hooks must share the scroll getter numbering"
+);
+
+/* real_ticks is NULL unless stats are on; the plain path inlines to no timing. */
+static inline double wsf_call_scroll_getter(
+	wsf_scroll_value_fn real,
 	struct libinput_event_pointer *event,
-	wsf_axis_t axis
+	wsf_axis_t axis,
+	uint64_t *real_ticks
 ) {
+	uint64_t start = 0;
 	double value = 0.0;
-	double factor = 0.0;
 
-	wsf_ensure_init();
+	if (real_ticks == NULL) {
+		return real(event, axis);
+	}
 
-	if (wsf_real_axis_value_discrete == NULL) {
-		wsf_real_axis_value_discrete =
-			(wsf_scroll_value_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_axis_value_discrete"
-			);
+	start = wsf_stats_ticks();
+	value = real(event, axis);
+	*real_ticks += wsf_stats_ticks() - start;
+	return value;
+}
+
+static inline double wsf_scroll_scale(
+	enum wsf_scroll_getter getter,
+	wsf_scroll_value_fn real,
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis,
+	uint64_t *real_ticks,
+	bool *scaled
+) {
+	struct wsf_event_cache_entry *entry = NULL;
+	double value = 0.0;
+
+	if (factors->scroll_identity[wsf_axis_index(axis)]) {
+		return wsf_call_scroll_getter(real, event, axis, real_ticks);
 	}
 
-	if (wsf_real_axis_value_discrete == NULL) {
-		if (wsf_debug && !wsf_logged_missing_axis_value_discrete) {
-			wsf_debug_log("axis_value_discrete symbol missing; returning 0");
-			wsf_logged_missing_axis_value_discrete = true;
+	entry = wsf_event_cache_lookup(event, axis);
+	if (entry != NULL && (entry->value_mask & (1u << getter)) != 0) {
+		if (scaled != NULL) {
+			*scaled = entry->should_scale;
 		}
-		return 0.0;
+		return entry->values[getter];
 	}
 
-	value = wsf_real_axis_value_discrete(event, axis);
-	factor = wsf_scroll_factor_for_axis(axis);
-	if (!wsf_should_scale_scroll(event, factor)) {
-		return value;
+	value = wsf_call_scroll_getter(real, event, axis, real_ticks);
+	if (entry == NULL) {
+		entry = wsf_event_cache_insert(event, axis);
+	}
+	if (entry->should_scale) {
+		value = wsf_scale_scroll_value(factors, entry, getter, event, axis, value);
+	}
+	if (scaled != NULL) {
+		*scaled = entry->should_scale;
 	}
 
-	return wsf_scale_scroll_value(event, axis, value, factor);
+	entry->values[getter] = value;
+	entry->value_mask |= (uint8_t) (1u << getter);
+	return value;
 }
 
-double libinput_event_pointer_get_scroll_value(
+/* Overhead excludes the real getter call; cache hits make none. */
+__attribute__((noinline)) static double wsf_scroll_scale_measured(
+	enum wsf_scroll_getter getter,
+	wsf_scroll_value_fn real,
+	const struct wsf_factor_snapshot *factors,
 	struct libinput_event_pointer *event,
 	wsf_axis_t axis
 ) {
-	double value = 0.0;
-	double factor = 0.0;
+	uint64_t start = wsf_stats_ticks();
+	uint64_t real_ticks = 0;
+	bool scaled = false;
+	double value = wsf_scroll_scale(getter, real, factors, event, axis, &real_ticks, &scaled);
+
+	wsf_stats_record(
+		factors->stats,
+		(enum wsf_stats_hook) getter,
+		wsf_stats_ticks() - start - real_ticks,
+		scaled
+	);
+	return value;
+}
+
+static double wsf_scroll_query(
+	enum wsf_scroll_getter getter,
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	wsf_scroll_value_fn real = NULL;
+	const struct wsf_factor_snapshot *factors = NULL;
 
+	/* Outside niri init is lazy: the getters are only resolved here. */
 	wsf_ensure_init();
+	real = wsf_scroll_getter_fn(getter);
 
-	if (wsf_real_scroll_value == NULL) {
-		wsf_real_scroll_value =
-			(wsf_scroll_value_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_scroll_value"
-			);
+	if (WSF_UNLIKELY(real == NULL)) {
+		wsf_log_missing(1u << getter, wsf_scroll_getter_missing[getter]);
+		return 0.0;
 	}
 
-	if (wsf_real_scroll_value == NULL) {
-		if (wsf_debug && !wsf_logged_missing_scroll) {
-			wsf_debug_log("scroll_value symbol missing; returning 0");
-			wsf_logged_missing_scroll = true;
-		}
-		return 0.0;
+	if (!wsf_state.active || event == NULL) {
+		return real(event, axis);
+	}
+	if (WSF_UNLIKELY((wsf_state.scroll_api & (1u << getter)) == 0)) {
+		wsf_state.scroll_api |= (uint8_t) (1u << getter);
 	}
 
-	value = wsf_real_scroll_value(event, axis);
-	factor = wsf_scroll_factor_for_axis(axis);
-	if (!wsf_should_scale_scroll(event, factor)) {
-		return value;
+	factors = wsf_factors();
+	if (WSF_UNLIKELY(factors->stats != NULL)) {
+		return wsf_scroll_scale_measured(getter, real, factors, event, axis);
 	}
 
-	return wsf_scale_scroll_value(event, axis, value, factor);
+	return wsf_scroll_scale(getter, real, factors, event, axis, NULL, NULL);
 }
 
-double libinput_event_pointer_get_scroll_value_v120(
+double libinput_event_pointer_get_axis_value(
 	struct libinput_event_pointer *event,
 	wsf_axis_t axis
 ) {
-	double value = 0.0;
-	double factor = 0.0;
+	return wsf_scroll_query(WSF_SCROLL_GETTER_AXIS_VALUE, event, axis);
+}
 
-	wsf_ensure_init();
+double libinput_event_pointer_get_axis_value_discrete(
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	return wsf_scroll_query(WSF_SCROLL_GETTER_AXIS_VALUE_DISCRETE, event, axis);
+}
 
-	if (wsf_real_scroll_value_v120 == NULL) {
-		wsf_real_scroll_value_v120 =
-			(wsf_scroll_value_fn) wsf_load_symbol(
-				"libinput_event_pointer_get_scroll_value_v120"
-			);
-	}
+double libinput_event_pointer_get_scroll_value(
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	return wsf_scroll_query(WSF_SCROLL_GETTER_SCROLL_VALUE, event, axis);
+}
 
-	if (wsf_real_scroll_value_v120 == NULL) {
-		if (wsf_debug && !wsf_logged_missing_scroll_v120) {
-			wsf_debug_log("scroll_value_v120 symbol missing; returning 0");
-			wsf_logged_missing_scroll_v120 = true;
-		}
-		return 0.0;
+double libinput_event_pointer_get_scroll_value_v120(
+	struct libinput_event_pointer *event,
+	wsf_axis_t axis
+) {
+	return wsf_scroll_query(WSF_SCROLL_GETTER_SCROLL_VALUE_V120, event, axis);
+}
+
+/* base may be NULL; it is only looked up when profiles are configured. */
+static inline const struct wsf_device_profile *wsf_gesture_profile(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event_gesture *event,
+	struct libinput_event *base
+) {
+	if (WSF_LIKELY(factors->device_profile_count == 0)) {
+		return NULL;
+	}
+	if (base == NULL && wsf_state.gesture_base_event != NULL) {
+		base = wsf_state.gesture_base_event(event);
 	}
 
-	value = wsf_real_scroll_value_v120(event, axis);
-	factor = wsf_scroll_factor_for_axis(axis);
-	if (!wsf_should_scale_scroll(event, factor)) {
-		return value;
+	return wsf_device_profile_for(factors, base);
+}
+
+static inline double wsf_pinch_zoom_factor(
+	const struct wsf_factor_snapshot *factors,
+	const struct wsf_device_profile *profile
+) {
+	return profile != NULL ? profile->pinch_zoom : factors->pinch_zoom_factor;
+}
+
+static inline double wsf_pinch_rotate_factor(
+	const struct wsf_factor_snapshot *factors,
+	const struct wsf_device_profile *profile
+) {
+	return profile != NULL ? profile->pinch_rotate : factors->pinch_rotate_factor;
+}
+
+static inline double wsf_gesture_scale_value(
+	const struct wsf_factor_snapshot *factors,
+	const struct wsf_device_profile *profile,
+	double scale
+) {
+	return wsf_engine_pinch_zoom(scale, wsf_pinch_zoom_factor(factors, profile));
+}
+
+static inline double wsf_gesture_angle_value(
+	const struct wsf_factor_snapshot *factors,
+	const struct wsf_device_profile *profile,
+	double delta
+) {
+	return wsf_engine_pinch_rotate(delta, wsf_pinch_rotate_factor(factors, profile));
+}
+
+/* Times the work after the real gesture getter returned. */
+__attribute__((noinline)) static double wsf_gesture_measured(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event_gesture *event,
+	enum wsf_stats_hook hook,
+	double value
+) {
+	uint64_t start = wsf_stats_ticks();
+	const struct wsf_device_profile *profile = wsf_gesture_profile(factors, event, NULL);
+	double result = 0.0;
+	bool scaled = false;
+
+	if (hook == WSF_STATS_HOOK_GESTURE_SCALE) {
+		result = wsf_gesture_scale_value(factors, profile, value);
+		scaled = wsf_pinch_zoom_factor(factors, profile) != 1.0;
+	} else {
+		result = wsf_gesture_angle_value(factors, profile, value);
+		scaled = wsf_pinch_rotate_factor(factors, profile) != 1.0;
 	}
 
-	return wsf_scale_scroll_value(event, axis, value, factor);
+	wsf_stats_record(factors->stats, hook, wsf_stats_ticks() - start, scaled);
+	return result;
 }
 
 double libinput_event_gesture_get_scale(struct libinput_event_gesture *event) {
+	const struct wsf_factor_snapshot *factors = NULL;
 	double scale = 1.0;
 
 	wsf_ensure_init();
 
-	if (wsf_real_gesture_scale == NULL) {
-		wsf_real_gesture_scale =
-			(wsf_gesture_value_fn) wsf_load_symbol(
-				"libinput_event_gesture_get_scale"
-			);
-	}
-
-	if (wsf_real_gesture_scale == NULL) {
-		if (wsf_debug && !wsf_logged_missing_gesture_scale) {
-			wsf_debug_log("gesture scale symbol missing; returning 1.0");
-			wsf_logged_missing_gesture_scale = true;
-		}
+	if (WSF_UNLIKELY(wsf_state.gesture_scale == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_GESTURE_SCALE,
+			"gesture scale symbol missing; returning 1.0"
+		);
 		return 1.0;
 	}
 
-	scale = wsf_real_gesture_scale(event);
-	if (!wsf_active || wsf_pinch_zoom_factor == 1.0) {
+	scale = wsf_state.gesture_scale(event);
+	if (!wsf_state.active) {
 		return scale;
 	}
 
-	return wsf_scale_pinch_zoom(scale);
+	factors = wsf_factors();
+	if (WSF_UNLIKELY(factors->stats != NULL)) {
+		return wsf_gesture_measured(factors, event, WSF_STATS_HOOK_GESTURE_SCALE, scale);
+	}
+
+	return wsf_gesture_scale_value(factors, wsf_gesture_profile(factors, event, NULL), scale);
 }
 
 double libinput_event_gesture_get_angle_delta(struct libinput_event_gesture *event) {
+	const struct wsf_factor_snapshot *factors = NULL;
 	double delta = 0.0;
 
 	wsf_ensure_init();
 
-	if (wsf_real_gesture_angle_delta == NULL) {
-		wsf_real_gesture_angle_delta =
-			(wsf_gesture_value_fn) wsf_load_symbol(
-				"libinput_event_gesture_get_angle_delta"
+	if (WSF_UNLIKELY(wsf_state.gesture_angle_delta == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_GESTURE_ANGLE,
+			"gesture angle symbol missing; returning 0"
+		);
+		return 0.0;
+	}
+
+	delta = wsf_state.gesture_angle_delta(event);
+	if (!wsf_state.active) {
+		return delta;
+	}
+
+	factors = wsf_factors();
+	if (WSF_UNLIKELY(factors->stats != NULL)) {
+		return wsf_gesture_measured(
+			factors,
+			event,
+			WSF_STATS_HOOK_GESTURE_ANGLE_DELTA,
+			delta
+		);
+	}
+
+	return wsf_gesture_angle_value(factors, wsf_gesture_profile(factors, event, NULL), delta);
+}
+
+/*
+ * Fills the event cache for the axes that scale; getters then hit it
+ * without work. Only what the getters would do anyway is done here: the
+ * event is classified once from the type already in hand, and wheel
+ * events and axes at factor 1.0 (which pass through) are left to the
+ * getters, as are any events the entries would merely copy.
+ */
+static bool wsf_fetch_scroll(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event *base,
+	wsf_event_type_t type,
+	enum wsf_scroll_getter getter,
+	uint64_t *real_ticks
+) {
+	static const wsf_axis_t axes[2] = {
+		WSF_AXIS_SCROLL_VERTICAL,
+		WSF_AXIS_SCROLL_HORIZONTAL,
+	};
+	struct libinput_event_pointer *event = NULL;
+	wsf_scroll_value_fn real = wsf_scroll_getter_fn(getter);
+	uint8_t source = 0;
+	bool scaled = false;
+	unsigned int i = 0;
+
+	if (type == WSF_EVENT_POINTER_SCROLL_WHEEL || real == NULL) {
+		return false;
+	}
+	event = wsf_state.pointer_event(base);
+	if (event == NULL) {
+		return false;
+	}
+	if (type == WSF_EVENT_POINTER_SCROLL_FINGER) {
+		source = WSF_AXIS_SOURCE_FINGER;
+	} else if (type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS) {
+		source = WSF_AXIS_SOURCE_CONTINUOUS;
+	} else if (wsf_state.axis_source != NULL) {
+		source = (uint8_t) wsf_state.axis_source(event);
+	}
+	if (!wsf_engine_scroll_source_scaled(source)) {
+		return false;
+	}
+
+	for (i = 0; i < 2; i++) {
+		struct wsf_event_cache_entry *entry = NULL;
+		double value = 0.0;
+
+		if (wsf_scroll_factor_for(factors, base, i) == 1.0 ||
+			!wsf_state.has_axis(event, axes[i])) {
+			continue;
+		}
+		entry = wsf_event_cache_claim(event, axes[i]);
+		entry->base = base;
+		entry->source = source;
+		entry->should_scale = true;
+		value = wsf_call_scroll_getter(real, event, axes[i], real_ticks);
+		entry->values[getter] =
+			wsf_scale_scroll_value(factors, entry, getter, event, axes[i], value);
+		entry->value_mask = (uint8_t) (1u << getter);
+		scaled = true;
+	}
+
+	return scaled;
+}
+
+/*
+ * libinput reports every scroll twice, as a scroll_* event and as a legacy
+ * axis event. Only the family niri reads is processed at fetch time (each
+ * copy would otherwise advance the velocity state); until niri has queried
+ * a scroll, or if it reads both, scroll events are left to the getters.
+ */
+static bool wsf_fetch_scroll_getter(wsf_event_type_t type, enum wsf_scroll_getter *out_getter) {
+	uint8_t api = wsf_state.scroll_api;
+
+	if ((api & WSF_SCROLL_API_MODERN) != 0 && (api & WSF_SCROLL_API_LEGACY) == 0) {
+		*out_getter = WSF_SCROLL_GETTER_SCROLL_VALUE;
+		return type == WSF_EVENT_POINTER_SCROLL_WHEEL ||
+			type == WSF_EVENT_POINTER_SCROLL_FINGER ||
+			type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS;
+	}
+	if ((api & WSF_SCROLL_API_LEGACY) != 0 && (api & WSF_SCROLL_API_MODERN) == 0) {
+		*out_getter = WSF_SCROLL_GETTER_AXIS_VALUE;
+		return type == WSF_EVENT_POINTER_AXIS;
+	}
+
+	return false;
+}
+
+/* The same scroll reported through the family niri does not read. */
+static bool wsf_coalesce_twin(enum wsf_scroll_getter getter, wsf_event_type_t type) {
+	if (getter == WSF_SCROLL_GETTER_AXIS_VALUE) {
+		return type == WSF_EVENT_POINTER_SCROLL_WHEEL ||
+			type == WSF_EVENT_POINTER_SCROLL_FINGER ||
+			type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS;
+	}
+	return type == WSF_EVENT_POINTER_AXIS;
+}
+
+/*
+ * Fails for anything that must stay a separate event: a wheel source, a
+ * stop, an axis left unscaled (its getter bypasses the cache) or no axis.
+ */
+static bool wsf_coalesce_describe(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event *base,
+	wsf_event_type_t type,
+	enum wsf_scroll_getter getter,
+	struct wsf_coalesce_run *out_run
+) {
+	static const wsf_axis_t axes[2] = {
+		WSF_AXIS_SCROLL_VERTICAL,
+		WSF_AXIS_SCROLL_HORIZONTAL,
+	};
+	struct libinput_event_pointer *event = wsf_state.pointer_event(base);
+	wsf_scroll_value_fn real = wsf_scroll_getter_fn(getter);
+	unsigned int i = 0;
+
+	if (event == NULL || real == NULL) {
+		return false;
+	}
+
+	memset(out_run, 0, sizeof(*out_run));
+	out_run->type = type;
+	if (type == WSF_EVENT_POINTER_SCROLL_FINGER) {
+		out_run->source = WSF_AXIS_SOURCE_FINGER;
+	} else if (type == WSF_EVENT_POINTER_SCROLL_CONTINUOUS) {
+		out_run->source = WSF_AXIS_SOURCE_CONTINUOUS;
+	} else if (wsf_state.axis_source != NULL) {
+		out_run->source = (uint8_t) wsf_state.axis_source(event);
+	}
+	if (!wsf_engine_scroll_source_scaled(out_run->source)) {
+		return false;
+	}
+	if (wsf_state.event_device != NULL) {
+		out_run->device = wsf_state.event_device(base);
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!wsf_state.has_axis(event, axes[i])) {
+			continue;
+		}
+		if (wsf_scroll_factor_for(factors, base, i) == 1.0 || real(event, axes[i]) == 0.0) {
+			return false;
+		}
+		out_run->axis_mask |= (uint8_t) (1u << i);
+	}
+
+	return out_run->axis_mask != 0;
+}
+
+static void wsf_coalesce_add(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput_event *base,
+	enum wsf_scroll_getter getter,
+	struct wsf_coalesce_run *run,
+	uint64_t *real_ticks
+) {
+	static const wsf_axis_t axes[2] = {
+		WSF_AXIS_SCROLL_VERTICAL,
+		WSF_AXIS_SCROLL_HORIZONTAL,
+	};
+	struct libinput_event_pointer *event = wsf_state.pointer_event(base);
+	wsf_scroll_value_fn real = wsf_scroll_getter_fn(getter);
+	unsigned int i = 0;
+
+	for (i = 0; i < 2; i++) {
+		if ((run->axis_mask & (1u << i)) != 0) {
+			run->sum[i] += wsf_scroll_scale(
+				getter,
+				real,
+				factors,
+				event,
+				axes[i],
+				real_ticks,
+				NULL
 			);
+		}
 	}
+}
+
+/* For events niri never sees: drop their cache entries, then free them. */
+static void wsf_release_event(struct libinput_event *event) {
+	wsf_event_cache_invalidate(event);
+	wsf_state.event_destroy(event);
+}
+
+/* Returns false, leaving *event alone, when there is nothing to merge. */
+static bool wsf_coalesce(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput *libinput,
+	struct libinput_event **event,
+	uint64_t *real_ticks
+) {
+	static const wsf_axis_t axes[2] = {
+		WSF_AXIS_SCROLL_VERTICAL,
+		WSF_AXIS_SCROLL_HORIZONTAL,
+	};
+	struct libinput_event *last = *event;
+	struct wsf_coalesce_run run;
+	struct wsf_coalesce_run next;
+	enum wsf_scroll_getter getter = WSF_SCROLL_GETTER_SCROLL_VALUE;
+	wsf_event_type_t type = wsf_state.event_type(last);
+	unsigned int merged = 1;
+	unsigned int i = 0;
+
+	if (!wsf_fetch_scroll_getter(type, &getter) ||
+		wsf_state.next_event_type(libinput) == 0 ||
+		!wsf_coalesce_describe(factors, last, type, getter, &run)) {
+		return false;
+	}
+
+	wsf_coalesce_add(factors, last, getter, &run, real_ticks);
+	while (merged < WSF_COALESCE_MAX_EVENTS) {
+		wsf_event_type_t next_type = wsf_state.next_event_type(libinput);
+		struct libinput_event *candidate = NULL;
 
-	if (wsf_real_gesture_angle_delta == NULL) {
-		if (wsf_debug && !wsf_logged_missing_gesture_angle) {
-			wsf_debug_log("gesture angle symbol missing; returning 0");
-			wsf_logged_missing_gesture_angle = true;
+		if (next_type != run.type && !wsf_coalesce_twin(getter, next_type)) {
+			break;
 		}
-		return 0.0;
+
+		candidate = wsf_state.get_event(libinput);
+		if (candidate == NULL) {
+			break;
+		}
+		if (next_type != run.type) {
+			wsf_release_event(candidate);
+			continue;
+		}
+		if (!wsf_coalesce_describe(factors, candidate, next_type, getter, &next) ||
+			next.device != run.device ||
+			next.source != run.source ||
+			next.axis_mask != run.axis_mask) {
+			wsf_held_libinput = libinput;
+			wsf_held_event = candidate;
+			break;
+		}
+
+		wsf_coalesce_add(factors, candidate, getter, &run, real_ticks);
+		wsf_release_event(last);
+		last = candidate;
+		merged++;
 	}
 
-	delta = wsf_real_gesture_angle_delta(event);
-	if (!wsf_active || wsf_pinch_rotate_factor == 1.0) {
-		return delta;
+	for (i = 0; i < 2; i++) {
+		struct wsf_event_cache_entry *entry = NULL;
+
+		if ((run.axis_mask & (1u << i)) == 0) {
+			continue;
+		}
+		entry = wsf_event_cache_lookup(wsf_state.pointer_event(last), axes[i]);
+		if (entry != NULL) {
+			entry->values[getter] = run.sum[i];
+		}
+	}
+
+	*event = last;
+	return true;
+}
+
+static inline bool wsf_fetch_event(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput *libinput,
+	struct libinput_event **event,
+	uint64_t *real_ticks
+) {
+	enum wsf_scroll_getter getter = WSF_SCROLL_GETTER_SCROLL_VALUE;
+	wsf_event_type_t type = 0;
+
+	if (wsf_state.coalesce && wsf_coalesce(factors, libinput, event, real_ticks)) {
+		return true;
+	}
+
+	type = wsf_state.event_type(*event);
+	if (wsf_fetch_scroll_getter(type, &getter)) {
+		return wsf_fetch_scroll(factors, *event, type, getter, real_ticks);
+	}
+
+	return false;
+}
+
+/* Overhead excludes the real getters called while filling the caches. */
+__attribute__((noinline)) static struct libinput_event *wsf_fetch_event_measured(
+	const struct wsf_factor_snapshot *factors,
+	struct libinput *libinput,
+	struct libinput_event *event
+) {
+	uint64_t start = wsf_stats_ticks();
+	uint64_t real_ticks = 0;
+	bool scaled = wsf_fetch_event(factors, libinput, &event, &real_ticks);
+
+	wsf_stats_record(
+		factors->stats,
+		WSF_STATS_HOOK_GET_EVENT,
+		wsf_stats_ticks() - start - real_ticks,
+		scaled
+	);
+	return event;
+}
+
+struct libinput_event *libinput_get_event(struct libinput *libinput) {
+	const struct wsf_factor_snapshot *factors = NULL;
+	struct libinput_event *event = NULL;
+
+	wsf_ensure_init();
+
+	if (WSF_UNLIKELY(wsf_state.get_event == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_GET_EVENT,
+			"get_event symbol missing; returning no event"
+		);
+		return NULL;
+	}
+
+	if (wsf_held_event != NULL && wsf_held_libinput == libinput) {
+		event = wsf_held_event;
+		wsf_held_event = NULL;
+	} else {
+		event = wsf_state.get_event(libinput);
+	}
+	if (!wsf_state.fetch || event == NULL) {
+		return event;
+	}
+
+	factors = wsf_factors();
+	if (WSF_UNLIKELY(factors->stats != NULL)) {
+		return wsf_fetch_event_measured(factors, libinput, event);
+	}
+
+	wsf_fetch_event(factors, libinput, &event, NULL);
+	return event;
+}
+
+wsf_event_type_t libinput_next_event_type(struct libinput *libinput) {
+	wsf_ensure_init();
+
+	if (WSF_UNLIKELY(wsf_state.next_event_type == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_NEXT_EVENT_TYPE,
+			"next_event_type symbol missing; reporting no event"
+		);
+		return 0;
+	}
+	if (wsf_held_event != NULL && wsf_held_libinput == libinput) {
+		return wsf_state.event_type(wsf_held_event);
+	}
+
+	return wsf_state.next_event_type(libinput);
+}
+
+void libinput_event_destroy(struct libinput_event *event) {
+	struct wsf_stats_block *stats = NULL;
+	uint64_t start = 0;
+
+	wsf_ensure_init();
+	if (wsf_state.active) {
+		stats = wsf_factors()->stats;
+		if (WSF_UNLIKELY(stats != NULL)) {
+			start = wsf_stats_ticks();
+		}
+	}
+
+	wsf_event_cache_invalidate(event);
+
+	if (wsf_state.device_count != 0 && event != NULL &&
+		wsf_state.event_type != NULL && wsf_state.event_device != NULL &&
+		wsf_state.event_type(event) == WSF_EVENT_DEVICE_REMOVED) {
+		wsf_device_evict(wsf_state.event_device(event));
+	}
+
+	if (WSF_UNLIKELY(stats != NULL)) {
+		wsf_stats_record(
+			stats,
+			WSF_STATS_HOOK_EVENT_DESTROY,
+			wsf_stats_ticks() - start,
+			false
+		);
+	}
+
+	if (WSF_UNLIKELY(wsf_state.event_destroy == NULL)) {
+		wsf_log_missing(
+			WSF_MISSING_EVENT_DESTROY,
+			"event_destroy symbol missing; event leaked"
+		);
+		return;
 	}
 
-	return delta * wsf_pinch_rotate_factor;
+	wsf_state.event_destroy(event);
 }
@@ -2,8 +2,13 @@
 
 #include "wsf_proc.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/auxv.h>
+
+/* The kernel keeps the first TASK_COMM_LEN - 1 bytes of the exec name. */
+#define WSF_COMM_MAX 15
 
 static const char *wsf_basename(const char *path) {
 	const char *slash = strrchr(path, '/');
@@ -76,26 +81,32 @@ bool wsf_proc_name(char *buf, size_t len) {
 	return true;
 }
 
+/* Whether the kernel's comm for an exec of `name` would read `target`. */
+static bool wsf_comm_matches(const char *name, const char *target) {
+	size_t name_len = strnlen(name, WSF_COMM_MAX);
+
+	return strlen(target) == name_len && strncmp(name, target, name_len) == 0;
+}
+
+/*
+ * Runs in every process that inherits the preload, so it makes no system
+ * calls: libc has already split argv[0] into program_invocation_short_name,
+ * and AT_EXECFN is the path handed to execve(), which is what the kernel
+ * derives /proc/self/comm from. Together they match what comparing comm
+ * and the basename of cmdline's argv[0] would.
+ */
 bool wsf_proc_is_target(const char *target) {
-	char comm[256];
-	char cmdline[256];
+	const char *execfn = NULL;
 
 	if (target == NULL || target[0] == '\0') {
 		return false;
 	}
 
-	if (wsf_read_comm(comm, sizeof(comm))) {
-		if (strcmp(comm, target) == 0) {
-			return true;
-		}
-	}
-
-	if (wsf_read_cmdline(cmdline, sizeof(cmdline))) {
-		const char *name = wsf_basename(cmdline);
-		if (strcmp(name, target) == 0) {
-			return true;
-		}
+	if (program_invocation_short_name != NULL &&
+		strcmp(program_invocation_short_name, target) == 0) {
+		return true;
 	}
 
-	return false;
+	execfn = (const char *) getauxval(AT_EXECFN);
+	return execfn != NULL && wsf_comm_matches(wsf_basename(execfn), target);
 }
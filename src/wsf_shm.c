@@ -0,0 +1,370 @@
+#define _GNU_SOURCE
+
+#include "wsf_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define WSF_SHM_WRITE_ATTEMPTS 1000
+
+struct wsf_shm_watch {
+	struct wsf_shm_block *block;
+	uint32_t seq;
+	wsf_shm_watch_fn on_change;
+	void *data;
+};
+
+static void wsf_debug_log(bool debug, const char *fmt, ...) {
+	if (!debug) {
+		return;
+	}
+
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "wsf: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static bool wsf_shm_name(char *buf, size_t len) {
+	int written = snprintf(buf, len, "/wsf-%u", (unsigned int) getuid());
+
+	return written > 0 && (size_t) written < len;
+}
+
+static bool wsf_shm_header_valid(const struct wsf_shm_block *block) {
+	return block->magic == WSF_SHM_MAGIC &&
+		block->version == WSF_SHM_VERSION &&
+		block->size == sizeof(*block);
+}
+
+/* Shared (not private) futex ops, so they reach other processes. */
+static void wsf_shm_wake(struct wsf_shm_block *block) {
+	syscall(SYS_futex, &block->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void wsf_shm_wait(struct wsf_shm_block *block, uint32_t seq) {
+	syscall(SYS_futex, &block->seq, FUTEX_WAIT, seq, NULL, NULL, 0);
+}
+
+static bool wsf_shm_writer_gone(uint32_t pid) {
+	return pid != 0 && kill((pid_t) pid, 0) != 0 && errno == ESRCH;
+}
+
+/*
+ * Takes the writer slot, from nobody or from a writer that died holding
+ * it. A dead writer may have left seq odd and the values torn; the caller
+ * rewrites all of them before seq turns even again.
+ */
+static bool wsf_shm_writer_claim(struct wsf_shm_block *block, uint32_t pid) {
+	uint32_t writer = 0;
+
+	if (atomic_compare_exchange_strong_explicit(
+		&block->writer,
+		&writer,
+		pid,
+		memory_order_acquire,
+		memory_order_relaxed
+	)) {
+		return true;
+	}
+
+	return wsf_shm_writer_gone(writer) &&
+		atomic_compare_exchange_strong_explicit(
+			&block->writer,
+			&writer,
+			pid,
+			memory_order_acquire,
+			memory_order_relaxed
+		);
+}
+
+struct wsf_shm_block *wsf_shm_open(bool create, bool debug) {
+	struct wsf_shm_block *block = NULL;
+	struct stat st;
+	char name[64];
+	int flags = O_RDWR | O_CLOEXEC;
+	int fd = -1;
+
+	if (!wsf_shm_name(name, sizeof(name))) {
+		return NULL;
+	}
+
+	if (create) {
+		flags |= O_CREAT;
+	}
+
+	fd = shm_open(name, flags, 0600);
+	if (fd < 0) {
+		if (errno != ENOENT || create) {
+			wsf_debug_log(debug, "shm: open %s failed: %s", name, strerror(errno));
+		}
+		return NULL;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_uid != getuid()) {
+		wsf_debug_log(debug, "shm: %s not owned by this user", name);
+		close(fd);
+		return NULL;
+	}
+
+	if ((size_t) st.st_size < sizeof(*block)) {
+		if (!create || ftruncate(fd, sizeof(*block)) != 0) {
+			close(fd);
+			return NULL;
+		}
+	}
+
+	block = mmap(NULL, sizeof(*block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (block == MAP_FAILED) {
+		wsf_debug_log(debug, "shm: mmap failed: %s", strerror(errno));
+		return NULL;
+	}
+
+	if (!wsf_shm_header_valid(block)) {
+		if (!create) {
+			wsf_debug_log(debug, "shm: %s has an unknown layout", name);
+			munmap(block, sizeof(*block));
+			return NULL;
+		}
+		memset(block, 0, sizeof(*block));
+		block->magic = WSF_SHM_MAGIC;
+		block->version = WSF_SHM_VERSION;
+		block->size = sizeof(*block);
+	}
+
+	if (create) {
+		uint32_t writer = atomic_load_explicit(&block->writer, memory_order_relaxed);
+		uint32_t seq = atomic_load_explicit(&block->seq, memory_order_relaxed);
+
+		block->owner_pid = (uint32_t) getpid();
+		/* A write left unfinished by a previous session would fail every later one. */
+		if (wsf_shm_writer_gone(writer)) {
+			wsf_debug_log(debug, "shm: clearing write left unfinished by pid %u", writer);
+			atomic_store_explicit(&block->writer, 0, memory_order_relaxed);
+			atomic_store_explicit(&block->seq, (seq + 1u) & ~1u, memory_order_release);
+			wsf_shm_wake(block);
+		}
+	}
+
+	return block;
+}
+
+void wsf_shm_close(struct wsf_shm_block *block) {
+	if (block != NULL) {
+		munmap(block, sizeof(*block));
+	}
+}
+
+bool wsf_shm_write(struct wsf_shm_block *block, const struct wsf_shm_values *values) {
+	uint32_t pid = (uint32_t) getpid();
+	uint32_t seq = 0;
+	int attempt = 0;
+
+	if (block == NULL || values == NULL) {
+		return false;
+	}
+
+	for (attempt = 0; attempt < WSF_SHM_WRITE_ATTEMPTS; attempt++) {
+		if (wsf_shm_writer_claim(block, pid)) {
+			break;
+		}
+		sched_yield();
+	}
+	if (attempt == WSF_SHM_WRITE_ATTEMPTS) {
+		return false;
+	}
+
+	/* Odd only if a dead writer left it so; readers already skip it. */
+	seq = atomic_load_explicit(&block->seq, memory_order_relaxed) | 1u;
+	atomic_store_explicit(&block->seq, seq, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&block->values, values, sizeof(block->values));
+	atomic_store_explicit(&block->seq, seq + 1, memory_order_release);
+	atomic_store_explicit(&block->writer, 0, memory_order_release);
+	wsf_shm_wake(block);
+	return true;
+}
+
+/* Single attempt against a sequence number the caller already loaded. */
+bool wsf_shm_try_read(
+	const struct wsf_shm_block *block,
+	uint32_t seq,
+	struct wsf_shm_values *out_values
+) {
+	if ((seq & 1u) != 0) {
+		return false;
+	}
+
+	memcpy(out_values, &block->values, sizeof(*out_values));
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(
+		(_Atomic uint32_t *) &block->seq,
+		memory_order_relaxed
+	) == seq;
+}
+
+bool wsf_shm_read(const struct wsf_shm_block *block, struct wsf_shm_values *out_values) {
+	int attempt = 0;
+
+	if (block == NULL || out_values == NULL) {
+		return false;
+	}
+
+	for (attempt = 0; attempt < WSF_SHM_WRITE_ATTEMPTS; attempt++) {
+		uint32_t seq = atomic_load_explicit(
+			(_Atomic uint32_t *) &block->seq,
+			memory_order_acquire
+		);
+
+		if (wsf_shm_try_read(block, seq, out_values)) {
+			return true;
+		}
+		sched_yield();
+	}
+
+	return false;
+}
+
+static bool wsf_shm_factor_valid(double factor) {
+	return factor >= WSF_FACTOR_MIN && factor <= WSF_FACTOR_MAX;
+}
+
+bool wsf_shm_values_valid(const struct wsf_shm_values *values) {
+	uint32_t i = 0;
+
+	if (values->device_profile_count > WSF_DEVICE_PROFILE_MAX) {
+		return false;
+	}
+	for (i = 0; i < values->device_profile_count; i++) {
+		if (!wsf_device_profile_valid(&values->device_profiles[i])) {
+			return false;
+		}
+	}
+	if (values->focus_profile_count > WSF_FOCUS_PROFILE_MAX) {
+		return false;
+	}
+	for (i = 0; i < values->focus_profile_count; i++) {
+		if (!wsf_focus_profile_valid(&values->focus_profiles[i])) {
+			return false;
+		}
+	}
+
+	return wsf_shm_factor_valid(values->scroll_vertical) &&
+		wsf_shm_factor_valid(values->scroll_horizontal) &&
+		wsf_shm_factor_valid(values->pinch_zoom) &&
+		wsf_shm_factor_valid(values->pinch_rotate) &&
+		values->trace <= 1 &&
+		values->stats <= 1 &&
+		wsf_scroll_curve_params_valid(&values->curve);
+}
+
+void wsf_shm_values_from_factors(
+	struct wsf_shm_values *out_values,
+	const struct wsf_effective_factors *factors
+) {
+	memset(out_values, 0, sizeof(*out_values));
+	out_values->scroll_vertical = factors->scroll_vertical;
+	out_values->scroll_horizontal = factors->scroll_horizontal;
+	out_values->pinch_zoom = factors->pinch_zoom;
+	out_values->pinch_rotate = factors->pinch_rotate;
+	out_values->curve = factors->curve;
+	out_values->device_profile_count = factors->device_profile_count;
+	memcpy(
+		out_values->device_profiles,
+		factors->device_profiles,
+		sizeof(out_values->device_profiles)
+	);
+	out_values->focus_profile_count = factors->focus_profile_count;
+	memcpy(
+		out_values->focus_profiles,
+		factors->focus_profiles,
+		sizeof(out_values->focus_profiles)
+	);
+	out_values->config_generation = factors->generation;
+}
+
+/*
+ * FUTEX_WAIT returns at once when seq already moved on, so a write that
+ * lands between the load and the wait is not missed. Odd values are
+ * writes in progress (or left by a dead writer) and only wait for the next.
+ */
+static void *wsf_shm_watch_thread(void *arg) {
+	struct wsf_shm_watch *watch = arg;
+	uint32_t seen = watch->seq;
+
+	for (;;) {
+		uint32_t seq = atomic_load_explicit(&watch->block->seq, memory_order_acquire);
+
+		if (seq == seen) {
+			wsf_shm_wait(watch->block, seq);
+			continue;
+		}
+		seen = seq;
+		if ((seq & 1u) == 0) {
+			watch->on_change(watch->data);
+		}
+	}
+
+	return NULL;
+}
+
+bool wsf_shm_watch_start(
+	struct wsf_shm_block *block,
+	uint32_t seq,
+	wsf_shm_watch_fn on_change,
+	void *data,
+	bool debug
+) {
+	struct wsf_shm_watch *watch = NULL;
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t all_signals;
+	sigset_t old_signals;
+	int rc = 0;
+
+	if (block == NULL || on_change == NULL) {
+		return false;
+	}
+
+	watch = calloc(1, sizeof(*watch));
+	if (watch == NULL) {
+		return false;
+	}
+	watch->block = block;
+	watch->seq = seq;
+	watch->on_change = on_change;
+	watch->data = data;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+	rc = pthread_create(&thread, &attr, wsf_shm_watch_thread, watch);
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0) {
+		wsf_debug_log(debug, "shm: pthread_create failed: %s", strerror(rc));
+		free(watch);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,94 @@
+#ifndef WSF_SHM_H
+#define WSF_SHM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wsf_config.h"
+
+#define WSF_SHM_MAGIC 0x31465357u
+#define WSF_SHM_VERSION 9u
+
+/* The owner runs with WSF_* factor overrides the config file does not show. */
+#define WSF_SHM_FLAG_ENV_OVERRIDES (1u << 0)
+
+/* Fixed-layout copy of the values a running compositor scales with. */
+struct wsf_shm_values {
+	double scroll_vertical;
+	double scroll_horizontal;
+	double pinch_zoom;
+	double pinch_rotate;
+	struct wsf_scroll_curve_params curve;
+	uint32_t trace;
+	uint32_t stats;
+	uint32_t device_profile_count;
+	uint32_t reserved;
+	struct wsf_device_profile device_profiles[WSF_DEVICE_PROFILE_MAX];
+	uint32_t focus_profile_count;
+	uint32_t reserved_focus;
+	struct wsf_focus_profile focus_profiles[WSF_FOCUS_PROFILE_MAX];
+	/* Generation of the config file these came from; 0 when not known. */
+	uint64_t config_generation;
+};
+
+/*
+ * Control block at /dev/shm/wsf-$UID, created by the preload library in the
+ * target process. Writers (the CLI, the in-process config watcher) claim
+ * writer with their pid, then move seq to odd for the copy and back to even;
+ * readers never block writers and copy again when they observe a write in
+ * progress.
+ *
+ * The block outlives its processes, so a writer killed mid-write would
+ * otherwise hold it forever: a writer whose pid is gone is taken over by
+ * the next writer, and the owner clears it when it creates the block.
+ *
+ * seq doubles as a futex: a writer wakes it once seq is even again, so
+ * the owner can sleep on it instead of polling (wsf_shm_watch_start).
+ */
+struct wsf_shm_block {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t owner_pid;
+	_Atomic uint32_t seq;
+	/* Pid of the process writing values; 0 when none is. */
+	_Atomic uint32_t writer;
+	/* WSF_SHM_FLAG_*, set by the owner when it creates the block. */
+	uint32_t flags;
+	struct wsf_shm_values values;
+};
+
+struct wsf_shm_block *wsf_shm_open(bool create, bool debug);
+void wsf_shm_close(struct wsf_shm_block *block);
+bool wsf_shm_write(struct wsf_shm_block *block, const struct wsf_shm_values *values);
+bool wsf_shm_try_read(
+	const struct wsf_shm_block *block,
+	uint32_t seq,
+	struct wsf_shm_values *out_values
+);
+bool wsf_shm_read(const struct wsf_shm_block *block, struct wsf_shm_values *out_values);
+bool wsf_shm_values_valid(const struct wsf_shm_values *values);
+
+typedef void (*wsf_shm_watch_fn)(void *data);
+
+/*
+ * Starts a detached background thread that sleeps on the block's seq and
+ * calls on_change after each completed write that leaves seq different
+ * from the seq passed in (the last generation the caller consumed). The
+ * thread blocks all signals so the host process keeps its own signal
+ * routing.
+ */
+bool wsf_shm_watch_start(
+	struct wsf_shm_block *block,
+	uint32_t seq,
+	wsf_shm_watch_fn on_change,
+	void *data,
+	bool debug
+);
+void wsf_shm_values_from_factors(
+	struct wsf_shm_values *out_values,
+	const struct wsf_effective_factors *factors
+);
+
+#endif
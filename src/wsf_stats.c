@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+
+#include "wsf_stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void wsf_debug_log(bool debug, const char *fmt, ...) {
+	if (!debug) {
+		return;
+	}
+
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "wsf: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static const char *const wsf_stats_hook_names[WSF_STATS_HOOK_COUNT] = {
+	[WSF_STATS_HOOK_SCROLL_VALUE] = "scroll_value",
+	[WSF_STATS_HOOK_SCROLL_VALUE_V120] = "scroll_value_v120",
+	[WSF_STATS_HOOK_AXIS_VALUE] = "axis_value",
+	[WSF_STATS_HOOK_AXIS_VALUE_DISCRETE] = "axis_value_discrete",
+	[WSF_STATS_HOOK_GESTURE_SCALE] = "gesture_scale",
+	[WSF_STATS_HOOK_GESTURE_ANGLE_DELTA] = "gesture_angle_delta",
+	[WSF_STATS_HOOK_EVENT_DESTROY] = "event_destroy",
+	[WSF_STATS_HOOK_GET_EVENT] = "get_event",
+};
+
+const char *wsf_stats_hook_name(enum wsf_stats_hook hook) {
+	if ((unsigned int) hook >= WSF_STATS_HOOK_COUNT) {
+		return "unknown";
+	}
+	return wsf_stats_hook_names[hook];
+}
+
+uint64_t wsf_stats_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull) + (uint64_t) ts.tv_nsec;
+}
+
+static bool wsf_stats_name(char *buf, size_t len) {
+	int written = snprintf(buf, len, "/wsf-stats-%u", (unsigned int) getuid());
+
+	return written > 0 && (size_t) written < len;
+}
+
+static bool wsf_stats_header_valid(const struct wsf_stats_block *block) {
+	return block->magic == WSF_STATS_MAGIC &&
+		block->version == WSF_STATS_VERSION &&
+		block->size == sizeof(*block);
+}
+
+struct wsf_stats_block *wsf_stats_open(bool create, bool debug) {
+	struct wsf_stats_block *block = NULL;
+	struct stat st;
+	char name[64];
+	int flags = O_RDWR | O_CLOEXEC;
+	int fd = -1;
+
+	if (!wsf_stats_name(name, sizeof(name))) {
+		return NULL;
+	}
+
+	if (create) {
+		flags |= O_CREAT;
+	}
+
+	fd = shm_open(name, flags, 0600);
+	if (fd < 0) {
+		if (errno != ENOENT || create) {
+			wsf_debug_log(debug, "stats: open %s failed: %s", name, strerror(errno));
+		}
+		return NULL;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_uid != getuid()) {
+		wsf_debug_log(debug, "stats: %s not owned by this user", name);
+		close(fd);
+		return NULL;
+	}
+
+	if ((size_t) st.st_size < sizeof(*block)) {
+		if (!create || ftruncate(fd, sizeof(*block)) != 0) {
+			close(fd);
+			return NULL;
+		}
+	}
+
+	block = mmap(NULL, sizeof(*block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (block == MAP_FAILED) {
+		wsf_debug_log(debug, "stats: mmap failed: %s", strerror(errno));
+		return NULL;
+	}
+
+	/* Counters restart with every compositor session. */
+	if (create || !wsf_stats_header_valid(block)) {
+		if (!create) {
+			wsf_debug_log(debug, "stats: %s has an unknown layout", name);
+			munmap(block, sizeof(*block));
+			return NULL;
+		}
+		memset(block, 0, sizeof(*block));
+		block->magic = WSF_STATS_MAGIC;
+		block->version = WSF_STATS_VERSION;
+		block->size = sizeof(*block);
+		block->owner_pid = (uint32_t) getpid();
+#if defined(__x86_64__) || defined(__i386__)
+		block->clock = WSF_STATS_CLOCK_TSC;
+#else
+		block->clock = WSF_STATS_CLOCK_MONOTONIC_NS;
+#endif
+		block->tick_origin = wsf_stats_ticks();
+		block->ns_origin = wsf_stats_now_ns();
+	}
+
+	return block;
+}
+
+void wsf_stats_close(struct wsf_stats_block *block) {
+	if (block != NULL) {
+		munmap(block, sizeof(*block));
+	}
+}
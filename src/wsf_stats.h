@@ -0,0 +1,100 @@
+#ifndef WSF_STATS_H
+#define WSF_STATS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WSF_STATS_MAGIC 0x54535357u
+#define WSF_STATS_VERSION 2u
+#define WSF_STATS_BUCKETS 32
+
+enum wsf_stats_hook {
+	WSF_STATS_HOOK_SCROLL_VALUE = 0,
+	WSF_STATS_HOOK_SCROLL_VALUE_V120,
+	WSF_STATS_HOOK_AXIS_VALUE,
+	WSF_STATS_HOOK_AXIS_VALUE_DISCRETE,
+	WSF_STATS_HOOK_GESTURE_SCALE,
+	WSF_STATS_HOOK_GESTURE_ANGLE_DELTA,
+	WSF_STATS_HOOK_EVENT_DESTROY,
+	WSF_STATS_HOOK_GET_EVENT,
+	WSF_STATS_HOOK_COUNT
+};
+
+enum wsf_stats_clock {
+	WSF_STATS_CLOCK_MONOTONIC_NS = 0,
+	WSF_STATS_CLOCK_TSC = 1
+};
+
+/*
+ * Bucket i counts calls whose own overhead (excluding the real libinput
+ * call) took [2^i, 2^(i+1)) ticks. One cache line of counters per hook.
+ */
+struct wsf_stats_counters {
+	_Alignas(64) _Atomic uint64_t calls;
+	_Atomic uint64_t scaled;
+	_Atomic uint64_t passthrough;
+	_Atomic uint64_t total_ticks;
+	_Atomic uint64_t buckets[WSF_STATS_BUCKETS];
+};
+
+/*
+ * Counters at /dev/shm/wsf-stats-$UID. They are only written from the
+ * compositor's input thread, so updates are plain load/store pairs rather
+ * than locked read-modify-writes. tick_origin/ns_origin let a reader turn
+ * TSC ticks into nanoseconds without the producer calibrating anything.
+ */
+struct wsf_stats_block {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t owner_pid;
+	uint32_t clock;
+	uint32_t reserved;
+	uint64_t tick_origin;
+	uint64_t ns_origin;
+	struct wsf_stats_counters hooks[WSF_STATS_HOOK_COUNT];
+};
+
+struct wsf_stats_block *wsf_stats_open(bool create, bool debug);
+void wsf_stats_close(struct wsf_stats_block *block);
+const char *wsf_stats_hook_name(enum wsf_stats_hook hook);
+uint64_t wsf_stats_now_ns(void);
+
+static inline uint64_t wsf_stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return wsf_stats_now_ns();
+#endif
+}
+
+static inline void wsf_stats_bump(_Atomic uint64_t *counter, uint64_t amount) {
+	atomic_store_explicit(
+		counter,
+		atomic_load_explicit(counter, memory_order_relaxed) + amount,
+		memory_order_relaxed
+	);
+}
+
+static inline void wsf_stats_record(
+	struct wsf_stats_block *block,
+	enum wsf_stats_hook hook,
+	uint64_t ticks,
+	bool scaled
+) {
+	struct wsf_stats_counters *counters = &block->hooks[hook];
+	unsigned int bucket = ticks == 0 ? 0u : 63u - (unsigned int) __builtin_clzll(ticks);
+
+	if (bucket >= WSF_STATS_BUCKETS) {
+		bucket = WSF_STATS_BUCKETS - 1;
+	}
+
+	wsf_stats_bump(&counters->calls, 1);
+	wsf_stats_bump(scaled ? &counters->scaled : &counters->passthrough, 1);
+	wsf_stats_bump(&counters->total_ticks, ticks);
+	wsf_stats_bump(&counters->buckets[bucket], 1);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+#include "wsf_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void wsf_debug_log(bool debug, const char *fmt, ...) {
+	if (!debug) {
+		return;
+	}
+
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "wsf: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static bool wsf_trace_name(char *buf, size_t len) {
+	int written = snprintf(buf, len, "/wsf-trace-%u", (unsigned int) getuid());
+
+	return written > 0 && (size_t) written < len;
+}
+
+static bool wsf_trace_header_valid(const struct wsf_trace_ring *ring) {
+	return ring->magic == WSF_TRACE_MAGIC &&
+		ring->version == WSF_TRACE_VERSION &&
+		ring->size == sizeof(*ring) &&
+		ring->capacity == WSF_TRACE_CAPACITY;
+}
+
+struct wsf_trace_ring *wsf_trace_open(bool create, bool debug) {
+	struct wsf_trace_ring *ring = NULL;
+	struct stat st;
+	char name[64];
+	int flags = O_RDWR | O_CLOEXEC;
+	int fd = -1;
+
+	if (!wsf_trace_name(name, sizeof(name))) {
+		return NULL;
+	}
+
+	if (create) {
+		flags |= O_CREAT;
+	}
+
+	fd = shm_open(name, flags, 0600);
+	if (fd < 0) {
+		if (errno != ENOENT || create) {
+			wsf_debug_log(debug, "trace: open %s failed: %s", name, strerror(errno));
+		}
+		return NULL;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_uid != getuid()) {
+		wsf_debug_log(debug, "trace: %s not owned by this user", name);
+		close(fd);
+		return NULL;
+	}
+
+	if ((size_t) st.st_size < sizeof(*ring)) {
+		if (!create || ftruncate(fd, sizeof(*ring)) != 0) {
+			close(fd);
+			return NULL;
+		}
+	}
+
+	ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		wsf_debug_log(debug, "trace: mmap failed: %s", strerror(errno));
+		return NULL;
+	}
+
+	/* A new producer always starts from an empty ring. */
+	if (create || !wsf_trace_header_valid(ring)) {
+		if (!create) {
+			wsf_debug_log(debug, "trace: %s has an unknown layout", name);
+			munmap(ring, sizeof(*ring));
+			return NULL;
+		}
+		memset(ring, 0, sizeof(*ring));
+		ring->magic = WSF_TRACE_MAGIC;
+		ring->version = WSF_TRACE_VERSION;
+		ring->size = sizeof(*ring);
+		ring->capacity = WSF_TRACE_CAPACITY;
+		ring->owner_pid = (uint32_t) getpid();
+	}
+
+	return ring;
+}
+
+void wsf_trace_close(struct wsf_trace_ring *ring) {
+	if (ring != NULL) {
+		munmap(ring, sizeof(*ring));
+	}
+}
+
+uint64_t wsf_trace_head(const struct wsf_trace_ring *ring) {
+	return atomic_load_explicit(
+		(_Atomic uint64_t *) &ring->head,
+		memory_order_acquire
+	);
+}
+
+/* False when the slot no longer (or not yet) holds record index. */
+bool wsf_trace_read(
+	const struct wsf_trace_ring *ring,
+	uint64_t index,
+	struct wsf_trace_entry *out_entry
+) {
+	const struct wsf_trace_record *record =
+		&ring->records[index & (WSF_TRACE_CAPACITY - 1)];
+	uint64_t seq = atomic_load_explicit(
+		(_Atomic uint64_t *) &record->seq,
+		memory_order_acquire
+	);
+
+	if (seq != index + 1) {
+		return false;
+	}
+
+	out_entry->index = index;
+	out_entry->time_us = record->time_us;
+	out_entry->raw = record->raw;
+	out_entry->scaled = record->scaled;
+	out_entry->velocity = record->velocity;
+	out_entry->multiplier = record->multiplier;
+	out_entry->axis = record->axis;
+	out_entry->source = record->source;
+	out_entry->getter = record->getter;
+	out_entry->device = record->device;
+	atomic_thread_fence(memory_order_acquire);
+
+	return atomic_load_explicit(
+		(_Atomic uint64_t *) &record->seq,
+		memory_order_relaxed
+	) == seq;
+}
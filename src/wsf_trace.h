@@ -0,0 +1,91 @@
+#ifndef WSF_TRACE_H
+#define WSF_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WSF_TRACE_MAGIC 0x52545357u
+#define WSF_TRACE_VERSION 1u
+#define WSF_TRACE_CAPACITY 8192u
+
+/*
+ * One scaled scroll event. seq is index + 1 of the ring position the
+ * record was written for, 0 while the producer is rewriting the slot.
+ */
+struct wsf_trace_record {
+	_Atomic uint64_t seq;
+	uint64_t time_us;
+	double raw;
+	double scaled;
+	double velocity;
+	double multiplier;
+	uint32_t axis;
+	uint32_t source;
+	uint32_t getter;
+	uint32_t device;
+};
+
+_Static_assert(sizeof(struct wsf_trace_record) == 64, "trace record must be 64 bytes");
+
+/*
+ * Ring at /dev/shm/wsf-trace-$UID. The compositor's input thread is the
+ * only producer and writes records with plain stores; readers validate
+ * each record against its seq and skip slots that were overwritten.
+ */
+struct wsf_trace_ring {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t capacity;
+	uint32_t owner_pid;
+	uint32_t reserved;
+	_Atomic uint64_t head;
+	_Alignas(64) struct wsf_trace_record records[WSF_TRACE_CAPACITY];
+};
+
+struct wsf_trace_entry {
+	uint64_t index;
+	uint64_t time_us;
+	double raw;
+	double scaled;
+	double velocity;
+	double multiplier;
+	uint32_t axis;
+	uint32_t source;
+	uint32_t getter;
+	uint32_t device;
+};
+
+struct wsf_trace_ring *wsf_trace_open(bool create, bool debug);
+void wsf_trace_close(struct wsf_trace_ring *ring);
+uint64_t wsf_trace_head(const struct wsf_trace_ring *ring);
+bool wsf_trace_read(
+	const struct wsf_trace_ring *ring,
+	uint64_t index,
+	struct wsf_trace_entry *out_entry
+);
+
+static inline void wsf_trace_push(
+	struct wsf_trace_ring *ring,
+	const struct wsf_trace_entry *entry
+) {
+	uint64_t index = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	struct wsf_trace_record *record = &ring->records[index & (WSF_TRACE_CAPACITY - 1)];
+
+	atomic_store_explicit(&record->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	record->time_us = entry->time_us;
+	record->raw = entry->raw;
+	record->scaled = entry->scaled;
+	record->velocity = entry->velocity;
+	record->multiplier = entry->multiplier;
+	record->axis = entry->axis;
+	record->source = entry->source;
+	record->getter = entry->getter;
+	record->device = entry->device;
+	atomic_store_explicit(&record->seq, index + 1, memory_order_release);
+	atomic_store_explicit(&ring->head, index + 1, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+
+#include "wsf_watch.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WSF_WATCH_DIR_MASK \
+	(IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | \
+		IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define WSF_WATCH_PARENT_MASK (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR)
+
+struct wsf_watch {
+	char dir[PATH_MAX];
+	char parent[PATH_MAX];
+	const char *name;
+	const char *dir_name;
+	wsf_watch_fn on_change;
+	void *data;
+	bool debug;
+	int fd;
+	int dir_wd;
+	int parent_wd;
+};
+
+static void wsf_debug_log(bool debug, const char *fmt, ...) {
+	if (!debug) {
+		return;
+	}
+
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "wsf: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+static bool wsf_split_path(char *path, const char **out_name) {
+	char *slash = strrchr(path, '/');
+
+	if (slash == NULL || slash == path || slash[1] == '\0') {
+		return false;
+	}
+
+	*slash = '\0';
+	*out_name = slash + 1;
+	return true;
+}
+
+/* Watches the directory if it exists, otherwise waits for it in the parent. */
+static bool wsf_watch_arm(struct wsf_watch *watch) {
+	watch->dir_wd = inotify_add_watch(watch->fd, watch->dir, WSF_WATCH_DIR_MASK);
+	if (watch->dir_wd >= 0) {
+		if (watch->parent_wd >= 0) {
+			inotify_rm_watch(watch->fd, watch->parent_wd);
+			watch->parent_wd = -1;
+		}
+		return true;
+	}
+
+	if (watch->parent_wd < 0) {
+		watch->parent_wd =
+			inotify_add_watch(watch->fd, watch->parent, WSF_WATCH_PARENT_MASK);
+	}
+	if (watch->parent_wd < 0) {
+		wsf_debug_log(
+			watch->debug,
+			"watch: cannot watch %s: %s",
+			watch->parent,
+			strerror(errno)
+		);
+		return false;
+	}
+
+	/* The directory may have appeared before the parent watch was armed. */
+	watch->dir_wd = inotify_add_watch(watch->fd, watch->dir, WSF_WATCH_DIR_MASK);
+	if (watch->dir_wd >= 0) {
+		inotify_rm_watch(watch->fd, watch->parent_wd);
+		watch->parent_wd = -1;
+	}
+
+	return true;
+}
+
+static void *wsf_watch_thread(void *arg) {
+	struct wsf_watch *watch = arg;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	for (;;) {
+		bool changed = false;
+		bool rearm = false;
+		ssize_t len = read(watch->fd, buf, sizeof(buf));
+		char *cursor = buf;
+
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			wsf_debug_log(watch->debug, "watch: read failed: %s", strerror(errno));
+			break;
+		}
+
+		while (cursor < buf + len) {
+			const struct inotify_event *event = (const struct inotify_event *) cursor;
+
+			cursor += sizeof(*event) + event->len;
+
+			if (event->wd == watch->dir_wd) {
+				if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0) {
+					rearm = true;
+					changed = true;
+					continue;
+				}
+				if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+					changed = true;
+				}
+				continue;
+			}
+
+			if (event->wd == watch->parent_wd && event->len > 0 &&
+				strcmp(event->name, watch->dir_name) == 0) {
+				rearm = true;
+				changed = true;
+			}
+		}
+
+		if (rearm) {
+			if (watch->dir_wd >= 0) {
+				inotify_rm_watch(watch->fd, watch->dir_wd);
+				watch->dir_wd = -1;
+			}
+			if (!wsf_watch_arm(watch)) {
+				break;
+			}
+		}
+
+		if (changed) {
+			watch->on_change(watch->data);
+		}
+	}
+
+	close(watch->fd);
+	free(watch);
+	return NULL;
+}
+
+bool wsf_watch_start(const char *path, wsf_watch_fn on_change, void *data, bool debug) {
+	struct wsf_watch *watch = NULL;
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t all_signals;
+	sigset_t old_signals;
+	int written = 0;
+	int rc = 0;
+
+	if (path == NULL || on_change == NULL) {
+		return false;
+	}
+
+	watch = calloc(1, sizeof(*watch));
+	if (watch == NULL) {
+		return false;
+	}
+
+	written = snprintf(watch->dir, sizeof(watch->dir), "%s", path);
+	if (written <= 0 || (size_t) written >= sizeof(watch->dir) ||
+		!wsf_split_path(watch->dir, &watch->name)) {
+		free(watch);
+		return false;
+	}
+	written = snprintf(watch->parent, sizeof(watch->parent), "%s", watch->dir);
+	if (written <= 0 || (size_t) written >= sizeof(watch->parent) ||
+		!wsf_split_path(watch->parent, &watch->dir_name)) {
+		free(watch);
+		return false;
+	}
+
+	watch->on_change = on_change;
+	watch->data = data;
+	watch->debug = debug;
+	watch->dir_wd = -1;
+	watch->parent_wd = -1;
+	watch->fd = inotify_init1(IN_CLOEXEC);
+	if (watch->fd < 0) {
+		wsf_debug_log(debug, "watch: inotify_init1 failed: %s", strerror(errno));
+		free(watch);
+		return false;
+	}
+	if (!wsf_watch_arm(watch)) {
+		close(watch->fd);
+		free(watch);
+		return false;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+	rc = pthread_create(&thread, &attr, wsf_watch_thread, watch);
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0) {
+		wsf_debug_log(debug, "watch: pthread_create failed: %s", strerror(rc));
+		close(watch->fd);
+		free(watch);
+		return false;
+	}
+
+	wsf_debug_log(debug, "watch: watching %s/%s", watch->dir, watch->name);
+	return true;
+}
@@ -0,0 +1,17 @@
+#ifndef WSF_WATCH_H
+#define WSF_WATCH_H
+
+#include <stdbool.h>
+
+typedef void (*wsf_watch_fn)(void *data);
+
+/*
+ * Starts a detached background thread that calls on_change whenever the
+ * file at path is rewritten in place (IN_CLOSE_WRITE), renamed into place
+ * or removed. The parent directory may not exist yet; it is picked up once
+ * created. The thread blocks all signals so the host process keeps its own
+ * signal routing.
+ */
+bool wsf_watch_start(const char *path, wsf_watch_fn on_change, void *data, bool debug);
+
+#endif
@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# usage: analyze-threads.sh <wsf> <config> <events>
+# The replay events repeated into a file large enough to be cut into many
+# chunks: the report must not depend on the thread count, and the events
+# that reach the curve must be the ones replay gives a multiplier.
+WSF="$1"
+CONFIG="$2"
+EVENTS="$3"
+
+DIR="$(mktemp -d)"
+trap 'rm -rf "$DIR"' EXIT
+
+for _ in $(seq 2000); do
+  cat "$EVENTS"
+done >"$DIR/corpus.txt"
+
+report() {
+  "$WSF" analyze --config "$CONFIG" --threads "$1" "$DIR/corpus.txt" |
+    grep -v '^seconds ' | sed 's/ threads [0-9]* / threads - /'
+}
+
+report 1 >"$DIR/one.txt"
+report 8 >"$DIR/eight.txt"
+if ! diff -u "$DIR/one.txt" "$DIR/eight.txt"; then
+  echo "analyze output depends on the thread count" >&2
+  exit 1
+fi
+
+curve="$(sed -n 's/.* curve \([0-9]*\) .*/\1/p' "$DIR/one.txt")"
+expected="$("$WSF" replay --config "$CONFIG" "$DIR/corpus.txt" |
+  awk '$1 == "scroll" && $8 != "-" { n++ } END { print n + 0 }')"
+if [ "$curve" != "$expected" ]; then
+  echo "analyze counted $curve curve events, replay scaled $expected" >&2
+  exit 1
+fi
@@ -0,0 +1,212 @@
+/*
+ * Checks the libwsf_core state-object API against itself: a batch call,
+ * which collects velocities per axis and looks the curve up in one vector
+ * pass, must give the same bits as per-event calls, the curve sampler and every
+ * vector curve kernel the CPU runs the same as the single-point lookup,
+ * and a reset state the same as a fresh one.
+ * The golden replay test covers the values themselves, since `wsf replay`
+ * goes through wsf_core_scale().
+ *
+ * usage: core-api <config>
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wsf_core.h"
+
+#define EVENT_COUNT 4096
+#define KERNEL_SAMPLES 1027
+
+static const uint32_t sources[] = {
+	WSF_SCROLL_SOURCE_FINGER,
+	WSF_SCROLL_SOURCE_CONTINUOUS,
+	WSF_SCROLL_SOURCE_WHEEL,
+	WSF_SCROLL_SOURCE_FINGER,
+};
+
+/*
+ * A deterministic mix of axes, devices (a few without a velocity slot),
+ * sources, gaps and gestures.
+ */
+static void make_events(struct wsf_core_event *events, size_t count) {
+	uint64_t time_us = 1000000;
+	uint32_t seed = 12345;
+	size_t i = 0;
+
+	for (i = 0; i < count; i++) {
+		struct wsf_core_event *event = &events[i];
+
+		seed = seed * 1103515245u + 12345u;
+		time_us += 2000 + (seed >> 16) % (i % 97 == 0 ? 400000 : 12000);
+		memset(event, 0, sizeof(*event));
+		event->time_us = time_us;
+		event->has_time = (seed >> 8) % 13 != 0;
+		event->kind = (seed >> 4) % 9 == 0 ? WSF_CORE_PINCH_ZOOM + (seed >> 12) % 2 :
+			(seed >> 10) % 2;
+		event->source = sources[(seed >> 20) % 4];
+		event->device = (seed >> 18) % 61 == 0 ? WSF_CORE_DEVICES : (seed >> 24) % 3;
+		event->value = event->kind == WSF_CORE_PINCH_ZOOM ?
+			0.9 + (double) ((seed >> 6) % 200) / 1000.0 :
+			(double) ((int) ((seed >> 6) % 4001) - 2000) / 100.0;
+	}
+}
+
+/* Ends of the table, non-finite input and an odd count for the tails. */
+static bool check_kernels(const struct wsf_core *core) {
+	const struct wsf_curve_table *table = &core->curve_table;
+	const double edges[] = {
+		NAN,
+		-INFINITY,
+		INFINITY,
+		-1.0,
+		0.0,
+		table->velocity_min,
+		nextafter(table->velocity_min, INFINITY),
+		nextafter(table->velocity_max, 0.0),
+		table->velocity_max,
+		nextafter(table->velocity_max, INFINITY),
+	};
+	size_t edge_count = sizeof(edges) / sizeof(edges[0]);
+	double velocities[KERNEL_SAMPLES];
+	double out[KERNEL_SAMPLES];
+	int kernel = 0;
+	size_t i = 0;
+
+	for (i = 0; i < KERNEL_SAMPLES; i++) {
+		velocities[i] = i < edge_count ? edges[i] :
+			table->velocity_max * 1.5 * (double) (i - edge_count) / KERNEL_SAMPLES;
+	}
+
+	for (kernel = WSF_CURVE_KERNEL_SCALAR; kernel <= (int) wsf_curve_kernel_widest(); kernel++) {
+		wsf_curve_lookup_batch(table, kernel, 0.75, velocities, out, KERNEL_SAMPLES);
+		for (i = 0; i < KERNEL_SAMPLES; i++) {
+			double expected = 0.75 * wsf_curve_lookup(table, velocities[i]);
+
+			if (memcmp(&expected, &out[i], sizeof(expected)) != 0) {
+				fprintf(
+					stderr,
+					"core-api: %s kernel at velocity %.17g: %.17g, expected %.17g\n",
+					wsf_curve_kernel_name(kernel),
+					velocities[i],
+					out[i],
+					expected
+				);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv) {
+	struct wsf_core_event *events = NULL;
+	double *batch = NULL;
+	struct wsf_core *single = NULL;
+	struct wsf_core *batched = NULL;
+	double velocities[64];
+	double sampled[64];
+	double range_min = 0.0;
+	double range_max = 0.0;
+	double first = 0.0;
+	unsigned int axis = 0;
+	size_t i = 0;
+	int failed = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: core-api <config>\n");
+		return 2;
+	}
+
+	single = wsf_core_new(argv[1]);
+	batched = wsf_core_new(argv[1]);
+	events = calloc(EVENT_COUNT, sizeof(*events));
+	batch = calloc(EVENT_COUNT, sizeof(*batch));
+	if (single == NULL || batched == NULL || events == NULL || batch == NULL) {
+		fprintf(stderr, "core-api: cannot load %s\n", argv[1]);
+		return 2;
+	}
+	if (wsf_core_new("/nonexistent/wsf-config") != NULL) {
+		fprintf(stderr, "core-api: a missing config loaded\n");
+		failed = 1;
+	}
+
+	make_events(events, EVENT_COUNT);
+	wsf_core_scale_batch(batched, events, batch, EVENT_COUNT);
+	for (i = 0; i < EVENT_COUNT; i++) {
+		double value = wsf_core_scale(single, &events[i], NULL);
+
+		if (i == 0) {
+			first = value;
+		}
+		if (memcmp(&value, &batch[i], sizeof(value)) != 0) {
+			fprintf(
+				stderr,
+				"core-api: event %zu: single %.17g, batch %.17g\n",
+				i,
+				value,
+				batch[i]
+			);
+			failed = 1;
+			break;
+		}
+	}
+
+	wsf_core_reset(single);
+	if (wsf_core_scale(single, &events[0], NULL) != first) {
+		fprintf(stderr, "core-api: reset state differs from a fresh one\n");
+		failed = 1;
+	}
+
+	wsf_core_curve_range(single, &range_min, &range_max);
+	if (!(range_max > range_min)) {
+		fprintf(stderr, "core-api: empty curve range %g..%g\n", range_min, range_max);
+		failed = 1;
+	}
+	for (i = 0; i < 64; i++) {
+		velocities[i] = range_max * 1.25 * (double) i / 63.0;
+	}
+	for (axis = WSF_CORE_SCROLL_VERTICAL; axis <= WSF_CORE_SCROLL_HORIZONTAL; axis++) {
+		wsf_core_curve_sample(single, axis, velocities, sampled, 64);
+		for (i = 0; i < 64; i++) {
+			if (sampled[i] != wsf_core_curve_multiplier(single, axis, velocities[i])) {
+				fprintf(stderr, "core-api: axis %u sample %zu differs\n", axis, i);
+				failed = 1;
+				break;
+			}
+		}
+	}
+
+	if (!check_kernels(single)) {
+		failed = 1;
+	}
+
+	/* An axis at 1.0 is left alone, as the preload leaves it. */
+	wsf_core_set_factors(single, 1.0, 1.0, 1.0, 1.0);
+	wsf_core_curve_sample(single, WSF_CORE_SCROLL_VERTICAL, velocities, sampled, 64);
+	for (i = 0; i < 64; i++) {
+		if (sampled[i] != 1.0) {
+			fprintf(stderr, "core-api: factor 1.0 sample %zu is %.17g\n", i, sampled[i]);
+			failed = 1;
+			break;
+		}
+	}
+	wsf_core_scale_batch(single, events, batch, EVENT_COUNT);
+	for (i = 0; i < EVENT_COUNT; i++) {
+		if (events[i].kind <= WSF_CORE_SCROLL_HORIZONTAL &&
+			memcmp(&batch[i], &events[i].value, sizeof(batch[i])) != 0) {
+			fprintf(stderr, "core-api: factor 1.0 event %zu scaled to %.17g\n", i, batch[i]);
+			failed = 1;
+			break;
+		}
+	}
+
+	wsf_core_free(single);
+	wsf_core_free(batched);
+	free(events);
+	free(batch);
+	return failed;
+}
@@ -0,0 +1,257 @@
+#define _GNU_SOURCE
+
+/*
+ * Builds small ld.so.cache files in each layout ldconfig has written (new
+ * only, old with the new table appended, old only) plus damaged ones, and
+ * checks which entries the reader reports and in what order.
+ *
+ * usage: ld-cache
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wsf_ldcache.h"
+
+#define CACHE_MAX 4096
+#define ENTRY_MAX 8
+#define FLAG_X8664_LIBC6 0x0303
+#define FLAG_I386_LIBC6 0x0003
+#define FLAG_ELF 0x0001
+
+enum cache_layout {
+	CACHE_NEW,
+	CACHE_COMPAT,
+	CACHE_OLD,
+};
+
+struct cache_entry {
+	int32_t flags;
+	const char *name;
+	const char *path;
+};
+
+static const struct cache_entry entries[] = {
+	{ FLAG_X8664_LIBC6, "libinput.so.10", "/usr/lib64/libinput.so.10.13.0" },
+	{ FLAG_I386_LIBC6, "libinput.so.10", "/usr/lib32/libinput.so.10.13.0" },
+	{ FLAG_X8664_LIBC6, "libinput-tools.so.1", "/usr/lib64/libinput-tools.so.1" },
+	{ FLAG_X8664_LIBC6, "libc.so.6", "/usr/lib64/libc.so.6" },
+	{ FLAG_ELF, "libinput.so.5", "/usr/lib/libinput.so.5" },
+};
+
+#define ENTRY_COUNT (sizeof(entries) / sizeof(entries[0]))
+
+struct lookup {
+	char seen[ENTRY_MAX][64];
+	unsigned int count;
+	unsigned int stop_at;
+};
+
+static void put_u32(unsigned char *buf, size_t at, uint32_t value) {
+	memcpy(buf + at, &value, sizeof(value));
+}
+
+/* Appends the strings at *end and returns the offsets relative to base. */
+static void put_strings(
+	unsigned char *buf,
+	size_t *end,
+	size_t base,
+	uint32_t *name_offsets,
+	uint32_t *path_offsets
+) {
+	size_t i = 0;
+
+	for (i = 0; i < ENTRY_COUNT; i++) {
+		size_t len = strlen(entries[i].name) + 1;
+
+		memcpy(buf + *end, entries[i].name, len);
+		name_offsets[i] = (uint32_t) (*end - base);
+		*end += len;
+		len = strlen(entries[i].path) + 1;
+		memcpy(buf + *end, entries[i].path, len);
+		path_offsets[i] = (uint32_t) (*end - base);
+		*end += len;
+	}
+}
+
+static size_t build_new(unsigned char *buf, size_t at) {
+	uint32_t names[ENTRY_MAX];
+	uint32_t paths[ENTRY_MAX];
+	size_t end = at + 48 + ENTRY_COUNT * 24;
+	size_t i = 0;
+
+	memcpy(buf + at, "glibc-ld.so.cache1.1", 20);
+	put_u32(buf, at + 20, ENTRY_COUNT);
+	put_strings(buf, &end, at, names, paths);
+	put_u32(buf, at + 24, (uint32_t) (end - (at + 48 + ENTRY_COUNT * 24)));
+	for (i = 0; i < ENTRY_COUNT; i++) {
+		size_t entry = at + 48 + i * 24;
+
+		put_u32(buf, entry, (uint32_t) entries[i].flags);
+		put_u32(buf, entry + 4, names[i]);
+		put_u32(buf, entry + 8, paths[i]);
+	}
+
+	return end;
+}
+
+static size_t build_cache(unsigned char *buf, enum cache_layout layout) {
+	uint32_t names[ENTRY_MAX];
+	uint32_t paths[ENTRY_MAX];
+	size_t table_end = 16 + ENTRY_COUNT * 12;
+	size_t end = table_end;
+	size_t i = 0;
+
+	memset(buf, 0, CACHE_MAX);
+	if (layout == CACHE_NEW) {
+		return build_new(buf, 0);
+	}
+
+	memcpy(buf, "ld.so-1.7.0", 11);
+	put_u32(buf, 12, ENTRY_COUNT);
+	if (layout == CACHE_COMPAT) {
+		/* The old entries point into the new table's strings. */
+		size_t new_at = (table_end + 7) & ~(size_t) 7;
+
+		end = build_new(buf, new_at);
+		put_strings(buf, &end, table_end, names, paths);
+	} else {
+		put_strings(buf, &end, table_end, names, paths);
+	}
+	for (i = 0; i < ENTRY_COUNT; i++) {
+		size_t entry = 16 + i * 12;
+
+		/* Old entries are dropped when a new table follows; mark them. */
+		put_u32(buf, entry, layout == CACHE_COMPAT ? FLAG_ELF : (uint32_t) entries[i].flags);
+		put_u32(buf, entry + 4, names[i]);
+		put_u32(buf, entry + 8, paths[i]);
+	}
+
+	return end;
+}
+
+static bool record_entry(const char *name, const char *path, void *data) {
+	struct lookup *lookup = data;
+
+	if (lookup->count < ENTRY_MAX) {
+		snprintf(lookup->seen[lookup->count], sizeof(lookup->seen[0]), "%s=%s", name, path);
+	}
+	lookup->count++;
+	return lookup->count == lookup->stop_at;
+}
+
+static bool write_cache(const char *path, const unsigned char *buf, size_t len) {
+	FILE *file = fopen(path, "we");
+	bool ok = false;
+
+	if (file == NULL) {
+		return false;
+	}
+	ok = fwrite(buf, 1, len, file) == len;
+	return fclose(file) == 0 && ok;
+}
+
+static int check(
+	const char *label,
+	const char *path,
+	unsigned int stop_at,
+	bool expect_found,
+	unsigned int expect_count,
+	const char *const *expect_seen
+) {
+	struct lookup lookup;
+	bool found = false;
+	unsigned int i = 0;
+	int failed = 0;
+
+	memset(&lookup, 0, sizeof(lookup));
+	lookup.stop_at = stop_at;
+	found = wsf_ldcache_find(path, "libinput.so", record_entry, &lookup);
+	if (found != expect_found || lookup.count != expect_count) {
+		fprintf(
+			stderr,
+			"ld-cache: %s: found=%d count=%u, expected found=%d count=%u\n",
+			label,
+			found,
+			lookup.count,
+			expect_found,
+			expect_count
+		);
+		failed = 1;
+	}
+	for (i = 0; i < expect_count && i < lookup.count && i < ENTRY_MAX; i++) {
+		if (strcmp(lookup.seen[i], expect_seen[i]) != 0) {
+			fprintf(
+				stderr,
+				"ld-cache: %s: entry %u: expected \"%s\", got \"%s\"\n",
+				label,
+				i + 1,
+				expect_seen[i],
+				lookup.seen[i]
+			);
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
+
+int main(void) {
+	static const char *const libinput_entries[] = {
+		"libinput.so.10=/usr/lib64/libinput.so.10.13.0",
+		"libinput.so.10=/usr/lib32/libinput.so.10.13.0",
+	};
+	static const char *const layout_names[] = { "new", "compat", "old" };
+	unsigned char buf[CACHE_MAX];
+	char path[] = "/tmp/wsf-ld-cache-XXXXXX";
+	size_t len = 0;
+	int failed = 0;
+	int fd = mkstemp(path);
+	int layout = 0;
+
+	if (fd < 0) {
+		perror("ld-cache: mkstemp");
+		return 2;
+	}
+	close(fd);
+
+	for (layout = CACHE_NEW; layout <= CACHE_OLD; layout++) {
+		len = build_cache(buf, (enum cache_layout) layout);
+		if (!write_cache(path, buf, len)) {
+			perror("ld-cache: write");
+			unlink(path);
+			return 2;
+		}
+		failed |= check(layout_names[layout], path, 0, false, 2, libinput_entries);
+		failed |= check(layout_names[layout], path, 1, true, 1, libinput_entries);
+	}
+
+	/* Entry count past the end of the file. */
+	len = build_cache(buf, CACHE_NEW);
+	put_u32(buf, 20, 1000000);
+	write_cache(path, buf, len);
+	failed |= check("count", path, 0, false, 0, NULL);
+
+	/* A string offset outside the file skips just that entry. */
+	len = build_cache(buf, CACHE_NEW);
+	put_u32(buf, 48 + 4, (uint32_t) len + 16);
+	write_cache(path, buf, len);
+	failed |= check("offset", path, 0, false, 1, libinput_entries + 1);
+
+	/* The last path cut off before its terminator. */
+	len = build_cache(buf, CACHE_NEW);
+	put_u32(buf, 48 + (ENTRY_COUNT - 1) * 24, FLAG_X8664_LIBC6);
+	write_cache(path, buf, len - 1);
+	failed |= check("truncated", path, 0, false, 2, libinput_entries);
+
+	write_cache(path, (const unsigned char *) "not a cache", 11);
+	failed |= check("magic", path, 0, false, 0, NULL);
+
+	unlink(path);
+	failed |= check("missing", path, 0, false, 0, NULL);
+
+	return failed;
+}
@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+
+/*
+ * Drives the niri IPC watcher against a mock niri: a unix socket in a
+ * private XDG_RUNTIME_DIR, named like the one niri creates for this
+ * process, that answers the EventStream request and then replays recorded
+ * event lines before hanging up. Every focus change the watcher reports
+ * must match the expected file, one "<app_id> <output>" line per change
+ * with "-" for an empty field.
+ *
+ * usage: niri-focus <events.jsonl> <expected.txt>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wsf_niri.h"
+
+#define MOCK_MAX_REPORTS 64
+#define MOCK_TIMEOUT_SEC 10
+
+struct mock_niri {
+	int listen_fd;
+	char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+	char *events;
+	size_t events_len;
+	bool request_ok;
+};
+
+static pthread_mutex_t reports_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reports_cond = PTHREAD_COND_INITIALIZER;
+static char reports[MOCK_MAX_REPORTS][2 * WSF_FOCUS_NAME_MAX + 2];
+static unsigned int report_count = 0;
+
+static bool read_file(const char *path, char **out, size_t *out_len) {
+	FILE *file = fopen(path, "r");
+	char *data = NULL;
+	long len = 0;
+
+	if (file == NULL) {
+		fprintf(stderr, "niri-focus: cannot open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	if (fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) < 0 ||
+		fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return false;
+	}
+	data = malloc((size_t) len + 1);
+	if (data == NULL || fread(data, 1, (size_t) len, file) != (size_t) len) {
+		free(data);
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+
+	data[len] = '\0';
+	*out = data;
+	*out_len = (size_t) len;
+	return true;
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		len -= (size_t) written;
+	}
+
+	return true;
+}
+
+/* Serves one client, then stops listening so reconnects find nothing. */
+static void *mock_serve(void *arg) {
+	struct mock_niri *mock = arg;
+	char request[64];
+	size_t used = 0;
+	int fd = accept(mock->listen_fd, NULL, NULL);
+
+	close(mock->listen_fd);
+	unlink(mock->socket_path);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	while (used < sizeof(request) - 1 && memchr(request, '\n', used) == NULL) {
+		ssize_t len = read(fd, request + used, sizeof(request) - 1 - used);
+
+		if (len <= 0) {
+			break;
+		}
+		used += (size_t) len;
+	}
+	request[used] = '\0';
+
+	mock->request_ok = strcmp(request, "\"EventStream\"\n") == 0;
+	if (mock->request_ok) {
+		write_all(fd, "{\"Ok\":\"Handled\"}\n", 17);
+		write_all(fd, mock->events, mock->events_len);
+	} else {
+		write_all(fd, "{\"Err\":\"unexpected request\"}\n", 29);
+	}
+	close(fd);
+	return NULL;
+}
+
+static void record_focus(const struct wsf_niri_focus *focus, void *data) {
+	(void) data;
+
+	pthread_mutex_lock(&reports_lock);
+	if (report_count < MOCK_MAX_REPORTS) {
+		snprintf(
+			reports[report_count++],
+			sizeof(reports[0]),
+			"%s %s",
+			focus->app_id[0] != '\0' ? focus->app_id : "-",
+			focus->output[0] != '\0' ? focus->output : "-"
+		);
+	}
+	pthread_cond_broadcast(&reports_cond);
+	pthread_mutex_unlock(&reports_lock);
+}
+
+int main(int argc, char **argv) {
+	struct mock_niri mock;
+	struct sockaddr_un addr;
+	struct timespec deadline;
+	char runtime_dir[] = "/tmp/wsf-niri-XXXXXX";
+	char *expected = NULL;
+	char *line = NULL;
+	char *save = NULL;
+	size_t expected_len = 0;
+	unsigned int expected_count = 0;
+	unsigned int i = 0;
+	pthread_t server;
+	int failed = 0;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: niri-focus <events.jsonl> <expected.txt>\n");
+		return 2;
+	}
+
+	memset(&mock, 0, sizeof(mock));
+	if (!read_file(argv[1], &mock.events, &mock.events_len) ||
+		!read_file(argv[2], &expected, &expected_len)) {
+		return 2;
+	}
+	for (i = 0; i < expected_len; i++) {
+		expected_count += expected[i] == '\n';
+	}
+
+	if (mkdtemp(runtime_dir) == NULL) {
+		perror("niri-focus: mkdtemp");
+		return 2;
+	}
+	snprintf(
+		mock.socket_path,
+		sizeof(mock.socket_path),
+		"%s/niri.wayland-1.%ld.sock",
+		runtime_dir,
+		(long) getpid()
+	);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, mock.socket_path, sizeof(addr.sun_path));
+
+	mock.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (mock.listen_fd < 0 ||
+		bind(mock.listen_fd, (const struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+		listen(mock.listen_fd, 1) != 0) {
+		perror("niri-focus: mock socket");
+		rmdir(runtime_dir);
+		return 2;
+	}
+	pthread_create(&server, NULL, mock_serve, &mock);
+
+	setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+	if (!wsf_niri_watch_start(record_focus, NULL, getenv("WSF_DEBUG") != NULL)) {
+		fprintf(stderr, "niri-focus: watcher did not start\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += MOCK_TIMEOUT_SEC;
+	pthread_mutex_lock(&reports_lock);
+	while (report_count < expected_count &&
+		pthread_cond_timedwait(&reports_cond, &reports_lock, &deadline) == 0) {
+	}
+	pthread_mutex_unlock(&reports_lock);
+	pthread_join(server, NULL);
+	rmdir(runtime_dir);
+
+	if (!mock.request_ok) {
+		fprintf(stderr, "niri-focus: watcher sent an unexpected request\n");
+		return 1;
+	}
+
+	pthread_mutex_lock(&reports_lock);
+	line = strtok_r(expected, "\n", &save);
+	for (i = 0; i < report_count || line != NULL; i++) {
+		const char *actual = i < report_count ? reports[i] : "(none)";
+
+		if (line == NULL || strcmp(line, actual) != 0) {
+			fprintf(
+				stderr,
+				"niri-focus: change %u: expected \"%s\", got \"%s\"\n",
+				i + 1,
+				line != NULL ? line : "(none)",
+				actual
+			);
+			failed = 1;
+		}
+		if (line != NULL) {
+			line = strtok_r(NULL, "\n", &save);
+		}
+	}
+	pthread_mutex_unlock(&reports_lock);
+
+	free(expected);
+	free(mock.events);
+	return failed;
+}
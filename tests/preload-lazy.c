@@ -0,0 +1,43 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stub_libinput.h"
+
+/*
+ * Run with the preload in LD_PRELOAD under a name other than niri, where
+ * init waits for the first hook call: that very first call must already
+ * reach the real getter and pass its value through, like every later one.
+ */
+
+double libinput_event_pointer_get_scroll_value(struct libinput_event *event, int axis);
+double libinput_event_pointer_get_axis_value(struct libinput_event *event, int axis);
+double libinput_event_gesture_get_scale(struct libinput_event *event);
+
+static int lazy_check(const char *name, double got, double expected) {
+	if (got != expected) {
+		fprintf(stderr, "%s returned %.4f, expected %.4f\n", name, got, expected);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	struct libinput_event event = { 0 };
+	int failures = 0;
+
+	event.type = STUB_EVENT_POINTER_SCROLL_FINGER;
+	event.source = STUB_AXIS_SOURCE_FINGER;
+	event.time_usec = 1000000;
+	event.value[0] = 3.0;
+	event.value[1] = -2.0;
+	event.scale = 1.25;
+
+	failures += lazy_check("first scroll query", libinput_event_pointer_get_scroll_value(&event, 0), 3.0);
+	failures += lazy_check("second scroll query", libinput_event_pointer_get_scroll_value(&event, 0), 3.0);
+	failures += lazy_check("axis query", libinput_event_pointer_get_axis_value(&event, 1), -2.0);
+	failures += lazy_check("gesture scale", libinput_event_gesture_get_scale(&event), 1.25);
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
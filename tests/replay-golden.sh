@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# usage: replay-golden.sh <wsf> <config> <events> <expected>
+WSF="$1"
+CONFIG="$2"
+EVENTS="$3"
+EXPECTED="$4"
+
+ACTUAL="$(mktemp)"
+trap 'rm -f "$ACTUAL"' EXIT
+
+"$WSF" replay --config "$CONFIG" "$EVENTS" >"$ACTUAL"
+if ! diff -u "$EXPECTED" "$ACTUAL"; then
+  echo "replay output differs from $EXPECTED" >&2
+  exit 1
+fi
+
+# Determinism: a second run must be byte-identical.
+"$WSF" replay --config "$CONFIG" "$EVENTS" | cmp -s - "$ACTUAL"
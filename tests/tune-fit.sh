@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# usage: tune-fit.sh <wsf> <config>
+# A synthetic session of fast gestures that overshoot and are pulled back
+# by a short, slow one the other way, between slow gestures that land.
+# The fit must not depend on the thread count, must cut the overshoots,
+# and must reach the config file of the HOME it runs under. At factor 1.0
+# niri applies no curve, so there is nothing to fit and nothing to write.
+WSF="$1"
+CONFIG="$2"
+
+DIR="$(mktemp -d)"
+trap 'rm -rf "$DIR"' EXIT
+
+awk 'BEGIN {
+  t = 1000000
+  for (g = 0; g < 120; g++) {
+    sign = (g % 2) ? -1 : 1
+    fast = (g % 3) == 0
+    step = fast ? 14 + (g % 7) : 0.6 + (g % 5) * 0.2
+    for (i = 0; i < 12; i++) {
+      printf "scroll %d vertical finger %.4f\n", t, sign * step
+      t += 8000
+    }
+    if (fast) {
+      t += 250000
+      for (i = 0; i < 8; i++) {
+        printf "scroll %d vertical finger %.4f\n", t, -sign * 6
+        t += 16000
+      }
+    }
+    t += 2000000
+  }
+}' >"$DIR/session.txt"
+
+tune() {
+  HOME="$DIR" "$WSF" tune --config "$CONFIG" --rounds 3 "$@" "$DIR/session.txt" |
+    grep -v '^seconds ' | sed 's/ threads [0-9]*$/ threads -/'
+}
+
+tune --dry-run --threads 1 >"$DIR/one.txt"
+tune --dry-run --threads 4 >"$DIR/four.txt"
+if ! diff -u "$DIR/one.txt" "$DIR/four.txt"; then
+  echo "tune result depends on the thread count" >&2
+  exit 1
+fi
+
+read -r before after < <(awk '$1 == "overshoots" { print $2, $3 }' "$DIR/one.txt")
+if [ -z "$before" ] || [ "$after" -ge "$before" ]; then
+  echo "tune did not reduce overshoots: ${before:-?} -> ${after:-?}" >&2
+  cat "$DIR/one.txt" >&2
+  exit 1
+fi
+
+tune --threads 2 >"$DIR/write.txt"
+grep -q '^config updated$' "$DIR/write.txt"
+max="$(awk '$1 == "max_multiplier" { print $3 }' "$DIR/one.txt")"
+if ! grep -qx 'scroll_curve=smoothstep' "$DIR/.config/wayland-scroll-factor/config" ||
+  ! grep -qx "scroll_curve_max_multiplier=$max" "$DIR/.config/wayland-scroll-factor/config"; then
+  echo "tuned curve missing from the config" >&2
+  cat "$DIR/.config/wayland-scroll-factor/config" >&2
+  exit 1
+fi
+
+sed -e 's/^scroll_vertical_factor=.*/scroll_vertical_factor=1.0/' \
+  -e 's/^scroll_horizontal_factor=.*/scroll_horizontal_factor=1.0/' "$CONFIG" >"$DIR/identity.conf"
+rm -f "$DIR/.config/wayland-scroll-factor/config"
+if HOME="$DIR" "$WSF" tune --config "$DIR/identity.conf" --rounds 1 "$DIR/session.txt" \
+  >"$DIR/identity.txt" 2>&1; then
+  echo "tune fitted a curve for an axis at factor 1.0" >&2
+  cat "$DIR/identity.txt" >&2
+  exit 1
+fi
+if ! grep -q 'vertical scrolling is at factor 1.0' "$DIR/identity.txt" ||
+  [ -e "$DIR/.config/wayland-scroll-factor/config" ]; then
+  echo "tune at factor 1.0 did not say why it has nothing to fit" >&2
+  cat "$DIR/identity.txt" >&2
+  exit 1
+fi
@@ -0,0 +1,966 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_config.h"
+#include "wsf_core.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * `wsf analyze` reads recorded scroll streams (the `wsf replay` grammar,
+ * usually `wsf trace --dump` output) and reports where they sit on the
+ * curve. Each file is mapped and cut at line boundaries into chunks, and
+ * a window of chunks goes through four passes:
+ *
+ *   parse     parallel      lines -> compact scroll events
+ *   velocity  sequential    the preload's per-axis EMA, gesture split
+ *   curve     parallel      batch curve kernel, histograms, region time
+ *   gestures  sequential    per-gesture distance
+ *
+ * The velocity pass depends on every earlier event of the same axis and
+ * stays in file order; it is a few arithmetic operations per event. The
+ * numbers are those `wsf replay` would produce for the same input and
+ * config.
+ */
+
+#define WSF_ANALYZE_CHUNK_MIN (256u * 1024u)
+#define WSF_ANALYZE_CHUNK_MAX (4u * 1024u * 1024u)
+#define WSF_ANALYZE_CHUNKS_PER_THREAD 2
+#define WSF_ANALYZE_LINE_MAX 4096
+#define WSF_ANALYZE_KEYS (WSF_CORE_DEVICES * 2)
+/* Velocity histogram: below 1, 16 bins per octave up to 2^20, and above. */
+#define WSF_ANALYZE_OCTAVES 20
+#define WSF_ANALYZE_OCTAVE_BINS 16
+#define WSF_ANALYZE_VELOCITY_BINS (WSF_ANALYZE_OCTAVES * WSF_ANALYZE_OCTAVE_BINS + 2)
+#define WSF_ANALYZE_MULTIPLIER_BINS 10
+
+enum wsf_analyze_region {
+	WSF_ANALYZE_BELOW = 0,
+	WSF_ANALYZE_RAMP = 1,
+	WSF_ANALYZE_ABOVE = 2,
+	WSF_ANALYZE_REGIONS = 3
+};
+
+struct wsf_analyze_event {
+	uint64_t time_us;
+	double value;
+	uint8_t key;
+	uint8_t source;
+	uint8_t has_time;
+};
+
+struct wsf_analyze_chunk {
+	const char *data;
+	size_t begin;
+	size_t end;
+	uint64_t lines;
+	bool malformed;
+	bool out_of_memory;
+	size_t malformed_offset;
+
+	struct wsf_analyze_event *events;
+	size_t event_count;
+	size_t event_cap;
+
+	/* Events that reach the curve, filled by the velocity pass. */
+	double *velocity;
+	double *multiplier;
+	double *dt_us;
+	double *raw;
+	uint32_t *gesture;
+	uint8_t *axis;
+	size_t curve_count;
+	size_t curve_cap;
+};
+
+/* Per-thread sums of the curve pass, merged at the end. */
+struct wsf_analyze_totals {
+	uint64_t velocity_bins[WSF_ANALYZE_VELOCITY_BINS];
+	uint64_t multiplier_bins[WSF_ANALYZE_MULTIPLIER_BINS];
+	double region_us[WSF_ANALYZE_REGIONS];
+	double velocity_sum;
+	double velocity_max;
+	double multiplier_sum;
+};
+
+struct wsf_analyze {
+	struct wsf_core *core;
+	unsigned int threads;
+	struct wsf_analyze_chunk *chunks;
+	size_t chunk_count;
+	struct wsf_analyze_totals *totals;
+	double multiplier_low;
+	double multiplier_high;
+
+	/* Velocity state of the file being read. */
+	struct wsf_scroll_axis_state state[WSF_ANALYZE_KEYS];
+	uint32_t key_gesture[WSF_ANALYZE_KEYS];
+
+	double *gesture_distance;
+	double *gesture_raw;
+	size_t gesture_count;
+	size_t gesture_cap;
+
+	uint64_t files;
+	uint64_t bytes;
+	uint64_t events;
+	uint64_t scroll;
+	uint64_t curve;
+};
+
+static bool wsf_analyze_reserve_events(struct wsf_analyze_chunk *chunk) {
+	size_t cap = chunk->event_cap == 0 ? 4096 : chunk->event_cap * 2;
+
+	if (!wsf_parallel_grow((void **) &chunk->events, sizeof(*chunk->events), cap)) {
+		return false;
+	}
+	chunk->event_cap = cap;
+	return true;
+}
+
+static bool wsf_analyze_reserve_curve(struct wsf_analyze_chunk *chunk, size_t count) {
+	if (count <= chunk->curve_cap) {
+		return true;
+	}
+	if (!wsf_parallel_grow((void **) &chunk->velocity, sizeof(double), count) ||
+		!wsf_parallel_grow((void **) &chunk->multiplier, sizeof(double), count) ||
+		!wsf_parallel_grow((void **) &chunk->dt_us, sizeof(double), count) ||
+		!wsf_parallel_grow((void **) &chunk->raw, sizeof(double), count) ||
+		!wsf_parallel_grow((void **) &chunk->gesture, sizeof(uint32_t), count) ||
+		!wsf_parallel_grow((void **) &chunk->axis, sizeof(uint8_t), count)) {
+		return false;
+	}
+	chunk->curve_cap = count;
+	return true;
+}
+
+static void wsf_analyze_chunk_free(struct wsf_analyze_chunk *chunk) {
+	free(chunk->events);
+	free(chunk->velocity);
+	free(chunk->multiplier);
+	free(chunk->dt_us);
+	free(chunk->raw);
+	free(chunk->gesture);
+	free(chunk->axis);
+}
+
+/* Parse pass: each line is copied out of the mapping and NUL-terminated. */
+static void wsf_analyze_parse(void *context, size_t index, unsigned int thread) {
+	struct wsf_analyze *analyze = context;
+	struct wsf_analyze_chunk *chunk = &analyze->chunks[index];
+	char line[WSF_ANALYZE_LINE_MAX];
+	size_t pos = chunk->begin;
+
+	(void) thread;
+	chunk->lines = 0;
+	chunk->event_count = 0;
+	chunk->malformed = false;
+	chunk->out_of_memory = false;
+
+	while (pos < chunk->end) {
+		const char *start = chunk->data + pos;
+		const char *newline = memchr(start, '\n', chunk->end - pos);
+		size_t len = newline != NULL ? (size_t) (newline - start) : chunk->end - pos;
+		struct wsf_core_event event;
+		enum wsf_event_status status = WSF_EVENT_MALFORMED;
+
+		if (len < sizeof(line)) {
+			memcpy(line, start, len);
+			line[len] = '\0';
+			status = wsf_event_parse(line, &event);
+		}
+		if (status == WSF_EVENT_MALFORMED) {
+			chunk->malformed = true;
+			chunk->malformed_offset = pos;
+			return;
+		}
+		pos += len + 1;
+		if (status == WSF_EVENT_NONE) {
+			continue;
+		}
+
+		chunk->lines++;
+		if (event.kind > WSF_CORE_SCROLL_HORIZONTAL) {
+			continue;
+		}
+		if (chunk->event_count == chunk->event_cap && !wsf_analyze_reserve_events(chunk)) {
+			chunk->out_of_memory = true;
+			return;
+		}
+		chunk->events[chunk->event_count++] = (struct wsf_analyze_event) {
+			event.time_us,
+			event.value,
+			(uint8_t) (event.device * 2 + event.kind),
+			(uint8_t) event.source,
+			(uint8_t) event.has_time,
+		};
+	}
+
+	if (!wsf_analyze_reserve_curve(chunk, chunk->event_count)) {
+		chunk->out_of_memory = true;
+	}
+}
+
+static bool wsf_analyze_new_gesture(struct wsf_analyze *analyze, unsigned int key) {
+	if (analyze->gesture_count == analyze->gesture_cap) {
+		size_t cap = analyze->gesture_cap == 0 ? 1024 : analyze->gesture_cap * 2;
+
+		if (!wsf_parallel_grow((void **) &analyze->gesture_distance, sizeof(double), cap) ||
+			!wsf_parallel_grow((void **) &analyze->gesture_raw, sizeof(double), cap)) {
+			return false;
+		}
+		analyze->gesture_cap = cap;
+	}
+
+	analyze->gesture_distance[analyze->gesture_count] = 0.0;
+	analyze->gesture_raw[analyze->gesture_count] = 0.0;
+	analyze->key_gesture[key] = (uint32_t) analyze->gesture_count++;
+	return true;
+}
+
+/* Velocity pass: the same classification and EMA as the preload's hook. */
+static bool wsf_analyze_velocity(struct wsf_analyze *analyze, struct wsf_analyze_chunk *chunk) {
+	const struct wsf_core *core = analyze->core;
+	size_t i = 0;
+
+	chunk->curve_count = 0;
+	for (i = 0; i < chunk->event_count; i++) {
+		const struct wsf_analyze_event *event = &chunk->events[i];
+		unsigned int axis = event->key & 1u;
+		struct wsf_scroll_axis_state *state = &analyze->state[event->key];
+		size_t slot = chunk->curve_count;
+		double scaled = 0.0;
+		double dt_us = 0.0;
+
+		if (!wsf_engine_scroll_source_scaled(event->source) ||
+			wsf_engine_scroll_trivial(event->value, core->scroll_factor[axis], &scaled)) {
+			continue;
+		}
+		if (wsf_engine_scroll_restarts(
+				&core->curve,
+				state,
+				event->has_time != 0,
+				event->time_us,
+				&dt_us
+			) &&
+			!wsf_analyze_new_gesture(analyze, event->key)) {
+			return false;
+		}
+
+		chunk->velocity[slot] = wsf_engine_scroll_velocity(
+			&core->curve,
+			state,
+			event->has_time != 0,
+			event->time_us,
+			event->value
+		);
+		chunk->dt_us[slot] = dt_us;
+		chunk->raw[slot] = event->value;
+		chunk->gesture[slot] = analyze->key_gesture[event->key];
+		chunk->axis[slot] = (uint8_t) axis;
+		chunk->curve_count++;
+	}
+
+	return true;
+}
+
+static unsigned int wsf_analyze_velocity_bin(double velocity) {
+	uint64_t bits = 0;
+	unsigned int octave = 0;
+
+	if (!(velocity >= 1.0)) {
+		return 0;
+	}
+	if (velocity >= (double) (1u << WSF_ANALYZE_OCTAVES)) {
+		return WSF_ANALYZE_VELOCITY_BINS - 1;
+	}
+
+	/* Exponent and top four mantissa bits: 16 linear steps per octave. */
+	memcpy(&bits, &velocity, sizeof(bits));
+	octave = (unsigned int) (bits >> 52) - 1023u;
+	return 1 + (octave * WSF_ANALYZE_OCTAVE_BINS) + (unsigned int) ((bits >> 48) & 15u);
+}
+
+/* Lower edge of a velocity bin; bin 0 starts at 0. */
+static double wsf_analyze_velocity_edge(unsigned int bin) {
+	unsigned int octave = 0;
+
+	if (bin == 0) {
+		return 0.0;
+	}
+	if (bin >= WSF_ANALYZE_VELOCITY_BINS - 1) {
+		return (double) (1u << WSF_ANALYZE_OCTAVES);
+	}
+	octave = (bin - 1) / WSF_ANALYZE_OCTAVE_BINS;
+	return ldexp(1.0 + (double) ((bin - 1) % WSF_ANALYZE_OCTAVE_BINS) / 16.0, (int) octave);
+}
+
+/* Curve pass: the batch kernel per axis run, then the histograms. */
+static void wsf_analyze_curve(void *context, size_t index, unsigned int thread) {
+	struct wsf_analyze *analyze = context;
+	const struct wsf_core *core = analyze->core;
+	struct wsf_analyze_chunk *chunk = &analyze->chunks[index];
+	struct wsf_analyze_totals *totals = &analyze->totals[thread];
+	double range = analyze->multiplier_high - analyze->multiplier_low;
+	size_t run = 0;
+	size_t i = 0;
+
+	/* Events alternate axes rarely; each same-axis run is one kernel call. */
+	while (run < chunk->curve_count) {
+		size_t run_end = run + 1;
+		unsigned int axis = chunk->axis[run];
+
+		while (run_end < chunk->curve_count && chunk->axis[run_end] == axis) {
+			run_end++;
+		}
+		wsf_curve_lookup_batch(
+			&core->curve_table,
+			core->kernel,
+			core->scroll_factor[axis],
+			chunk->velocity + run,
+			chunk->multiplier + run,
+			run_end - run
+		);
+		run = run_end;
+	}
+
+	for (i = 0; i < chunk->curve_count; i++) {
+		double velocity = chunk->velocity[i];
+		double multiplier = chunk->multiplier[i];
+		enum wsf_analyze_region region = WSF_ANALYZE_RAMP;
+		unsigned int bin = 0;
+
+		totals->velocity_bins[wsf_analyze_velocity_bin(velocity)]++;
+		totals->velocity_sum += velocity;
+		if (velocity > totals->velocity_max) {
+			totals->velocity_max = velocity;
+		}
+
+		if (range > 0.0) {
+			double position = (multiplier - analyze->multiplier_low) / range;
+
+			if (position > 0.0) {
+				bin = (unsigned int) (position * WSF_ANALYZE_MULTIPLIER_BINS);
+				if (bin >= WSF_ANALYZE_MULTIPLIER_BINS) {
+					bin = WSF_ANALYZE_MULTIPLIER_BINS - 1;
+				}
+			}
+		}
+		totals->multiplier_bins[bin]++;
+		totals->multiplier_sum += multiplier;
+
+		if (!(velocity > core->curve_table.velocity_min)) {
+			region = WSF_ANALYZE_BELOW;
+		} else if (velocity >= core->curve_table.velocity_max) {
+			region = WSF_ANALYZE_ABOVE;
+		}
+		totals->region_us[region] += chunk->dt_us[i];
+	}
+}
+
+static void wsf_analyze_gestures(struct wsf_analyze *analyze, const struct wsf_analyze_chunk *chunk) {
+	size_t i = 0;
+
+	for (i = 0; i < chunk->curve_count; i++) {
+		double raw = chunk->raw[i];
+
+		analyze->gesture_distance[chunk->gesture[i]] += fabs(raw * chunk->multiplier[i]);
+		analyze->gesture_raw[chunk->gesture[i]] += fabs(raw);
+	}
+}
+
+static uint64_t wsf_analyze_line_number(const char *data, size_t offset) {
+	uint64_t line = 1;
+	const char *cursor = data;
+	const char *end = data + offset;
+
+	while ((cursor = memchr(cursor, '\n', (size_t) (end - cursor))) != NULL) {
+		line++;
+		cursor++;
+	}
+	return line;
+}
+
+/* Chunk size for this file: enough chunks to keep every thread busy. */
+static size_t wsf_analyze_chunk_size(size_t size, unsigned int threads) {
+	size_t chunk = size / ((size_t) threads * WSF_ANALYZE_CHUNKS_PER_THREAD);
+
+	if (chunk < WSF_ANALYZE_CHUNK_MIN) {
+		return WSF_ANALYZE_CHUNK_MIN;
+	}
+	if (chunk > WSF_ANALYZE_CHUNK_MAX) {
+		return WSF_ANALYZE_CHUNK_MAX;
+	}
+	return chunk;
+}
+
+static bool wsf_analyze_data(
+	struct wsf_analyze *analyze,
+	const char *path,
+	const char *data,
+	size_t size
+) {
+	size_t window = (size_t) analyze->threads * WSF_ANALYZE_CHUNKS_PER_THREAD;
+	size_t chunk_size = wsf_analyze_chunk_size(size, analyze->threads);
+	size_t offset = 0;
+	size_t i = 0;
+
+	memset(analyze->state, 0, sizeof(analyze->state));
+
+	while (offset < size) {
+		analyze->chunk_count = 0;
+		while (analyze->chunk_count < window && offset < size) {
+			struct wsf_analyze_chunk *chunk = &analyze->chunks[analyze->chunk_count++];
+			size_t end = size - offset > chunk_size ? offset + chunk_size : size;
+			const char *newline = end < size ? memchr(data + end, '\n', size - end) : NULL;
+
+			if (end < size) {
+				end = newline != NULL ? (size_t) (newline - data) + 1 : size;
+			}
+			chunk->data = data;
+			chunk->begin = offset;
+			chunk->end = end;
+			offset = end;
+		}
+
+		wsf_parallel_run(analyze->threads, wsf_analyze_parse, analyze, analyze->chunk_count);
+		for (i = 0; i < analyze->chunk_count; i++) {
+			const struct wsf_analyze_chunk *chunk = &analyze->chunks[i];
+
+			if (chunk->malformed) {
+				fprintf(
+					stderr,
+					"analyze: %s: line %" PRIu64 ": malformed event\n",
+					path,
+					wsf_analyze_line_number(data, chunk->malformed_offset)
+				);
+				return false;
+			}
+			if (chunk->out_of_memory) {
+				fprintf(stderr, "Out of memory.\n");
+				return false;
+			}
+		}
+
+		for (i = 0; i < analyze->chunk_count; i++) {
+			struct wsf_analyze_chunk *chunk = &analyze->chunks[i];
+
+			if (!wsf_analyze_velocity(analyze, chunk)) {
+				fprintf(stderr, "Out of memory.\n");
+				return false;
+			}
+			analyze->events += chunk->lines;
+			analyze->scroll += chunk->event_count;
+			analyze->curve += chunk->curve_count;
+		}
+
+		wsf_parallel_run(analyze->threads, wsf_analyze_curve, analyze, analyze->chunk_count);
+		for (i = 0; i < analyze->chunk_count; i++) {
+			wsf_analyze_gestures(analyze, &analyze->chunks[i]);
+		}
+	}
+
+	return true;
+}
+
+static bool wsf_analyze_file(struct wsf_analyze *analyze, const char *path) {
+	struct stat st;
+	void *data = NULL;
+	bool ok = false;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "Failed to stat %s: %s\n", path, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	analyze->files++;
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	analyze->bytes += (uint64_t) st.st_size;
+	ok = wsf_analyze_data(analyze, path, data, (size_t) st.st_size);
+	munmap(data, (size_t) st.st_size);
+	return ok;
+}
+
+/* The multiplier histogram spans the curve's range under both factors. */
+static void wsf_analyze_multiplier_range(struct wsf_analyze *analyze) {
+	const struct wsf_core *core = analyze->core;
+	double table_low = core->curve_table.values[0];
+	double table_high = table_low;
+	bool any = false;
+	unsigned int axis = 0;
+	unsigned int i = 0;
+
+	for (i = 1; i <= WSF_CURVE_TABLE_SIZE; i++) {
+		table_low = fmin(table_low, core->curve_table.values[i]);
+		table_high = fmax(table_high, core->curve_table.values[i]);
+	}
+
+	for (axis = 0; axis < 2; axis++) {
+		double factor = core->scroll_factor[axis];
+
+		if (!isfinite(factor) || factor <= 0.0) {
+			continue;
+		}
+		if (!any || factor * table_low < analyze->multiplier_low) {
+			analyze->multiplier_low = factor * table_low;
+		}
+		if (!any || factor * table_high > analyze->multiplier_high) {
+			analyze->multiplier_high = factor * table_high;
+		}
+		any = true;
+	}
+}
+
+static int wsf_analyze_compare_double(const void *a, const void *b) {
+	double lhs = *(const double *) a;
+	double rhs = *(const double *) b;
+
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/* Nearest-rank percentile over sorted values. */
+static double wsf_analyze_percentile(const double *sorted, size_t count, double fraction) {
+	size_t rank = (size_t) ((double) count * fraction + 0.999999);
+
+	if (count == 0) {
+		return 0.0;
+	}
+	if (rank == 0) {
+		rank = 1;
+	}
+	if (rank > count) {
+		rank = count;
+	}
+	return sorted[rank - 1];
+}
+
+/* Upper edge of the bin holding the given rank; the histogram's resolution. */
+static double wsf_analyze_velocity_percentile(
+	const struct wsf_analyze_totals *totals,
+	uint64_t count,
+	double fraction
+) {
+	uint64_t rank = (uint64_t) ((double) count * fraction + 0.999999);
+	uint64_t seen = 0;
+	unsigned int bin = 0;
+
+	if (rank == 0) {
+		rank = 1;
+	}
+	for (bin = 0; bin < WSF_ANALYZE_VELOCITY_BINS - 1; bin++) {
+		seen += totals->velocity_bins[bin];
+		if (seen >= rank) {
+			return fmin(wsf_analyze_velocity_edge(bin + 1), totals->velocity_max);
+		}
+	}
+	return totals->velocity_max;
+}
+
+struct wsf_analyze_report {
+	struct wsf_analyze_totals totals;
+	double seconds;
+	double velocity_mean;
+	double velocity_p50;
+	double velocity_p90;
+	double velocity_p99;
+	double multiplier_mean;
+	double region_total_us;
+	double gesture_mean;
+	double gesture_p50;
+	double gesture_p90;
+	double gesture_max;
+	double gesture_raw_mean;
+};
+
+static void wsf_analyze_summarize(
+	struct wsf_analyze *analyze,
+	double seconds,
+	struct wsf_analyze_report *report
+) {
+	struct wsf_analyze_totals *totals = &report->totals;
+	double gesture_sum = 0.0;
+	double raw_sum = 0.0;
+	unsigned int thread = 0;
+	unsigned int i = 0;
+	size_t g = 0;
+
+	memset(report, 0, sizeof(*report));
+	report->seconds = seconds;
+	for (thread = 0; thread < analyze->threads; thread++) {
+		const struct wsf_analyze_totals *part = &analyze->totals[thread];
+
+		for (i = 0; i < WSF_ANALYZE_VELOCITY_BINS; i++) {
+			totals->velocity_bins[i] += part->velocity_bins[i];
+		}
+		for (i = 0; i < WSF_ANALYZE_MULTIPLIER_BINS; i++) {
+			totals->multiplier_bins[i] += part->multiplier_bins[i];
+		}
+		for (i = 0; i < WSF_ANALYZE_REGIONS; i++) {
+			totals->region_us[i] += part->region_us[i];
+		}
+		totals->velocity_sum += part->velocity_sum;
+		totals->velocity_max = fmax(totals->velocity_max, part->velocity_max);
+		totals->multiplier_sum += part->multiplier_sum;
+	}
+	for (i = 0; i < WSF_ANALYZE_REGIONS; i++) {
+		report->region_total_us += totals->region_us[i];
+	}
+
+	if (analyze->curve > 0) {
+		report->velocity_mean = totals->velocity_sum / (double) analyze->curve;
+		report->velocity_p50 = wsf_analyze_velocity_percentile(totals, analyze->curve, 0.50);
+		report->velocity_p90 = wsf_analyze_velocity_percentile(totals, analyze->curve, 0.90);
+		report->velocity_p99 = wsf_analyze_velocity_percentile(totals, analyze->curve, 0.99);
+		report->multiplier_mean = totals->multiplier_sum / (double) analyze->curve;
+	}
+
+	if (analyze->gesture_count > 0) {
+		for (g = 0; g < analyze->gesture_count; g++) {
+			gesture_sum += analyze->gesture_distance[g];
+			raw_sum += analyze->gesture_raw[g];
+		}
+		qsort(
+			analyze->gesture_distance,
+			analyze->gesture_count,
+			sizeof(double),
+			wsf_analyze_compare_double
+		);
+		report->gesture_mean = gesture_sum / (double) analyze->gesture_count;
+		report->gesture_raw_mean = raw_sum / (double) analyze->gesture_count;
+		report->gesture_p50 =
+			wsf_analyze_percentile(analyze->gesture_distance, analyze->gesture_count, 0.50);
+		report->gesture_p90 =
+			wsf_analyze_percentile(analyze->gesture_distance, analyze->gesture_count, 0.90);
+		report->gesture_max = analyze->gesture_distance[analyze->gesture_count - 1];
+	}
+}
+
+/* The display groups the fine velocity bins two octaves at a time. */
+#define WSF_ANALYZE_DISPLAY_BINS (WSF_ANALYZE_OCTAVES / 2 + 2)
+
+static void wsf_analyze_display_bins(
+	const struct wsf_analyze_totals *totals,
+	uint64_t *counts,
+	double *low,
+	double *high
+) {
+	unsigned int row = 0;
+	unsigned int bin = 0;
+
+	for (row = 0; row < WSF_ANALYZE_DISPLAY_BINS; row++) {
+		unsigned int first = row == 0 ? 0 : 1 + (row - 1) * 2 * WSF_ANALYZE_OCTAVE_BINS;
+		unsigned int last = row == 0 ? 1 : first + 2 * WSF_ANALYZE_OCTAVE_BINS;
+
+		if (row == WSF_ANALYZE_DISPLAY_BINS - 1) {
+			first = WSF_ANALYZE_VELOCITY_BINS - 1;
+			last = WSF_ANALYZE_VELOCITY_BINS;
+		}
+		counts[row] = 0;
+		for (bin = first; bin < last; bin++) {
+			counts[row] += totals->velocity_bins[bin];
+		}
+		low[row] = wsf_analyze_velocity_edge(first);
+		high[row] = row == WSF_ANALYZE_DISPLAY_BINS - 1 ? INFINITY : wsf_analyze_velocity_edge(last);
+	}
+}
+
+static double wsf_analyze_share(uint64_t part, uint64_t whole) {
+	return whole > 0 ? 100.0 * (double) part / (double) whole : 0.0;
+}
+
+static void wsf_analyze_print_text(
+	const struct wsf_analyze *analyze,
+	const struct wsf_analyze_report *report
+) {
+	const struct wsf_analyze_totals *totals = &report->totals;
+	const struct wsf_curve_table *table = &analyze->core->curve_table;
+	uint64_t counts[WSF_ANALYZE_DISPLAY_BINS];
+	double low[WSF_ANALYZE_DISPLAY_BINS];
+	double high[WSF_ANALYZE_DISPLAY_BINS];
+	double step = (analyze->multiplier_high - analyze->multiplier_low) / WSF_ANALYZE_MULTIPLIER_BINS;
+	const char *region_names[WSF_ANALYZE_REGIONS] = { "below", "ramp", "above" };
+	unsigned int row = 0;
+
+	printf(
+		"files %" PRIu64 " bytes %" PRIu64 " threads %u kernel %s\n",
+		analyze->files,
+		analyze->bytes,
+		analyze->threads,
+		wsf_curve_kernel_name(analyze->core->kernel)
+	);
+	printf(
+		"events %" PRIu64 " scroll %" PRIu64 " curve %" PRIu64 " gestures %zu\n",
+		analyze->events,
+		analyze->scroll,
+		analyze->curve,
+		analyze->gesture_count
+	);
+	printf(
+		"seconds %.3f events_per_sec %.0f\n",
+		report->seconds,
+		report->seconds > 0.0 ? (double) analyze->events / report->seconds : 0.0
+	);
+	if (analyze->curve == 0) {
+		printf("no events reached the curve\n");
+		return;
+	}
+
+	printf(
+		"\nvelocity (units/s): mean %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+		report->velocity_mean,
+		report->velocity_p50,
+		report->velocity_p90,
+		report->velocity_p99,
+		totals->velocity_max
+	);
+	wsf_analyze_display_bins(totals, counts, low, high);
+	for (row = 0; row < WSF_ANALYZE_DISPLAY_BINS; row++) {
+		if (counts[row] == 0) {
+			continue;
+		}
+		printf(
+			"  %9.0f - %9.0f  %12" PRIu64 "  %5.1f%%\n",
+			low[row],
+			high[row],
+			counts[row],
+			wsf_analyze_share(counts[row], analyze->curve)
+		);
+	}
+
+	printf("\nmultiplier: mean %.4f\n", report->multiplier_mean);
+	for (row = 0; row < WSF_ANALYZE_MULTIPLIER_BINS; row++) {
+		if (totals->multiplier_bins[row] == 0) {
+			continue;
+		}
+		printf(
+			"  %9.4f - %9.4f  %12" PRIu64 "  %5.1f%%\n",
+			analyze->multiplier_low + step * row,
+			analyze->multiplier_low + step * (row + 1),
+			totals->multiplier_bins[row],
+			wsf_analyze_share(totals->multiplier_bins[row], analyze->curve)
+		);
+	}
+
+	printf(
+		"\ncurve region time (ramp %.0f - %.0f units/s):\n",
+		table->velocity_min,
+		table->velocity_max
+	);
+	for (row = 0; row < WSF_ANALYZE_REGIONS; row++) {
+		printf(
+			"  %-5s  %12.3f s  %5.1f%%\n",
+			region_names[row],
+			totals->region_us[row] / 1e6,
+			report->region_total_us > 0.0 ?
+				100.0 * totals->region_us[row] / report->region_total_us : 0.0
+		);
+	}
+
+	printf(
+		"\ngesture distance: mean %.1f p50 %.1f p90 %.1f max %.1f (unscaled mean %.1f)\n",
+		report->gesture_mean,
+		report->gesture_p50,
+		report->gesture_p90,
+		report->gesture_max,
+		report->gesture_raw_mean
+	);
+}
+
+static void wsf_analyze_print_json(
+	const struct wsf_analyze *analyze,
+	const struct wsf_analyze_report *report
+) {
+	const struct wsf_analyze_totals *totals = &report->totals;
+	const struct wsf_curve_table *table = &analyze->core->curve_table;
+	uint64_t counts[WSF_ANALYZE_DISPLAY_BINS];
+	double low[WSF_ANALYZE_DISPLAY_BINS];
+	double high[WSF_ANALYZE_DISPLAY_BINS];
+	double step = (analyze->multiplier_high - analyze->multiplier_low) / WSF_ANALYZE_MULTIPLIER_BINS;
+	bool first = true;
+	unsigned int row = 0;
+
+	printf(
+		"{\"files\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"threads\":%u,\"kernel\":\"%s\","
+		"\"events\":%" PRIu64 ",\"scroll\":%" PRIu64 ",\"curve\":%" PRIu64 ",\"gestures\":%zu,"
+		"\"seconds\":%.6f,\"events_per_sec\":%.0f,",
+		analyze->files,
+		analyze->bytes,
+		analyze->threads,
+		wsf_curve_kernel_name(analyze->core->kernel),
+		analyze->events,
+		analyze->scroll,
+		analyze->curve,
+		analyze->gesture_count,
+		report->seconds,
+		report->seconds > 0.0 ? (double) analyze->events / report->seconds : 0.0
+	);
+
+	printf(
+		"\"velocity\":{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,"
+		"\"histogram\":[",
+		report->velocity_mean,
+		report->velocity_p50,
+		report->velocity_p90,
+		report->velocity_p99,
+		totals->velocity_max
+	);
+	wsf_analyze_display_bins(totals, counts, low, high);
+	for (row = 0; row < WSF_ANALYZE_DISPLAY_BINS; row++) {
+		if (counts[row] == 0) {
+			continue;
+		}
+		if (isinf(high[row])) {
+			printf("%s[%.3f,null,%" PRIu64 "]", first ? "" : ",", low[row], counts[row]);
+		} else {
+			printf("%s[%.3f,%.3f,%" PRIu64 "]", first ? "" : ",", low[row], high[row], counts[row]);
+		}
+		first = false;
+	}
+
+	printf("]},\"multiplier\":{\"mean\":%.6f,\"histogram\":[", report->multiplier_mean);
+	first = true;
+	for (row = 0; row < WSF_ANALYZE_MULTIPLIER_BINS; row++) {
+		if (totals->multiplier_bins[row] == 0) {
+			continue;
+		}
+		printf(
+			"%s[%.6f,%.6f,%" PRIu64 "]",
+			first ? "" : ",",
+			analyze->multiplier_low + step * row,
+			analyze->multiplier_low + step * (row + 1),
+			totals->multiplier_bins[row]
+		);
+		first = false;
+	}
+
+	printf(
+		"]},\"regions\":{\"velocity_min\":%.3f,\"velocity_max\":%.3f,"
+		"\"below_seconds\":%.6f,\"ramp_seconds\":%.6f,\"above_seconds\":%.6f},",
+		table->velocity_min,
+		table->velocity_max,
+		totals->region_us[WSF_ANALYZE_BELOW] / 1e6,
+		totals->region_us[WSF_ANALYZE_RAMP] / 1e6,
+		totals->region_us[WSF_ANALYZE_ABOVE] / 1e6
+	);
+	printf(
+		"\"gesture_distance\":{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"max\":%.3f,"
+		"\"unscaled_mean\":%.3f}}\n",
+		report->gesture_mean,
+		report->gesture_p50,
+		report->gesture_p90,
+		report->gesture_max,
+		report->gesture_raw_mean
+	);
+}
+
+int wsf_cmd_analyze(int argc, char **argv) {
+	const char *config_path = NULL;
+	struct wsf_effective_factors factors;
+	struct wsf_analyze analyze;
+	struct wsf_analyze_report report;
+	struct timespec start;
+	bool json = false;
+	bool ok = true;
+	int first_file = 0;
+	int i = 0;
+
+	memset(&analyze, 0, sizeof(analyze));
+	analyze.threads = wsf_parallel_default_threads();
+
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+			config_path = argv[++i];
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			if (!wsf_parallel_parse_threads(argv[++i], &analyze.threads)) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--") == 0) {
+			i++;
+			break;
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "Unknown option for analyze: %s\n", argv[i]);
+			return 1;
+		} else {
+			break;
+		}
+	}
+	first_file = i;
+	if (first_file >= argc) {
+		fprintf(stderr, "analyze takes one or more trace files.\n");
+		return 1;
+	}
+
+	if (!wsf_event_load_factors(config_path, &factors, wsf_debug_enabled())) {
+		return 1;
+	}
+
+	analyze.core = malloc(sizeof(*analyze.core));
+	analyze.chunks = calloc(
+		(size_t) analyze.threads * WSF_ANALYZE_CHUNKS_PER_THREAD,
+		sizeof(*analyze.chunks)
+	);
+	analyze.totals = calloc(analyze.threads, sizeof(*analyze.totals));
+	if (analyze.core == NULL || analyze.chunks == NULL || analyze.totals == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		free(analyze.core);
+		free(analyze.chunks);
+		free(analyze.totals);
+		return 1;
+	}
+	wsf_core_init(analyze.core, &factors);
+	wsf_analyze_multiplier_range(&analyze);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = first_file; ok && i < argc; i++) {
+		ok = wsf_analyze_file(&analyze, argv[i]);
+	}
+
+	if (ok) {
+		wsf_analyze_summarize(&analyze, wsf_parallel_elapsed(&start), &report);
+		if (json) {
+			wsf_analyze_print_json(&analyze, &report);
+		} else {
+			wsf_analyze_print_text(&analyze, &report);
+		}
+	}
+
+	for (i = 0; i < (int) analyze.threads * WSF_ANALYZE_CHUNKS_PER_THREAD; i++) {
+		wsf_analyze_chunk_free(&analyze.chunks[i]);
+	}
+	free(analyze.chunks);
+	free(analyze.totals);
+	free(analyze.gesture_distance);
+	free(analyze.gesture_raw);
+	free(analyze.core);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#define WSF_BENCH_DEFAULT_RUNS 2000
+#define WSF_BENCH_MAX_RUNS 1000000
+#define WSF_BENCH_WARMUP_RUNS 20
+#define WSF_BENCH_SHM_PREFIX "/dev/shm/wsf-"
+
+struct wsf_bench_latency {
+	double p50_us;
+	double p99_us;
+	double mean_us;
+};
+
+struct wsf_bench_footprint {
+	unsigned int scanned;
+	unsigned int unreadable;
+	unsigned int mapped;
+	uint64_t lib_rss_kb;
+	uint64_t lib_pss_kb;
+	uint64_t shm_rss_kb;
+	uint64_t shm_pss_kb;
+	uint64_t process_rss_kb;
+	uint64_t process_pss_kb;
+};
+
+static int wsf_bench_compare_u64(const void *a, const void *b) {
+	uint64_t lhs = *(const uint64_t *) a;
+	uint64_t rhs = *(const uint64_t *) b;
+
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/* Nearest-rank percentile over sorted samples. */
+static double wsf_bench_percentile_us(const uint64_t *sorted, size_t count, double fraction) {
+	size_t rank = (size_t) ((double) count * fraction + 0.999999);
+
+	if (rank == 0) {
+		rank = 1;
+	}
+	if (rank > count) {
+		rank = count;
+	}
+
+	return (double) sorted[rank - 1] / 1000.0;
+}
+
+static void wsf_bench_summarize(uint64_t *samples, size_t count, struct wsf_bench_latency *out) {
+	uint64_t total = 0;
+	size_t i = 0;
+
+	qsort(samples, count, sizeof(*samples), wsf_bench_compare_u64);
+	for (i = 0; i < count; i++) {
+		total += samples[i];
+	}
+
+	out->p50_us = wsf_bench_percentile_us(samples, count, 0.50);
+	out->p99_us = wsf_bench_percentile_us(samples, count, 0.99);
+	out->mean_us = ((double) total / (double) count) / 1000.0;
+}
+
+/*
+ * Copies environ without any LD_PRELOAD so the baseline really runs bare.
+ * The last slot is left free for the preload entry.
+ */
+static char **wsf_bench_environ(char *preload_entry) {
+	size_t count = 0;
+	size_t kept = 0;
+	size_t i = 0;
+	char **env = NULL;
+
+	while (environ[count] != NULL) {
+		count++;
+	}
+
+	env = calloc(count + 2, sizeof(*env));
+	if (env == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (strncmp(environ[i], "LD_PRELOAD=", 11) != 0) {
+			env[kept++] = environ[i];
+		}
+	}
+	env[kept] = preload_entry;
+
+	return env;
+}
+
+/* Wall time of one spawn-to-reap cycle, or 0 when the command failed. */
+static uint64_t wsf_bench_run_once(
+	char *const *command,
+	char *const *env,
+	const posix_spawn_file_actions_t *actions
+) {
+	uint64_t start = wsf_live_now_ns();
+	pid_t pid = 0;
+	int status = 0;
+	int err = posix_spawnp(&pid, command[0], actions, NULL, command, env);
+
+	if (err != 0) {
+		fprintf(stderr, "Failed to run %s: %s\n", command[0], strerror(err));
+		return 0;
+	}
+
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			return 0;
+		}
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%s did not exit cleanly (status %d)\n", command[0], status);
+		return 0;
+	}
+
+	return wsf_live_now_ns() - start;
+}
+
+static int wsf_bench_startup(
+	const char *lib_path,
+	char *const *command,
+	unsigned int runs,
+	bool json
+) {
+	posix_spawn_file_actions_t actions;
+	struct wsf_bench_latency bare;
+	struct wsf_bench_latency preloaded;
+	char preload_entry[4096];
+	char **env_bare = NULL;
+	char **env_preload = NULL;
+	uint64_t *samples_bare = NULL;
+	uint64_t *samples_preload = NULL;
+	unsigned int i = 0;
+	int written = 0;
+	int rc = 1;
+
+	written = snprintf(preload_entry, sizeof(preload_entry), "LD_PRELOAD=%s", lib_path);
+	if (written <= 0 || (size_t) written >= sizeof(preload_entry)) {
+		fprintf(stderr, "Library path too long.\n");
+		return 1;
+	}
+
+	env_bare = wsf_bench_environ(NULL);
+	env_preload = wsf_bench_environ(preload_entry);
+	samples_bare = calloc(runs, sizeof(*samples_bare));
+	samples_preload = calloc(runs, sizeof(*samples_preload));
+	if (env_bare == NULL || env_preload == NULL ||
+		samples_bare == NULL || samples_preload == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		goto out;
+	}
+
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+	for (i = 0; i < WSF_BENCH_WARMUP_RUNS; i++) {
+		if (wsf_bench_run_once(command, env_bare, &actions) == 0 ||
+			wsf_bench_run_once(command, env_preload, &actions) == 0) {
+			goto out_actions;
+		}
+	}
+
+	/* Interleaved so drift in machine load hits both sides equally. */
+	for (i = 0; i < runs; i++) {
+		samples_bare[i] = wsf_bench_run_once(command, env_bare, &actions);
+		samples_preload[i] = wsf_bench_run_once(command, env_preload, &actions);
+		if (samples_bare[i] == 0 || samples_preload[i] == 0) {
+			goto out_actions;
+		}
+	}
+
+	wsf_bench_summarize(samples_bare, runs, &bare);
+	wsf_bench_summarize(samples_preload, runs, &preloaded);
+
+	if (json) {
+		printf("{\"command\":");
+		wsf_print_json_string(command[0]);
+		printf(",\"library\":");
+		wsf_print_json_string(lib_path);
+		printf(
+			",\"runs\":%u,"
+			"\"without\":{\"p50_us\":%.3f,\"p99_us\":%.3f,\"mean_us\":%.3f},"
+			"\"with\":{\"p50_us\":%.3f,\"p99_us\":%.3f,\"mean_us\":%.3f},"
+			"\"delta\":{\"p50_us\":%.3f,\"p99_us\":%.3f,\"mean_us\":%.3f}}\n",
+			runs,
+			bare.p50_us,
+			bare.p99_us,
+			bare.mean_us,
+			preloaded.p50_us,
+			preloaded.p99_us,
+			preloaded.mean_us,
+			preloaded.p50_us - bare.p50_us,
+			preloaded.p99_us - bare.p99_us,
+			preloaded.mean_us - bare.mean_us
+		);
+	} else {
+		printf("command: %s (%u runs each, interleaved)\n", command[0], runs);
+		printf("library: %s\n", lib_path);
+		printf("%-10s %10s %10s %10s\n", "", "p50_us", "p99_us", "mean_us");
+		printf("%-10s %10.1f %10.1f %10.1f\n", "without", bare.p50_us, bare.p99_us, bare.mean_us);
+		printf(
+			"%-10s %10.1f %10.1f %10.1f\n",
+			"with",
+			preloaded.p50_us,
+			preloaded.p99_us,
+			preloaded.mean_us
+		);
+		printf(
+			"%-10s %+10.1f %+10.1f %+10.1f\n",
+			"delta",
+			preloaded.p50_us - bare.p50_us,
+			preloaded.p99_us - bare.p99_us,
+			preloaded.mean_us - bare.mean_us
+		);
+	}
+	rc = 0;
+
+out_actions:
+	posix_spawn_file_actions_destroy(&actions);
+out:
+	free(samples_preload);
+	free(samples_bare);
+	free(env_preload);
+	free(env_bare);
+	return rc;
+}
+
+/* The mapped library counts when it is the same file name as ours. */
+static bool wsf_bench_is_library(const char *mapped, const char *lib_path) {
+	return strcmp(mapped, lib_path) == 0 ||
+		strcmp(wsf_live_basename(mapped), wsf_live_basename(lib_path)) == 0;
+}
+
+/* Mapping headers open with the address range, counters with "Key:". */
+static bool wsf_bench_smaps_header(const char *line) {
+	size_t token = strcspn(line, " ");
+
+	return token > 0 && line[token - 1] != ':';
+}
+
+static bool wsf_bench_read_kb(const char *line, const char *key, uint64_t *out_kb) {
+	size_t key_len = strlen(key);
+	unsigned long long value = 0;
+
+	if (strncmp(line, key, key_len) != 0 || line[key_len] != ':') {
+		return false;
+	}
+	if (sscanf(line + key_len + 1, "%llu", &value) != 1) {
+		return false;
+	}
+
+	*out_kb = (uint64_t) value;
+	return true;
+}
+
+/*
+ * smaps lists every mapping followed by its counters; only the mappings of
+ * the library and of the control blocks are summed. Returns false when the
+ * process has none of them (or vanished while being read).
+ */
+static bool wsf_bench_scan_smaps(
+	const char *pid,
+	const char *lib_path,
+	struct wsf_bench_footprint *footprint
+) {
+	char path[320];
+	char line[4096];
+	FILE *file = NULL;
+	uint64_t *rss = NULL;
+	uint64_t *pss = NULL;
+	bool mapped = false;
+
+	snprintf(path, sizeof(path), "/proc/%s/smaps", pid);
+	file = fopen(path, "re");
+	if (file == NULL) {
+		footprint->unreadable++;
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *name = NULL;
+		uint64_t kb = 0;
+
+		if (wsf_bench_smaps_header(line)) {
+			name = strchr(line, '/');
+			rss = NULL;
+			pss = NULL;
+			if (name != NULL) {
+				name[strcspn(name, "\n")] = '\0';
+				if (wsf_bench_is_library(name, lib_path)) {
+					rss = &footprint->lib_rss_kb;
+					pss = &footprint->lib_pss_kb;
+					mapped = true;
+				} else if (strncmp(name, WSF_BENCH_SHM_PREFIX, strlen(WSF_BENCH_SHM_PREFIX)) == 0) {
+					rss = &footprint->shm_rss_kb;
+					pss = &footprint->shm_pss_kb;
+				}
+			}
+			continue;
+		}
+
+		if (rss != NULL && wsf_bench_read_kb(line, "Rss", &kb)) {
+			*rss += kb;
+		} else if (pss != NULL && wsf_bench_read_kb(line, "Pss", &kb)) {
+			*pss += kb;
+		}
+	}
+
+	fclose(file);
+	return mapped;
+}
+
+/* Whole-process totals, for scale against the library's share. */
+static void wsf_bench_scan_rollup(const char *pid, struct wsf_bench_footprint *footprint) {
+	char path[320];
+	char line[256];
+	FILE *file = NULL;
+
+	snprintf(path, sizeof(path), "/proc/%s/smaps_rollup", pid);
+	file = fopen(path, "re");
+	if (file == NULL) {
+		return;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		uint64_t kb = 0;
+
+		if (wsf_bench_read_kb(line, "Rss", &kb)) {
+			footprint->process_rss_kb += kb;
+		} else if (wsf_bench_read_kb(line, "Pss", &kb)) {
+			footprint->process_pss_kb += kb;
+		}
+	}
+
+	fclose(file);
+}
+
+/* Cheap pre-filter: maps is much shorter than smaps. */
+static bool wsf_bench_maps_library(const char *pid, const char *lib_path, bool *unreadable) {
+	char path[320];
+	char line[4096];
+	FILE *file = NULL;
+	bool found = false;
+
+	snprintf(path, sizeof(path), "/proc/%s/maps", pid);
+	file = fopen(path, "re");
+	if (file == NULL) {
+		*unreadable = true;
+		return false;
+	}
+
+	while (!found && fgets(line, sizeof(line), file) != NULL) {
+		char *name = strchr(line, '/');
+
+		if (name == NULL) {
+			continue;
+		}
+		name[strcspn(name, "\n")] = '\0';
+		found = wsf_bench_is_library(name, lib_path);
+	}
+
+	fclose(file);
+	return found;
+}
+
+static int wsf_bench_memory(const char *lib_path, bool json) {
+	struct wsf_bench_footprint footprint;
+	struct dirent *entry = NULL;
+	DIR *proc = opendir("/proc");
+
+	if (proc == NULL) {
+		fprintf(stderr, "Failed to open /proc: %s\n", strerror(errno));
+		return 1;
+	}
+
+	memset(&footprint, 0, sizeof(footprint));
+	while ((entry = readdir(proc)) != NULL) {
+		bool unreadable = false;
+
+		if (!wsf_live_is_pid(entry->d_name)) {
+			continue;
+		}
+
+		footprint.scanned++;
+		if (!wsf_bench_maps_library(entry->d_name, lib_path, &unreadable)) {
+			if (unreadable) {
+				footprint.unreadable++;
+			}
+			continue;
+		}
+		if (wsf_bench_scan_smaps(entry->d_name, lib_path, &footprint)) {
+			footprint.mapped++;
+			wsf_bench_scan_rollup(entry->d_name, &footprint);
+		}
+	}
+	closedir(proc);
+
+	if (json) {
+		printf("{\"library\":");
+		wsf_print_json_string(lib_path);
+		printf(
+			",\"scanned\":%u,\"unreadable\":%u,\"processes\":%u,"
+			"\"library_rss_kb\":%" PRIu64 ",\"library_pss_kb\":%" PRIu64 ","
+			"\"shm_rss_kb\":%" PRIu64 ",\"shm_pss_kb\":%" PRIu64 ","
+			"\"process_rss_kb\":%" PRIu64 ",\"process_pss_kb\":%" PRIu64 "}\n",
+			footprint.scanned,
+			footprint.unreadable,
+			footprint.mapped,
+			footprint.lib_rss_kb,
+			footprint.lib_pss_kb,
+			footprint.shm_rss_kb,
+			footprint.shm_pss_kb,
+			footprint.process_rss_kb,
+			footprint.process_pss_kb
+		);
+		return 0;
+	}
+
+	printf("library: %s\n", lib_path);
+	printf(
+		"processes: %u mapping it (%u scanned, %u unreadable)\n",
+		footprint.mapped,
+		footprint.scanned,
+		footprint.unreadable
+	);
+	printf(
+		"library: rss %" PRIu64 " KiB, pss %" PRIu64 " KiB\n",
+		footprint.lib_rss_kb,
+		footprint.lib_pss_kb
+	);
+	printf(
+		"control blocks: rss %" PRIu64 " KiB, pss %" PRIu64 " KiB\n",
+		footprint.shm_rss_kb,
+		footprint.shm_pss_kb
+	);
+	printf(
+		"those processes: rss %" PRIu64 " KiB, pss %" PRIu64 " KiB\n",
+		footprint.process_rss_kb,
+		footprint.process_pss_kb
+	);
+	return 0;
+}
+
+static bool wsf_bench_parse_runs(const char *text, unsigned int *out_runs) {
+	char *end = NULL;
+	unsigned long value = 0;
+
+	errno = 0;
+	value = strtoul(text, &end, 10);
+	if (errno != 0 || end == text || *end != '\0' ||
+		value == 0 || value > WSF_BENCH_MAX_RUNS) {
+		return false;
+	}
+
+	*out_runs = (unsigned int) value;
+	return true;
+}
+
+int wsf_cmd_bench(int argc, char **argv) {
+	static char *default_command[] = { "/bin/true", NULL };
+	char lib_path[4096];
+	char *const *command = default_command;
+	const char *mode = NULL;
+	const char *lib_override = NULL;
+	unsigned int runs = WSF_BENCH_DEFAULT_RUNS;
+	bool json = false;
+	int i = 0;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: wsf bench startup|memory [options]\n");
+		return 1;
+	}
+
+	mode = argv[2];
+	if (strcmp(mode, "startup") != 0 && strcmp(mode, "memory") != 0) {
+		fprintf(stderr, "Unknown bench: %s\n", mode);
+		return 1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--lib") == 0 && i + 1 < argc) {
+			lib_override = argv[++i];
+		} else if (strcmp(mode, "startup") == 0 && strcmp(argv[i], "--runs") == 0 &&
+			i + 1 < argc) {
+			if (!wsf_bench_parse_runs(argv[++i], &runs)) {
+				fprintf(stderr, "Invalid run count: %s\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(mode, "startup") == 0 && strcmp(argv[i], "--") == 0 &&
+			i + 1 < argc) {
+			command = &argv[i + 1];
+			break;
+		} else {
+			fprintf(stderr, "Unknown option for bench %s: %s\n", mode, argv[i]);
+			return 1;
+		}
+	}
+
+	if (lib_override != NULL) {
+		if (snprintf(lib_path, sizeof(lib_path), "%s", lib_override) >= (int) sizeof(lib_path)) {
+			fprintf(stderr, "Library path too long.\n");
+			return 1;
+		}
+	} else if (!wsf_lib_path(lib_path, sizeof(lib_path))) {
+		fprintf(stderr, "Could not determine the preload library path.\n");
+		return 1;
+	}
+
+	if (strcmp(mode, "memory") == 0) {
+		return wsf_bench_memory(lib_path, json);
+	}
+
+	if (access(lib_path, R_OK) != 0) {
+		fprintf(stderr, "Preload library not readable: %s\n", lib_path);
+		return 1;
+	}
+
+	return wsf_bench_startup(lib_path, command, runs, json);
+}
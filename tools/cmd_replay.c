@@ -0,0 +1,355 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_config.h"
+#include "wsf_core.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Runs a recorded event stream through the preload's scaling engine, held
+ * in a wsf_core state object. Input is one event per line:
+ *
+ *   scroll <time_us|-> <vertical|horizontal> <source> <value> [device]
+ *   pinch <time_us|-> <scale>
+ *   rotate <time_us|-> <delta>
+ *
+ * Rows printed by `wsf trace --dump` are accepted as scroll events too, so
+ * a captured session can be replayed against another config. Output is a
+ * pure function of the input and the factors, one line per event.
+ */
+
+#define WSF_REPLAY_OUTPUT_BUFFER (1u << 16)
+#define WSF_REPLAY_NUMBER_MAX 352
+#define WSF_REPLAY_LINE_MAX (4 * WSF_REPLAY_NUMBER_MAX + 128)
+
+struct wsf_replay_counts {
+	uint64_t events;
+	uint64_t scaled;
+};
+
+/*
+ * Output lines are assembled by hand: printf's float conversion dominated
+ * the replay loop. Fixed-point values round half away from zero and fall
+ * back to snprintf outside the range an int64 can hold.
+ */
+struct wsf_replay_text {
+	char data[WSF_REPLAY_LINE_MAX];
+	size_t len;
+};
+
+static void wsf_replay_put_str(struct wsf_replay_text *text, const char *str) {
+	size_t len = strlen(str);
+
+	memcpy(text->data + text->len, str, len);
+	text->len += len;
+}
+
+static void wsf_replay_put_u64(struct wsf_replay_text *text, uint64_t value) {
+	char digits[20];
+	unsigned int count = 0;
+
+	do {
+		digits[count++] = (char) ('0' + (value % 10));
+		value /= 10;
+	} while (value != 0);
+
+	while (count > 0) {
+		text->data[text->len++] = digits[--count];
+	}
+}
+
+static void wsf_replay_put_fixed(struct wsf_replay_text *text, double value, unsigned int decimals) {
+	static const double scales[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0 };
+	double scaled = value * scales[decimals];
+	uint64_t whole = 0;
+	uint64_t fraction = 0;
+	uint64_t unit = (uint64_t) scales[decimals];
+	unsigned int i = 0;
+	char digits[6];
+
+	if (!(fabs(scaled) < 9.0e15)) {
+		int written = snprintf(
+			text->data + text->len,
+			WSF_REPLAY_NUMBER_MAX,
+			"%.*f",
+			(int) decimals,
+			value
+		);
+
+		if (written > 0) {
+			text->len += (size_t) written < WSF_REPLAY_NUMBER_MAX ?
+				(size_t) written : WSF_REPLAY_NUMBER_MAX - 1;
+		}
+		return;
+	}
+
+	if (signbit(value)) {
+		scaled = -scaled;
+		text->data[text->len++] = '-';
+	}
+	whole = (uint64_t) (scaled + 0.5);
+	fraction = whole % unit;
+	wsf_replay_put_u64(text, whole / unit);
+	if (decimals == 0) {
+		return;
+	}
+
+	text->data[text->len++] = '.';
+	for (i = decimals; i > 0; i--) {
+		digits[i - 1] = (char) ('0' + (fraction % 10));
+		fraction /= 10;
+	}
+	memcpy(text->data + text->len, digits, decimals);
+	text->len += decimals;
+}
+
+static void wsf_replay_put_time(struct wsf_replay_text *text, bool has_time, uint64_t time_us) {
+	if (has_time) {
+		wsf_replay_put_u64(text, time_us);
+	} else {
+		text->data[text->len++] = '-';
+	}
+}
+
+static void wsf_replay_scroll(
+	struct wsf_core *core,
+	struct wsf_replay_counts *counts,
+	FILE *out,
+	bool has_time,
+	uint64_t time_us,
+	unsigned int device,
+	unsigned int axis,
+	unsigned int source,
+	double value
+) {
+	struct wsf_core_event event = { time_us, axis, source, device, has_time, value };
+	struct wsf_core_result result;
+	struct wsf_replay_text text;
+
+	wsf_core_scale(core, &event, &result);
+	if (result.curve) {
+		counts->scaled++;
+	}
+
+	if (out == NULL) {
+		return;
+	}
+
+	text.len = 0;
+	wsf_replay_put_str(&text, "scroll ");
+	wsf_replay_put_time(&text, has_time, time_us);
+	text.data[text.len++] = ' ';
+	wsf_replay_put_u64(&text, device);
+	text.data[text.len++] = ' ';
+	wsf_replay_put_str(&text, wsf_event_axis_name(axis));
+	text.data[text.len++] = ' ';
+	wsf_replay_put_str(&text, wsf_event_source_name(source));
+	text.data[text.len++] = ' ';
+	wsf_replay_put_fixed(&text, value, 6);
+	text.data[text.len++] = ' ';
+	wsf_replay_put_fixed(&text, result.value, 6);
+	if (result.curve) {
+		text.data[text.len++] = ' ';
+		wsf_replay_put_fixed(&text, result.velocity, 3);
+		text.data[text.len++] = ' ';
+		wsf_replay_put_fixed(&text, result.multiplier, 6);
+		text.data[text.len++] = '\n';
+	} else {
+		wsf_replay_put_str(&text, " - -\n");
+	}
+	fwrite(text.data, 1, text.len, out);
+}
+
+static void wsf_replay_gesture(
+	struct wsf_core *core,
+	struct wsf_replay_counts *counts,
+	FILE *out,
+	enum wsf_core_kind kind,
+	bool has_time,
+	uint64_t time_us,
+	double value
+) {
+	struct wsf_core_event event = { time_us, kind, 0, 0, has_time, value };
+	double factor = kind == WSF_CORE_PINCH_ZOOM ?
+		core->pinch_zoom_factor : core->pinch_rotate_factor;
+	double scaled = wsf_core_scale(core, &event, NULL);
+	struct wsf_replay_text text;
+
+	if (factor != 1.0) {
+		counts->scaled++;
+	}
+	if (out == NULL) {
+		return;
+	}
+
+	text.len = 0;
+	wsf_replay_put_str(&text, kind == WSF_CORE_PINCH_ZOOM ? "pinch" : "rotate");
+	text.data[text.len++] = ' ';
+	wsf_replay_put_time(&text, has_time, time_us);
+	text.data[text.len++] = ' ';
+	wsf_replay_put_fixed(&text, value, 6);
+	text.data[text.len++] = ' ';
+	wsf_replay_put_fixed(&text, scaled, 6);
+	text.data[text.len++] = '\n';
+	fwrite(text.data, 1, text.len, out);
+}
+
+static bool wsf_replay_line(
+	struct wsf_core *core,
+	struct wsf_replay_counts *counts,
+	FILE *out,
+	char *line
+) {
+	struct wsf_core_event event;
+	enum wsf_event_status status = wsf_event_parse(line, &event);
+
+	if (status == WSF_EVENT_NONE) {
+		return true;
+	}
+	counts->events++;
+	if (status != WSF_EVENT_OK) {
+		return false;
+	}
+
+	if (event.kind <= WSF_CORE_SCROLL_HORIZONTAL) {
+		wsf_replay_scroll(
+			core,
+			counts,
+			out,
+			event.has_time != 0,
+			event.time_us,
+			event.device,
+			event.kind,
+			event.source,
+			event.value
+		);
+	} else {
+		wsf_replay_gesture(
+			core,
+			counts,
+			out,
+			(enum wsf_core_kind) event.kind,
+			event.has_time != 0,
+			event.time_us,
+			event.value
+		);
+	}
+	return true;
+}
+
+static double wsf_replay_elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) (now.tv_sec - start->tv_sec) +
+		((double) (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+int wsf_cmd_replay(int argc, char **argv) {
+	static char output_buffer[WSF_REPLAY_OUTPUT_BUFFER];
+	const char *config_path = NULL;
+	const char *input_path = NULL;
+	struct wsf_effective_factors factors;
+	struct wsf_core *core = NULL;
+	struct wsf_replay_counts counts = { 0, 0 };
+	struct timespec start;
+	bool summary = false;
+	bool debug = wsf_debug_enabled();
+	FILE *input = stdin;
+	FILE *out = stdout;
+	char *line = NULL;
+	size_t size = 0;
+	uint64_t line_number = 0;
+	double elapsed = 0.0;
+	int result = 0;
+	int i = 0;
+
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+			config_path = argv[++i];
+		} else if (strcmp(argv[i], "--summary") == 0) {
+			summary = true;
+		} else if (argv[i][0] == '-' && strcmp(argv[i], "-") != 0) {
+			fprintf(stderr, "Unknown option for replay: %s\n", argv[i]);
+			return 1;
+		} else if (input_path == NULL) {
+			input_path = argv[i];
+		} else {
+			fprintf(stderr, "replay takes a single input file\n");
+			return 1;
+		}
+	}
+
+	if (!wsf_event_load_factors(config_path, &factors, debug)) {
+		return 1;
+	}
+
+	if (input_path != NULL && strcmp(input_path, "-") != 0) {
+		input = fopen(input_path, "r");
+		if (input == NULL) {
+			fprintf(stderr, "Failed to open %s: %s\n", input_path, strerror(errno));
+			return 1;
+		}
+	}
+
+	core = malloc(sizeof(*core));
+	if (core == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		if (input != stdin) {
+			fclose(input);
+		}
+		return 1;
+	}
+	wsf_core_init(core, &factors);
+
+	if (summary) {
+		out = NULL;
+	} else {
+		setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+		printf("# scroll time_us device axis source raw scaled velocity multiplier\n");
+		printf("# pinch|rotate time_us raw scaled\n");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (getline(&line, &size, input) != -1) {
+		line_number++;
+		if (!wsf_replay_line(core, &counts, out, line)) {
+			fprintf(stderr, "replay: line %" PRIu64 ": malformed event\n", line_number);
+			result = 1;
+			break;
+		}
+	}
+	elapsed = wsf_replay_elapsed(&start);
+
+	if (ferror(input)) {
+		fprintf(stderr, "Failed to read input: %s\n", strerror(errno));
+		result = 1;
+	}
+	if (out != NULL && fflush(out) != 0) {
+		result = 1;
+	}
+
+	if (summary) {
+		printf(
+			"events %" PRIu64 " scaled %" PRIu64 " seconds %.3f events_per_sec %.0f\n",
+			counts.events,
+			counts.scaled,
+			elapsed,
+			elapsed > 0.0 ? (double) counts.events / elapsed : 0.0
+		);
+	}
+
+	free(line);
+	free(core);
+	if (input != stdin) {
+		fclose(input);
+	}
+	return result;
+}
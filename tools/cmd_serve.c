@@ -0,0 +1,414 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * `wsf serve` keeps one CLI process around for a front end (the GUI) and
+ * runs commands in it, one per request line on stdin:
+ *
+ *   {"id":7,"args":["set","--live","--scroll-vertical","0.5000"]}
+ *
+ * and answers each with one line on stdout, in request order:
+ *
+ *   {"id":7,"status":0,"stdout":"","stderr":""}
+ *
+ * status, stdout and stderr are what `wsf <args>` would have exited with
+ * and printed. Only commands that return promptly and do not read stdin
+ * are served. The loop ends at EOF on stdin.
+ */
+
+#define WSF_SERVE_ARGS_MAX 32
+
+static const char *const wsf_serve_commands[] = {
+	"set",
+	"get",
+	"status",
+	"doctor",
+	"enable",
+	"disable",
+	"stats",
+	NULL
+};
+
+struct wsf_serve_request {
+	long long id;
+	bool has_id;
+	int argc;
+	char *argv[WSF_SERVE_ARGS_MAX + 1];
+};
+
+struct wsf_serve_parser {
+	char *cursor;
+};
+
+static void wsf_serve_skip_space(struct wsf_serve_parser *parser) {
+	while (*parser->cursor == ' ' || *parser->cursor == '\t' ||
+		*parser->cursor == '\r' || *parser->cursor == '\n') {
+		parser->cursor++;
+	}
+}
+
+static bool wsf_serve_expect(struct wsf_serve_parser *parser, char c) {
+	wsf_serve_skip_space(parser);
+	if (*parser->cursor != c) {
+		return false;
+	}
+	parser->cursor++;
+	return true;
+}
+
+static int wsf_serve_hex(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/* Writes a UTF-8 encoding of code at out; returns the bytes written. */
+static size_t wsf_serve_utf8(char *out, unsigned int code) {
+	if (code < 0x80) {
+		out[0] = (char) code;
+		return 1;
+	}
+	if (code < 0x800) {
+		out[0] = (char) (0xc0 | (code >> 6));
+		out[1] = (char) (0x80 | (code & 0x3f));
+		return 2;
+	}
+	out[0] = (char) (0xe0 | (code >> 12));
+	out[1] = (char) (0x80 | ((code >> 6) & 0x3f));
+	out[2] = (char) (0x80 | (code & 0x3f));
+	return 3;
+}
+
+/*
+ * Decodes a string in place: the decoded form is never longer than the
+ * escaped one, so it overwrites the line it came from. Surrogate pairs
+ * are not joined; arguments are option names and numbers.
+ */
+static char *wsf_serve_string(struct wsf_serve_parser *parser) {
+	char *out = NULL;
+	char *start = NULL;
+
+	wsf_serve_skip_space(parser);
+	if (*parser->cursor != '"') {
+		return NULL;
+	}
+	start = out = ++parser->cursor;
+
+	while (*parser->cursor != '"') {
+		char c = *parser->cursor++;
+
+		if (c == '\0' || (unsigned char) c < 0x20) {
+			return NULL;
+		}
+		if (c != '\\') {
+			*out++ = c;
+			continue;
+		}
+		c = *parser->cursor++;
+		switch (c) {
+		case '"':
+		case '\\':
+		case '/':
+			*out++ = c;
+			break;
+		case 'b':
+			*out++ = '\b';
+			break;
+		case 'f':
+			*out++ = '\f';
+			break;
+		case 'n':
+			*out++ = '\n';
+			break;
+		case 'r':
+			*out++ = '\r';
+			break;
+		case 't':
+			*out++ = '\t';
+			break;
+		case 'u': {
+			unsigned int code = 0;
+			int i = 0;
+
+			for (i = 0; i < 4; i++) {
+				int digit = wsf_serve_hex(parser->cursor[i]);
+
+				if (digit < 0) {
+					return NULL;
+				}
+				code = (code << 4) | (unsigned int) digit;
+			}
+			if (code == 0) {
+				return NULL;
+			}
+			parser->cursor += 4;
+			out += wsf_serve_utf8(out, code);
+			break;
+		}
+		default:
+			return NULL;
+		}
+	}
+
+	parser->cursor++;
+	*out = '\0';
+	return start;
+}
+
+/* Skips a scalar value of a key the server does not use. */
+static bool wsf_serve_skip_value(struct wsf_serve_parser *parser) {
+	wsf_serve_skip_space(parser);
+	if (*parser->cursor == '"') {
+		return wsf_serve_string(parser) != NULL;
+	}
+	if (*parser->cursor == '{' || *parser->cursor == '[') {
+		return false;
+	}
+	while (*parser->cursor != '\0' && *parser->cursor != ',' && *parser->cursor != '}') {
+		parser->cursor++;
+	}
+	return true;
+}
+
+static bool wsf_serve_args(struct wsf_serve_parser *parser, struct wsf_serve_request *request) {
+	if (!wsf_serve_expect(parser, '[')) {
+		return false;
+	}
+	wsf_serve_skip_space(parser);
+	if (*parser->cursor == ']') {
+		parser->cursor++;
+		return true;
+	}
+
+	do {
+		char *arg = wsf_serve_string(parser);
+
+		if (arg == NULL || request->argc >= WSF_SERVE_ARGS_MAX) {
+			return false;
+		}
+		request->argv[request->argc++] = arg;
+	} while (wsf_serve_expect(parser, ','));
+
+	return wsf_serve_expect(parser, ']');
+}
+
+static bool wsf_serve_parse(char *line, struct wsf_serve_request *request) {
+	struct wsf_serve_parser parser = { line };
+	bool has_args = false;
+
+	memset(request, 0, sizeof(*request));
+	/* argv[0] is the program name, as for main(). */
+	request->argv[request->argc++] = "wsf";
+
+	if (!wsf_serve_expect(&parser, '{')) {
+		return false;
+	}
+	wsf_serve_skip_space(&parser);
+	if (*parser.cursor == '}') {
+		return false;
+	}
+
+	do {
+		char *key = wsf_serve_string(&parser);
+
+		if (key == NULL || !wsf_serve_expect(&parser, ':')) {
+			return false;
+		}
+		if (strcmp(key, "id") == 0) {
+			char *end = NULL;
+
+			wsf_serve_skip_space(&parser);
+			request->id = strtoll(parser.cursor, &end, 10);
+			if (end == parser.cursor) {
+				return false;
+			}
+			request->has_id = true;
+			parser.cursor = end;
+		} else if (strcmp(key, "args") == 0) {
+			if (!wsf_serve_args(&parser, request)) {
+				return false;
+			}
+			has_args = true;
+		} else if (!wsf_serve_skip_value(&parser)) {
+			return false;
+		}
+	} while (wsf_serve_expect(&parser, ','));
+
+	if (!wsf_serve_expect(&parser, '}')) {
+		return false;
+	}
+	wsf_serve_skip_space(&parser);
+	return *parser.cursor == '\0' && has_args;
+}
+
+static bool wsf_serve_allowed(const char *cmd) {
+	int i = 0;
+
+	for (i = 0; wsf_serve_commands[i] != NULL; i++) {
+		if (strcmp(cmd, wsf_serve_commands[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void wsf_serve_json_string(FILE *out, const char *value, size_t len) {
+	size_t i = 0;
+
+	fputc('"', out);
+	for (i = 0; i < len; i++) {
+		unsigned char c = (unsigned char) value[i];
+
+		switch (c) {
+		case '"':
+			fputs("\\\"", out);
+			break;
+		case '\\':
+			fputs("\\\\", out);
+			break;
+		case '\n':
+			fputs("\\n", out);
+			break;
+		case '\t':
+			fputs("\\t", out);
+			break;
+		default:
+			if (c < 0x20) {
+				fprintf(out, "\\u%04x", c);
+			} else {
+				fputc(c, out);
+			}
+			break;
+		}
+	}
+	fputc('"', out);
+}
+
+/*
+ * Runs one command with stdout and stderr pointed at memory streams; the
+ * commands print with printf/fprintf(stderr), which go through these
+ * globals.
+ */
+static int wsf_serve_run(
+	struct wsf_serve_request *request,
+	char **out_text,
+	size_t *out_len,
+	char **err_text,
+	size_t *err_len
+) {
+	FILE *saved_out = stdout;
+	FILE *saved_err = stderr;
+	FILE *capture_out = open_memstream(out_text, out_len);
+	FILE *capture_err = open_memstream(err_text, err_len);
+	int status = 1;
+
+	if (capture_out == NULL || capture_err == NULL) {
+		if (capture_out != NULL) {
+			fclose(capture_out);
+		}
+		if (capture_err != NULL) {
+			fclose(capture_err);
+		}
+		return -1;
+	}
+
+	stdout = capture_out;
+	stderr = capture_err;
+	if (request->argc < 2) {
+		fprintf(stderr, "Missing command.\n");
+		status = 2;
+	} else if (!wsf_serve_allowed(request->argv[1])) {
+		fprintf(stderr, "Command not available in serve mode: %s\n", request->argv[1]);
+		status = 2;
+	} else {
+		status = wsf_dispatch(request->argc, request->argv);
+	}
+	stdout = saved_out;
+	stderr = saved_err;
+
+	fclose(capture_out);
+	fclose(capture_err);
+	return status;
+}
+
+static void wsf_serve_reply(
+	const struct wsf_serve_request *request,
+	int status,
+	const char *out_text,
+	size_t out_len,
+	const char *err_text,
+	size_t err_len
+) {
+	if (request->has_id) {
+		printf("{\"id\":%lld,", request->id);
+	} else {
+		printf("{\"id\":null,");
+	}
+	printf("\"status\":%d,\"stdout\":", status);
+	wsf_serve_json_string(stdout, out_text, out_len);
+	printf(",\"stderr\":");
+	wsf_serve_json_string(stdout, err_text, err_len);
+	printf("}\n");
+	fflush(stdout);
+}
+
+int wsf_cmd_serve(int argc, char **argv) {
+	struct wsf_serve_request request;
+	char *line = NULL;
+	size_t line_cap = 0;
+	ssize_t line_len = 0;
+
+	(void) argv;
+	if (argc != 2) {
+		fprintf(stderr, "serve takes no options.\n");
+		return 1;
+	}
+
+	while ((line_len = getline(&line, &line_cap, stdin)) >= 0) {
+		char *out_text = NULL;
+		char *err_text = NULL;
+		size_t out_len = 0;
+		size_t err_len = 0;
+		int status = 0;
+
+		if (line_len > 0 && line[line_len - 1] == '\n') {
+			line[--line_len] = '\0';
+		}
+		if (line_len == 0) {
+			continue;
+		}
+
+		if (!wsf_serve_parse(line, &request)) {
+			static const char invalid[] = "Invalid request.\n";
+
+			wsf_serve_reply(&request, 2, "", 0, invalid, sizeof(invalid) - 1);
+			continue;
+		}
+
+		status = wsf_serve_run(&request, &out_text, &out_len, &err_text, &err_len);
+		if (status < 0) {
+			static const char failed[] = "Cannot capture command output.\n";
+
+			wsf_serve_reply(&request, 1, "", 0, failed, sizeof(failed) - 1);
+		} else {
+			wsf_serve_reply(&request, status, out_text, out_len, err_text, err_len);
+		}
+		free(out_text);
+		free(err_text);
+	}
+
+	free(line);
+	return 0;
+}
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_config.h"
+#include "wsf_shm.h"
+#include "wsf_stats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Ticks are converted with at least this much wall time since the origin. */
+#define WSF_STATS_MIN_CALIBRATION_NS 50000000ull
+
+struct wsf_stats_summary {
+	uint64_t calls;
+	uint64_t scaled;
+	uint64_t passthrough;
+	uint64_t buckets[WSF_STATS_BUCKETS];
+	double mean_ns;
+	double p50_ns;
+	double p99_ns;
+};
+
+static double wsf_stats_ticks_per_ns(const struct wsf_stats_block *block) {
+	uint64_t ticks = 0;
+	uint64_t now = 0;
+
+	if (block->clock != WSF_STATS_CLOCK_TSC) {
+		return 1.0;
+	}
+
+	now = wsf_stats_now_ns();
+	if (now - block->ns_origin < WSF_STATS_MIN_CALIBRATION_NS) {
+		struct timespec ts = { 0, (long) WSF_STATS_MIN_CALIBRATION_NS };
+
+		nanosleep(&ts, NULL);
+	}
+
+	ticks = wsf_stats_ticks();
+	now = wsf_stats_now_ns();
+	if (now <= block->ns_origin || ticks <= block->tick_origin) {
+		return 1.0;
+	}
+
+	return (double) (ticks - block->tick_origin) / (double) (now - block->ns_origin);
+}
+
+/* Upper bound of the bucket holding the given fraction of calls. */
+static double wsf_stats_percentile(
+	const struct wsf_stats_summary *summary,
+	double fraction,
+	double ticks_per_ns
+) {
+	uint64_t target = (uint64_t) ((double) summary->calls * fraction);
+	uint64_t seen = 0;
+	unsigned int i = 0;
+
+	for (i = 0; i < WSF_STATS_BUCKETS; i++) {
+		seen += summary->buckets[i];
+		if (seen > target || (seen == summary->calls && seen > 0)) {
+			return (double) (2ull << i) / ticks_per_ns;
+		}
+	}
+
+	return 0.0;
+}
+
+static void wsf_stats_summarize(
+	const struct wsf_stats_counters *counters,
+	double ticks_per_ns,
+	struct wsf_stats_summary *out
+) {
+	uint64_t total_ticks = atomic_load_explicit(
+		(_Atomic uint64_t *) &counters->total_ticks,
+		memory_order_relaxed
+	);
+	unsigned int i = 0;
+
+	memset(out, 0, sizeof(*out));
+	out->scaled = atomic_load_explicit((_Atomic uint64_t *) &counters->scaled, memory_order_relaxed);
+	out->passthrough =
+		atomic_load_explicit((_Atomic uint64_t *) &counters->passthrough, memory_order_relaxed);
+	for (i = 0; i < WSF_STATS_BUCKETS; i++) {
+		out->buckets[i] =
+			atomic_load_explicit((_Atomic uint64_t *) &counters->buckets[i], memory_order_relaxed);
+		out->calls += out->buckets[i];
+	}
+
+	if (out->calls == 0) {
+		return;
+	}
+
+	out->mean_ns = ((double) total_ticks / (double) out->calls) / ticks_per_ns;
+	out->p50_ns = wsf_stats_percentile(out, 0.50, ticks_per_ns);
+	out->p99_ns = wsf_stats_percentile(out, 0.99, ticks_per_ns);
+}
+
+static void wsf_stats_print_text(const struct wsf_stats_block *block, double ticks_per_ns) {
+	unsigned int hook = 0;
+
+	printf(
+		"clock: %s (%.3f ticks/ns), compositor pid %u\n",
+		block->clock == WSF_STATS_CLOCK_TSC ? "tsc" : "monotonic",
+		ticks_per_ns,
+		block->owner_pid
+	);
+	printf(
+		"%-20s %12s %12s %12s %9s %9s %9s\n",
+		"hook",
+		"calls",
+		"scaled",
+		"passthrough",
+		"mean_ns",
+		"p50_ns",
+		"p99_ns"
+	);
+
+	for (hook = 0; hook < WSF_STATS_HOOK_COUNT; hook++) {
+		struct wsf_stats_summary summary;
+
+		wsf_stats_summarize(&block->hooks[hook], ticks_per_ns, &summary);
+		printf(
+			"%-20s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %9.1f %9.1f %9.1f\n",
+			wsf_stats_hook_name((enum wsf_stats_hook) hook),
+			summary.calls,
+			summary.scaled,
+			summary.passthrough,
+			summary.mean_ns,
+			summary.p50_ns,
+			summary.p99_ns
+		);
+	}
+
+	for (hook = 0; hook < WSF_STATS_HOOK_COUNT; hook++) {
+		struct wsf_stats_summary summary;
+		unsigned int i = 0;
+
+		wsf_stats_summarize(&block->hooks[hook], ticks_per_ns, &summary);
+		if (summary.calls == 0) {
+			continue;
+		}
+
+		printf("\n%s overhead histogram:\n", wsf_stats_hook_name((enum wsf_stats_hook) hook));
+		for (i = 0; i < WSF_STATS_BUCKETS; i++) {
+			if (summary.buckets[i] == 0) {
+				continue;
+			}
+			printf(
+				"  %9.1f - %9.1f ns  %12" PRIu64 "\n",
+				(double) (1ull << i) / ticks_per_ns,
+				(double) (2ull << i) / ticks_per_ns,
+				summary.buckets[i]
+			);
+		}
+	}
+}
+
+static void wsf_stats_print_json(const struct wsf_stats_block *block, double ticks_per_ns) {
+	unsigned int hook = 0;
+
+	printf(
+		"{\"clock\":\"%s\",\"ticks_per_ns\":%.6f,\"owner_pid\":%u,\"hooks\":{",
+		block->clock == WSF_STATS_CLOCK_TSC ? "tsc" : "monotonic",
+		ticks_per_ns,
+		block->owner_pid
+	);
+
+	for (hook = 0; hook < WSF_STATS_HOOK_COUNT; hook++) {
+		struct wsf_stats_summary summary;
+		bool first = true;
+		unsigned int i = 0;
+
+		wsf_stats_summarize(&block->hooks[hook], ticks_per_ns, &summary);
+		printf(
+			"%s\"%s\":{\"calls\":%" PRIu64 ",\"scaled\":%" PRIu64 ",\"passthrough\":%" PRIu64 ","
+			"\"mean_ns\":%.3f,\"p50_ns\":%.3f,\"p99_ns\":%.3f,\"histogram_ns\":[",
+			hook > 0 ? "," : "",
+			wsf_stats_hook_name((enum wsf_stats_hook) hook),
+			summary.calls,
+			summary.scaled,
+			summary.passthrough,
+			summary.mean_ns,
+			summary.p50_ns,
+			summary.p99_ns
+		);
+		for (i = 0; i < WSF_STATS_BUCKETS; i++) {
+			if (summary.buckets[i] == 0) {
+				continue;
+			}
+			printf(
+				"%s[%.3f,%.3f,%" PRIu64 "]",
+				first ? "" : ",",
+				(double) (1ull << i) / ticks_per_ns,
+				(double) (2ull << i) / ticks_per_ns,
+				summary.buckets[i]
+			);
+			first = false;
+		}
+		printf("]}");
+	}
+
+	printf("}}\n");
+}
+
+static int wsf_stats_switch(bool on, bool debug) {
+	struct wsf_shm_block *block = wsf_shm_open(false, debug);
+	struct wsf_shm_values values;
+	bool ok = false;
+
+	if (block == NULL) {
+		fprintf(stderr, "No running compositor with the preload found.\n");
+		return 1;
+	}
+
+	if (wsf_shm_read(block, &values)) {
+		values.stats = on ? 1u : 0u;
+		ok = wsf_shm_write(block, &values);
+	}
+	wsf_shm_close(block);
+
+	if (!ok) {
+		fprintf(stderr, "Failed to update the control block.\n");
+		return 1;
+	}
+
+	printf("stats %s\n", on ? "enabled" : "disabled");
+	return 0;
+}
+
+int wsf_cmd_stats(int argc, char **argv) {
+	struct wsf_stats_block *block = NULL;
+	bool debug = wsf_debug_enabled();
+	bool json = false;
+	int i = 0;
+
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--enable") == 0) {
+			return wsf_stats_switch(true, debug);
+		} else if (strcmp(argv[i], "--disable") == 0) {
+			return wsf_stats_switch(false, debug);
+		} else {
+			fprintf(stderr, "Unknown option for stats: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	block = wsf_stats_open(false, debug);
+	if (block == NULL) {
+		fprintf(stderr, "No stats recorded (run `wsf stats --enable` first).\n");
+		return 1;
+	}
+
+	if (json) {
+		wsf_stats_print_json(block, wsf_stats_ticks_per_ns(block));
+	} else {
+		wsf_stats_print_text(block, wsf_stats_ticks_per_ns(block));
+	}
+
+	wsf_stats_close(block);
+	return 0;
+}
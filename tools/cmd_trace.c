@@ -0,0 +1,221 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_config.h"
+#include "wsf_shm.h"
+#include "wsf_trace.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define WSF_TRACE_POLL_NS 20000000L
+#define WSF_TRACE_WAIT_NS 100000000L
+
+static volatile sig_atomic_t wsf_trace_stop = 0;
+
+static void wsf_trace_on_signal(int sig) {
+	(void) sig;
+	wsf_trace_stop = 1;
+}
+
+static void wsf_trace_sleep(long ns) {
+	struct timespec ts = { 0, ns };
+
+	nanosleep(&ts, NULL);
+}
+
+static const char *wsf_trace_source_name(uint32_t source) {
+	switch (source) {
+	case 1:
+		return "wheel";
+	case 2:
+		return "finger";
+	case 3:
+		return "continuous";
+	case 4:
+		return "wheel-tilt";
+	default:
+		return "unknown";
+	}
+}
+
+static const char *wsf_trace_getter_name(uint32_t getter) {
+	static const char *const names[] = { "scroll", "v120", "axis", "discrete" };
+
+	if (getter < sizeof(names) / sizeof(names[0])) {
+		return names[getter];
+	}
+	return "unknown";
+}
+
+static void wsf_trace_print_header(bool json) {
+	if (!json) {
+		printf("# index time_us device axis source getter raw scaled velocity multiplier\n");
+	}
+}
+
+static void wsf_trace_print_entry(const struct wsf_trace_entry *entry, bool json) {
+	if (json) {
+		printf(
+			"{\"index\":%" PRIu64 ",\"time_us\":%" PRIu64 ",\"device\":%u,"
+			"\"axis\":\"%s\",\"source\":\"%s\",\"getter\":\"%s\","
+			"\"raw\":%.6f,\"scaled\":%.6f,\"velocity\":%.3f,\"multiplier\":%.6f}\n",
+			entry->index,
+			entry->time_us,
+			entry->device,
+			entry->axis == 0 ? "vertical" : "horizontal",
+			wsf_trace_source_name(entry->source),
+			wsf_trace_getter_name(entry->getter),
+			entry->raw,
+			entry->scaled,
+			entry->velocity,
+			entry->multiplier
+		);
+		return;
+	}
+
+	printf(
+		"%" PRIu64 " %" PRIu64 " %u %s %s %s %.6f %.6f %.3f %.6f\n",
+		entry->index,
+		entry->time_us,
+		entry->device,
+		entry->axis == 0 ? "vertical" : "horizontal",
+		wsf_trace_source_name(entry->source),
+		wsf_trace_getter_name(entry->getter),
+		entry->raw,
+		entry->scaled,
+		entry->velocity,
+		entry->multiplier
+	);
+}
+
+/* Prints [*next, head) and returns how many records were already overwritten. */
+static uint64_t wsf_trace_drain(const struct wsf_trace_ring *ring, uint64_t *next, bool json) {
+	uint64_t head = wsf_trace_head(ring);
+	uint64_t lost = 0;
+	struct wsf_trace_entry entry;
+
+	if (head < *next) {
+		/* The compositor restarted and reset the ring. */
+		*next = 0;
+	}
+	if (head - *next > WSF_TRACE_CAPACITY) {
+		lost = head - WSF_TRACE_CAPACITY - *next;
+		*next = head - WSF_TRACE_CAPACITY;
+	}
+
+	for (; *next < head; (*next)++) {
+		if (wsf_trace_read(ring, *next, &entry)) {
+			wsf_trace_print_entry(&entry, json);
+		} else {
+			lost++;
+		}
+	}
+
+	return lost;
+}
+
+static bool wsf_trace_set(struct wsf_shm_block *block, bool on) {
+	struct wsf_shm_values values;
+
+	if (!wsf_shm_read(block, &values)) {
+		return false;
+	}
+	values.trace = on ? 1u : 0u;
+	return wsf_shm_write(block, &values);
+}
+
+static int wsf_trace_dump(bool json, bool debug) {
+	struct wsf_trace_ring *ring = wsf_trace_open(false, debug);
+	uint64_t next = 0;
+	uint64_t lost = 0;
+
+	if (ring == NULL) {
+		fprintf(stderr, "No trace ring found (run `wsf trace` while scrolling first).\n");
+		return 1;
+	}
+
+	wsf_trace_print_header(json);
+	lost = wsf_trace_drain(ring, &next, json);
+	if (lost > 0) {
+		fprintf(stderr, "%" PRIu64 " records overwritten while reading\n", lost);
+	}
+	wsf_trace_close(ring);
+	return 0;
+}
+
+static int wsf_trace_tail(bool json, bool debug) {
+	struct wsf_shm_block *block = wsf_shm_open(false, debug);
+	struct wsf_trace_ring *ring = NULL;
+	struct sigaction action;
+	uint64_t next = 0;
+	uint64_t lost = 0;
+
+	if (block == NULL) {
+		fprintf(stderr, "No running compositor with the preload found.\n");
+		return 1;
+	}
+	if (!wsf_trace_set(block, true)) {
+		fprintf(stderr, "Failed to enable tracing.\n");
+		wsf_shm_close(block);
+		return 1;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = wsf_trace_on_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGPIPE, &action, NULL);
+
+	/* The compositor creates the ring on its next scroll or pinch event. */
+	while (!wsf_trace_stop && ring == NULL) {
+		ring = wsf_trace_open(false, debug);
+		if (ring == NULL) {
+			wsf_trace_sleep(WSF_TRACE_WAIT_NS);
+		}
+	}
+
+	if (ring != NULL) {
+		wsf_trace_print_header(json);
+		fflush(stdout);
+		next = wsf_trace_head(ring);
+		while (!wsf_trace_stop) {
+			lost += wsf_trace_drain(ring, &next, json);
+			fflush(stdout);
+			wsf_trace_sleep(WSF_TRACE_POLL_NS);
+		}
+		wsf_trace_close(ring);
+	}
+
+	wsf_trace_set(block, false);
+	wsf_shm_close(block);
+	if (lost > 0) {
+		fprintf(stderr, "%" PRIu64 " records dropped (reader too slow)\n", lost);
+	}
+	return 0;
+}
+
+int wsf_cmd_trace(int argc, char **argv) {
+	bool dump = false;
+	bool json = false;
+	int i = 0;
+
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--dump") == 0) {
+			dump = true;
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else {
+			fprintf(stderr, "Unknown option for trace: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (dump) {
+		return wsf_trace_dump(json, wsf_debug_enabled());
+	}
+	return wsf_trace_tail(json, wsf_debug_enabled());
+}
@@ -0,0 +1,883 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_config.h"
+#include "wsf_core.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * `wsf tune` fits the smoothstep curve (min/max multiplier, velocity
+ * low/high, smoothing) to recorded scroll streams. The streams are split
+ * into gestures as the engine restarts its EMA, and every gesture gets a
+ * target distance:
+ *
+ *   reversals  a gesture the user corrected (an opposite, shorter gesture
+ *              on the same axis within --correction-ms) should have
+ *              landed where the correction left it; the rest stay put.
+ *   distance   flings (peak velocity above --fling-velocity) should travel
+ *              --target-distance; the rest stay put.
+ *
+ * The cost of a curve is the mean squared log ratio of scaled distance to
+ * target, so over- and undershooting by the same factor cost the same.
+ * Candidates come from a grid over the parameter box, then rounds of
+ * smaller grids around the best so far. Each one replays the whole stream
+ * through wsf_core_scale(), and a round's candidates share the threads.
+ * The reset gap and the factors are not tuned: they decide what a gesture
+ * is and what reaches the curve.
+ */
+
+#define WSF_TUNE_DIMENSIONS 5
+#define WSF_TUNE_GRID_POINTS 5
+#define WSF_TUNE_REFINE_POINTS 3
+#define WSF_TUNE_ROUNDS_DEFAULT 6
+#define WSF_TUNE_ROUNDS_MAX 20
+#define WSF_TUNE_CORRECTION_MS_DEFAULT 1000.0
+#define WSF_TUNE_FLING_VELOCITY_DEFAULT 1000.0
+/* A corrected gesture still needs its correction past this ratio. */
+#define WSF_TUNE_OVERSHOOT 1.10
+/* Candidates are rounded to what the config file keeps. */
+#define WSF_TUNE_PRECISION 10000.0
+#define WSF_TUNE_KEYS (WSF_CORE_DEVICES * 2)
+
+enum wsf_tune_objective {
+	WSF_TUNE_REVERSALS = 0,
+	WSF_TUNE_DISTANCE = 1
+};
+
+struct wsf_tune_dimension {
+	const char *name;
+	double low;
+	double high;
+	bool logarithmic;
+};
+
+static const struct wsf_tune_dimension wsf_tune_dimensions[WSF_TUNE_DIMENSIONS] = {
+	{ "min_multiplier", 0.2, 2.0, false },
+	{ "max_multiplier", 0.5, 4.0, false },
+	{ "velocity_low", 10.0, 1000.0, true },
+	{ "velocity_high", 200.0, 10000.0, true },
+	{ "smoothing", 0.05, 1.0, false },
+};
+
+struct wsf_tune_gesture {
+	double raw;
+	/* Scaled distance with the current curve. */
+	double current;
+	double target;
+	double peak_velocity;
+	uint64_t start_us;
+	uint64_t end_us;
+	bool timed;
+	bool scored;
+	/* Followed by a correction; target is where the correction ended. */
+	bool corrected;
+	/* Is itself a correction, so not something the user aimed. */
+	bool correction;
+};
+
+struct wsf_tune_candidate {
+	struct wsf_scroll_curve_params curve;
+	/* Grid position in [0, 1] per dimension. */
+	double position[WSF_TUNE_DIMENSIONS];
+	double cost;
+	size_t overshoots;
+};
+
+struct wsf_tune {
+	struct wsf_effective_factors factors;
+	unsigned int threads;
+	unsigned int rounds;
+	enum wsf_tune_objective objective;
+	double target_distance;
+	double fling_velocity;
+	double correction_us;
+
+	/* Events that reach the curve, and the gesture each belongs to. */
+	struct wsf_core_event *events;
+	uint32_t *event_gesture;
+	size_t event_count;
+	size_t event_cap;
+	/* Index of each file's first event; velocity restarts there. */
+	size_t *file_start;
+	size_t file_count;
+
+	struct wsf_tune_gesture *gestures;
+	size_t gesture_count;
+	size_t gesture_cap;
+	size_t scored;
+	size_t corrected;
+	size_t flings;
+
+	struct wsf_tune_candidate *candidates;
+	size_t candidate_count;
+	/* Per thread: a state object and the gesture distance sums. */
+	struct wsf_core *cores;
+	double *sums;
+
+	uint64_t lines;
+	uint64_t scroll;
+	/* Per axis: events the compositor passes through at factor 1.0. */
+	uint64_t identity[2];
+};
+
+static bool wsf_tune_add_event(
+	struct wsf_tune *tune,
+	const struct wsf_core_event *event,
+	uint32_t gesture
+) {
+	if (tune->event_count == tune->event_cap) {
+		size_t cap = tune->event_cap == 0 ? 4096 : tune->event_cap * 2;
+
+		if (!wsf_parallel_grow((void **) &tune->events, sizeof(*tune->events), cap) ||
+			!wsf_parallel_grow((void **) &tune->event_gesture, sizeof(*tune->event_gesture), cap)) {
+			return false;
+		}
+		tune->event_cap = cap;
+	}
+
+	tune->events[tune->event_count] = *event;
+	tune->event_gesture[tune->event_count] = gesture;
+	tune->event_count++;
+	return true;
+}
+
+static bool wsf_tune_new_gesture(struct wsf_tune *tune, uint32_t *out_gesture) {
+	if (tune->gesture_count == UINT32_MAX) {
+		return false;
+	}
+	if (tune->gesture_count == tune->gesture_cap) {
+		size_t cap = tune->gesture_cap == 0 ? 1024 : tune->gesture_cap * 2;
+
+		if (!wsf_parallel_grow((void **) &tune->gestures, sizeof(*tune->gestures), cap)) {
+			return false;
+		}
+		tune->gesture_cap = cap;
+	}
+
+	memset(&tune->gestures[tune->gesture_count], 0, sizeof(*tune->gestures));
+	*out_gesture = (uint32_t) tune->gesture_count++;
+	return true;
+}
+
+/*
+ * Keeps the events that reach the curve and splits them into gestures,
+ * measuring each with the current curve as it goes.
+ */
+static bool wsf_tune_load_file(struct wsf_tune *tune, struct wsf_core *current, const char *path) {
+	uint32_t key_gesture[WSF_TUNE_KEYS];
+	FILE *input = fopen(path, "r");
+	char *line = NULL;
+	size_t size = 0;
+	uint64_t line_number = 0;
+	bool ok = true;
+
+	if (input == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	if (!wsf_parallel_grow(
+		(void **) &tune->file_start,
+		sizeof(*tune->file_start),
+		tune->file_count + 1
+	)) {
+		fprintf(stderr, "Out of memory.\n");
+		fclose(input);
+		return false;
+	}
+	tune->file_start[tune->file_count++] = tune->event_count;
+	wsf_core_reset(current);
+
+	while (ok && getline(&line, &size, input) != -1) {
+		struct wsf_core_event event;
+		struct wsf_core_result result;
+		struct wsf_tune_gesture *gesture = NULL;
+		unsigned int key = 0;
+		double scaled = 0.0;
+		double dt_us = 0.0;
+
+		line_number++;
+		switch (wsf_event_parse(line, &event)) {
+		case WSF_EVENT_NONE:
+			continue;
+		case WSF_EVENT_MALFORMED:
+			fprintf(stderr, "tune: %s:%" PRIu64 ": malformed event\n", path, line_number);
+			ok = false;
+			continue;
+		default:
+			break;
+		}
+		tune->lines++;
+		if (event.kind > WSF_CORE_SCROLL_HORIZONTAL) {
+			continue;
+		}
+		tune->scroll++;
+		if (wsf_engine_scroll_source_scaled(event.source) &&
+			current->scroll_factor[event.kind] == 1.0) {
+			tune->identity[event.kind]++;
+			continue;
+		}
+		if (!wsf_engine_scroll_source_scaled(event.source) ||
+			wsf_engine_scroll_trivial(event.value, current->scroll_factor[event.kind], &scaled)) {
+			continue;
+		}
+
+		key = (event.device * 2) + event.kind;
+		if (wsf_engine_scroll_restarts(
+			&current->curve,
+			&current->axis[event.device][event.kind],
+			event.has_time != 0,
+			event.time_us,
+			&dt_us
+		)) {
+			if (!wsf_tune_new_gesture(tune, &key_gesture[key])) {
+				ok = false;
+				fprintf(stderr, "Out of memory.\n");
+				continue;
+			}
+			tune->gestures[key_gesture[key]].start_us = event.time_us;
+			tune->gestures[key_gesture[key]].timed = event.has_time != 0;
+		}
+		if (!wsf_tune_add_event(tune, &event, key_gesture[key])) {
+			ok = false;
+			fprintf(stderr, "Out of memory.\n");
+			continue;
+		}
+
+		gesture = &tune->gestures[key_gesture[key]];
+		wsf_core_scale(current, &event, &result);
+		gesture->raw += event.value;
+		gesture->current += result.value;
+		gesture->peak_velocity = fmax(gesture->peak_velocity, result.velocity);
+		gesture->timed = gesture->timed && event.has_time != 0;
+		gesture->end_us = event.time_us;
+	}
+
+	if (ok && ferror(input)) {
+		fprintf(stderr, "Failed to read %s: %s\n", path, strerror(errno));
+		ok = false;
+	}
+	free(line);
+	fclose(input);
+	return ok;
+}
+
+/*
+ * A correction follows on the same axis within the correction window,
+ * goes the other way and is shorter; the user meant to stop where it
+ * ended. Gestures are in stream order, so a key's previous gesture is the
+ * last one seen for it within the same file.
+ */
+static void wsf_tune_find_corrections(struct wsf_tune *tune) {
+	size_t file = 0;
+
+	for (file = 0; file < tune->file_count; file++) {
+		size_t begin = tune->file_start[file];
+		size_t end = file + 1 < tune->file_count ? tune->file_start[file + 1] : tune->event_count;
+		int64_t previous[WSF_TUNE_KEYS];
+		size_t i = 0;
+
+		for (i = 0; i < WSF_TUNE_KEYS; i++) {
+			previous[i] = -1;
+		}
+		for (i = begin; i < end; i++) {
+			const struct wsf_core_event *event = &tune->events[i];
+			unsigned int key = (event->device * 2) + event->kind;
+			uint32_t index = tune->event_gesture[i];
+			struct wsf_tune_gesture *gesture = &tune->gestures[index];
+			struct wsf_tune_gesture *before = NULL;
+			double intended = 0.0;
+
+			if (previous[key] == (int64_t) index) {
+				continue;
+			}
+			if (previous[key] >= 0) {
+				before = &tune->gestures[previous[key]];
+			}
+			previous[key] = index;
+			if (before == NULL || before->correction || !before->timed || !gesture->timed ||
+				gesture->start_us < before->end_us ||
+				(double) (gesture->start_us - before->end_us) > tune->correction_us ||
+				(before->raw > 0.0) == (gesture->raw > 0.0) ||
+				fabs(gesture->raw) >= fabs(before->raw)) {
+				continue;
+			}
+
+			intended = before->current + gesture->current;
+			if ((intended > 0.0) != (before->current > 0.0) || intended == 0.0) {
+				continue;
+			}
+			before->corrected = true;
+			before->target = fabs(intended);
+			gesture->correction = true;
+		}
+	}
+}
+
+static void wsf_tune_set_targets(struct wsf_tune *tune) {
+	size_t i = 0;
+
+	if (tune->objective == WSF_TUNE_REVERSALS) {
+		wsf_tune_find_corrections(tune);
+	}
+	for (i = 0; i < tune->gesture_count; i++) {
+		struct wsf_tune_gesture *gesture = &tune->gestures[i];
+
+		if (gesture->correction || !isfinite(gesture->current) || gesture->current == 0.0) {
+			gesture->corrected = false;
+			continue;
+		}
+		if (tune->objective == WSF_TUNE_DISTANCE) {
+			if (gesture->peak_velocity >= tune->fling_velocity) {
+				gesture->target = tune->target_distance;
+				tune->flings++;
+			} else {
+				gesture->target = fabs(gesture->current);
+			}
+		} else if (gesture->corrected) {
+			tune->corrected++;
+		} else {
+			gesture->target = fabs(gesture->current);
+		}
+		gesture->scored = true;
+		tune->scored++;
+	}
+}
+
+static double wsf_tune_round(double value) {
+	return round(value * WSF_TUNE_PRECISION) / WSF_TUNE_PRECISION;
+}
+
+static void wsf_tune_candidate_at(
+	const struct wsf_tune *tune,
+	const double *position,
+	struct wsf_tune_candidate *candidate
+) {
+	double values[WSF_TUNE_DIMENSIONS];
+	unsigned int d = 0;
+
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		const struct wsf_tune_dimension *dimension = &wsf_tune_dimensions[d];
+
+		candidate->position[d] = position[d];
+		if (dimension->logarithmic) {
+			values[d] = dimension->low * pow(dimension->high / dimension->low, position[d]);
+		} else {
+			values[d] = dimension->low + ((dimension->high - dimension->low) * position[d]);
+		}
+		values[d] = wsf_tune_round(values[d]);
+	}
+
+	candidate->curve = tune->factors.curve;
+	candidate->curve.kind = WSF_SCROLL_CURVE_SMOOTHSTEP;
+	candidate->curve.min_multiplier = values[0];
+	candidate->curve.max_multiplier = values[1];
+	candidate->curve.velocity_low = values[2];
+	candidate->curve.velocity_high = values[3];
+	candidate->curve.smoothing = values[4];
+	candidate->cost = INFINITY;
+	candidate->overshoots = 0;
+}
+
+/* The tuned parameters in wsf_tune_dimensions order. */
+static void wsf_tune_values(const struct wsf_scroll_curve_params *curve, double *out_values) {
+	out_values[0] = curve->min_multiplier;
+	out_values[1] = curve->max_multiplier;
+	out_values[2] = curve->velocity_low;
+	out_values[3] = curve->velocity_high;
+	out_values[4] = curve->smoothing;
+}
+
+/* Where a smoothstep curve sits in the box, if it does. */
+static bool wsf_tune_position_of(const struct wsf_scroll_curve_params *curve, double *out_position) {
+	double values[WSF_TUNE_DIMENSIONS];
+	unsigned int d = 0;
+
+	if (curve->kind != WSF_SCROLL_CURVE_SMOOTHSTEP) {
+		return false;
+	}
+	wsf_tune_values(curve, values);
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		const struct wsf_tune_dimension *dimension = &wsf_tune_dimensions[d];
+
+		if (values[d] < dimension->low || values[d] > dimension->high) {
+			return false;
+		}
+		if (dimension->logarithmic) {
+			out_position[d] = log(values[d] / dimension->low) / log(dimension->high / dimension->low);
+		} else {
+			out_position[d] = (values[d] - dimension->low) / (dimension->high - dimension->low);
+		}
+	}
+	return true;
+}
+
+/* Replays every event with one candidate curve and scores the gestures. */
+static void wsf_tune_evaluate(void *context, size_t index, unsigned int thread) {
+	struct wsf_tune *tune = context;
+	struct wsf_tune_candidate *candidate = &tune->candidates[index];
+	struct wsf_core *core = &tune->cores[thread];
+	double *sums = tune->sums + ((size_t) thread * tune->gesture_count);
+	size_t file = 0;
+	size_t i = 0;
+	double cost = 0.0;
+
+	if (!wsf_scroll_curve_params_valid(&candidate->curve)) {
+		return;
+	}
+
+	core->curve = candidate->curve;
+	wsf_curve_compile(&core->curve_table, &core->curve);
+	memset(sums, 0, tune->gesture_count * sizeof(*sums));
+	for (file = 0; file < tune->file_count; file++) {
+		size_t end = file + 1 < tune->file_count ? tune->file_start[file + 1] : tune->event_count;
+
+		wsf_core_reset(core);
+		for (i = tune->file_start[file]; i < end; i++) {
+			sums[tune->event_gesture[i]] += wsf_core_scale(core, &tune->events[i], NULL);
+		}
+	}
+
+	candidate->overshoots = 0;
+	for (i = 0; i < tune->gesture_count; i++) {
+		const struct wsf_tune_gesture *gesture = &tune->gestures[i];
+		double distance = 0.0;
+		double ratio = 0.0;
+
+		if (!gesture->scored) {
+			continue;
+		}
+		/* A gesture whose events cancel out is a miss, not infinitely far off. */
+		distance = fmax(fabs(sums[i]), gesture->target * 1e-6);
+		ratio = log(distance / gesture->target);
+		cost += ratio * ratio;
+		if (gesture->corrected && distance > gesture->target * WSF_TUNE_OVERSHOOT) {
+			candidate->overshoots++;
+		}
+	}
+	candidate->cost = cost / (double) tune->scored;
+}
+
+/* Lowest cost wins; ties go to the earlier candidate, whatever the thread count. */
+static size_t wsf_tune_best(const struct wsf_tune *tune) {
+	size_t best = 0;
+	size_t i = 0;
+
+	for (i = 1; i < tune->candidate_count; i++) {
+		if (tune->candidates[i].cost < tune->candidates[best].cost) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+/*
+ * Every combination of points per dimension, spaced step apart around
+ * center and clamped to the box.
+ */
+static void wsf_tune_grid(
+	struct wsf_tune *tune,
+	const double *center,
+	double step,
+	unsigned int points
+) {
+	size_t combinations = 1;
+	size_t combination = 0;
+	unsigned int d = 0;
+
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		combinations *= points;
+	}
+	for (combination = 0; combination < combinations; combination++) {
+		double position[WSF_TUNE_DIMENSIONS];
+		size_t rest = combination;
+
+		for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+			double offset = (double) (rest % points) - ((double) (points - 1) / 2.0);
+
+			position[d] = fmin(1.0, fmax(0.0, center[d] + (offset * step)));
+			rest /= points;
+		}
+		wsf_tune_candidate_at(tune, position, &tune->candidates[tune->candidate_count++]);
+	}
+}
+
+/*
+ * A coarse grid over the whole box, then finer ones around the best so
+ * far. A current smoothstep curve inside the box counts as the best until
+ * a candidate beats it, so the search refines from there rather than from
+ * a grid point that fits worse.
+ */
+static bool wsf_tune_search(
+	struct wsf_tune *tune,
+	const struct wsf_tune_candidate *current,
+	struct wsf_tune_candidate *out_best
+) {
+	size_t capacity = 1;
+	double box[WSF_TUNE_DIMENSIONS];
+	double center[WSF_TUNE_DIMENSIONS];
+	double step = 1.0 / (WSF_TUNE_GRID_POINTS - 1);
+	unsigned int pass = 0;
+	unsigned int d = 0;
+
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		capacity *= WSF_TUNE_GRID_POINTS;
+		box[d] = 0.5;
+		center[d] = 0.5;
+	}
+	tune->candidates = malloc(capacity * sizeof(*tune->candidates));
+	if (tune->candidates == NULL) {
+		return false;
+	}
+
+	memset(out_best, 0, sizeof(*out_best));
+	out_best->cost = INFINITY;
+	if (wsf_tune_position_of(&current->curve, center)) {
+		*out_best = *current;
+		memcpy(out_best->position, center, sizeof(center));
+	}
+	for (pass = 0; pass < tune->rounds; pass++) {
+		size_t best = 0;
+
+		tune->candidate_count = 0;
+		if (pass == 0) {
+			wsf_tune_grid(tune, box, step, WSF_TUNE_GRID_POINTS);
+		} else {
+			step /= 2.0;
+			wsf_tune_grid(tune, center, step, WSF_TUNE_REFINE_POINTS);
+		}
+		wsf_parallel_run(tune->threads, wsf_tune_evaluate, tune, tune->candidate_count);
+
+		best = wsf_tune_best(tune);
+		if (tune->candidates[best].cost < out_best->cost) {
+			*out_best = tune->candidates[best];
+			memcpy(center, out_best->position, sizeof(center));
+		}
+	}
+
+	return true;
+}
+
+static size_t wsf_tune_candidates_per_run(unsigned int rounds) {
+	size_t grid = 1;
+	size_t refine = 1;
+	unsigned int d = 0;
+
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		grid *= WSF_TUNE_GRID_POINTS;
+		refine *= WSF_TUNE_REFINE_POINTS;
+	}
+	return grid + (refine * (rounds - 1)) + 1;
+}
+
+static void wsf_tune_print(
+	const struct wsf_tune *tune,
+	const struct wsf_tune_candidate *current,
+	const struct wsf_tune_candidate *best,
+	double seconds
+) {
+	const struct wsf_scroll_curve_params *before = &current->curve;
+	const struct wsf_scroll_curve_params *after = &best->curve;
+	double before_values[WSF_TUNE_DIMENSIONS];
+	double after_values[WSF_TUNE_DIMENSIONS];
+	unsigned int d = 0;
+
+	printf(
+		"files %zu events %" PRIu64 " scroll %" PRIu64 " curve %zu gestures %zu scored %zu\n",
+		tune->file_count,
+		tune->lines,
+		tune->scroll,
+		tune->event_count,
+		tune->gesture_count,
+		tune->scored
+	);
+	if (tune->objective == WSF_TUNE_DISTANCE) {
+		printf(
+			"objective distance target %.1f fling_velocity %.1f flings %zu\n",
+			tune->target_distance,
+			tune->fling_velocity,
+			tune->flings
+		);
+	} else {
+		printf(
+			"objective reversals correction_ms %.0f corrected %zu\n",
+			tune->correction_us / 1000.0,
+			tune->corrected
+		);
+	}
+	printf(
+		"candidates %zu rounds %u threads %u\n",
+		wsf_tune_candidates_per_run(tune->rounds),
+		tune->rounds,
+		tune->threads
+	);
+	printf("seconds %.3f\n", seconds);
+
+	printf("\n%-16s %12s %12s\n", "", "current", "tuned");
+	printf(
+		"%-16s %12s %12s\n",
+		"kind",
+		wsf_scroll_curve_kind_name(before->kind),
+		wsf_scroll_curve_kind_name(after->kind)
+	);
+	wsf_tune_values(before, before_values);
+	wsf_tune_values(after, after_values);
+	for (d = 0; d < WSF_TUNE_DIMENSIONS; d++) {
+		printf("%-16s", wsf_tune_dimensions[d].name);
+		/* The smoothstep keys mean nothing to a curve given by points. */
+		if (before->kind == WSF_SCROLL_CURVE_SMOOTHSTEP) {
+			printf(" %12.4f", before_values[d]);
+		} else {
+			printf(" %12s", "-");
+		}
+		if (after->kind == WSF_SCROLL_CURVE_SMOOTHSTEP) {
+			printf(" %12.4f\n", after_values[d]);
+		} else {
+			printf(" %12s\n", "-");
+		}
+	}
+	printf("%-16s %12.6f %12.6f\n", "cost", current->cost, best->cost);
+	if (tune->objective == WSF_TUNE_REVERSALS) {
+		printf("%-16s %12zu %12zu\n", "overshoots", current->overshoots, best->overshoots);
+	}
+}
+
+/* Only the smoothstep keys change; points stay for switching back. */
+static bool wsf_tune_write(const struct wsf_scroll_curve_params *curve) {
+	struct wsf_config_values updates;
+	struct wsf_config_txn txn;
+	bool debug = wsf_debug_enabled();
+
+	wsf_config_values_init(&updates);
+	updates.curve.kind = WSF_SCROLL_CURVE_SMOOTHSTEP;
+	updates.curve.min_multiplier = curve->min_multiplier;
+	updates.curve.max_multiplier = curve->max_multiplier;
+	updates.curve.velocity_low = curve->velocity_low;
+	updates.curve.velocity_high = curve->velocity_high;
+	updates.curve.smoothing = curve->smoothing;
+	updates.has_curve_kind = true;
+	updates.has_curve_min_multiplier = true;
+	updates.has_curve_max_multiplier = true;
+	updates.has_curve_velocity_low = true;
+	updates.has_curve_velocity_high = true;
+	updates.has_curve_smoothing = true;
+
+	if (wsf_config_txn_begin(&txn, debug) != 0 ||
+		wsf_config_merge_updates(&txn.values, &updates) != 0) {
+		wsf_config_txn_end(&txn);
+		fprintf(stderr, "Failed to write config.\n");
+		return false;
+	}
+	if (wsf_config_txn_commit(&txn, debug) != 0) {
+		fprintf(stderr, "Failed to write config.\n");
+		return false;
+	}
+	return true;
+}
+
+static bool wsf_tune_parse_positive(const char *option, const char *input, double *out_value) {
+	char *end = NULL;
+	double value = 0.0;
+
+	errno = 0;
+	value = strtod(input, &end);
+	if (errno != 0 || end == input || *end != '\0' || !isfinite(value) || value <= 0.0) {
+		fprintf(stderr, "%s takes a positive number.\n", option);
+		return false;
+	}
+	*out_value = value;
+	return true;
+}
+
+static void wsf_tune_free(struct wsf_tune *tune) {
+	free(tune->events);
+	free(tune->event_gesture);
+	free(tune->file_start);
+	free(tune->gestures);
+	free(tune->candidates);
+	free(tune->cores);
+	free(tune->sums);
+}
+
+int wsf_cmd_tune(int argc, char **argv) {
+	const char *config_path = NULL;
+	struct wsf_tune tune;
+	struct wsf_core *current = NULL;
+	struct wsf_tune_candidate baseline;
+	struct wsf_tune_candidate best;
+	struct timespec start;
+	bool dry_run = false;
+	bool has_target = false;
+	bool ok = true;
+	unsigned int thread = 0;
+	unsigned int axis = 0;
+	int first_file = 0;
+	int i = 0;
+
+	memset(&tune, 0, sizeof(tune));
+	tune.threads = wsf_parallel_default_threads();
+	tune.rounds = WSF_TUNE_ROUNDS_DEFAULT;
+	tune.objective = WSF_TUNE_REVERSALS;
+	tune.fling_velocity = WSF_TUNE_FLING_VELOCITY_DEFAULT;
+	tune.correction_us = WSF_TUNE_CORRECTION_MS_DEFAULT * 1000.0;
+
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+			config_path = argv[++i];
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			if (!wsf_parallel_parse_threads(argv[++i], &tune.threads)) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--objective") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "reversals") == 0) {
+				tune.objective = WSF_TUNE_REVERSALS;
+			} else if (strcmp(argv[i], "distance") == 0) {
+				tune.objective = WSF_TUNE_DISTANCE;
+			} else {
+				fprintf(stderr, "--objective takes reversals or distance.\n");
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--target-distance") == 0 && i + 1 < argc) {
+			if (!wsf_tune_parse_positive(argv[i], argv[i + 1], &tune.target_distance)) {
+				return 1;
+			}
+			has_target = true;
+			i++;
+		} else if (strcmp(argv[i], "--fling-velocity") == 0 && i + 1 < argc) {
+			if (!wsf_tune_parse_positive(argv[i], argv[i + 1], &tune.fling_velocity)) {
+				return 1;
+			}
+			i++;
+		} else if (strcmp(argv[i], "--correction-ms") == 0 && i + 1 < argc) {
+			if (!wsf_tune_parse_positive(argv[i], argv[i + 1], &tune.correction_us)) {
+				return 1;
+			}
+			tune.correction_us *= 1000.0;
+			i++;
+		} else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+			char *end = NULL;
+			long rounds = strtol(argv[++i], &end, 10);
+
+			if (*end != '\0' || rounds < 1 || rounds > WSF_TUNE_ROUNDS_MAX) {
+				fprintf(stderr, "--rounds takes 1 to %d.\n", WSF_TUNE_ROUNDS_MAX);
+				return 1;
+			}
+			tune.rounds = (unsigned int) rounds;
+		} else if (strcmp(argv[i], "--dry-run") == 0) {
+			dry_run = true;
+		} else if (strcmp(argv[i], "--") == 0) {
+			i++;
+			break;
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "Unknown option for tune: %s\n", argv[i]);
+			return 1;
+		} else {
+			break;
+		}
+	}
+	first_file = i;
+	if (first_file >= argc) {
+		fprintf(stderr, "tune takes one or more trace files.\n");
+		return 1;
+	}
+	if (tune.objective == WSF_TUNE_DISTANCE && !has_target) {
+		fprintf(stderr, "--objective distance needs --target-distance.\n");
+		return 1;
+	}
+
+	if (!wsf_event_load_factors(config_path, &tune.factors, wsf_debug_enabled())) {
+		return 1;
+	}
+	current = malloc(sizeof(*current));
+	if (current == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+	wsf_core_init(current, &tune.factors);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = first_file; ok && i < argc; i++) {
+		ok = wsf_tune_load_file(&tune, current, argv[i]);
+	}
+	free(current);
+	if (!ok) {
+		wsf_tune_free(&tune);
+		return 1;
+	}
+
+	wsf_tune_set_targets(&tune);
+	for (axis = WSF_CORE_SCROLL_VERTICAL; axis <= WSF_CORE_SCROLL_HORIZONTAL; axis++) {
+		if (tune.identity[axis] != 0) {
+			fprintf(
+				stderr,
+				"%s scrolling is at factor 1.0, which niri passes through without the curve; "
+				"its %" PRIu64 " events are not fitted.\n",
+				wsf_event_axis_name(axis),
+				tune.identity[axis]
+			);
+		}
+	}
+	if (tune.scored == 0) {
+		fprintf(stderr, "No scroll gestures reach the curve; nothing to fit.\n");
+		ok = false;
+	} else if (tune.objective == WSF_TUNE_REVERSALS && tune.corrected == 0) {
+		fprintf(stderr, "No corrected gestures in the traces; nothing to fit.\n");
+		ok = false;
+	} else if (tune.objective == WSF_TUNE_DISTANCE && tune.flings == 0) {
+		fprintf(stderr, "No flings above %.1f units/s in the traces.\n", tune.fling_velocity);
+		ok = false;
+	}
+	if (!ok) {
+		wsf_tune_free(&tune);
+		return 1;
+	}
+
+	tune.cores = malloc(tune.threads * sizeof(*tune.cores));
+	tune.sums = malloc((size_t) tune.threads * tune.gesture_count * sizeof(*tune.sums));
+	if (tune.cores == NULL || tune.sums == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		wsf_tune_free(&tune);
+		return 1;
+	}
+	for (thread = 0; thread < tune.threads; thread++) {
+		wsf_core_init(&tune.cores[thread], &tune.factors);
+	}
+
+	/* The current curve is scored the same way, whatever its kind. */
+	memset(&baseline, 0, sizeof(baseline));
+	baseline.curve = tune.factors.curve;
+	tune.candidates = &baseline;
+	tune.candidate_count = 1;
+	wsf_tune_evaluate(&tune, 0, 0);
+	tune.candidates = NULL;
+
+	if (!wsf_tune_search(&tune, &baseline, &best)) {
+		fprintf(stderr, "Out of memory.\n");
+		wsf_tune_free(&tune);
+		return 1;
+	}
+	if (!(best.cost < baseline.cost)) {
+		best = baseline;
+	}
+	wsf_tune_print(&tune, &baseline, &best, wsf_parallel_elapsed(&start));
+
+	if (best.cost == baseline.cost) {
+		printf("current curve fits best; config unchanged\n");
+	} else if (dry_run) {
+		printf("dry run; config unchanged\n");
+	} else if (wsf_tune_write(&best.curve)) {
+		printf("config updated\n");
+	} else {
+		ok = false;
+	}
+
+	wsf_tune_free(&tune);
+	return ok ? 0 : 1;
+}
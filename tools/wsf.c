@@ -1,10 +1,14 @@
 #define _GNU_SOURCE
 
+#include "wsf_cmd.h"
 #include "wsf_config.h"
+#include "wsf_ldcache.h"
+#include "wsf_shm.h"
 
 #include <errno.h>
 #include <ctype.h>
 #include <dlfcn.h>
+#include <link.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,7 +49,7 @@ static bool wsf_env_dir_path(char *buf, size_t len) {
 	return wsf_build_path(buf, len, ".config/environment.d");
 }
 
-static bool wsf_lib_path(char *buf, size_t len) {
+bool wsf_lib_path(char *buf, size_t len) {
 	const char *override = getenv("WSF_LIB_PATH");
 	int written = 0;
 
@@ -121,11 +125,24 @@ static void wsf_print_usage(const char *prog) {
 	fprintf(stderr, "    --pinch-zoom <factor>\n");
 	fprintf(stderr, "    --pinch-rotate <factor>\n");
 	fprintf(stderr, "    --factor <factor>\n");
+	fprintf(stderr, "    --live         Also retune a running niri immediately\n");
+	fprintf(stderr, "    --preview      Only retune a running niri; leave the config\n");
 	fprintf(stderr, "  get [--json]   Print effective factors\n");
 	fprintf(stderr, "  enable         Enable preload via environment.d\n");
 	fprintf(stderr, "  disable        Disable preload via environment.d\n");
 	fprintf(stderr, "  status [--json] Show current status\n");
 	fprintf(stderr, "  doctor [--json] Print diagnostics\n");
+	fprintf(stderr, "  trace [--dump] [--json] Tail (or dump) scaled scroll events\n");
+	fprintf(stderr, "  stats [--json|--enable|--disable] Per-hook overhead in the running niri\n");
+	fprintf(stderr, "  replay [--config FILE] [--summary] [FILE] Scale a recorded event stream\n");
+	fprintf(stderr, "  analyze [--config FILE] [--threads N] [--json] FILE...\n");
+	fprintf(stderr, "                 Velocity, multiplier and gesture statistics of traces\n");
+	fprintf(stderr, "  tune [--objective reversals|distance] [--target-distance D] [--dry-run] FILE...\n");
+	fprintf(stderr, "                 Fit the scroll curve to traces and write it to the config\n");
+	fprintf(stderr, "  bench startup [--runs N] [--lib PATH] [--json] [-- CMD...]\n");
+	fprintf(stderr, "                 Process startup latency with and without the preload\n");
+	fprintf(stderr, "  bench memory [--lib PATH] [--json] Preload footprint across live processes\n");
+	fprintf(stderr, "  serve          Run commands from JSON lines on stdin (for the GUI)\n");
 }
 
 static bool wsf_parse_factor_arg(const char *arg, double *out_factor) {
@@ -162,14 +179,106 @@ static bool wsf_parse_factor_arg(const char *arg, double *out_factor) {
 	return true;
 }
 
+enum wsf_live_result {
+	WSF_LIVE_APPLIED = 0,
+	WSF_LIVE_NOT_RUNNING = 1,
+	WSF_LIVE_ENV_OVERRIDES = 2,
+	WSF_LIVE_FAILED = 3
+};
+
+/*
+ * Pushes the config just committed straight into the running compositor's
+ * control block, tagged with the file's generation so the compositor's
+ * own reload of the file is skipped. A preview was never committed and
+ * carries no generation, so the next reload of the file replaces it. A
+ * compositor with WSF_* overrides resolves the file against an
+ * environment this process cannot see, so it is left to reload the file
+ * itself.
+ */
+static enum wsf_live_result wsf_apply_live(
+	const struct wsf_config_values *values,
+	bool preview,
+	bool debug
+) {
+	struct wsf_effective_factors factors;
+	struct wsf_shm_values live;
+	struct wsf_shm_values current;
+	struct wsf_shm_block *block = wsf_shm_open(false, debug);
+	bool ok = false;
+
+	if (block == NULL) {
+		return WSF_LIVE_NOT_RUNNING;
+	}
+	if ((block->flags & WSF_SHM_FLAG_ENV_OVERRIDES) != 0) {
+		wsf_shm_close(block);
+		return WSF_LIVE_ENV_OVERRIDES;
+	}
+
+	wsf_config_resolve(values, &factors);
+	wsf_shm_values_from_factors(&live, &factors);
+	if (preview) {
+		live.config_generation = 0;
+	}
+	if (wsf_shm_read(block, &current)) {
+		live.trace = current.trace;
+		live.stats = current.stats;
+	}
+	ok = wsf_shm_write(block, &live);
+	wsf_shm_close(block);
+	return ok ? WSF_LIVE_APPLIED : WSF_LIVE_FAILED;
+}
+
+/* A preview that reached no compositor did nothing, so it fails. */
+static int wsf_report_live(enum wsf_live_result result, bool preview) {
+	switch (result) {
+	case WSF_LIVE_APPLIED:
+		printf("live values updated\n");
+		return 0;
+	case WSF_LIVE_ENV_OVERRIDES:
+		fprintf(stderr,
+			"Warning: niri runs with WSF_* overrides; it applies the config on its own reload.\n"
+		);
+		break;
+	case WSF_LIVE_NOT_RUNNING:
+	case WSF_LIVE_FAILED:
+		fprintf(stderr,
+			preview ?
+				"Warning: no running compositor with the preload; nothing to preview.\n" :
+				"Warning: no running compositor with the preload; config only.\n"
+		);
+		break;
+	}
+	return preview ? 1 : 0;
+}
+
 static int wsf_cmd_set(int argc, char **argv) {
 	struct wsf_config_values updates;
+	struct wsf_config_values current;
+	struct wsf_config_txn txn;
 	bool has_updates = false;
+	bool live = false;
+	bool preview = false;
 	bool debug = wsf_debug_enabled();
+	int status = WSF_CONFIG_OK;
 	int i = 0;
+	int j = 0;
 
 	wsf_config_values_init(&updates);
 
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--live") == 0) {
+			live = true;
+			continue;
+		}
+		if (strcmp(argv[i], "--preview") == 0) {
+			preview = true;
+			continue;
+		}
+		argv[2 + j] = argv[i];
+		j++;
+	}
+	argc = 2 + j;
+
 	if (argc == 3 && argv[2][0] != '-') {
 		double factor = 0.0;
 
@@ -251,15 +360,52 @@ static int wsf_cmd_set(int argc, char **argv) {
 		return 1;
 	}
 
-	if (wsf_config_write_updates(&updates, debug) != 0) {
+	/* A preview only retunes the running compositor; the file stays as it is. */
+	if (preview) {
+		status = wsf_config_read(&current, debug);
+		if (status == WSF_CONFIG_INVALID || status == WSF_CONFIG_ERROR ||
+			wsf_config_merge_updates(&current, &updates) != 0) {
+			fprintf(stderr, "Failed to read config.\n");
+			return 1;
+		}
+		return wsf_report_live(wsf_apply_live(&current, true, debug), true);
+	}
+
+	/* The lock keeps a concurrent `wsf set` (or the GUI) from interleaving. */
+	if (wsf_config_txn_begin(&txn, debug) != 0 ||
+		wsf_config_merge_updates(&txn.values, &updates) != 0) {
+		wsf_config_txn_end(&txn);
 		fprintf(stderr, "Failed to write config.\n");
 		return 1;
 	}
 
+	if (wsf_config_txn_commit(&txn, debug) != 0) {
+		fprintf(stderr, "Failed to write config.\n");
+		return 1;
+	}
+
+	/* Only after the commit: a pushed generation the file never reached would hide the next one. */
+	if (live) {
+		wsf_report_live(wsf_apply_live(&txn.values, false, debug), false);
+	}
+
 	printf("config updated\n");
 	return 0;
 }
 
+static void wsf_print_curve_points(const struct wsf_scroll_curve_params *curve, bool json) {
+	unsigned int i = 0;
+
+	for (i = 0; i < curve->point_count; i++) {
+		printf(
+			json ? "%s[%.4f,%.4f]" : "%s%.4f:%.4f",
+			i > 0 ? "," : "",
+			curve->point_velocity[i],
+			curve->point_multiplier[i]
+		);
+	}
+}
+
 static int wsf_cmd_get(bool json) {
 	struct wsf_effective_factors factors;
 	int status = wsf_effective_factors(&factors, false);
@@ -271,13 +417,18 @@ static int wsf_cmd_get(bool json) {
 			"\"scroll_horizontal_factor\":%.4f,"
 			"\"pinch_zoom_factor\":%.4f,"
 			"\"pinch_rotate_factor\":%.4f,"
-			"\"legacy_factor_used\":%s}\n",
+			"\"legacy_factor_used\":%s,"
+			"\"scroll_curve\":\"%s\","
+			"\"scroll_curve_points\":[",
 			factors.scroll_vertical,
 			factors.scroll_horizontal,
 			factors.pinch_zoom,
 			factors.pinch_rotate,
-			factors.used_legacy_factor ? "true" : "false"
+			factors.used_legacy_factor ? "true" : "false",
+			wsf_scroll_curve_kind_name(factors.curve.kind)
 		);
+		wsf_print_curve_points(&factors.curve, true);
+		printf("]}\n");
 		return 0;
 	}
 
@@ -285,6 +436,12 @@ static int wsf_cmd_get(bool json) {
 	printf("scroll_horizontal_factor=%.4f\n", factors.scroll_horizontal);
 	printf("pinch_zoom_factor=%.4f\n", factors.pinch_zoom);
 	printf("pinch_rotate_factor=%.4f\n", factors.pinch_rotate);
+	printf("scroll_curve=%s\n", wsf_scroll_curve_kind_name(factors.curve.kind));
+	if (factors.curve.point_count > 0) {
+		printf("scroll_curve_points=");
+		wsf_print_curve_points(&factors.curve, false);
+		printf("\n");
+	}
 	return 0;
 }
 
@@ -375,7 +532,7 @@ static void wsf_print_factor_status(int status) {
 	}
 }
 
-static void wsf_print_json_string(const char *value) {
+void wsf_print_json_string(const char *value) {
 	const unsigned char *cursor = (const unsigned char *) value;
 
 	if (value == NULL) {
@@ -414,6 +571,26 @@ static void wsf_print_json_string(const char *value) {
 	printf("\"");
 }
 
+/*
+ * The config generation the running compositor has applied, from its
+ * control block. False when no compositor with the preload is running.
+ */
+static bool wsf_running_generation(uint64_t *out_generation) {
+	struct wsf_shm_block *block = wsf_shm_open(false, false);
+	struct wsf_shm_values values;
+	bool ok = false;
+
+	if (block == NULL) {
+		return false;
+	}
+	ok = wsf_shm_read(block, &values);
+	wsf_shm_close(block);
+	if (ok) {
+		*out_generation = values.config_generation;
+	}
+	return ok;
+}
+
 static int wsf_cmd_status(bool json) {
 	char env_path[512];
 	char lib_path[512];
@@ -425,6 +602,8 @@ static int wsf_cmd_status(bool json) {
 	const char *env_scroll_horizontal = getenv("WSF_SCROLL_HORIZONTAL_FACTOR");
 	const char *env_pinch_zoom = getenv("WSF_PINCH_ZOOM_FACTOR");
 	const char *env_pinch_rotate = getenv("WSF_PINCH_ROTATE_FACTOR");
+	uint64_t running_generation = 0;
+	bool running = wsf_running_generation(&running_generation);
 	bool env_present = false;
 	bool lib_present = false;
 
@@ -462,6 +641,15 @@ static int wsf_cmd_status(bool json) {
 		wsf_print_json_string(config_path);
 		printf(",");
 		printf("\"config_present\":%s,", config_present ? "true" : "false");
+		printf("\"config_generation\":%llu,", (unsigned long long) factors.generation);
+		if (running) {
+			printf(
+				"\"running_generation\":%llu,",
+				(unsigned long long) running_generation
+			);
+		} else {
+			printf("\"running_generation\":null,");
+		}
 		printf("\"factors\":{");
 		printf("\"scroll_vertical_factor\":%.4f,", factors.scroll_vertical);
 		printf("\"scroll_horizontal_factor\":%.4f,", factors.scroll_horizontal);
@@ -483,6 +671,14 @@ static int wsf_cmd_status(bool json) {
 			config_path,
 			config_present ? "present" : "missing"
 		);
+		if (factors.generation != 0) {
+			printf("config generation: %llu\n", (unsigned long long) factors.generation);
+		} else if (config_present) {
+			printf("config generation: unknown (edited since the last wsf set)\n");
+		}
+	}
+	if (running) {
+		printf("running generation: %llu\n", (unsigned long long) running_generation);
 	}
 	printf("scroll_vertical_factor: %.4f (", factors.scroll_vertical);
 	wsf_print_factor_status(status);
@@ -533,24 +729,55 @@ static bool wsf_run_command(const char *cmd, char *buf, size_t len) {
 	return true;
 }
 
-static bool wsf_find_libinput_from_ldconfig(char *buf, size_t len) {
-	return wsf_run_command(
-		"ldconfig -p 2>/dev/null | awk '/libinput\\.so/{print $4; exit}'",
-		buf,
-		len
-	);
+struct wsf_libinput_location {
+	char path[512];
+	const char *source;
+	/* What the running compositor mapped; empty when none was found. */
+	char compositor_path[512];
+	unsigned int pid;
+};
+
+static bool wsf_libinput_try_open(
+	const char *path,
+	const char *source,
+	struct wsf_libinput_location *location,
+	void **out_handle
+) {
+	void *handle = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+
+	if (handle == NULL) {
+		return false;
+	}
+
+	snprintf(location->path, sizeof(location->path), "%s", path);
+	location->source = source;
+	*out_handle = handle;
+	return true;
 }
 
-static void *wsf_open_libinput(void) {
-	const char *candidates[] = {
-		"libinput.so",
-		"libinput.so.10",
-		"libinput.so.11",
-		"libinput.so.12",
-		"libinput.so.9",
-		"libinput.so.8",
-		NULL
-	};
+struct wsf_libinput_cache_lookup {
+	struct wsf_libinput_location *location;
+	void *handle;
+};
+
+static bool wsf_libinput_cache_entry(const char *name, const char *path, void *data) {
+	struct wsf_libinput_cache_lookup *lookup = data;
+
+	(void) name;
+	return wsf_libinput_try_open(path, "ld.so.cache", lookup->location, &lookup->handle);
+}
+
+/*
+ * Resolves libinput without spawning anything: the library the running
+ * compositor mapped (the exact file niri uses, found by wsf_live_find),
+ * else the first loadable entry in ld.so.cache, else whatever the linker
+ * finds for the usual sonames (LD_LIBRARY_PATH, or a system without a
+ * cache). A mapping shown as deleted was replaced by an upgrade.
+ */
+static void *wsf_open_libinput(
+	const struct wsf_live_process *live,
+	struct wsf_libinput_location *location
+) {
 	const char *sonames[] = {
 		"libinput.so.10",
 		"libinput.so.11",
@@ -560,39 +787,42 @@ static void *wsf_open_libinput(void) {
 		"libinput.so.8",
 		NULL
 	};
+	struct wsf_libinput_cache_lookup lookup;
+	struct link_map *map = NULL;
 	void *handle = NULL;
-	char libdir[256];
-	char libpath[512];
-	char path[512];
 	int i = 0;
 
-	for (i = 0; candidates[i] != NULL; i++) {
-		handle = dlopen(candidates[i], RTLD_LAZY | RTLD_LOCAL);
-		if (handle != NULL) {
+	memset(location, 0, sizeof(*location));
+
+	if (live->pid != 0 && live->libinput_path[0] != '\0') {
+		location->pid = live->pid;
+		snprintf(
+			location->compositor_path,
+			sizeof(location->compositor_path),
+			"%s",
+			live->libinput_path
+		);
+		if (strstr(location->compositor_path, " (deleted)") == NULL &&
+			wsf_libinput_try_open(location->compositor_path, "compositor", location, &handle)) {
 			return handle;
 		}
 	}
 
-	if (wsf_run_command("pkg-config --variable=libdir libinput 2>/dev/null",
-		libdir,
-		sizeof(libdir))) {
-		for (i = 0; sonames[i] != NULL; i++) {
-			int written = snprintf(path, sizeof(path), "%s/%s", libdir, sonames[i]);
-			if (written <= 0 || (size_t) written >= sizeof(path)) {
-				continue;
-			}
-			handle = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
-			if (handle != NULL) {
-				return handle;
-			}
-		}
+	lookup.location = location;
+	lookup.handle = NULL;
+	if (wsf_ldcache_find(WSF_LDCACHE_PATH, "libinput.so", wsf_libinput_cache_entry, &lookup)) {
+		return lookup.handle;
 	}
 
-	if (wsf_find_libinput_from_ldconfig(libpath, sizeof(libpath))) {
-		handle = dlopen(libpath, RTLD_LAZY | RTLD_LOCAL);
-		if (handle != NULL) {
-			return handle;
+	for (i = 0; sonames[i] != NULL; i++) {
+		if (!wsf_libinput_try_open(sonames[i], "soname", location, &handle)) {
+			continue;
 		}
+		if (dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0 && map != NULL &&
+			map->l_name != NULL && map->l_name[0] != '\0') {
+			snprintf(location->path, sizeof(location->path), "%s", map->l_name);
+		}
+		return handle;
 	}
 
 	return NULL;
@@ -610,6 +840,7 @@ static bool wsf_has_symbol(void *handle, const char *symbol) {
 
 struct wsf_symbol_status {
 	bool libinput_found;
+	struct wsf_libinput_location library;
 	bool scroll_value;
 	bool scroll_v120;
 	bool axis_value;
@@ -621,8 +852,11 @@ struct wsf_symbol_status {
 	bool gesture_angle;
 };
 
-static void wsf_symbol_status(struct wsf_symbol_status *status) {
-	void *handle = wsf_open_libinput();
+static void wsf_symbol_status(
+	struct wsf_symbol_status *status,
+	const struct wsf_live_process *live
+) {
+	void *handle = wsf_open_libinput(live, &status->library);
 	bool scroll_value = false;
 	bool scroll_v120 = false;
 	bool axis_value = false;
@@ -673,12 +907,25 @@ static void wsf_symbol_status(struct wsf_symbol_status *status) {
 }
 
 static void wsf_doctor_symbols_print(const struct wsf_symbol_status *status) {
+	const struct wsf_libinput_location *library = &status->library;
+	bool from_compositor = library->source != NULL &&
+		strcmp(library->source, "compositor") == 0;
+
+	if (library->pid != 0 && !from_compositor) {
+		printf("libinput (niri pid %u): %s\n", library->pid, library->compositor_path);
+	}
 	if (!status->libinput_found) {
 		printf("libinput symbols: unavailable (libinput.so not found)\n");
 		printf("hint: ensure libinput is installed and reachable.\n");
 		return;
 	}
 
+	if (from_compositor) {
+		printf("libinput library: %s (mapped by niri pid %u)\n", library->path, library->pid);
+	} else {
+		printf("libinput library: %s (%s)\n", library->path, library->source);
+	}
+
 	printf(
 		"libinput symbols: scroll_value=%s scroll_v120=%s axis_value=%s axis_discrete=%s axis_source=%s base_event=%s event_type=%s\n",
 		status->scroll_value ? "yes" : "no",
@@ -707,6 +954,339 @@ static void wsf_print_kv(const char *key, const char *value) {
 	printf("%s: %s\n", key, value != NULL ? value : "unknown");
 }
 
+#define WSF_INPUT_DEVICES_MAX 64
+
+struct wsf_input_device {
+	char name[256];
+	uint32_t vendor;
+	uint32_t product;
+};
+
+/*
+ * Pointer devices (those with a mouse handler) as the kernel lists them.
+ * libinput reports the same name and IDs, so a profile matches here
+ * exactly when it matches in the compositor.
+ */
+static size_t wsf_input_devices(struct wsf_input_device *out, size_t max) {
+	struct wsf_input_device device;
+	FILE *file = fopen("/proc/bus/input/devices", "re");
+	char line[512];
+	bool pointer = false;
+	size_t count = 0;
+
+	if (file == NULL) {
+		return 0;
+	}
+
+	memset(&device, 0, sizeof(device));
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (strncmp(line, "I:", 2) == 0) {
+			unsigned int vendor = 0;
+			unsigned int product = 0;
+
+			if (sscanf(line, "I: Bus=%*x Vendor=%x Product=%x", &vendor, &product) == 2) {
+				device.vendor = vendor;
+				device.product = product;
+			}
+		} else if (strncmp(line, "N: Name=\"", 9) == 0) {
+			char *end = strrchr(line + 9, '"');
+
+			if (end != NULL) {
+				size_t len = (size_t) (end - (line + 9));
+
+				if (len >= sizeof(device.name)) {
+					len = sizeof(device.name) - 1;
+				}
+				memcpy(device.name, line + 9, len);
+				device.name[len] = '\0';
+			}
+		} else if (strncmp(line, "H:", 2) == 0) {
+			pointer = strstr(line, "mouse") != NULL && strstr(line, "event") != NULL;
+		} else if (line[0] == '\n') {
+			if (pointer && count < max) {
+				out[count++] = device;
+			}
+			memset(&device, 0, sizeof(device));
+			pointer = false;
+		}
+	}
+	if (pointer && count < max) {
+		out[count++] = device;
+	}
+
+	fclose(file);
+	return count;
+}
+
+static void wsf_doctor_devices_print(const struct wsf_effective_factors *factors, bool json) {
+	struct wsf_input_device devices[WSF_INPUT_DEVICES_MAX];
+	size_t count = wsf_input_devices(devices, WSF_INPUT_DEVICES_MAX);
+	size_t i = 0;
+
+	if (json) {
+		printf("\"device_profiles\":%u,\"devices\":[", factors->device_profile_count);
+	} else {
+		printf("device profiles: %u\n", factors->device_profile_count);
+		printf("pointer devices:%s\n", count == 0 ? " none found" : "");
+	}
+
+	for (i = 0; i < count; i++) {
+		int profile = wsf_device_profile_match(
+			factors->device_profiles,
+			factors->device_profile_count,
+			devices[i].name,
+			devices[i].vendor,
+			devices[i].product
+		);
+
+		if (json) {
+			printf("%s{\"name\":", i > 0 ? "," : "");
+			wsf_print_json_string(devices[i].name);
+			printf(
+				",\"vendor\":\"%04x\",\"product\":\"%04x\",\"profile\":",
+				devices[i].vendor,
+				devices[i].product
+			);
+			if (profile < 0) {
+				printf("null}");
+			} else {
+				printf("%d}", profile + 1);
+			}
+			continue;
+		}
+
+		printf("  %s (%04x:%04x): ", devices[i].name, devices[i].vendor, devices[i].product);
+		if (profile < 0) {
+			printf("global factors\n");
+		} else {
+			const struct wsf_device_profile *match = &factors->device_profiles[profile];
+
+			printf(
+				"profile %d (scroll %.4f/%.4f, pinch %.4f/%.4f)\n",
+				profile + 1,
+				match->scroll_vertical,
+				match->scroll_horizontal,
+				match->pinch_zoom,
+				match->pinch_rotate
+			);
+		}
+	}
+
+	if (json) {
+		printf("],");
+	}
+}
+
+/*
+ * The [app] and [output] sections. They only take effect inside niri,
+ * which subscribes to its own IPC socket; NIRI_SOCKET shows whether this
+ * shell runs under a niri whose socket the preload would find.
+ */
+static void wsf_doctor_focus_print(const struct wsf_effective_factors *factors, bool json) {
+	static const char *const keys[] = {
+		"scroll_vertical_factor",
+		"scroll_horizontal_factor",
+		"pinch_zoom_factor",
+		"pinch_rotate_factor",
+	};
+	const char *niri_socket = getenv("NIRI_SOCKET");
+	uint32_t i = 0;
+	uint32_t k = 0;
+
+	if (json) {
+		printf("\"focus_profiles\":[");
+	} else {
+		printf("focus profiles: %u\n", factors->focus_profile_count);
+	}
+
+	for (i = 0; i < factors->focus_profile_count; i++) {
+		const struct wsf_focus_profile *profile = &factors->focus_profiles[i];
+		const double *values = &profile->scroll_vertical;
+		const char *kind = profile->match == WSF_FOCUS_MATCH_APP ? "app" : "output";
+		bool first = true;
+
+		if (json) {
+			printf("%s{\"kind\":\"%s\",\"name\":", i > 0 ? "," : "", kind);
+			wsf_print_json_string(profile->name);
+		} else {
+			printf("  %s %s:", kind, profile->name);
+		}
+		for (k = 0; k < 4; k++) {
+			if ((profile->keys & (1u << k)) == 0) {
+				continue;
+			}
+			if (json) {
+				printf(",\"%s\":%.4f", keys[k], values[k]);
+			} else {
+				printf("%s %s=%.4f", first ? "" : ",", keys[k], values[k]);
+			}
+			first = false;
+		}
+		printf(json ? "}" : (first ? " no factors\n" : "\n"));
+	}
+
+	if (json) {
+		printf(
+			"],\"niri_socket\":%s,",
+			niri_socket != NULL && niri_socket[0] != '\0' ? "true" : "false"
+		);
+	} else if (factors->focus_profile_count > 0) {
+		printf(
+			"niri IPC socket: %s\n",
+			niri_socket != NULL && niri_socket[0] != '\0' ? niri_socket : "not set (not under niri?)"
+		);
+	}
+}
+
+static const char *wsf_config_cache_name(int state) {
+	switch (state) {
+	case WSF_CONFIG_CACHE_FRESH:
+		return "fresh";
+	case WSF_CONFIG_CACHE_STALE:
+		return "stale";
+	default:
+		return "missing";
+	}
+}
+
+static void wsf_doctor_live_print(
+	const struct wsf_live_process *live,
+	const char *lib_path,
+	bool json
+) {
+	const char *env = live->wsf_env;
+	double scan_ms = (double) live->scan_ns / 1e6;
+
+	if (json) {
+		printf("\"live\":{");
+		printf("\"processes_scanned\":%u,\"scan_ms\":%.3f,", live->scanned, scan_ms);
+		if (live->pid == 0) {
+			printf("\"pid\":null},");
+			return;
+		}
+		printf("\"pid\":%u,", live->pid);
+		printf("\"preload_mapped\":");
+		if (live->maps_readable) {
+			printf("%s", live->preload_path[0] != '\0' ? "true" : "false");
+		} else {
+			printf("null");
+		}
+		printf(",\"preload\":");
+		wsf_print_json_string(live->preload_path[0] != '\0' ? live->preload_path : NULL);
+		printf(",\"libinput\":");
+		wsf_print_json_string(live->libinput_path[0] != '\0' ? live->libinput_path : NULL);
+		printf(",\"LD_PRELOAD\":");
+		wsf_print_json_string(live->has_ld_preload ? live->ld_preload : NULL);
+		printf(",\"wsf_env\":[");
+		while (*env != '\0') {
+			size_t len = strcspn(env, "\n");
+			char entry[256];
+
+			snprintf(entry, sizeof(entry), "%.*s", (int) len, env);
+			wsf_print_json_string(entry);
+			env += len;
+			if (*env == '\n') {
+				env++;
+				printf(",");
+			}
+		}
+		printf("],\"factors\":");
+		if (live->values_valid) {
+			printf(
+				"{\"scroll_vertical_factor\":%.4f,\"scroll_horizontal_factor\":%.4f,"
+				"\"pinch_zoom_factor\":%.4f,\"pinch_rotate_factor\":%.4f,"
+				"\"config_generation\":%llu,\"device_profiles\":%u,\"focus_profiles\":%u}",
+				live->values.scroll_vertical,
+				live->values.scroll_horizontal,
+				live->values.pinch_zoom,
+				live->values.pinch_rotate,
+				(unsigned long long) live->values.config_generation,
+				live->values.device_profile_count,
+				live->values.focus_profile_count
+			);
+		} else {
+			printf("null");
+		}
+		printf(",\"counters\":");
+		if (live->counters_valid) {
+			printf(
+				"{\"scaled\":%llu,\"passthrough\":%llu}",
+				(unsigned long long) live->scaled,
+				(unsigned long long) live->passthrough
+			);
+		} else {
+			printf("null");
+		}
+		printf("},");
+		return;
+	}
+
+	if (live->pid == 0) {
+		printf(
+			"niri: not running (scanned %u processes in %.1f ms)\n",
+			live->scanned,
+			scan_ms
+		);
+		return;
+	}
+	if (live->scanned == 0) {
+		printf("niri: pid %u (from the control block, %.1f ms)\n", live->pid, scan_ms);
+	} else {
+		printf(
+			"niri: pid %u (scanned %u processes in %.1f ms)\n",
+			live->pid,
+			live->scanned,
+			scan_ms
+		);
+	}
+	if (!live->maps_readable) {
+		printf("niri preload: unknown (cannot read /proc/%u/maps)\n", live->pid);
+	} else if (live->preload_path[0] == '\0') {
+		printf("niri preload: not loaded\n");
+		printf("hint: run wsf enable, then log out and back in.\n");
+	} else {
+		printf("niri preload: %s (loaded)\n", live->preload_path);
+		if (strcmp(live->preload_path, lib_path) != 0) {
+			printf("note: niri loaded a different file than %s\n", lib_path);
+		}
+	}
+	if (live->environ_readable) {
+		printf("niri LD_PRELOAD: %s\n", live->has_ld_preload ? live->ld_preload : "(not set)");
+		while (*env != '\0') {
+			size_t len = strcspn(env, "\n");
+
+			printf("niri env: %.*s\n", (int) len, env);
+			env += len + (env[len] == '\n');
+		}
+	}
+	if (live->values_valid) {
+		printf(
+			"live factors: scroll_vertical=%.4f scroll_horizontal=%.4f pinch_zoom=%.4f pinch_rotate=%.4f\n",
+			live->values.scroll_vertical,
+			live->values.scroll_horizontal,
+			live->values.pinch_zoom,
+			live->values.pinch_rotate
+		);
+		printf(
+			"live config: generation %llu, %u device profiles, %u focus profiles\n",
+			(unsigned long long) live->values.config_generation,
+			live->values.device_profile_count,
+			live->values.focus_profile_count
+		);
+		if (live->counters_valid) {
+			printf(
+				"live counters: scaled=%llu passthrough=%llu\n",
+				(unsigned long long) live->scaled,
+				(unsigned long long) live->passthrough
+			);
+		} else {
+			printf("live counters: off (wsf stats --enable)\n");
+		}
+	} else if (live->preload_path[0] != '\0') {
+		printf("live factors: unavailable (no control block from this niri)\n");
+	}
+}
+
 static int wsf_cmd_doctor(bool json) {
 	char env_path[512];
 	char lib_path[512];
@@ -717,6 +1297,7 @@ static int wsf_cmd_doctor(bool json) {
 	const char *config_path = wsf_config_path();
 	struct wsf_effective_factors factors;
 	int status = wsf_effective_factors(&factors, false);
+	int cache_state = wsf_config_cache_state();
 	const char *env_factor = getenv("WSF_FACTOR");
 	const char *env_scroll_vertical = getenv("WSF_SCROLL_VERTICAL_FACTOR");
 	const char *env_scroll_horizontal = getenv("WSF_SCROLL_HORIZONTAL_FACTOR");
@@ -727,6 +1308,7 @@ static int wsf_cmd_doctor(bool json) {
 	bool env_present = false;
 	bool lib_present = false;
 	bool config_present = false;
+	struct wsf_live_process live;
 	struct wsf_symbol_status symbols;
 
 	if (!wsf_env_file_path(env_path, sizeof(env_path))) {
@@ -745,7 +1327,8 @@ static int wsf_cmd_doctor(bool json) {
 		config_present = access(config_path, F_OK) == 0;
 	}
 
-	wsf_symbol_status(&symbols);
+	wsf_live_find("niri", &live);
+	wsf_symbol_status(&symbols, &live);
 
 	if (json) {
 		printf("{");
@@ -781,6 +1364,7 @@ static int wsf_cmd_doctor(bool json) {
 		wsf_print_json_string(config_path);
 		printf(",");
 		printf("\"config_present\":%s,", config_present ? "true" : "false");
+		printf("\"config_cache\":\"%s\",", wsf_config_cache_name(cache_state));
 		printf("\"factors\":{");
 		printf("\"scroll_vertical_factor\":%.4f,", factors.scroll_vertical);
 		printf("\"scroll_horizontal_factor\":%.4f,", factors.scroll_horizontal);
@@ -821,6 +1405,18 @@ static int wsf_cmd_doctor(bool json) {
 		printf("\"gesture_scale\":%s,", symbols.gesture_scale ? "true" : "false");
 		printf("\"gesture_angle\":%s", symbols.gesture_angle ? "true" : "false");
 		printf("},");
+		printf("\"libinput_library\":");
+		wsf_print_json_string(symbols.libinput_found ? symbols.library.path : NULL);
+		printf(",");
+		printf("\"libinput_source\":");
+		wsf_print_json_string(symbols.library.source);
+		printf(",");
+		printf("\"compositor_libinput\":");
+		wsf_print_json_string(symbols.library.pid != 0 ? symbols.library.compositor_path : NULL);
+		printf(",");
+		wsf_doctor_live_print(&live, lib_path, true);
+		wsf_doctor_devices_print(&factors, true);
+		wsf_doctor_focus_print(&factors, true);
 		printf("\"scroll_axis_filter_enabled\":%s", symbols.axis_source ? "true" : "false");
 		printf("}\n");
 		return 0;
@@ -847,6 +1443,7 @@ static int wsf_cmd_doctor(bool json) {
 			config_path,
 			config_present ? "present" : "missing"
 		);
+		printf("config cache: %s\n", wsf_config_cache_name(cache_state));
 	}
 	printf("scroll_vertical_factor: %.4f (", factors.scroll_vertical);
 	wsf_print_factor_status(status);
@@ -877,12 +1474,15 @@ static int wsf_cmd_doctor(bool json) {
 		printf("LD_PRELOAD: %s\n", ld_preload);
 	}
 
+	wsf_doctor_live_print(&live, lib_path, false);
 	wsf_doctor_symbols_print(&symbols);
+	wsf_doctor_devices_print(&factors, false);
+	wsf_doctor_focus_print(&factors, false);
 	printf("note: logout/login required after enable/disable\n");
 	return 0;
 }
 
-int main(int argc, char **argv) {
+int wsf_dispatch(int argc, char **argv) {
 	const char *cmd = NULL;
 	bool json = false;
 	int i = 0;
@@ -945,8 +1545,33 @@ int main(int argc, char **argv) {
 		}
 		return wsf_cmd_doctor(json);
 	}
+	if (strcmp(cmd, "bench") == 0) {
+		return wsf_cmd_bench(argc, argv);
+	}
+	if (strcmp(cmd, "replay") == 0) {
+		return wsf_cmd_replay(argc, argv);
+	}
+	if (strcmp(cmd, "analyze") == 0) {
+		return wsf_cmd_analyze(argc, argv);
+	}
+	if (strcmp(cmd, "tune") == 0) {
+		return wsf_cmd_tune(argc, argv);
+	}
+	if (strcmp(cmd, "stats") == 0) {
+		return wsf_cmd_stats(argc, argv);
+	}
+	if (strcmp(cmd, "trace") == 0) {
+		return wsf_cmd_trace(argc, argv);
+	}
+	if (strcmp(cmd, "serve") == 0) {
+		return wsf_cmd_serve(argc, argv);
+	}
 
 	fprintf(stderr, "Unknown command: %s\n", cmd);
 	wsf_print_usage(argv[0]);
 	return 1;
 }
+
+int main(int argc, char **argv) {
+	return wsf_dispatch(argc, argv);
+}
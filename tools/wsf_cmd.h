@@ -0,0 +1,107 @@
+#ifndef WSF_CMD_H
+#define WSF_CMD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wsf_shm.h"
+
+/* The running compositor as seen through /proc and its control blocks. */
+struct wsf_live_process {
+	unsigned int pid;
+	unsigned int candidates;
+	unsigned int scanned;
+	uint64_t scan_ns;
+	bool maps_readable;
+	char preload_path[512];
+	char libinput_path[512];
+	bool environ_readable;
+	bool has_ld_preload;
+	char ld_preload[512];
+	/* WSF_* entries of its environment, one per line. */
+	char wsf_env[1024];
+	/* Only set when the blocks were created by this pid. */
+	bool values_valid;
+	struct wsf_shm_values values;
+	bool counters_valid;
+	uint64_t scaled;
+	uint64_t passthrough;
+};
+
+bool wsf_lib_path(char *buf, size_t len);
+/* value as a JSON string literal on stdout; null for NULL. */
+void wsf_print_json_string(const char *value);
+
+/* Runs `wsf argv[1] ...` as main() would and returns its exit status. */
+int wsf_dispatch(int argc, char **argv);
+
+/*
+ * Finds the process of the current user whose comm is target in one pass
+ * over /proc, preferring the one that created the control block, and reads
+ * its maps, environ and live blocks. Returns false when none is running.
+ */
+bool wsf_live_find(const char *target, struct wsf_live_process *live);
+
+/* Helpers shared with `wsf bench`, which also walks /proc. */
+uint64_t wsf_live_now_ns(void);
+bool wsf_live_is_pid(const char *name);
+const char *wsf_live_basename(const char *path);
+
+struct wsf_core_event;
+struct wsf_effective_factors;
+
+enum wsf_event_status {
+	WSF_EVENT_NONE = 0,
+	WSF_EVENT_OK = 1,
+	WSF_EVENT_MALFORMED = 2
+};
+
+/*
+ * Parses one line of a recorded event stream (`wsf replay` input or a
+ * `wsf trace --dump` row), splitting it in place. NONE for blank lines
+ * and comments.
+ */
+enum wsf_event_status wsf_event_parse(char *line, struct wsf_core_event *event);
+const char *wsf_event_axis_name(unsigned int axis);
+const char *wsf_event_source_name(unsigned int source);
+/*
+ * Factors for replaying events: the user's config with WSF_* overrides,
+ * or only config_path when given. Prints the error itself.
+ */
+bool wsf_event_load_factors(
+	const char *config_path,
+	struct wsf_effective_factors *out_factors,
+	bool debug
+);
+
+#define WSF_PARALLEL_THREADS_MAX 64
+
+typedef void (*wsf_parallel_work)(void *context, size_t index, unsigned int thread);
+
+/*
+ * Runs work(context, index, thread) for every index below count on up to
+ * threads threads, the calling one included; thread is below threads.
+ */
+void wsf_parallel_run(unsigned int threads, wsf_parallel_work work, void *context, size_t count);
+/* The online CPUs, capped at WSF_PARALLEL_THREADS_MAX. */
+unsigned int wsf_parallel_default_threads(void);
+/* A --threads argument; prints the error itself. */
+bool wsf_parallel_parse_threads(const char *input, unsigned int *out_threads);
+
+struct timespec;
+
+/* Seconds since start on CLOCK_MONOTONIC, for the run time in reports. */
+double wsf_parallel_elapsed(const struct timespec *start);
+/* Resizes *array to count elements; on failure it is left as it was. */
+bool wsf_parallel_grow(void **array, size_t element, size_t count);
+
+int wsf_cmd_analyze(int argc, char **argv);
+int wsf_cmd_bench(int argc, char **argv);
+int wsf_cmd_replay(int argc, char **argv);
+int wsf_cmd_serve(int argc, char **argv);
+int wsf_cmd_stats(int argc, char **argv);
+int wsf_cmd_trace(int argc, char **argv);
+int wsf_cmd_tune(int argc, char **argv);
+
+#endif
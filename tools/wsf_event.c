@@ -0,0 +1,286 @@
+#include "wsf_cmd.h"
+#include "wsf_core.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The recorded event grammar shared by `wsf replay` and `wsf analyze`:
+ *
+ *   scroll <time_us|-> <vertical|horizontal> <source> <value> [device]
+ *   pinch <time_us|-> <scale>
+ *   rotate <time_us|-> <delta>
+ *
+ * plus `wsf trace --dump` rows:
+ *   index time_us device axis source getter raw scaled velocity multiplier
+ * where the ring stores 0 for events that carried no timestamp.
+ */
+
+#define WSF_EVENT_MAX_FIELDS 12
+
+static const char *const wsf_event_axis_names[2] = { "vertical", "horizontal" };
+
+static const char *const wsf_event_source_names[] = {
+	[WSF_SCROLL_SOURCE_WHEEL] = "wheel",
+	[WSF_SCROLL_SOURCE_FINGER] = "finger",
+	[WSF_SCROLL_SOURCE_CONTINUOUS] = "continuous",
+	[WSF_SCROLL_SOURCE_WHEEL_TILT] = "wheel-tilt",
+};
+
+const char *wsf_event_axis_name(unsigned int axis) {
+	return axis < 2 ? wsf_event_axis_names[axis] : "?";
+}
+
+const char *wsf_event_source_name(unsigned int source) {
+	if (source < WSF_SCROLL_SOURCE_WHEEL || source > WSF_SCROLL_SOURCE_WHEEL_TILT) {
+		return "?";
+	}
+	return wsf_event_source_names[source];
+}
+
+static bool wsf_event_parse_axis(const char *input, uint32_t *out_axis) {
+	unsigned int i = 0;
+
+	for (i = 0; i < 2; i++) {
+		if (strcmp(input, wsf_event_axis_names[i]) == 0) {
+			*out_axis = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool wsf_event_parse_source(const char *input, uint32_t *out_source) {
+	unsigned int i = 0;
+
+	for (i = WSF_SCROLL_SOURCE_WHEEL; i <= WSF_SCROLL_SOURCE_WHEEL_TILT; i++) {
+		if (strcmp(input, wsf_event_source_names[i]) == 0) {
+			*out_source = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Digits only, rejecting values past UINT64_MAX as strtoull() would. */
+static bool wsf_event_parse_u64(const char *input, uint64_t *out_value) {
+	uint64_t value = 0;
+
+	if (input[0] == '\0') {
+		return false;
+	}
+	for (; *input != '\0'; input++) {
+		uint64_t digit = (uint64_t) (*input - '0');
+
+		if (*input < '0' || *input > '9' || value > (UINT64_MAX - digit) / 10) {
+			return false;
+		}
+		value = (value * 10) + digit;
+	}
+	*out_value = value;
+	return true;
+}
+
+/* "-" marks an event without a timestamp. */
+static bool wsf_event_parse_time(const char *input, struct wsf_core_event *event) {
+	if (strcmp(input, "-") == 0) {
+		event->has_time = 0;
+		event->time_us = 0;
+		return true;
+	}
+	event->has_time = 1;
+	return wsf_event_parse_u64(input, &event->time_us);
+}
+
+/*
+ * Plain decimals of up to 15 significant digits, which is what the trace
+ * and replay writers print: the digits and 10^k (k <= 22) are exact
+ * doubles, so one correctly rounded division gives strtod()'s result.
+ * Returns false for anything else.
+ */
+static bool wsf_event_parse_decimal(const char *input, double *out_value) {
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	const char *cursor = input;
+	uint64_t mantissa = 0;
+	unsigned int digits = 0;
+	unsigned int decimals = 0;
+	bool negative = false;
+	bool point = false;
+	bool any_digit = false;
+
+	if (*cursor == '-' || *cursor == '+') {
+		negative = *cursor == '-';
+		cursor++;
+	}
+	for (; *cursor != '\0'; cursor++) {
+		if (*cursor == '.' && !point) {
+			point = true;
+			continue;
+		}
+		if (*cursor < '0' || *cursor > '9') {
+			return false;
+		}
+		any_digit = true;
+		if (mantissa != 0 || *cursor != '0') {
+			digits++;
+		}
+		mantissa = (mantissa * 10) + (uint64_t) (*cursor - '0');
+		decimals += point;
+	}
+	if (!any_digit || digits > 15 || decimals > 22) {
+		return false;
+	}
+
+	*out_value = (double) mantissa / powers[decimals];
+	if (negative) {
+		*out_value = -*out_value;
+	}
+	return true;
+}
+
+static bool wsf_event_parse_double(const char *input, double *out_value) {
+	char *end = NULL;
+	double value = 0.0;
+
+	if (wsf_event_parse_decimal(input, out_value)) {
+		return true;
+	}
+
+	errno = 0;
+	value = strtod(input, &end);
+	if (errno != 0 || end == input || *end != '\0') {
+		return false;
+	}
+	*out_value = value;
+	return true;
+}
+
+static bool wsf_event_parse_device(const char *input, uint32_t *out_device) {
+	uint64_t device = 0;
+
+	if (!wsf_event_parse_u64(input, &device) || device >= WSF_CORE_DEVICES) {
+		return false;
+	}
+	*out_device = (uint32_t) device;
+	return true;
+}
+
+static unsigned int wsf_event_split(char *line, char **fields) {
+	unsigned int count = 0;
+	char *cursor = line;
+
+	while (*cursor != '\0') {
+		while (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r') {
+			cursor++;
+		}
+		if (*cursor == '\0' || *cursor == '#') {
+			break;
+		}
+		if (count == WSF_EVENT_MAX_FIELDS) {
+			return count + 1;
+		}
+		fields[count++] = cursor;
+		while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' &&
+			*cursor != '\n' && *cursor != '\r') {
+			cursor++;
+		}
+		if (*cursor != '\0') {
+			*cursor++ = '\0';
+		}
+	}
+
+	return count;
+}
+
+static bool wsf_event_trace_row(char **fields, unsigned int count, struct wsf_core_event *event) {
+	uint64_t index = 0;
+
+	if (count != 10 ||
+		!wsf_event_parse_u64(fields[0], &index) ||
+		!wsf_event_parse_u64(fields[1], &event->time_us) ||
+		!wsf_event_parse_device(fields[2], &event->device) ||
+		!wsf_event_parse_axis(fields[3], &event->kind) ||
+		!wsf_event_parse_source(fields[4], &event->source) ||
+		!wsf_event_parse_double(fields[6], &event->value)) {
+		return false;
+	}
+	event->has_time = event->time_us != 0;
+	return true;
+}
+
+enum wsf_event_status wsf_event_parse(char *line, struct wsf_core_event *event) {
+	char *fields[WSF_EVENT_MAX_FIELDS];
+	unsigned int count = wsf_event_split(line, fields);
+
+	memset(event, 0, sizeof(*event));
+	if (count == 0) {
+		return WSF_EVENT_NONE;
+	}
+	if (count > WSF_EVENT_MAX_FIELDS) {
+		return WSF_EVENT_MALFORMED;
+	}
+
+	if (fields[0][0] >= '0' && fields[0][0] <= '9') {
+		return wsf_event_trace_row(fields, count, event) ? WSF_EVENT_OK : WSF_EVENT_MALFORMED;
+	}
+
+	if (strcmp(fields[0], "scroll") == 0) {
+		if ((count != 5 && count != 6) ||
+			!wsf_event_parse_time(fields[1], event) ||
+			!wsf_event_parse_axis(fields[2], &event->kind) ||
+			!wsf_event_parse_source(fields[3], &event->source) ||
+			!wsf_event_parse_double(fields[4], &event->value)) {
+			return WSF_EVENT_MALFORMED;
+		}
+		if (count == 6 && !wsf_event_parse_device(fields[5], &event->device)) {
+			return WSF_EVENT_MALFORMED;
+		}
+		return WSF_EVENT_OK;
+	}
+
+	if (strcmp(fields[0], "pinch") == 0) {
+		event->kind = WSF_CORE_PINCH_ZOOM;
+	} else if (strcmp(fields[0], "rotate") == 0) {
+		event->kind = WSF_CORE_PINCH_ROTATE;
+	} else {
+		return WSF_EVENT_MALFORMED;
+	}
+	if (count != 3 || !wsf_event_parse_time(fields[1], event) ||
+		!wsf_event_parse_double(fields[2], &event->value)) {
+		return WSF_EVENT_MALFORMED;
+	}
+	return WSF_EVENT_OK;
+}
+
+/* An explicit config file replaces the user's config and ignores env overrides. */
+bool wsf_event_load_factors(
+	const char *config_path,
+	struct wsf_effective_factors *out_factors,
+	bool debug
+) {
+	struct wsf_config_values values;
+	int status = WSF_CONFIG_OK;
+
+	if (config_path == NULL) {
+		status = wsf_effective_factors(out_factors, debug);
+		if (status == WSF_CONFIG_ERROR || status == WSF_CONFIG_INVALID) {
+			fprintf(stderr, "Failed to read %s.\n", wsf_config_path());
+			return false;
+		}
+		return true;
+	}
+
+	wsf_config_values_init(&values);
+	status = wsf_config_read_path(config_path, &values, debug);
+	if (status != WSF_CONFIG_OK) {
+		fprintf(stderr, "Failed to read %s.\n", config_path);
+		return false;
+	}
+	wsf_config_resolve(&values, out_factors);
+	return true;
+}
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+#include "wsf_shm.h"
+#include "wsf_stats.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Processes named like the target; more than one while `niri msg` runs. */
+#define WSF_LIVE_CANDIDATES_MAX 16
+#define WSF_LIVE_ENVIRON_MAX (256 * 1024)
+
+uint64_t wsf_live_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+bool wsf_live_is_pid(const char *name) {
+	if (name[0] == '\0') {
+		return false;
+	}
+	for (; *name != '\0'; name++) {
+		if (*name < '0' || *name > '9') {
+			return false;
+		}
+	}
+	return true;
+}
+
+const char *wsf_live_basename(const char *path) {
+	const char *slash = strrchr(path, '/');
+
+	return slash == NULL ? path : slash + 1;
+}
+
+/* Reads up to len - 1 bytes of <dir>/<name>, dir relative to dir_fd. */
+static ssize_t wsf_live_read(
+	int dir_fd,
+	const char *dir,
+	const char *name,
+	char *buf,
+	size_t len
+) {
+	char path[64];
+	ssize_t used = 0;
+	int fd = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	while ((size_t) used < len - 1) {
+		ssize_t got = read(fd, buf + used, len - 1 - (size_t) used);
+
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			break;
+		}
+		used += got;
+	}
+	close(fd);
+
+	buf[used] = '\0';
+	return used;
+}
+
+static bool wsf_live_comm_is(int proc_fd, const char *pid, const char *target) {
+	char comm[32];
+	ssize_t len = wsf_live_read(proc_fd, pid, "comm", comm, sizeof(comm));
+
+	if (len <= 0) {
+		return false;
+	}
+	comm[strcspn(comm, "\n")] = '\0';
+	return strcmp(comm, target) == 0;
+}
+
+/* Records the preload and libinput mappings; false when maps is unreadable. */
+static bool wsf_live_scan_maps(unsigned int pid, struct wsf_live_process *live) {
+	char path[64];
+	char line[4096];
+	FILE *file = NULL;
+
+	snprintf(path, sizeof(path), "/proc/%u/maps", pid);
+	file = fopen(path, "re");
+	if (file == NULL) {
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *name = strchr(line, '/');
+		const char *base = NULL;
+
+		if (name == NULL) {
+			continue;
+		}
+		name[strcspn(name, "\n")] = '\0';
+		base = wsf_live_basename(name);
+		if (live->preload_path[0] == '\0' && strcmp(base, "libwsf_preload.so") == 0) {
+			snprintf(live->preload_path, sizeof(live->preload_path), "%s", name);
+		} else if (live->libinput_path[0] == '\0' &&
+			strncmp(base, "libinput.so", strlen("libinput.so")) == 0) {
+			snprintf(live->libinput_path, sizeof(live->libinput_path), "%s", name);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void wsf_live_append(char *buf, size_t len, const char *entry) {
+	size_t used = strlen(buf);
+
+	if (used + strlen(entry) + 2 > len) {
+		return;
+	}
+	if (used > 0) {
+		buf[used++] = '\n';
+	}
+	strcpy(buf + used, entry);
+}
+
+/* LD_PRELOAD and the WSF_* variables the compositor was started with. */
+static bool wsf_live_scan_environ(unsigned int pid, struct wsf_live_process *live) {
+	char proc_dir[32];
+	char *data = malloc(WSF_LIVE_ENVIRON_MAX);
+	char *cursor = NULL;
+	ssize_t len = 0;
+
+	if (data == NULL) {
+		return false;
+	}
+	snprintf(proc_dir, sizeof(proc_dir), "/proc/%u", pid);
+	len = wsf_live_read(AT_FDCWD, proc_dir, "environ", data, WSF_LIVE_ENVIRON_MAX);
+	if (len < 0) {
+		free(data);
+		return false;
+	}
+
+	for (cursor = data; cursor < data + len; cursor += strlen(cursor) + 1) {
+		if (strncmp(cursor, "LD_PRELOAD=", strlen("LD_PRELOAD=")) == 0) {
+			live->has_ld_preload = true;
+			snprintf(
+				live->ld_preload,
+				sizeof(live->ld_preload),
+				"%s",
+				cursor + strlen("LD_PRELOAD=")
+			);
+		} else if (strncmp(cursor, "WSF_", strlen("WSF_")) == 0) {
+			wsf_live_append(live->wsf_env, sizeof(live->wsf_env), cursor);
+		}
+	}
+
+	free(data);
+	return true;
+}
+
+static void wsf_live_read_blocks(struct wsf_live_process *live) {
+	struct wsf_shm_block *block = wsf_shm_open(false, false);
+	struct wsf_stats_block *stats = NULL;
+	int hook = 0;
+
+	if (block != NULL) {
+		live->values_valid = block->owner_pid == live->pid &&
+			wsf_shm_read(block, &live->values);
+		wsf_shm_close(block);
+	}
+
+	if (!live->values_valid || live->values.stats == 0) {
+		return;
+	}
+	stats = wsf_stats_open(false, false);
+	if (stats == NULL) {
+		return;
+	}
+	if (stats->owner_pid == live->pid) {
+		live->counters_valid = true;
+		for (hook = 0; hook < WSF_STATS_HOOK_COUNT; hook++) {
+			const struct wsf_stats_counters *counters = &stats->hooks[hook];
+
+			if (hook == WSF_STATS_HOOK_EVENT_DESTROY || hook == WSF_STATS_HOOK_GET_EVENT) {
+				continue;
+			}
+			live->scaled += atomic_load_explicit(&counters->scaled, memory_order_relaxed);
+			live->passthrough +=
+				atomic_load_explicit(&counters->passthrough, memory_order_relaxed);
+		}
+	}
+	wsf_stats_close(stats);
+}
+
+/* Whether /proc/<pid> is a process of this user named target. */
+static bool wsf_live_is_target(int proc_fd, const char *pid, const char *target, uid_t uid) {
+	struct stat st;
+
+	return wsf_live_comm_is(proc_fd, pid, target) &&
+		fstatat(proc_fd, pid, &st, 0) == 0 && st.st_uid == uid;
+}
+
+/*
+ * One readdir pass; per process only comm is read, through openat relative
+ * to /proc, and the owner is checked for matches alone. A `niri msg`
+ * client has the same comm, so the compositor is the match mapping
+ * libinput.
+ */
+static void wsf_live_scan(DIR *proc, const char *target, struct wsf_live_process *live) {
+	unsigned int candidates[WSF_LIVE_CANDIDATES_MAX];
+	struct dirent *entry = NULL;
+	uid_t uid = getuid();
+	unsigned int i = 0;
+
+	while ((entry = readdir(proc)) != NULL) {
+		if (!wsf_live_is_pid(entry->d_name)) {
+			continue;
+		}
+		live->scanned++;
+		if (!wsf_live_is_target(dirfd(proc), entry->d_name, target, uid)) {
+			continue;
+		}
+		if (live->candidates < WSF_LIVE_CANDIDATES_MAX) {
+			candidates[live->candidates] = (unsigned int) strtoul(entry->d_name, NULL, 10);
+		}
+		live->candidates++;
+	}
+
+	for (i = 0; live->pid == 0 && i < live->candidates && i < WSF_LIVE_CANDIDATES_MAX; i++) {
+		live->preload_path[0] = '\0';
+		live->libinput_path[0] = '\0';
+		if (wsf_live_scan_maps(candidates[i], live) && live->libinput_path[0] != '\0') {
+			live->pid = candidates[i];
+			live->maps_readable = true;
+		}
+	}
+	if (live->pid == 0) {
+		live->preload_path[0] = '\0';
+		live->libinput_path[0] = '\0';
+	}
+}
+
+bool wsf_live_find(const char *target, struct wsf_live_process *live) {
+	struct wsf_shm_block *block = wsf_shm_open(false, false);
+	uint64_t start = wsf_live_now_ns();
+	unsigned int owner_pid = 0;
+	char pid_name[16];
+	DIR *proc = NULL;
+
+	memset(live, 0, sizeof(*live));
+	if (block != NULL) {
+		owner_pid = block->owner_pid;
+		wsf_shm_close(block);
+	}
+
+	proc = opendir("/proc");
+	if (proc == NULL) {
+		return false;
+	}
+
+	/*
+	 * With the preload running, the control block names the pid and the
+	 * scan is skipped; a stale pid must still be our niri.
+	 */
+	snprintf(pid_name, sizeof(pid_name), "%u", owner_pid);
+	if (owner_pid != 0 && wsf_live_is_target(dirfd(proc), pid_name, target, getuid())) {
+		live->pid = owner_pid;
+		live->candidates = 1;
+		live->maps_readable = wsf_live_scan_maps(live->pid, live);
+	} else {
+		wsf_live_scan(proc, target, live);
+	}
+	closedir(proc);
+
+	if (live->pid != 0) {
+		live->environ_readable = wsf_live_scan_environ(live->pid, live);
+		wsf_live_read_blocks(live);
+	}
+
+	live->scan_ns = wsf_live_now_ns() - start;
+	return live->pid != 0;
+}
@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+
+#include "wsf_cmd.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct wsf_parallel_pool {
+	wsf_parallel_work work;
+	void *context;
+	size_t count;
+	_Atomic size_t next;
+};
+
+struct wsf_parallel_worker {
+	struct wsf_parallel_pool *pool;
+	unsigned int thread;
+};
+
+static void *wsf_parallel_worker_main(void *arg) {
+	struct wsf_parallel_worker *worker = arg;
+	struct wsf_parallel_pool *pool = worker->pool;
+	size_t index = 0;
+
+	while ((index = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+		pool->work(pool->context, index, worker->thread);
+	}
+	return NULL;
+}
+
+/*
+ * Items go to whichever thread is free; if a thread cannot be started the
+ * others pick up its share.
+ */
+void wsf_parallel_run(unsigned int threads, wsf_parallel_work work, void *context, size_t count) {
+	struct wsf_parallel_pool pool = { work, context, count, 0 };
+	struct wsf_parallel_worker workers[WSF_PARALLEL_THREADS_MAX];
+	pthread_t handles[WSF_PARALLEL_THREADS_MAX];
+	bool started[WSF_PARALLEL_THREADS_MAX];
+	unsigned int wanted = threads;
+	unsigned int i = 0;
+
+	if (wanted > WSF_PARALLEL_THREADS_MAX) {
+		wanted = WSF_PARALLEL_THREADS_MAX;
+	}
+	if (wanted == 0 || (size_t) wanted > count) {
+		wanted = count == 0 ? 1 : (unsigned int) count;
+	}
+	for (i = 0; i < wanted; i++) {
+		workers[i].pool = &pool;
+		workers[i].thread = i;
+		started[i] = i > 0 &&
+			pthread_create(&handles[i], NULL, wsf_parallel_worker_main, &workers[i]) == 0;
+	}
+
+	wsf_parallel_worker_main(&workers[0]);
+	for (i = 1; i < wanted; i++) {
+		if (started[i]) {
+			pthread_join(handles[i], NULL);
+		}
+	}
+}
+
+unsigned int wsf_parallel_default_threads(void) {
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (online < 1) {
+		return 1;
+	}
+	return online > WSF_PARALLEL_THREADS_MAX ? WSF_PARALLEL_THREADS_MAX : (unsigned int) online;
+}
+
+bool wsf_parallel_parse_threads(const char *input, unsigned int *out_threads) {
+	char *end = NULL;
+	long threads = strtol(input, &end, 10);
+
+	if (end == input || *end != '\0' || threads < 1 || threads > WSF_PARALLEL_THREADS_MAX) {
+		fprintf(stderr, "--threads takes 1 to %d.\n", WSF_PARALLEL_THREADS_MAX);
+		return false;
+	}
+	*out_threads = (unsigned int) threads;
+	return true;
+}
+
+double wsf_parallel_elapsed(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) (now.tv_sec - start->tv_sec) +
+		((double) (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+bool wsf_parallel_grow(void **array, size_t element, size_t count) {
+	void *grown = realloc(*array, element * count);
+
+	if (grown == NULL) {
+		return false;
+	}
+	*array = grown;
+	return true;
+}